@@ -1,49 +1,78 @@
 #include "altitude_control.h"
 #include "../drivers/thruster/Thruster.h"
+#include "../drivers/dvl/DVL.h"
 #include <stdio.h>
 #include <math.h>
-#include <time.h> // 引入时间头文件
+#include "../sys/clock/clock.h"
+#include "../sys/log/log.h"
 
-static time_t g_last_control_time = 0; // 上次控制的时间
+static int64_t g_start_ms = 0;       // 启动的时间 (Clock_nowMs，数据超时检查的宽限期从这里开始)
+static int64_t g_last_print_ms = 0;  // 上次打印调试信息的时间 (Clock_nowMs)
 
 volatile int g_altitude_control_enabled = 0;
 volatile double g_target_altitude = 0.0;
 
-// 参数调优 (定高时，离底太近比较危险，建议死区和阈值根据实际地形调整)
-#define ALT_DEAD_ZONE       0.50   // 死区：±20cm
-#define ALT_LEVEL_LOW_TH    1.00   // 1档微调阈值：50cm
-#define ALT_LEVEL_HIGH_TH   2.00   // 高速阈值：1.5m
+// 参数调优 (定高时，离底太近比较危险，建议死区和比例系数根据实际地形调整)
+#define ALT_DATA_TIMEOUT_MS 3000   // 传感器数据超时 (毫秒)
+#define ALT_DEAD_ZONE       0.10   // 死区：±10cm
+#define ALT_KP              (THRUSTER_SPEED_MAX / 2.0)     // 比例系数：误差2m时全速
+#define ALT_MIN_SPEED       (THRUSTER_SPEED_PER_LEVEL / 2) // 死区外的最小转速
 
-// 浮力配平 (通常AUV是正浮力，停止时会自动上浮，所以维持高度可能需要微弱下潜)
-// 如果你的机器人在死区内总是飘上去，这里请改为 THRUSTER_LEVEL_1
-#define ALT_BUOYANCY_COMPENSATION  THRUSTER_STOP 
+// 浮力配平转速 (通常AUV是正浮力，停止时会自动上浮，所以维持高度可能需要微弱下潜)
+// 如果你的机器人在死区内总是飘上去，这里请改为一个小的正值，例如 THRUSTER_SPEED_PER_LEVEL / 2
+#define ALT_BUOYANCY_COMPENSATION  0
+
+/* 辅助：控制器按固定频率 (10~50Hz) 运行，调试信息每秒最多打印一次 */
+static int AltitudeControl_PrintDue(void) {
+    int64_t now = Clock_nowMs();
+    if (now - g_last_print_ms < 1000) return 0;
+    g_last_print_ms = now;
+    return 1;
+}
+
+/* 辅助：由高度误差计算垂直转速 (注意方向与定深相反：太低要上浮，输出为负) */
+static int AltitudeControl_Output(double error) {
+    double out = -ALT_KP * error;
+
+    if (out > 0 && out < ALT_MIN_SPEED) out = ALT_MIN_SPEED;
+    if (out < 0 && out > -ALT_MIN_SPEED) out = -ALT_MIN_SPEED;
+
+    // 加上配平后在浮点里限幅，再转成整数 (误差很大时 (int) 转换会溢出)
+    out += ALT_BUOYANCY_COMPENSATION;
+    if (out > THRUSTER_SPEED_MAX)  out = THRUSTER_SPEED_MAX;
+    if (out < -THRUSTER_SPEED_MAX) out = -THRUSTER_SPEED_MAX;
+    return (int)out;
+}
 
 void AltitudeControl_Start(double target) {
+    if (!isfinite(target)) {
+        LOG_E(LOG_MOD_ALTITUDE, "[AutoAlt] 目标值无效，定高未启动\n");
+        return;
+    }
     g_target_altitude = target;
     // [关键修改] 启动时重置时间戳！
     // 这相当于告诉看门狗：“我刚启动，请给我 3秒钟 时间等传感器数据”
-    g_last_control_time = time(NULL);
+    g_start_ms = Clock_nowMs();
     g_altitude_control_enabled = 1;
-    printf("[AutoAlt] 定高模式启动，目标离底高度: %.2f 米\n", target);
+    LOG_I(LOG_MOD_ALTITUDE, "[AutoAlt] 定高模式启动，目标离底高度: %.2f 米\n", target);
 }
 
 void AltitudeControl_Stop(void) {
     if(g_altitude_control_enabled) {
         g_altitude_control_enabled = 0;
         Thruster_Stop();
-        printf("[AutoAlt] 定高模式已停止\n");
+        LOG_I(LOG_MOD_ALTITUDE, "[AutoAlt] 定高模式已停止\n");
     }
 }
 
 void AltitudeControl_Loop(float current_altitude) {
-    g_last_control_time = time(NULL); // 更新时间戳
-    
     if (!g_altitude_control_enabled) return;
+    int verbose = AltitudeControl_PrintDue();
 
     // [安全保护] DVL 丢失底锁时通常返回 0 或 -1，或者极小值
     // 如果离底太近（<0.3m）或者数据无效，必须强制上浮或停机，防止撞底
-    if (current_altitude < 0.3) { 
-        printf("[AutoAlt] 警告：离底过近或数据无效 (%.2f)，强制停机/上浮！\n", current_altitude);
+    if (!isfinite(current_altitude) || current_altitude < 0.3) { 
+        if (verbose) LOG_W(LOG_MOD_ALTITUDE, "[AutoAlt] 警告：离底过近或数据无效 (%.2f)，强制停机/上浮！\n", current_altitude);
         // 这里策略很关键：是停机还是紧急上浮？
         // 建议先停机，避免推进器卷入泥沙；或者用1档轻轻上浮
         Thruster_Stop(); 
@@ -53,39 +82,20 @@ void AltitudeControl_Loop(float current_altitude) {
 
     double error = g_target_altitude - current_altitude;
     
-    printf("[AutoAlt] Target: %.2f, Curr: %.2f, Err: %.2f\n", g_target_altitude, current_altitude, error);
+    if (verbose) LOG_I(LOG_MOD_ALTITUDE, "[AutoAlt] Target: %.2f, Curr: %.2f, Err: %.2f\n", g_target_altitude, current_altitude, error);
 
     // 1. 死区判断
     if (fabs(error) <= ALT_DEAD_ZONE) {
-        if (ALT_BUOYANCY_COMPENSATION == THRUSTER_STOP) {
+        if (ALT_BUOYANCY_COMPENSATION == 0) {
              Thruster_StopVertical(); // [修改] 只停垂直
         } else {
-             Thruster_Sinking(ALT_BUOYANCY_COMPENSATION);
+             Thruster_SetVertical(ALT_BUOYANCY_COMPENSATION);
         }
         return;
     }
 
-    // 2. 动作判断 (注意方向与定深相反！)
-    if (error > 0) { 
-        // 目标 > 当前 (例如目标5m，当前2m)，太低了 -> 需要上浮 (Float)
-        if (error > ALT_LEVEL_HIGH_TH) {
-            Thruster_Floating(THRUSTER_LEVEL_5);
-        } else if (error > ALT_LEVEL_LOW_TH) {
-            Thruster_Floating(THRUSTER_LEVEL_3);
-        } else {
-            Thruster_Floating(THRUSTER_LEVEL_1);
-        }
-    } else {
-        // 目标 < 当前 (例如目标2m，当前5m)，太高了 -> 需要下潜 (Sink)
-        double abs_error = fabs(error);
-        if (abs_error > ALT_LEVEL_HIGH_TH) {
-            Thruster_Sinking(THRUSTER_LEVEL_5);
-        } else if (abs_error > ALT_LEVEL_LOW_TH) {
-            Thruster_Sinking(THRUSTER_LEVEL_3);
-        } else {
-            Thruster_Sinking(THRUSTER_LEVEL_1);
-        }
-    }
+    // 2. 比例输出 (目标 > 当前 太低了上浮，目标 < 当前 太高了下潜)
+    Thruster_SetVertical(AltitudeControl_Output(error));
 }
 
 // [新增] 安全检查函数，供主循环调用
@@ -93,13 +103,15 @@ void AltitudeControl_SafetyCheck(void) {
     // 1. 如果没开启定深，直接退出，不消耗 CPU，也不检查传感器
     if (!g_altitude_control_enabled) return;
 
-    time_t now = time(NULL);
+    dvlDataPack_t pack;
+    int64_t stamp;
+    DVL_getDataPack(&pack, &stamp);
     
     // 2. 检查超时
-    // 如果 Start() 之后 3秒内，或者上一次 Loop() 之后 3秒内
-    // 都没有新的传感器数据进来，说明传感器没开或挂了。
-    if (difftime(now, g_last_control_time) > 3.0) {
-        printf("[AutoDepth] 错误：传感器数据超时 (>3s)，可能未打开传感器？强制停止！\n");
+    // Start() 之后给一段宽限期；之后传感器最新样本超过超时时间没有更新，
+    // 说明传感器没开或挂了。
+    if (Clock_nowMs() - g_start_ms > ALT_DATA_TIMEOUT_MS && Bus_ageMs(stamp) > ALT_DATA_TIMEOUT_MS) {
+        LOG_E(LOG_MOD_ALTITUDE, "[AutoAlt] 错误：传感器数据超时 (>%dms)，可能未打开传感器？强制停止！\n", ALT_DATA_TIMEOUT_MS);
         AltitudeControl_Stop(); // 触发停机保护
     }
 }
\ No newline at end of file
@@ -9,7 +9,7 @@ extern volatile double g_target_altitude;
 void AltitudeControl_Init(void);
 void AltitudeControl_Start(double target);
 void AltitudeControl_Stop(void);
-// 核心算法，被DVL线程调用
+// 核心算法，被控制执行器按固定频率调用
 void AltitudeControl_Loop(float current_altitude); 
 
 void AltitudeControl_SafetyCheck(void); 
@@ -0,0 +1,264 @@
+/************************************************************************************
+					文件名：control_executor.c
+					描述：控制执行器实现
+ ************************************************************************************/
+
+#include "control_executor.h"
+#include "depth_control.h"
+#include "altitude_control.h"
+#include "navigation_control.h"
+#include "../drivers/ctd/CTD.h"
+#include "../drivers/dvl/DVL.h"
+#include "../drivers/thruster/Thruster.h"
+#include "../sys/clock/clock.h"
+#include "../sys/latency/latency.h"
+#include "../sys/trace/trace.h"
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  样本最大年龄(毫秒)，超过后不再用它计算输出，保持上一次的输出，
+    一直没有新数据时由SafetyCheck停机(CTD、DVL都是1Hz左右)  */
+#define CONTROL_DEPTH_MAX_AGE_MS    2000
+#define CONTROL_DVL_MAX_AGE_MS      2000
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+/*  控制频率    */
+static int g_control_rate_hz = CONTROL_RATE_DEFAULT_HZ;
+
+/*  定时器文件描述符    */
+static int g_control_timer_fd = -1;
+
+/*  执行统计(Epoll线程写，打印线程读)   */
+static controlExecStats_t g_control_stats = {0};
+static pthread_mutex_t g_control_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*  上一次用过的深度样本时间戳(只在Epoll线程中使用)，同一样本只记录一次延时  */
+static int64_t g_control_last_ctd_stamp = 0;
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:int ControlExec_SetRate(int hz)
+* 函数简介:设置控制频率，必须在ControlExec_Init之前调用
+* 函数参数:hz:控制频率，CONTROL_RATE_MIN_HZ ~ CONTROL_RATE_MAX_HZ
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int ControlExec_SetRate(int hz)
+{
+    if(g_control_timer_fd >= 0)
+    {
+        printf("ControlExec_SetRate:定时器已启动，不能再修改控制频率\n");
+        return -1;
+    }
+
+    if(hz < CONTROL_RATE_MIN_HZ || hz > CONTROL_RATE_MAX_HZ)
+    {
+        printf("ControlExec_SetRate:控制频率%dHz超出范围(%d~%dHz)\n", hz, CONTROL_RATE_MIN_HZ, CONTROL_RATE_MAX_HZ);
+        return -1;
+    }
+
+    g_control_rate_hz = hz;
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int ControlExec_GetRate(void)
+* 函数简介:获取控制频率
+* 函数参数:无
+* 函数返回值:控制频率(Hz)
+*****************************************************************/
+int ControlExec_GetRate(void)
+{
+    return g_control_rate_hz;
+}
+
+/*******************************************************************
+* 函数原型:int ControlExec_Init(void)
+* 函数简介:创建周期定时器(非阻塞)，由调用者加入Epoll监听
+* 函数参数:无
+* 函数返回值:成功返回定时器fd，失败返回-1
+*****************************************************************/
+int ControlExec_Init(void)
+{
+    if(g_control_timer_fd >= 0)
+    {
+        return g_control_timer_fd;
+    }
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(fd < 0)
+    {
+        perror("ControlExec_Init:timerfd_create");
+        return -1;
+    }
+
+    long periodNs = 1000000000L / g_control_rate_hz;
+    struct itimerspec spec = {
+        .it_interval = {periodNs / 1000000000L, periodNs % 1000000000L},
+        .it_value = {periodNs / 1000000000L, periodNs % 1000000000L}
+    };
+    if(timerfd_settime(fd, 0, &spec, NULL) < 0)
+    {
+        perror("ControlExec_Init:timerfd_settime");
+        close(fd);
+        return -1;
+    }
+
+    g_control_timer_fd = fd;
+
+    return fd;
+}
+
+/*******************************************************************
+* 函数原型:int ControlExec_getFD(void)
+* 函数简介:返回定时器文件描述符
+* 函数参数:无
+* 函数返回值:fd，没有初始化时返回-1
+*****************************************************************/
+int ControlExec_getFD(void)
+{
+    return g_control_timer_fd;
+}
+
+/*******************************************************************
+* 函数原型:void ControlExec_Tick(void)
+* 函数简介:定时器到期时调用。取最新的CTD、DVL样本，样本足够新时运行
+*          定深、定高、导航控制器(各控制器没有开启时直接返回)，并记录耗时
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void ControlExec_Tick(void)
+{
+    uint64_t expirations = 0;
+
+    /*  1.读定时器，到期多次说明错过了周期  */
+    if(read(g_control_timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+    {
+        if(errno != EAGAIN && errno != EINTR)
+        {
+            perror("ControlExec_Tick:timerfd read");
+        }
+        return;
+    }
+
+    int64_t startUs = Clock_nowUs();
+    Trace_begin("control", "Tick");
+    if(expirations > 1)
+    {
+        Trace_instant("control", "Missed");
+    }
+
+    /*  2.定深  */
+    ctdDataPack_t ctd;
+    int64_t ctdStamp;
+    int depthStale = 0;
+
+    CTD_getDataPack(&ctd, &ctdStamp);
+    if(Bus_ageMs(ctdStamp) <= CONTROL_DEPTH_MAX_AGE_MS)
+    {
+        if(ctdStamp != g_control_last_ctd_stamp)
+        {
+            g_control_last_ctd_stamp = ctdStamp;
+            Latency_recordSince(LATENCY_STAGE_CONTROL, ctdStamp);
+        }
+
+        /*  定深提交的推进器指令带上深度样本的时间戳，应答时记录端到端延时    */
+        Thruster_SetSampleStamp(ctdStamp);
+        Trace_begin("control", "Depth");
+        DepthControl_Loop(ctd.depth);
+        Trace_end("control", "Depth");
+        Thruster_SetSampleStamp(0);
+    }
+    else
+    {
+        depthStale = g_depth_control_enabled;
+    }
+
+    /*  3.定高、导航    */
+    dvlDataPack_t dvl;
+    int64_t dvlStamp;
+    int dvlStale = 0;
+
+    DVL_getDataPack(&dvl, &dvlStamp);
+    if(Bus_ageMs(dvlStamp) <= CONTROL_DVL_MAX_AGE_MS)
+    {
+        Trace_begin("control", "Altitude");
+        AltitudeControl_Loop(dvl.buttomDistance);
+        Trace_end("control", "Altitude");
+        Trace_begin("control", "Nav");
+        Nav_Loop(dvl.heading);
+        Trace_end("control", "Nav");
+    }
+    else
+    {
+        dvlStale = g_altitude_control_enabled || g_nav_control_enabled;
+    }
+
+    Trace_end("control", "Tick");
+
+    /*  4.统计  */
+    long costUs = (long)(Clock_nowUs() - startUs);
+
+    pthread_mutex_lock(&g_control_stats_mutex);
+    g_control_stats.ticks++;
+    g_control_stats.missed += expirations - 1;
+    if(costUs > 1000000L / g_control_rate_hz)
+    {
+        g_control_stats.overruns++;
+    }
+    g_control_stats.staleDepth += depthStale;
+    g_control_stats.staleDvl += dvlStale;
+    g_control_stats.lastUs = costUs;
+    if(costUs > g_control_stats.maxUs)
+    {
+        g_control_stats.maxUs = costUs;
+    }
+    g_control_stats.totalUs += costUs;
+    pthread_mutex_unlock(&g_control_stats_mutex);
+}
+
+/*******************************************************************
+* 函数原型:void ControlExec_getStats(controlExecStats_t *stats)
+* 函数简介:获取执行统计
+* 函数参数:stats:输出统计
+* 函数返回值:无
+*****************************************************************/
+void ControlExec_getStats(controlExecStats_t *stats)
+{
+    pthread_mutex_lock(&g_control_stats_mutex);
+    *stats = g_control_stats;
+    pthread_mutex_unlock(&g_control_stats_mutex);
+}
+
+/*******************************************************************
+* 函数原型:void ControlExec_PrintStats(void)
+* 函数简介:打印执行统计
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void ControlExec_PrintStats(void)
+{
+    controlExecStats_t stats;
+
+    if(g_control_timer_fd < 0)
+    {
+        return;
+    }
+
+    ControlExec_getStats(&stats);
+    printf("控制执行器(%dHz):执行%lu 错过周期%lu 超时%lu 深度过旧%lu DVL过旧%lu 耗时 最近%ldus 平均%lluus 最长%ldus\n",
+           g_control_rate_hz, stats.ticks, stats.missed, stats.overruns, stats.staleDepth, stats.staleDvl,
+           stats.lastUs, stats.ticks ? stats.totalUs / stats.ticks : 0, stats.maxUs);
+}
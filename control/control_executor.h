@@ -0,0 +1,61 @@
+/************************************************************************************
+					文件名：control_executor.h
+					描述：控制执行器。由timerfd按固定频率驱动，在Epoll线程中运行定深、定高、
+						  导航控制器，输入取总线上最新的传感器样本(带年龄检查)
+ ************************************************************************************/
+
+#ifndef __CONTROL_EXECUTOR_H__
+#define __CONTROL_EXECUTOR_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <time.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  控制频率范围(Hz)    */
+#define CONTROL_RATE_MIN_HZ         10
+#define CONTROL_RATE_MAX_HZ         50
+#define CONTROL_RATE_DEFAULT_HZ     20
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  执行统计    */
+typedef struct
+{
+    unsigned long ticks;                //执行次数
+    unsigned long missed;               //错过的周期(Epoll线程来不及处理，定时器到期多次才读一次)
+    unsigned long overruns;             //执行时间超过一个周期的次数
+    unsigned long staleDepth;           //深度样本过旧而跳过定深的次数
+    unsigned long staleDvl;             //DVL样本过旧而跳过定高/导航的次数
+    long lastUs;                        //最近一次执行耗时(微秒)
+    long maxUs;                         //最长执行耗时(微秒)
+    unsigned long long totalUs;         //累计执行耗时(微秒)
+}controlExecStats_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  控制频率(在ControlExec_Init之前设置)  */
+int ControlExec_SetRate(int hz);
+int ControlExec_GetRate(void);
+
+/*  初始化:创建并启动定时器    */
+int ControlExec_Init(void);
+int ControlExec_getFD(void);
+
+/*  定时器到期时调用(Epoll线程) */
+void ControlExec_Tick(void);
+
+/*  统计    */
+void ControlExec_getStats(controlExecStats_t *stats);
+void ControlExec_PrintStats(void);
+
+#endif
@@ -1,31 +1,61 @@
 #include "depth_control.h"
 #include "../drivers/thruster/Thruster.h"
+#include "../drivers/ctd/CTD.h"
 #include <stdio.h>
 #include <math.h>
-#include <time.h> // 引入时间头文件
+#include "../sys/clock/clock.h"
+#include "../sys/log/log.h"
 
-static time_t g_last_control_time = 0; // 上次控制的时间
+static int64_t g_start_ms = 0;       // 启动的时间 (Clock_nowMs，数据超时检查的宽限期从这里开始)
+static int64_t g_last_print_ms = 0;  // 上次打印调试信息的时间 (Clock_nowMs)
 
 volatile int g_depth_control_enabled = 0;
 volatile double g_target_depth = 0.0;
 
 // 参数调优宏定义
-#define DEAD_ZONE       0.50   // 死区：±50cm
-#define LEVEL_LOW_TH    1.00   // 低速阈值：1m
-#define LEVEL_HIGH_TH   2.00   // 高速阈值：2m
+#define DEPTH_DATA_TIMEOUT_MS 3000   // 传感器数据超时 (毫秒)
+#define DEAD_ZONE       0.10   // 死区：±10cm (比例输出在目标附近自然减小，死区只用来滤掉传感器噪声)
+#define DEPTH_KP        (THRUSTER_SPEED_MAX / 2.0)     // 比例系数：误差2m时全速
+#define DEPTH_MIN_SPEED (THRUSTER_SPEED_PER_LEVEL / 2) // 死区外的最小转速，低于此值推进器转不起来
 
-// 浮力配平档位 (如果机器人在水里会自动上浮，这里可能需要填 1 或 2，表示停止时其实要保持微弱下潜)
-#define BUOYANCY_COMPENSATION_LEVEL THRUSTER_STOP 
+// 浮力配平转速 (如果机器人在水里会自动上浮，这里填一个小的正值，表示停止时其实要保持微弱下潜)
+#define BUOYANCY_COMPENSATION_SPEED 0
+
+/* 辅助：控制器按固定频率 (10~50Hz) 运行，调试信息每秒最多打印一次 */
+static int DepthControl_PrintDue(void) {
+    int64_t now = Clock_nowMs();
+    if (now - g_last_print_ms < 1000) return 0;
+    g_last_print_ms = now;
+    return 1;
+}
+
+/* 辅助：由深度误差计算垂直转速 (正值下潜，负值上浮) */
+static int DepthControl_Output(double error) {
+    double out = DEPTH_KP * error;
+
+    if (out > 0 && out < DEPTH_MIN_SPEED) out = DEPTH_MIN_SPEED;
+    if (out < 0 && out > -DEPTH_MIN_SPEED) out = -DEPTH_MIN_SPEED;
+
+    // 加上配平后在浮点里限幅，再转成整数 (误差很大时 (int) 转换会溢出)
+    out += BUOYANCY_COMPENSATION_SPEED;
+    if (out > THRUSTER_SPEED_MAX)  out = THRUSTER_SPEED_MAX;
+    if (out < -THRUSTER_SPEED_MAX) out = -THRUSTER_SPEED_MAX;
+    return (int)out;
+}
 
 void DepthControl_Start(double target) {
+    if (!isfinite(target)) {
+        LOG_E(LOG_MOD_DEPTH, "[AutoDepth] 目标值无效，定深未启动\n");
+        return;
+    }
     g_target_depth = target;
     
     // [关键修改] 启动时重置时间戳！
     // 这相当于告诉看门狗：“我刚启动，请给我 3秒钟 时间等传感器数据”
-    g_last_control_time = time(NULL); 
+    g_start_ms = Clock_nowMs();
     
     g_depth_control_enabled = 1;
-    printf("[AutoDepth] 定深启动，目标: %.2f，等待传感器数据...\n", target);
+    LOG_I(LOG_MOD_DEPTH, "[AutoDepth] 定深启动，目标: %.2f，等待传感器数据...\n", target);
 }
 
 void DepthControl_Stop(void) {
@@ -34,65 +64,47 @@ void DepthControl_Stop(void) {
 }
 
 void DepthControl_Loop(double current_depth) {
-    g_last_control_time = time(NULL); // 更新时间戳
-
     if (!g_depth_control_enabled) return;
+    int verbose = DepthControl_PrintDue();
 
     double error = g_target_depth - current_depth;
     
     // 打印调试信息，方便上位机监控
-    printf("[AutoDepth] Target: %.2f, Curr: %.2f, Err: %.2f\n", g_target_depth, current_depth, error);
+    if (verbose) LOG_I(LOG_MOD_DEPTH, "[AutoDepth] Target: %.2f, Curr: %.2f, Err: %.2f\n", g_target_depth, current_depth, error);
     // [新增] 安全保护：如果深度数据异常（例如在空气中或传感器故障），强制停止
-    if (current_depth < 0.3) { // 假设有效作业深度至少0.3米
-        printf("[AutoDepth] 警告：当前深度过浅 (%.2f)，可能在水面或数据异常，暂停推进！\n", current_depth);
+    if (!isfinite(current_depth) || current_depth < 0.3) { // 假设有效作业深度至少0.3米
+        if (verbose) LOG_W(LOG_MOD_DEPTH, "[AutoDepth] 警告：当前深度过浅 (%.2f)，可能在水面或数据异常，暂停推进！\n", current_depth);
         Thruster_Stop();
         return;
     }
 
     // 1. 进入死区
     if (fabs(error) <= DEAD_ZONE) {
-        if (BUOYANCY_COMPENSATION_LEVEL == THRUSTER_STOP) {
+        if (BUOYANCY_COMPENSATION_SPEED == 0) {
              Thruster_StopVertical(); // [修改] 只停垂直，不影响水平导航
         } else {
-             Thruster_Sinking(BUOYANCY_COMPENSATION_LEVEL);
+             Thruster_SetVertical(BUOYANCY_COMPENSATION_SPEED);
         }
         return;
     }
 
-    // 2. 动作判断
-    if (error > 0) { 
-        // 目标 > 当前，说明在上方，需要下潜 (Sinking)
-        if (error > LEVEL_HIGH_TH) {
-            Thruster_Sinking(THRUSTER_LEVEL_5); // 误差大，全速下潜
-        } else if (error > LEVEL_LOW_TH) {
-            Thruster_Sinking(THRUSTER_LEVEL_3); // 误差中，中速下潜
-        } else {
-            Thruster_Sinking(THRUSTER_LEVEL_1); // 误差小，慢速下潜
-        }
-    } else {
-        // 目标 < 当前，说明在下方，需要上浮 (Floating)
-        double abs_error = fabs(error);
-        if (abs_error > LEVEL_HIGH_TH) {
-            Thruster_Floating(THRUSTER_LEVEL_5);
-        } else if (abs_error > LEVEL_LOW_TH) {
-            Thruster_Floating(THRUSTER_LEVEL_3);
-        } else {
-            Thruster_Floating(THRUSTER_LEVEL_1);
-        }
-    }
+    // 2. 比例输出：目标 > 当前 (在上方) 为正，下潜；目标 < 当前 (在下方) 为负，上浮
+    Thruster_SetVertical(DepthControl_Output(error));
 }
 // [新增] 安全检查函数，供主循环调用
 void DepthControl_SafetyCheck(void) {
     // 1. 如果没开启定深，直接退出，不消耗 CPU，也不检查传感器
     if (!g_depth_control_enabled) return;
 
-    time_t now = time(NULL);
+    ctdDataPack_t pack;
+    int64_t stamp;
+    CTD_getDataPack(&pack, &stamp);
     
     // 2. 检查超时
-    // 如果 Start() 之后 3秒内，或者上一次 Loop() 之后 3秒内
-    // 都没有新的传感器数据进来，说明传感器没开或挂了。
-    if (difftime(now, g_last_control_time) > 3.0) {
-        printf("[AutoDepth] 错误：传感器数据超时 (>3s)，可能未打开传感器？强制停止！\n");
+    // Start() 之后给一段宽限期；之后传感器最新样本超过超时时间没有更新，
+    // 说明传感器没开或挂了。
+    if (Clock_nowMs() - g_start_ms > DEPTH_DATA_TIMEOUT_MS && Bus_ageMs(stamp) > DEPTH_DATA_TIMEOUT_MS) {
+        LOG_E(LOG_MOD_DEPTH, "[AutoDepth] 错误：传感器数据超时 (>%dms)，可能未打开传感器？强制停止！\n", DEPTH_DATA_TIMEOUT_MS);
         DepthControl_Stop(); // 触发停机保护
     }
 }
\ No newline at end of file
@@ -9,7 +9,7 @@ extern volatile double g_target_depth;
 void DepthControl_Init(void);
 void DepthControl_Start(double target);
 void DepthControl_Stop(void);
-void DepthControl_Loop(double current_depth); // 核心算法，被CTD线程调用
+void DepthControl_Loop(double current_depth); // 核心算法，被控制执行器按固定频率调用
 void DepthControl_SafetyCheck(void);
 
 #endif
\ No newline at end of file
@@ -2,8 +2,9 @@
 #include "../drivers/thruster/Thruster.h"
 #include <stdio.h>
 #include <math.h>
-#include <time.h>
 #include "../drivers/ctd/CTD.h"
+#include "../sys/clock/clock.h"
+#include "../sys/log/log.h"
 
 /* 常量定义 */
 #define PI 3.14159265358979323846
@@ -15,13 +16,19 @@
 #define NAV_ALIGN_THRESHOLD  15.0  // 对准阈值：航向误差 < 15度 允许直行
 #define NAV_RE_ALIGN_TRIGGER 30.0  // 重新对准阈值：航向误差 > 30度 切换回原地旋转
 #define NAV_ARRIVAL_DIST     6.0   // 到达阈值：距离 < 3米 视为到达
-#define NAV_DATA_TIMEOUT     10.0   // 数据超时时间 (秒)
+#define NAV_DATA_TIMEOUT_MS  10000  // 定位数据超时时间 (毫秒)
+#define NAV_DEPTH_MAX_AGE_MS 3000   // 深度样本最大年龄 (毫秒)，超过视为CTD失效
+#define NAV_YAW_KP           (THRUSTER_SPEED_MAX / 90.0)        // 转向比例系数：误差90度时全速转向
+#define NAV_YAW_MAX          (THRUSTER_SPEED_PER_LEVEL * 2)     // 原地旋转最大转速 (2档，避免太快转过头)
+#define NAV_YAW_MIN          (THRUSTER_SPEED_PER_LEVEL / 2)     // 原地旋转最小转速，低于此值转不起来
+#define NAV_CRUISE_SPEED     (THRUSTER_SPEED_PER_LEVEL * 4)     // 巡航前进转速 (4档)
 
 /* 状态变量 */
 volatile int g_nav_control_enabled = 0;
 static double g_target_lat = 0.0, g_target_lon = 0.0;
 static double g_curr_lat = 0.0,   g_curr_lon = 0.0;
-static time_t g_last_pos_time = 0; // 上次收到定位数据的时间
+static int64_t g_last_pos_ms = 0; // 上次收到定位数据的时间 (单调时钟，毫秒)
+static int64_t g_last_print_ms = 0; // 上次打印调试信息的时间 (单调时钟，毫秒)
 
 static pthread_mutex_t g_nav_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -47,7 +54,7 @@ void Nav_SetTarget(double lat, double lon) {
     g_target_lon = lon;
     g_nav_control_enabled = 1; // 收到目标自动开启导航
     g_nav_state = NAV_STATE_ALIGNING; // 重置为对准状态
-    printf("[AutoNav] 收到新目标: Lat=%.6f, Lon=%.6f -> 导航启动！\n", lat, lon);
+    LOG_I(LOG_MOD_NAV, "[AutoNav] 收到新目标: Lat=%.6f, Lon=%.6f -> 导航启动！\n", lat, lon);
 }
 
 /* 更新当前位置 (收到 /.../) */
@@ -58,7 +65,7 @@ void Nav_UpdateCurrentPos(double lat, double lon) {
     pthread_mutex_lock(&g_nav_mutex); // 加锁
     g_curr_lat = lat;
     g_curr_lon = lon;
-    g_last_pos_time = time(NULL);
+    g_last_pos_ms = Clock_nowMs();
     pthread_mutex_unlock(&g_nav_mutex); // 解锁
 }
 
@@ -68,7 +75,7 @@ void Nav_Stop(void) {
         g_nav_control_enabled = 0;
         g_nav_state = NAV_STATE_IDLE;
         Thruster_StopHorizontal(); // [修改] 导航结束只停水平，不让机器人掉下来
-        printf("[AutoNav] 导航已停止。\n");
+        LOG_I(LOG_MOD_NAV, "[AutoNav] 导航已停止。\n");
     }
 }
 
@@ -89,19 +96,44 @@ static double Calc_Bearing(double lat1, double lon1, double lat2, double lon2) {
     return fmod((RAD2DEG(bearing) + 360.0), 360.0);
 }
 
+/* 辅助：由航向误差计算转向量 (正值右转)，限幅在 ±limit 以内 */
+static int Calc_YawOutput(double head_err, double limit) {
+    double yaw = NAV_YAW_KP * head_err;
+    if (yaw > limit)  yaw = limit;
+    if (yaw < -limit) yaw = -limit;
+    return (int)yaw;
+}
+
 // [control/navigation_control.c]
 
-/* 核心循环 (1Hz) */
+/* 辅助：控制器按固定频率 (10~50Hz) 运行，调试信息每秒最多打印一次 */
+static int Nav_PrintDue(void) {
+    int64_t now = Clock_nowMs();
+    if (now - g_last_print_ms < 1000) return 0;
+    g_last_print_ms = now;
+    return 1;
+}
+
+/* 核心循环 (由控制执行器按固定频率调用) */
 void Nav_Loop(float current_heading) {
     if (!g_nav_control_enabled) return;
+    int verbose = Nav_PrintDue();
 
     // ---------------------------------------------------------
     // 1. [新增] 浅水保护 (防止水面打水漂)
     // ---------------------------------------------------------
-    // 获取当前深度，如果小于 0.2m (接近水面)，强制停车并暂停导航
-    float current_depth = CTD_getDepthValue(); 
+    // 获取当前深度快照，如果小于 0.2m (接近水面) 或样本过旧，强制停车并暂停导航
+    ctdDataPack_t ctd;
+    int64_t ctd_stamp;
+    CTD_getDataPack(&ctd, &ctd_stamp);
+    float current_depth = (float)ctd.depth;
+    if (Bus_ageMs(ctd_stamp) > NAV_DEPTH_MAX_AGE_MS) {
+        if (verbose) LOG_W(LOG_MOD_NAV, "[AutoNav] 警告: 深度数据过旧或没有数据，暂停导航！\n");
+        Thruster_Stop();
+        return;
+    }
     if (current_depth < 0.2f) {
-        printf("[AutoNav] 警告: 深度过浅 (%.2fm)，暂停导航防止推进器空转！\n", current_depth);
+        if (verbose) LOG_W(LOG_MOD_NAV, "[AutoNav] 警告: 深度过浅 (%.2fm)，暂停导航防止推进器空转！\n", current_depth);
         Thruster_Stop();
         return; 
     }
@@ -109,9 +141,8 @@ void Nav_Loop(float current_heading) {
     // ---------------------------------------------------------
     // 2. 安全看门狗检查
     // ---------------------------------------------------------
-    time_t now = time(NULL);
-    if (difftime(now, g_last_pos_time) > NAV_DATA_TIMEOUT) {
-        printf("[AutoNav] 错误：定位数据超时 (>%.0fs)，强制停车！\n", NAV_DATA_TIMEOUT);
+    if (Clock_nowMs() - g_last_pos_ms > NAV_DATA_TIMEOUT_MS) {
+        LOG_E(LOG_MOD_NAV, "[AutoNav] 错误：定位数据超时 (>%dms)，强制停车！\n", NAV_DATA_TIMEOUT_MS);
         Nav_Stop();
         return;
     }
@@ -140,7 +171,7 @@ void Nav_Loop(float current_heading) {
     if (head_err > 180.0)  head_err -= 360.0;
     if (head_err < -180.0) head_err += 360.0;
 
-    printf("[AutoNav] Dist: %.1fm | Bear: %.1f | CurrHead: %.1f | Err: %.1f | State: %d\n", 
+    if (verbose) LOG_I(LOG_MOD_NAV, "[AutoNav] Dist: %.1fm | Bear: %.1f | CurrHead: %.1f | Err: %.1f | State: %d\n", 
            dist, target_heading, current_heading, head_err, g_nav_state);
 
     // ---------------------------------------------------------
@@ -152,9 +183,11 @@ void Nav_Loop(float current_heading) {
             if (fabs(head_err) < NAV_ALIGN_THRESHOLD) {
                 g_nav_state = NAV_STATE_CRUISING;
             } else {
-                // 原地旋转 (使用2档，避免太快转过头)
-                if (head_err > 0) Thruster_TurnRight(THRUSTER_LEVEL_2);
-                else              Thruster_TurnLeft(THRUSTER_LEVEL_2);
+                // 原地旋转，转速随误差减小，接近目标航向时减速，避免转过头
+                int yaw = Calc_YawOutput(head_err, NAV_YAW_MAX);
+                if (yaw > 0 && yaw < NAV_YAW_MIN)  yaw = NAV_YAW_MIN;
+                if (yaw < 0 && yaw > -NAV_YAW_MIN) yaw = -NAV_YAW_MIN;
+                Thruster_SetHorizontal(0, yaw);
             }
             break;
 
@@ -169,16 +202,16 @@ void Nav_Loop(float current_heading) {
                 Thruster_StopHorizontal(); 
             } 
             else {
-                // 航向基本正确，全速前进 (使用4档)
-                // 此时虽然有小误差，但依靠下一次循环的 RE_ALIGN_TRIGGER 来纠偏
-                Thruster_Forward(THRUSTER_LEVEL_4);
+                // 航向基本正确，巡航前进，同时按航向误差差速纠偏
+                // 偏航过大时仍依靠 RE_ALIGN_TRIGGER 切回原地旋转
+                Thruster_SetHorizontal(NAV_CRUISE_SPEED, Calc_YawOutput(head_err, NAV_YAW_MAX));
             }
             break;
 
         case NAV_STATE_ARRIVED:
             // 阶段C：到达
             Thruster_StopHorizontal(); 
-            printf("[AutoNav] 到达目标点！(误差 < %.1fm) 导航结束。\n", dist);
+            LOG_I(LOG_MOD_NAV, "[AutoNav] 到达目标点！(误差 < %.1fm) 导航结束。\n", dist);
             g_nav_control_enabled = 0; // 关闭导航使能
             break;
             
@@ -10,7 +10,7 @@ void Nav_SetTarget(double lat, double lon);       // 设置目标点 (由USBL调
 void Nav_UpdateCurrentPos(double lat, double lon);// 更新当前位置 (由USBL调用)
 void Nav_Stop(void);                              // 停止导航
 
-// 核心控制循环，挂载在 DVL 线程中执行 (1Hz)
+// 核心控制循环，由控制执行器按固定频率调用 (10~50Hz)
 void Nav_Loop(float current_heading);
 
 #endif
\ No newline at end of file
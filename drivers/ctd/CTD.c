@@ -6,6 +6,7 @@
  
 #include "CTD.h"
 #include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/log/log.h"
 #include "../../sys/epoll/epoll_manager.h"
 
 /************************************************************************************
@@ -22,18 +23,6 @@ extern pthread_t g_tid_ctd;
 /*  工作状态    */
 volatile int g_ctd_status = -1;			//-1为不可工作，1为可以工作
 
-/*	保存解析后的数据	*/
-ctdDataPack_t g_ctdDataPack = 
-{
-	.temperature = 0.0,
-	.conductivity = 0.0,
-	.pressure = 0.0,
-	.depth = 0.0,
-	.salinity = 0.0,
-	.soundVelocity = 0.0,
-	.density = 0.0
-};
-
 /************************************************************************************
  									全局变量(仅可本文件使用)
 *************************************************************************************/
@@ -46,9 +35,20 @@ static int g_ctd_fd = -1;
 /*	读取原始数据之后 存放的数组	*/
 static char g_ctd_readbuf[64] = {0};
 
+/*	串口接收缓冲区与帧格式('$'开头，'\n'结尾)	*/
+static serialPortStream_t g_ctd_stream;
+static const serialPortFramer_t g_ctd_framer = {SerialPort_extractDelimited, "$", 1, '\n', 1, sizeof(g_ctd_readbuf) - 1};
+
 /*	读写锁	*/
 static pthread_rwlock_t g_ctd_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
+/*	解析中的数据(只在解析线程中使用)，解析完整后发布到总线	*/
+static ctdDataPack_t g_ctdDataPack = {0};
+
+/*	最新值总线:其他线程通过CTD_getDataPack取快照	*/
+static ctdDataPack_t g_ctd_sample = {0};
+static busSlot_t g_ctd_bus = BUS_SLOT_INITIALIZER(g_ctd_sample);
+
 /*	旧的串口配置	*/
 static struct termios g_ctd_oldSerialPortConfig = {0};
 
@@ -178,6 +178,7 @@ int CTD_Init_default(void)
         return -1;
     }
     
+	SerialPort_streamInit(&g_ctd_stream, g_ctd_fd, "CTD", &g_ctd_framer);
 	g_ctd_status = 1;
     return 0;
 }
@@ -214,11 +215,35 @@ int CTD_Init(void)
 		return -1;
 	}
 
+	/*	3.初始化接收缓冲区	*/
+	SerialPort_streamInit(&g_ctd_stream, g_ctd_fd, "CTD", &g_ctd_framer);
+
 	sleep(3);	//数据延时等待
 
 	return 0;
 }
 
+ /*******************************************************************
+ * 函数原型:int CTD_Reopen(void)
+ * 函数简介:串口挂断(如USB串口拔出)后重新打开CTD。旧的文件描述符已失效，直接关闭、不恢复旧配置，再重新初始化
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int CTD_Reopen(void)
+{
+	/*	1.关闭失效的文件描述符	*/
+	pthread_rwlock_wrlock(&g_ctd_rwlock);
+	if(g_ctd_fd >= 0)
+	{
+		close(g_ctd_fd);
+		g_ctd_fd = -1;
+	}
+	pthread_rwlock_unlock(&g_ctd_rwlock);
+
+	/*	2.重新打开并配置串口	*/
+	return CTD_Init();
+}
+
 
  /*******************************************************************
  * 函数原型:int CTD_Close_default(void)
@@ -291,76 +316,74 @@ int CTD_Close(void)
 
 
 /*******************************************************************
-* 函数原型:int CTD_ReadRawData(void)
-* 函数功能: 从CTD设备读取完整数据帧
+* 函数原型:ssize_t CTD_ReadRawData(void)
+* 函数功能: 从接收缓冲区取出一帧完整数据，缓冲区中没有完整的帧时再读串口
 * 参数说明:无
 * 返回值:
-*   成功返回0，失败返回-1
+*   成功返回帧长度，没有完整的帧返回0，失败返回-1:
+*   读取错误时errno为read的错误，帧无效时errno为EBADMSG(缓冲区中可能还有帧)
 * 注意事项:
 *   1. 会自动在数据末尾添加字符串结束符
-*   2. 超时或错误时会清空缓冲区并写入"invalid"
+*   2. 读取错误或长度错误时写入"invalid"
+*   3. 不完整的帧保留在接收缓冲区中，等下次数据到达后继续拼接
+*   4. 返回帧长度或帧无效后缓冲区中可能还有帧，应继续调用直到返回0或读取错误
 ********************************************************************/
-int CTD_ReadRawData(void)
+ssize_t CTD_ReadRawData(void)
 {
 	/* 0.*入口检查	*/
-    if(g_ctd_fd < 0 || g_ctd_readbuf == NULL || sizeof(g_ctd_readbuf) < g_ctdDataProtocol.length + 1)
+    if(g_ctd_fd < 0 || sizeof(g_ctd_readbuf) < g_ctdDataProtocol.length + 1)
 	{
+        errno = EBADF;
         return -1;
     }
 
-	int state = 0;			//读取状态
-	int nread = 0;		  //读取数据的总长度
-
 	pthread_rwlock_wrlock(&g_ctd_rwlock);
-    memset(g_ctd_readbuf, 0, sizeof(g_ctd_readbuf));
 
-	while(nread < g_ctdDataProtocol.length)
+	/*	1.按照协议取出一帧	*/
+	int nread = SerialPort_streamRead(&g_ctd_stream, g_ctd_readbuf, sizeof(g_ctd_readbuf));
+	if(nread == 0)
 	{
-        /*	读取数据	*/
-        char c;
-        if(read(g_ctd_fd, &c, 1) != 1)
-		{
-			tcflush(g_ctd_fd, TCIFLUSH);
-			perror("CTD_readData:read");
-			break;
-		}
-
-        /*	按照协议读取数据	*/
-        if(state == 0 && c == g_ctdDataProtocol.head_marker)
-		{
-            state = 1;		//开始读取
-			g_ctd_readbuf[nread++] = c;	//把数据头写进数组
-        }
-		else if(state == 1)
-		{
-            if(c == g_ctdDataProtocol.tail_marker)
-			{
-				g_ctd_readbuf[nread++] = c;
-                g_ctd_readbuf[nread] = '\0';
-				if(nread == g_ctdDataProtocol.length)
-				{
-					pthread_rwlock_unlock(&g_ctd_rwlock);
-					return 0;
-				}
-				else
-				{
-					g_ctd_readbuf[nread] = '\0';
-					printf("CTD_readData:length error\n");
-					break;
-				}
-            }
-            g_ctd_readbuf[nread++] = c;
-        }
-    }
-    
-	/*	如果发生异常	*/
+		pthread_rwlock_unlock(&g_ctd_rwlock);
+		return 0;
+	}
+	else if(nread == g_ctdDataProtocol.length)
+	{
+		pthread_rwlock_unlock(&g_ctd_rwlock);
+		return nread;
+	}
+	else if(nread < 0)
+	{
+		int err = errno;
+		memset(g_ctd_readbuf, 0, sizeof(g_ctd_readbuf));
+		pthread_rwlock_unlock(&g_ctd_rwlock);
+		LOG_E(LOG_MOD_CTD, "CTD_ReadRawData:read:%s\n", strerror(err));
+		errno = err;
+		return -1;
+	}
+
+	/*	帧长度错误	*/
+	g_ctd_stream.stats.badFrames++;
+	LOG_W(LOG_MOD_CTD, "CTD_readData:length error\n");
 	memset(g_ctd_readbuf, 0, sizeof(g_ctd_readbuf));
     strcpy(g_ctd_readbuf, "invalid");
 	pthread_rwlock_unlock(&g_ctd_rwlock);
+	errno = EBADMSG;
     return -1;
 }
 
 
+ /*******************************************************************
+ * 函数原型:serialPortStream_t *CTD_getStream(void)
+ * 函数简介:返回串口接收缓冲区，用于设置取帧策略和查看接收统计
+ * 函数参数:无
+ * 函数返回值: 接收缓冲区
+ *****************************************************************/
+serialPortStream_t *CTD_getStream(void)
+{
+	return &g_ctd_stream;
+}
+
+
  /*******************************************************************
  * 函数原型:int CTD_ParseData(char *ctdRawData)
  * 函数简介:解析CTD数据，并计算数据，把数据保存到g_ctdDataPack
@@ -372,12 +395,12 @@ int CTD_ParseData(void)
 	/*	0.入口检查	*/
 	if(g_ctd_readbuf == NULL)
 	{
-		printf("CTD_parseData:g_ctd_readbuf NULL\n");
+		LOG_W(LOG_MOD_CTD, "CTD_parseData:g_ctd_readbuf NULL\n");
 		return -1;
 	}
 	else if(strncmp(g_ctd_readbuf, "invalid", 7) == 0)
 	{
-		printf("CTD_parseData:原始数据无效\n");
+		LOG_W(LOG_MOD_CTD, "CTD_parseData:原始数据无效\n");
 		return -1;
 	}
 
@@ -386,7 +409,6 @@ int CTD_ParseData(void)
 	char temp_conductivity[16] = {0};
 
 	/*	1.解析数据	*/
-	pthread_rwlock_wrlock(&g_ctd_rwlock);
 	sscanf(g_ctd_readbuf, "%*[^T]T=%[0-9.Ee+-]%*[^P]P=%[0-9.Ee+-]%*[^C]C=%[0-9.Ee+-];\r\n",  temp_tempature, temp_pressure, temp_conductivity);
 	sscanf(temp_tempature,"%lf", &g_ctdDataPack.temperature);
 	sscanf(temp_pressure,"%lf", &g_ctdDataPack.pressure);
@@ -428,12 +450,26 @@ int CTD_ParseData(void)
 	// 2.4.深度计算
 	g_ctdDataPack.depth = g_ctdDataPack.pressure + 2.8;
 
-	pthread_rwlock_unlock(&g_ctd_rwlock);
+	/*	3.发布	*/
+	Bus_publish(&g_ctd_bus, &g_ctdDataPack, g_ctd_stream.frameStampNs);
 	
 	return 0;	
 }
 
 
+/*******************************************************************
+* 函数原型:int CTD_getDataPack(ctdDataPack_t *out, int64_t *stampNs)
+* 函数简介:获取最新一次解析结果的快照(任何线程都可以调用，不阻塞解析线程)
+* 函数参数:out:输出数据
+* 函数参数:stampNs:输出数据的时间戳(原始数据读入的时间，Clock_nowNs)，可以为NULL，用Bus_ageMs判断数据新旧
+* 函数返回值:成功返回0，还没有数据返回1
+*****************************************************************/
+int CTD_getDataPack(ctdDataPack_t *out, int64_t *stampNs)
+{
+	return Bus_read(&g_ctd_bus, out, stampNs);
+}
+
+
 /*******************************************************************
 * 函数原型:double CTD_getTemperatureValue(void)
 * 函数简介:获得温度数值。单位是摄氏度
@@ -442,7 +478,9 @@ int CTD_ParseData(void)
 *****************************************************************/ 
 double CTD_getTemperatureValue(void)
 {
-	return g_ctdDataPack.temperature;
+	ctdDataPack_t pack;
+	CTD_getDataPack(&pack, NULL);
+	return pack.temperature;
 }
 
 
@@ -454,7 +492,9 @@ double CTD_getTemperatureValue(void)
 *****************************************************************/ 
 double CTD_getPressureValue(void)
 {
-	return g_ctdDataPack.pressure;
+	ctdDataPack_t pack;
+	CTD_getDataPack(&pack, NULL);
+	return pack.pressure;
 }
 
 
@@ -466,7 +506,9 @@ double CTD_getPressureValue(void)
 *****************************************************************/ 
 double CTD_getConductivityValue(void)
 {
-	return g_ctdDataPack.conductivity;
+	ctdDataPack_t pack;
+	CTD_getDataPack(&pack, NULL);
+	return pack.conductivity;
 }
 
 
@@ -478,7 +520,9 @@ double CTD_getConductivityValue(void)
 *****************************************************************/ 
 double CTD_getDepthValue(void)
 {
-	return g_ctdDataPack.depth;
+	ctdDataPack_t pack;
+	CTD_getDataPack(&pack, NULL);
+	return pack.depth;
 }
 
 
@@ -490,7 +534,9 @@ double CTD_getDepthValue(void)
 *****************************************************************/ 
 double CTD_getSalinityValue(void)
 {
-	return g_ctdDataPack.salinity;
+	ctdDataPack_t pack;
+	CTD_getDataPack(&pack, NULL);
+	return pack.salinity;
 }
 
 
@@ -502,7 +548,9 @@ double CTD_getSalinityValue(void)
 *****************************************************************/ 
 double CTD_getSoundVelocityValue(void)
 {
-	return g_ctdDataPack.soundVelocity;
+	ctdDataPack_t pack;
+	CTD_getDataPack(&pack, NULL);
+	return pack.soundVelocity;
 }
 
 
@@ -514,7 +562,9 @@ double CTD_getSoundVelocityValue(void)
 *****************************************************************/ 
 double CTD_getDensityValue(void)
 {
-	return g_ctdDataPack.density;
+	ctdDataPack_t pack;
+	CTD_getDataPack(&pack, NULL);
+	return pack.density;
 }
 
 
@@ -526,10 +576,8 @@ double CTD_getDensityValue(void)
 *****************************************************************/ 
 void CTD_PrintAllData(void)
 {	
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-    printf("TIME: %d-%02d-%02d %02d:%02d:%02d\n",nowtime->tm_year + 1900,nowtime->tm_mon + 1,nowtime->tm_mday,\
-    											nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
+	char timeStr[CLOCK_FORMAT_LEN];
+    printf("TIME: %s\n", Clock_format(Clock_nowNs(), timeStr, sizeof(timeStr)));
 	printf("************CTD采集数据信息**************\n");
 	printf("温度:%8.3lf ℃\n", CTD_getTemperatureValue());
 	printf("压力:%8.3lf dbar\n", CTD_getPressureValue());
@@ -25,6 +25,8 @@
 #include <pthread.h>
 #include <math.h>
 #include <time.h>
+#include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/bus/bus.h"
  
 
 /************************************************************************************
@@ -59,18 +61,21 @@ int CTD_getFD(void);
 /*	初始化	*/
 int CTD_Init_default(void);
 int CTD_Init(void);
+int CTD_Reopen(void);
 
 /*	关闭传感器	*/
 int CTD_Close_default(void);
 int CTD_Close(void);
 
 /*	读取原始数据	*/
-int CTD_ReadRawData(void);
+ssize_t CTD_ReadRawData(void);
+serialPortStream_t *CTD_getStream(void);
 
 /*	解析数据	*/
 int CTD_ParseData(void);
 
 /*	获取数据	*/
+int CTD_getDataPack(ctdDataPack_t *out, int64_t *stampNs);
 double CTD_getTemperatureValue(void);
 double CTD_getPressureValue(void);
 double CTD_getConductivityValue(void);
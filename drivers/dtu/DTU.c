@@ -6,6 +6,8 @@
 
 #include "DTU.h"
 #include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/log/log.h"
+#include "../../sys/metrics/metrics.h"
 #include "../../sys/epoll/epoll_manager.h"
 #include "../thruster/Thruster.h"
 #include "../../drivers/maincabin/MainCabin.h"
@@ -45,6 +47,72 @@ static pthread_rwlock_t g_dtu_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 /*	旧的串口配置	*/
 static struct termios g_dtu_oldSerialPortConfig = {0};
 
+/*	串口接收缓冲区与帧格式(帧提取器见DTU_ExtractFrame)	*/
+static int DTU_ExtractFrame(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start);
+static serialPortStream_t g_dtu_stream;
+static const serialPortFramer_t g_dtu_framer = {DTU_ExtractFrame, NULL, 0, 0, 0, MAX_DTU_RECV_DATA_SIZE - 1};
+
+ /*******************************************************************
+ * 函数原型:static int DTU_ExtractFrame(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+ * 函数简介:DTU帧提取器，支持两种指令:
+ *          推进器指令"#CMD$$NN#"(8字节，'#'开头'#'结尾)；释放器指令"@cmd@"('@'开头'@'结尾)
+ * 函数参数:framer:帧格式
+ * 函数参数:data/len:待查找的数据
+ * 函数参数:start:输出，帧起始位置/可丢弃字节数/重新同步的位置
+ * 函数返回值: 找到返回帧长度，数据不够返回0，帧损坏返回-1
+ *****************************************************************/
+static int DTU_ExtractFrame(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+{
+	/*	1.查找帧头	*/
+	size_t head = 0;
+	while(head < len && data[head] != '#' && data[head] != '@')
+	{
+		head++;
+	}
+	if(head == len)
+	{
+		*start = len;
+		return 0;
+	}
+
+	/*	2.推进器指令:定长8字节	*/
+	if(data[head] == '#')
+	{
+		if(len - head < 8)
+		{
+			*start = head;
+			return 0;
+		}
+		if(data[head + 7] != '#' || data[head + 3] != '$' || data[head + 4] != '$')
+		{
+			*start = head + 1;
+			return -1;
+		}
+		*start = head;
+		return 8;
+	}
+
+	/*	3.释放器指令:查找结尾的'@'	*/
+	size_t i = head + 1;
+	for(; i < len && i - head < framer->frameLen; i++)
+	{
+		if(data[i] == '@')
+		{
+			*start = head;
+			return (int)(i - head + 1);
+		}
+	}
+
+	if(i - head >= framer->frameLen)
+	{
+		*start = head + 1;
+		return -1;
+	}
+
+	*start = head;
+	return 0;
+}
+
  /*******************************************************************
  * 函数原型:int DTU_getFD(void)
  * 函数简介:返回文件描述符
@@ -134,9 +202,33 @@ int DTU_Init(void)
 		return -1;
 	}
 
+	/*	3.初始化接收缓冲区	*/
+	SerialPort_streamInit(&g_dtu_stream, g_dtu_fd, "DTU", &g_dtu_framer);
+
 	return 0;
 }
 
+ /*******************************************************************
+ * 函数原型:int DTU_Reopen(void)
+ * 函数简介:串口挂断(如USB串口拔出)后重新打开DTU。旧的文件描述符已失效，直接关闭、不恢复旧配置，再重新初始化
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int DTU_Reopen(void)
+{
+	/*	1.关闭失效的文件描述符	*/
+	pthread_rwlock_wrlock(&g_dtu_rwlock);
+	if(g_dtu_fd >= 0)
+	{
+		close(g_dtu_fd);
+		g_dtu_fd = -1;
+	}
+	pthread_rwlock_unlock(&g_dtu_rwlock);
+
+	/*	2.重新打开并配置串口	*/
+	return DTU_Init();
+}
+
  /*******************************************************************
  * 函数原型:ssize_t DTU_SendData(unsigned char *sendBuf, size_t bufsize)
  * 函数简介:DTU发送数据，发送之后会刷新缓存区
@@ -161,49 +253,60 @@ ssize_t DTU_SendData(unsigned char *sendBuf, size_t bufsize)
  	if(nwrite < bufsize + 1)
 	{
         perror("DTU_SendData:dtu write error");
+        pthread_rwlock_unlock(&g_dtu_rwlock);
         return -1;
     }
 	pthread_rwlock_unlock(&g_dtu_rwlock);
 
-    tcflush(g_dtu_fd, TCOFLUSH);
+    Metrics_flushed(METRICS_DEV_DTU, SerialPort_flush(g_dtu_fd, TCOFLUSH));
     
     return 0;
 }
  
  /*******************************************************************
  * 函数原型:ssize_t DTU_RecvData(void)
- * 函数简介:DTU接收数据,在接收数据之前会清空dtuReadBuf,之后会刷新缓存区
+ * 函数简介:DTU从接收缓冲区取出一条完整的指令，缓冲区中没有完整的指令时再读串口
  * 函数参数:无
- * 函数返回值: 成功返回读取到的字节个数，失败就返回-1
+ * 函数返回值: 成功返回指令长度，没有完整的指令返回0，读取错误返回-1(errno为read的错误)
  *****************************************************************/ 
 ssize_t DTU_RecvData(void)
 {
 	/*	1.入口检查	*/
  	if(g_dtu_fd < 0 || g_dtu_recvbuf == NULL || sizeof(g_dtu_recvbuf) <= 0 || sizeof(g_dtu_recvbuf)  > MAX_DTU_RECV_DATA_SIZE)
  	{
+ 		errno = EBADF;
  		return -1;
  	}
 
 	pthread_rwlock_wrlock(&g_dtu_rwlock);
-	memset(g_dtu_recvbuf, 0, sizeof(g_dtu_recvbuf));
-		
-	ssize_t nread = 0;
-	nread = read(g_dtu_fd, g_dtu_recvbuf, sizeof(g_dtu_recvbuf) - 1);
+
+	/*	2.取出一条指令	*/
+	ssize_t nread = SerialPort_streamRead(&g_dtu_stream, g_dtu_recvbuf, sizeof(g_dtu_recvbuf));
 	if(nread < 0) 
 	{
+		int err = errno;
+		memset(g_dtu_recvbuf, 0, sizeof(g_dtu_recvbuf));
+		pthread_rwlock_unlock(&g_dtu_rwlock);
+		LOG_E(LOG_MOD_DTU, "DTU_RecvData:read:%s\n", strerror(err));
+		errno = err;
 		return -1;
 	}
-	else
-	{
-		g_dtu_recvbuf[nread] = '\0';
-	}
 
 	pthread_rwlock_unlock(&g_dtu_rwlock);
-	
-	tcflush(g_dtu_fd, TCIFLUSH);
 	return nread;
 } 
 
+ /*******************************************************************
+ * 函数原型:serialPortStream_t *DTU_getStream(void)
+ * 函数简介:返回串口接收缓冲区，用于设置取帧策略和查看接收统计
+ * 函数参数:无
+ * 函数返回值: 接收缓冲区
+ *****************************************************************/
+serialPortStream_t *DTU_getStream(void)
+{
+	return &g_dtu_stream;
+}
+
  /*******************************************************************
  * 函数原型:void DTU_ParseData(void)
  * 函数简介:解析DTU接收的数据
@@ -232,29 +335,29 @@ void DTU_ParseData(void)
         {
 			int ret1 = MainCabin_SwitchPowerDevice(Releaser1, 1); // 获取返回值
     		if(ret1 == 0) {
-        		printf("DTU指令成功: 释放器1已打开\n");
+        		LOG_I(LOG_MOD_DTU, "DTU指令成功: 释放器1已打开\n");
     			} else {
-        	printf("DTU指令失败: 释放器1打开失败! (主控舱通信异常)\n");
+        	LOG_E(LOG_MOD_DTU, "DTU指令失败: 释放器1打开失败! (主控舱通信异常)\n");
     		}
         }
         else if(strstr((char *)g_dtu_recvbuf, "open2") != NULL)
         {
         	int ret2 = MainCabin_SwitchPowerDevice(Releaser2, 1);
             if(ret2 == 0) {
-        		printf("DTU指令成功: 释放器1已关闭\n");
+        		LOG_I(LOG_MOD_DTU, "DTU指令成功: 释放器1已关闭\n");
     			} else {
-        	printf("DTU指令失败: 释放器1关闭失败! (主控舱通信异常)\n");
+        	LOG_E(LOG_MOD_DTU, "DTU指令失败: 释放器1关闭失败! (主控舱通信异常)\n");
     		}
         }
         else if(strstr((char *)g_dtu_recvbuf, "close1") != NULL)
         {
             MainCabin_SwitchPowerDevice(Releaser1, -1);
-            printf("DTU指令: 释放器1已关闭\n");
+            LOG_I(LOG_MOD_DTU, "DTU指令: 释放器1已关闭\n");
         }
         else if(strstr((char *)g_dtu_recvbuf, "close2") != NULL)
         {
             MainCabin_SwitchPowerDevice(Releaser2, -1);
-            printf("DTU指令: 释放器2已关闭\n");
+            LOG_I(LOG_MOD_DTU, "DTU指令: 释放器2已关闭\n");
         }
     }
 }
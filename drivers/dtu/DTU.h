@@ -25,6 +25,7 @@
 #include <signal.h>
 #include <termios.h> 
 #include <pthread.h>
+#include "../../sys/SerialPort/SerialPort.h"
 
  
 /************************************************************************************
@@ -42,10 +43,12 @@ int DTU_getFD(void);
 
 /*	初始化	*/
 int DTU_Init(void);
+int DTU_Reopen(void);
 
 /*	发送/接收数据	*/
 ssize_t DTU_SendData(unsigned char *dtuSendBuf, size_t bufsize);
 ssize_t DTU_RecvData(void);
+serialPortStream_t *DTU_getStream(void);
 
 /*	接收的数据进行解析	*/
 void DTU_ParseData(void);
@@ -6,6 +6,8 @@
  
 #include "DVL.h"
 #include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/log/log.h"
+#include "../../sys/metrics/metrics.h"
 #include "../../sys/epoll/epoll_manager.h"
 
  /************************************************************************************
@@ -22,19 +24,6 @@ extern pthread_t g_tid_dvl;
 /*  工作状态    */
 volatile int g_dvl_status = -1;			//-1为关闭串口，1为开启串口
 
-/*	保存解析后的数据	*/
-dvlDataPack_t g_dvlDataPack = 
-{
-	.pitch = 0.0,
-	.roll = 0.0,
-	.heading = 0.0,
-	.transducerEntryDepth = 0.0,
-	.speedX = 0.0,
-	.speedY = 0.0,
-	.speedZ = 0.0,
-    .buttomDistance = 0.0
-};
-
 /************************************************************************************
  									全局变量(仅可本文件使用)
 *************************************************************************************/
@@ -47,9 +36,20 @@ static int g_dvl_fd = -1;
 /*	读取原始数据之后 存放的数组	*/
 static char g_dvl_readbuf[512] = {0};
 
+/*	串口接收缓冲区与帧格式(":SA"开头，共6行，每行以'\r'结尾)	*/
+static serialPortStream_t g_dvl_stream;
+static const serialPortFramer_t g_dvl_framer = {SerialPort_extractHeadCount, ":SA", 3, '\r', 6, sizeof(g_dvl_readbuf) - 1};
+
 /*	读写锁	*/
 static pthread_rwlock_t g_dvl_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
+/*	解析中的数据(只在解析线程中使用)，解析完整后发布到总线	*/
+static dvlDataPack_t g_dvlDataPack = {0};
+
+/*	最新值总线:其他线程通过DVL_getDataPack取快照	*/
+static dvlDataPack_t g_dvl_sample = {0};
+static busSlot_t g_dvl_bus = BUS_SLOT_INITIALIZER(g_dvl_sample);
+
 /*	旧的串口配置	*/
 static struct termios g_dvl_oldSerialPortConfig = {0};
 
@@ -161,6 +161,7 @@ int DVL_Init_default(void)
         return -1;
     }
     
+	SerialPort_streamInit(&g_dvl_stream, g_dvl_fd, "DVL", &g_dvl_framer);
 	g_dvl_status = 1;
     return 0;
 }
@@ -197,9 +198,33 @@ int DVL_Init(void)
 		return -1;
 	}
 
+	/*	3.初始化接收缓冲区	*/
+	SerialPort_streamInit(&g_dvl_stream, g_dvl_fd, "DVL", &g_dvl_framer);
+
 	return 0;
 }
 
+ /*******************************************************************
+ * 函数原型:int DVL_Reopen(void)
+ * 函数简介:串口挂断(如USB串口拔出)后重新打开DVL。旧的文件描述符已失效，直接关闭、不恢复旧配置，再重新初始化
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int DVL_Reopen(void)
+{
+	/*	1.关闭失效的文件描述符	*/
+	pthread_rwlock_wrlock(&g_dvl_rwlock);
+	if(g_dvl_fd >= 0)
+	{
+		close(g_dvl_fd);
+		g_dvl_fd = -1;
+	}
+	pthread_rwlock_unlock(&g_dvl_rwlock);
+
+	/*	2.重新打开并配置串口	*/
+	return DVL_Init();
+}
+
 
  /*******************************************************************
  * 函数原型:int DVL_Close_default(void)
@@ -284,12 +309,12 @@ int DVL_SendCmd_OpenDVLDevice(void)
 	/*	1.发送开始数据传输命令	*/
 	if(16 != write(g_dvl_fd, Cmd_OpenDVLDevice, strlen(Cmd_OpenDVLDevice)))
 	{
-		printf("DVL_SendCmd_OpenDVLDevice:Send Cmd_OpenDVLDevice error\n");
+		LOG_E(LOG_MOD_DVL, "DVL_SendCmd_OpenDVLDevice:Send Cmd_OpenDVLDevice error\n");
 		return -1;
 	}
 
 	sleep(1);
-	tcflush(g_dvl_fd, TCIOFLUSH);
+	Metrics_flushed(METRICS_DEV_DVL, SerialPort_flush(g_dvl_fd, TCIOFLUSH));
 
 	return 0;
 }
@@ -311,85 +336,50 @@ int DVL_SendCmd_SetDVLSendFreq(void)
 	/*	1.发送设置频率命令	*/
 	if(16 != write(g_dvl_fd, Cmd_SetDVLSendFreq, strlen(Cmd_SetDVLSendFreq)))
 	{
-		printf("DVL_SendCmd_SetDVLSendFreq:Send Cmd_SetDVLSendFreq error\n");
+		LOG_E(LOG_MOD_DVL, "DVL_SendCmd_SetDVLSendFreq:Send Cmd_SetDVLSendFreq error\n");
 		return -1;
 	}
 	sleep(1);
-	tcflush(g_dvl_fd, TCIOFLUSH);
+	Metrics_flushed(METRICS_DEV_DVL, SerialPort_flush(g_dvl_fd, TCIOFLUSH));
 
 	return 0;
 }
 
  /*******************************************************************
- * 函数原型:ssize_t DVL_readData(int dvlfd, void *dvlReadBuf, size_t bufsize)
- * 函数简介:DVL从串口读取数据
- * 函数参数:dvlfd:DVL设备的文件描述符
- * 		   dvlReadBuf:读取的数据存放的数据
- * 			bufsize:数组大小
- * 函数返回值: 成功返回读取到的字节个数，失败就返回-1
+ * 函数原型:ssize_t DVL_ReadRawData(void)
+ * 函数简介:DVL从接收缓冲区取出一帧完整的6行数据并检查，缓冲区中没有完整的帧时再读串口
+ * 函数参数:无
+ * 函数返回值: 成功返回帧长度，没有完整的帧返回0，失败返回-1:
+ *           读取错误时errno为read的错误，帧无效时errno为EBADMSG(缓冲区中可能还有帧)
  *****************************************************************/ 
 ssize_t DVL_ReadRawData(void)
 {
     /* 0.*入口检查	*/
     if(g_dvl_fd < 0 || g_dvl_readbuf == NULL || sizeof(g_dvl_readbuf) < g_dvlDataProtocol.length + 1)
 	{
+        errno = EBADF;
         return -1;
     }
 
     pthread_rwlock_wrlock(&g_dvl_rwlock);
-    memset(g_dvl_readbuf, 0, sizeof(g_dvl_readbuf));
 
-    ssize_t nread = 0;
-    char c = 0;
-    int i = 0;
-    int datahead = 0, dataend = 0;
-    int start = 0;
-    int byte = 0;
-    int isValid = -1;
+    int isValid = 0;
 
-    while(byte < 512)
+    /*  1.取出一帧(6行数据)，帧不完整时等待下次数据    */
+    int nread = SerialPort_streamRead(&g_dvl_stream, g_dvl_readbuf, sizeof(g_dvl_readbuf));
+    if(nread == 0)
     {
-        nread = read(g_dvl_fd, &c, 1);
-        byte++;
-        if(nread == 1)
-        {
-            if(c == ':')
-            {
-                start = 1;
-                datahead++;
-            }
-
-            if(c == '\r' && start == 1)
-            {
-                dataend++;
-            }
-                
-            if(start)
-            {
-                g_dvl_readbuf[i++] = c;
-            }
-
-            if(datahead == 6 && dataend == 6)
-            {
-                g_dvl_readbuf[i++] = '\0';
-                isValid = 0;
-                pthread_rwlock_unlock(&g_dvl_rwlock);
-                break;
-            }
-            else if(datahead - dataend >= 2)
-            {
-                isValid = -1;
-                pthread_rwlock_unlock(&g_dvl_rwlock);
-                break;
-            }
-        }
-        else 
-        {
-            perror("DVL_ReadRawData:dvl read data error");
-            isValid = -1;
-            pthread_rwlock_unlock(&g_dvl_rwlock);
-            break;
-        }            
+        pthread_rwlock_unlock(&g_dvl_rwlock);
+        return 0;
+    }
+    else if(nread < 0)
+    {
+        int err = errno;
+        memset(g_dvl_readbuf, 0, sizeof(g_dvl_readbuf));
+        pthread_rwlock_unlock(&g_dvl_rwlock);
+        LOG_E(LOG_MOD_DVL, "DVL_ReadRawData:read:%s\n", strerror(err));
+        errno = err;
+        return -1;
     }
 
     /*	字符串检测	*/
@@ -418,15 +408,29 @@ ssize_t DVL_ReadRawData(void)
 
     if(isValid == -1)
     {
-        printf("DVL_ReadRawData:dvl data invaild\n");
+        LOG_W(LOG_MOD_DVL, "DVL_ReadRawData:dvl data invaild\n");
         memset(g_dvl_readbuf, 0, sizeof(g_dvl_readbuf));
         strcpy(g_dvl_readbuf, "invalid");
-        tcflush(g_dvl_fd, TCIFLUSH);
+        g_dvl_stream.stats.badFrames++;
+        pthread_rwlock_unlock(&g_dvl_rwlock);
+        errno = EBADMSG;
         return -1;
     }
 
-    tcflush(g_dvl_fd, TCIFLUSH);
-    return 0;
+    pthread_rwlock_unlock(&g_dvl_rwlock);
+    return nread;
+}
+
+
+ /*******************************************************************
+ * 函数原型:serialPortStream_t *DVL_getStream(void)
+ * 函数简介:返回串口接收缓冲区，用于设置取帧策略和查看接收统计
+ * 函数参数:无
+ * 函数返回值: 接收缓冲区
+ *****************************************************************/
+serialPortStream_t *DVL_getStream(void)
+{
+	return &g_dvl_stream;
 }
 
 
@@ -440,12 +444,12 @@ int DVL_ParseData(void)
 {
 	if(g_dvl_readbuf == NULL)
 	{
-		printf("DVL_ParseData:dvlRawData NULL\n");
+		LOG_W(LOG_MOD_DVL, "DVL_ParseData:dvlRawData NULL\n");
 		return -1;
 	}
 	else if(strncmp(g_dvl_readbuf, "invalid", 7) == 0)
 	{
-		printf("DVL_ParseData:dvlRawData invalid\n");
+		LOG_W(LOG_MOD_DVL, "DVL_ParseData:dvlRawData invalid\n");
 		return -1;
 	}
 
@@ -458,8 +462,6 @@ int DVL_ParseData(void)
 	static char speedZ[8];						//底跟踪，Z轴速度，向下为正，单位mm/s
 	static char buttomDistance[8];				//设备离底距离 高度，单位m
 
-	pthread_rwlock_wrlock(&g_dvl_rwlock);
-
 	char *datahead = NULL;
 
 	datahead = strstr(g_dvl_readbuf, ":SA");
@@ -507,11 +509,24 @@ int DVL_ParseData(void)
     memset(transducerEntryDepth, 0, sizeof(transducerEntryDepth));
     memset(buttomDistance, 0, sizeof(buttomDistance));
 
-	pthread_rwlock_unlock(&g_dvl_rwlock);
+	Bus_publish(&g_dvl_bus, &g_dvlDataPack, g_dvl_stream.frameStampNs);
 	
 	return 0;	
 }
 
+
+/*******************************************************************
+* 函数原型:int DVL_getDataPack(dvlDataPack_t *out, int64_t *stampNs)
+* 函数简介:获取最新一次解析结果的快照(任何线程都可以调用，不阻塞解析线程)
+* 函数参数:out:输出数据
+* 函数参数:stampNs:输出数据的时间戳(原始数据读入的时间，Clock_nowNs)，可以为NULL，用Bus_ageMs判断数据新旧
+* 函数返回值:成功返回0，还没有数据返回1
+*****************************************************************/
+int DVL_getDataPack(dvlDataPack_t *out, int64_t *stampNs)
+{
+	return Bus_read(&g_dvl_bus, out, stampNs);
+}
+
 /*******************************************************************
  * 函数原型:float DVL_getPitchValue(void)
  * 函数简介:获得pitch数值。
@@ -520,7 +535,9 @@ int DVL_ParseData(void)
  *****************************************************************/ 
 float DVL_getPitchValue(void)
 {
-	return g_dvlDataPack.pitch;
+	dvlDataPack_t pack;
+	DVL_getDataPack(&pack, NULL);
+	return pack.pitch;
 }
 
 /*******************************************************************
@@ -531,7 +548,9 @@ float DVL_getPitchValue(void)
  *****************************************************************/ 
 float DVL_getRollValue(void)
 {
-	return g_dvlDataPack.roll;
+	dvlDataPack_t pack;
+	DVL_getDataPack(&pack, NULL);
+	return pack.roll;
 }
 
 /*******************************************************************
@@ -542,7 +561,9 @@ float DVL_getRollValue(void)
  *****************************************************************/ 
 float DVL_getHeadingValue(void)
 {
-	return g_dvlDataPack.heading;
+	dvlDataPack_t pack;
+	DVL_getDataPack(&pack, NULL);
+	return pack.heading;
 }
 
 /*******************************************************************
@@ -553,7 +574,9 @@ float DVL_getHeadingValue(void)
  *****************************************************************/ 
 float DVL_getSpeedXValue(void)
 {
-	return g_dvlDataPack.speedX;
+	dvlDataPack_t pack;
+	DVL_getDataPack(&pack, NULL);
+	return pack.speedX;
 }
 
 /*******************************************************************
@@ -564,7 +587,9 @@ float DVL_getSpeedXValue(void)
  *****************************************************************/ 
 float DVL_getSpeedYValue(void)
 {
-	return g_dvlDataPack.speedY;
+	dvlDataPack_t pack;
+	DVL_getDataPack(&pack, NULL);
+	return pack.speedY;
 }
 
 /*******************************************************************
@@ -575,7 +600,9 @@ float DVL_getSpeedYValue(void)
  *****************************************************************/ 
 float DVL_getSpeedZValue(void)
 {
-	return g_dvlDataPack.speedZ;
+	dvlDataPack_t pack;
+	DVL_getDataPack(&pack, NULL);
+	return pack.speedZ;
 }
 
 /*******************************************************************
@@ -586,7 +613,9 @@ float DVL_getSpeedZValue(void)
  *****************************************************************/ 
 float DVL_getTransducerEntryDepthValue(void)
 {
-	return g_dvlDataPack.transducerEntryDepth;
+	dvlDataPack_t pack;
+	DVL_getDataPack(&pack, NULL);
+	return pack.transducerEntryDepth;
 }
 
 /*******************************************************************
@@ -597,7 +626,9 @@ float DVL_getTransducerEntryDepthValue(void)
  *****************************************************************/ 
 float DVL_getButtomDistanceValue(void)
 {
-	return g_dvlDataPack.buttomDistance;
+	dvlDataPack_t pack;
+	DVL_getDataPack(&pack, NULL);
+	return pack.buttomDistance;
 }
 
 /*******************************************************************
@@ -608,10 +639,8 @@ float DVL_getButtomDistanceValue(void)
 *****************************************************************/ 
 void DVL_PrintAllData(void)
 {
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-    printf("TIME: %d-%02d-%02d %02d:%02d:%02d\n",nowtime->tm_year + 1900,nowtime->tm_mon + 1,nowtime->tm_mday,\
-    											nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
+	char timeStr[CLOCK_FORMAT_LEN];
+    printf("TIME: %s\n", Clock_format(Clock_nowNs(), timeStr, sizeof(timeStr)));
 	
 /*	printf("************DVL数据信息**************\n");
 	printf("俯仰:%f °\n", g_dvlDataPack.pitch);
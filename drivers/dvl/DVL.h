@@ -26,6 +26,8 @@
 #include <pthread.h>
 #include <math.h>
 #include <time.h>
+#include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/bus/bus.h"
  
 
 /************************************************************************************
@@ -58,6 +60,7 @@ int DVL_getFD(void);
 /*	初始化	*/
 int DVL_Init_default(void);
 int DVL_Init(void);
+int DVL_Reopen(void);
 
 /*	关闭传感器	*/
 int DVL_Close_default(void);
@@ -69,11 +72,13 @@ int DVL_SendCmd_SetDVLSendFreq(void);
 
 /*	读取原始数据	*/
 ssize_t DVL_ReadRawData(void);
+serialPortStream_t *DVL_getStream(void);
 
 /*	解析数据	*/
 int DVL_ParseData(void);
 
 /*	获取数据	*/
+int DVL_getDataPack(dvlDataPack_t *out, int64_t *stampNs);
 float DVL_getPitchValue(void);
 float DVL_getRollValue(void);
 float DVL_getHeadingValue(void);
@@ -7,21 +7,11 @@
 
 #include "GPS.h"
 #include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/log/log.h"
 
 /************************************************************************************
  									全局变量(其他文件可使用)
 *************************************************************************************/
-/*	保存解析后的数据	*/
-gpsDataPack_t g_gps_DataPack = {
-    .systemFlag = {0},
-    .longitudeDirection = 'x',
-    .latitudeDirection = 'x',
-    .satelliteNum = 0,
-    .isValid = 0,
-    .longitude = 0,
-    .latitude = 0
-};
-
 /************************************************************************************
  									全局变量(仅可本文件使用)
 *************************************************************************************/
@@ -34,9 +24,29 @@ static int g_gps_fd = -1;
 /*	读取原始数据之后 存放的数组	*/
 static char g_gps_readbuf[1024] = {0};
 
+/*	串口接收缓冲区与帧格式(只取GGA语句，"$GNGGA"开头，'\n'结尾，NMEA语句最长82个字符)
+	其他语句没有帧头，会被当作无用字节丢弃	*/
+static serialPortStream_t g_gps_stream;
+static const serialPortFramer_t g_gps_framer = {SerialPort_extractDelimited, "$GNGGA", 6, '\n', 1, 128};
+
 /*	读写锁	*/
 static pthread_rwlock_t g_gps_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
+/*	解析中的数据(只在解析线程中使用)，解析完整后发布到总线	*/
+static gpsDataPack_t g_gps_DataPack = {
+    .systemFlag = {0},
+    .longitudeDirection = 'x',
+    .latitudeDirection = 'x',
+    .satelliteNum = 0,
+    .isValid = 0,
+    .longitude = 0,
+    .latitude = 0
+};
+
+/*	最新值总线:其他线程通过GPS_getDataPack取快照	*/
+static gpsDataPack_t g_gps_sample = {0};
+static busSlot_t g_gps_bus = BUS_SLOT_INITIALIZER(g_gps_sample);
+
 /*	旧的串口配置	*/
 static struct termios g_gps_oldSerialPortConfig = {0};
 
@@ -82,82 +92,93 @@ int GPS_Init(void)
 		return -1;
 	}
 
+	/*	3.初始化接收缓冲区	*/
+	SerialPort_streamInit(&g_gps_stream, g_gps_fd, "GPS", &g_gps_framer);
+
 	return 0;
 }
 
+ /*******************************************************************
+ * 函数原型:int GPS_Reopen(void)
+ * 函数简介:串口挂断(如USB串口拔出)后重新打开GPS。旧的文件描述符已失效，直接关闭、不恢复旧配置，再重新初始化
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int GPS_Reopen(void)
+{
+	/*	1.关闭失效的文件描述符	*/
+	pthread_rwlock_wrlock(&g_gps_rwlock);
+	if(g_gps_fd >= 0)
+	{
+		close(g_gps_fd);
+		g_gps_fd = -1;
+	}
+	pthread_rwlock_unlock(&g_gps_rwlock);
+
+	/*	2.重新打开并配置串口	*/
+	return GPS_Init();
+}
+
 /*******************************************************************
  * 函数原型:ssize_t GPS_ReadRawData(void)
- * 函数简介:GPS从串口读取数据
+ * 函数简介:GPS从接收缓冲区取出一条完整的GGA语句，缓冲区中没有时再读串口
  * 函数参数:无
- * 函数返回值: 成功返回读取到的字节个数，失败就返回-1
+ * 函数返回值: 成功返回读取到的字节个数，没有完整的语句返回0，失败返回-1:
+ *           读取错误时errno为read的错误，语句无效时errno为EBADMSG(缓冲区中可能还有语句)
  *****************************************************************/ 
 ssize_t GPS_ReadRawData(void)
 {
     /* 0.*入口检查	*/
     if(g_gps_fd < 0 || g_gps_readbuf  == NULL || sizeof(g_gps_readbuf) < 512)
 	{
+        errno = EBADF;
         return -1;
     }
 
     pthread_rwlock_wrlock(&g_gps_rwlock);
-    memset(g_gps_readbuf, 0, sizeof(g_gps_readbuf));
-
-    ssize_t nread = 0;
-    char c = 0;
-    int i = 0;
-    int start = 0;
 
-    while(1)
+    /*  1.取出一条GGA语句，没有完整的语句时等待下次数据 */
+    int nread = SerialPort_streamRead(&g_gps_stream, g_gps_readbuf, sizeof(g_gps_readbuf));
+    if(nread == 0)
     {
-        nread = read(g_gps_fd, &c, 1);
-        if(nread == 1)
-        {
-            if(c == '$')
-            {
-                start = 1;
-            }
-                
-            if(start)
-            {
-                g_gps_readbuf[i++] = c;
-            }
-            if((c == '\n') && start == 1)
-            {
-                if(strstr(g_gps_readbuf,"$GNGGA") == NULL)
-                {
-                    i = 0;
-                    start = 0;
-                    memset(g_gps_readbuf, 0, sizeof(g_gps_readbuf));
-                    continue;
-                }
-                else
-                {
-                    g_gps_readbuf[i] = '\0';
-                    break;
-                }
-            }
-        }
-        else
-        {
-            break;
-        }            
+        pthread_rwlock_unlock(&g_gps_rwlock);
+        return 0;
+    }
+    else if(nread < 0)
+    {
+        int err = errno;
+        memset(g_gps_readbuf, 0, sizeof(g_gps_readbuf));
+        pthread_rwlock_unlock(&g_gps_rwlock);
+        LOG_E(LOG_MOD_GPS, "GPS_ReadRawData:read:%s\n", strerror(err));
+        errno = err;
+        return -1;
     }
     
     if(g_gps_readbuf[0] != '$' || strncmp(g_gps_readbuf+3,"GGA",3) != 0)
     {
-        printf("GPS_ReadRawData:gps data invalid\n");
+        LOG_W(LOG_MOD_GPS, "GPS_ReadRawData:gps data invalid\n");
         memset(g_gps_readbuf, 0, sizeof(g_gps_readbuf));
         strcpy(g_gps_readbuf, "invalid");
-        tcflush(g_gps_fd, TCIFLUSH);
         pthread_rwlock_unlock(&g_gps_rwlock);
+        errno = EBADMSG;
         return -1;
     }
     
-    tcflush(g_gps_fd, TCIFLUSH);
     pthread_rwlock_unlock(&g_gps_rwlock);
     return strlen(g_gps_readbuf);
 }
 
+ /*******************************************************************
+ * 函数原型:serialPortStream_t *GPS_getStream(void)
+ * 函数简介:返回串口接收缓冲区，用于设置取帧策略和查看接收统计
+ * 函数参数:无
+ * 函数返回值: 接收缓冲区
+ *****************************************************************/
+serialPortStream_t *GPS_getStream(void)
+{
+    return &g_gps_stream;
+}
+
  /*******************************************************************
  * 函数原型:int GPS_ParseData(void)
  * 函数简介:解析GPS数据
@@ -179,7 +200,6 @@ int GPS_ParseData(void)
 	char Lng[16] = {'\0'}, LngDirect[2] = {'\0'}, fs[2] = {'\0'}, svNum[4] = {'\0'};
 	float fLat = 0.0f, fLng = 0.0f;
 
-    pthread_rwlock_wrlock(&g_gps_rwlock);
     /*  判断是否有信号  */
     /* eg. $GPGGA,082559.00,4005.22599,N,11632.58234,E,1,04,3.08,14.6,M,-5.6,M,,*76"<CR><LF>*/
     if(strstr(g_gps_readbuf, ",,,,,") != NULL)
@@ -218,11 +238,23 @@ int GPS_ParseData(void)
         g_gps_DataPack.longitude = fLng;
         g_gps_DataPack.satelliteNum = atoi(svNum);
     }
-    pthread_rwlock_unlock(&g_gps_rwlock);
+    Bus_publish(&g_gps_bus, &g_gps_DataPack, g_gps_stream.frameStampNs);
 
     return 0;
 }
 
+/*******************************************************************
+* 函数原型:int GPS_getDataPack(gpsDataPack_t *out, int64_t *stampNs)
+* 函数简介:获取最新一次解析结果的快照(任何线程都可以调用，不阻塞解析线程)
+* 函数参数:out:输出数据
+* 函数参数:stampNs:输出数据的时间戳(原始数据读入的时间，Clock_nowNs)，可以为NULL，用Bus_ageMs判断数据新旧
+* 函数返回值:成功返回0，还没有数据返回1
+*****************************************************************/
+int GPS_getDataPack(gpsDataPack_t *out, int64_t *stampNs)
+{
+    return Bus_read(&g_gps_bus, out, stampNs);
+}
+
 /*******************************************************************
 * 函数原型:char *GPS_DataPackageProcessing(void)
 * 函数简介:将GPS的数据进行按格式打包
@@ -248,7 +280,9 @@ char *GPS_DataPackageProcessing(void)
  *****************************************************************/
 float GPS_getLongitudeValue(void)
 {
-    return g_gps_DataPack.longitude;
+    gpsDataPack_t pack;
+    GPS_getDataPack(&pack, NULL);
+    return pack.longitude;
 }
 
 /*******************************************************************
@@ -259,7 +293,9 @@ float GPS_getLongitudeValue(void)
  *****************************************************************/
 float GPS_getLatitudeValue(void)
 {
-    return g_gps_DataPack.latitude;
+    gpsDataPack_t pack;
+    GPS_getDataPack(&pack, NULL);
+    return pack.latitude;
 }
 
 /*******************************************************************
@@ -270,10 +306,8 @@ float GPS_getLatitudeValue(void)
 *****************************************************************/ 
 void GPS_PrintAllData(void)
 {
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-    printf("TIME: %d-%02d-%02d %02d:%02d:%02d\n",nowtime->tm_year + 1900,nowtime->tm_mon + 1,nowtime->tm_mday,\
-    											nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
+	char timeStr[CLOCK_FORMAT_LEN];
+    printf("TIME: %s\n", Clock_format(Clock_nowNs(), timeStr, sizeof(timeStr)));
 	
 	printf("************GPS数据信息**************\n");
 	printf("系统标识符:%s\n", g_gps_DataPack.systemFlag);
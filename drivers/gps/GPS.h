@@ -27,6 +27,8 @@
 #include <pthread.h>
 #include <math.h>
 #include <time.h>
+#include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/bus/bus.h"
 
 
 /************************************************************************************
@@ -51,15 +53,18 @@ int GPS_getFD(void);
 
 /*	初始化	*/
 int GPS_Init(void);
+int GPS_Reopen(void);
 
 /*  读取数据 /解析数据 */
 ssize_t GPS_ReadRawData(void);
+serialPortStream_t *GPS_getStream(void);
 int GPS_ParseData(void);
 
 /*  打包数据    */
 char *GPS_DataPackageProcessing(void);
 
 /*  获取数据    */
+int GPS_getDataPack(gpsDataPack_t *out, int64_t *stampNs);
 float GPS_getLongitudeValue(void);
 float GPS_getLatitudeValue(void);
 
@@ -10,6 +10,9 @@
 
 #include "../../sys/socket/TCP/tcp.h"
 #include "../../tool/tool.h"
+#include "../../sys/log/log.h"
+#include "../../sys/metrics/metrics.h"
+#include "../../sys/procstat/procstat.h"
 
 #include "../ctd/CTD.h"
 #include "../dvl/DVL.h"
@@ -38,18 +41,6 @@ volatile int g_usbl_power_flag = -1;		//-1为未连接，1为已连接
 volatile int g_releaser1_power_flag = -1;		//-1为未连接，1为已连接
 volatile int g_releaser2_power_flag = -1;		//-1为未连接，1为已连接
 
-/*	数据保存的结构体	*/
-maincabinDataPack_t g_maincabin_data_pack = {
-	.temperature = 0.0f,
-	.pressure = 0.0f,
-	.humidity = 0.0f,
-	.isLeak01= {"01GOOD"},
-	.isLeak02 = {"02GOOD"},
-	.deviceState = {"DEVCLOS"},
-	.releaser1State = {"R1OPEN"},
-	.releaser2State = {"R2OPEN"}
-};
-
 /*	工作线程tid	*/
 pthread_t g_tid_ctd = 0;
 pthread_t g_tid_dvl = 0;
@@ -63,9 +54,28 @@ pthread_t g_tid_sonar = 0;
 /*	读取原始数据之后 存放的数组	*/
 static unsigned char g_maincabin_readbuf[128] = {0};
 
-/*	读写锁	*/
+/*	原始数据读入的时间(Clock_nowNs)	*/
+static int64_t g_maincabin_readStampNs = 0;
+
+/*	读写锁(多个线程修改g_maincabin_data_pack，修改和发布要在锁内完成)	*/
 static pthread_rwlock_t g_maincabin_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
+/*	数据保存的结构体(只在写锁内访问)，修改后发布到总线	*/
+static maincabinDataPack_t g_maincabin_data_pack = {
+	.temperature = 0.0f,
+	.pressure = 0.0f,
+	.humidity = 0.0f,
+	.isLeak01= {"01GOOD"},
+	.isLeak02 = {"02GOOD"},
+	.deviceState = {"DEVCLOS"},
+	.releaser1State = {"R1OPEN"},
+	.releaser2State = {"R2OPEN"}
+};
+
+/*	最新值总线:其他线程通过MainCabin_getDataPack取快照	*/
+static maincabinDataPack_t g_maincabin_sample = {0};
+static busSlot_t g_maincabin_bus = BUS_SLOT_INITIALIZER(g_maincabin_sample);
+
 /*	主控舱数据协议	*/
 static maincabinDataProtocol_t g_maincabin_data_protocol = {
 	.length = 117,
@@ -122,6 +132,25 @@ const unsigned char g_control_power_cmd[7][2][13] =
 };
 
 
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static void MainCabin_SetState(char *field, const char *state)
+* 函数简介:修改一个状态字符串并发布(设备上电、释放器状态由其他线程修改)
+* 函数参数:field:g_maincabin_data_pack中的状态字段
+* 函数参数:state:新状态
+* 函数返回值: 无
+*****************************************************************/
+static void MainCabin_SetState(char *field, const char *state)
+{
+	pthread_rwlock_wrlock(&g_maincabin_rwlock);
+	strncpy(field, state, sizeof(g_maincabin_data_pack.deviceState) - 1);
+	Bus_publish(&g_maincabin_bus, &g_maincabin_data_pack, 0);
+	pthread_rwlock_unlock(&g_maincabin_rwlock);
+}
+
+
  /*******************************************************************
  * 函数原型:int  MainCabin_getFD(void)
  * 函数简介:返回文件描述符
@@ -173,7 +202,7 @@ int MainCabin_ReConnect(void)
     
     g_maincabin_tcpcliConnectFlag = -1; // 标记为未连接
 
-    printf("[MainCabin] 尝试重连服务器 %s:%d ...\n", TCP_MAINCABIN_IP, TCP_MAINCABIN_PORT);
+    LOG_I(LOG_MOD_MAINCABIN, "[MainCabin] 尝试重连服务器 %s:%d ...\n", TCP_MAINCABIN_IP, TCP_MAINCABIN_PORT);
 
     // 2. 重新建立连接
     g_maincabin_tcpclisock_fd = TCP_InitClient(TCP_MAINCABIN_IP, TCP_MAINCABIN_PORT);
@@ -183,14 +212,14 @@ int MainCabin_ReConnect(void)
     }
 
     // 3. 重新加入 Epoll 监听
-    if(epoll_manager_add_fd(g_epoll_manager_fd, g_maincabin_tcpclisock_fd, EPOLLIN) < 0)
+    if(Task_MainCabin_Attach() < 0)
     {
         close(g_maincabin_tcpclisock_fd);
         return -1;
     }
 
     g_maincabin_tcpcliConnectFlag = 1; // 标记为已连接
-    printf("[MainCabin] 重连成功！\n");
+    LOG_I(LOG_MOD_MAINCABIN, "[MainCabin] 重连成功！\n");
     return 0;
 }
 
@@ -258,15 +287,15 @@ int MainCabin_SwitchPowerDevice(MainCabin_Control_DeviceID id, int power)
 			if(ret < 0) 
     		{
         	// [新增] 发送失败也认为是断开
-       		 printf("[MainCabin] 发送指令失败，连接可能已断开\n");
+       		 LOG_E(LOG_MOD_MAINCABIN, "[MainCabin] 发送指令失败，连接可能已断开\n");
         	 g_maincabin_tcpcliConnectFlag = -1; 
         	 return -1;
     		}
 			if(ret == sizeof(g_control_power_cmd[0][0]))
 			{
 				*temp = 1;
-				if(id == Releaser1) strcpy(g_maincabin_data_pack.releaser1State,"R1OPEN");
-				if(id == Releaser2) strcpy(g_maincabin_data_pack.releaser2State,"R2OPEN");
+				if(id == Releaser1) MainCabin_SetState(g_maincabin_data_pack.releaser1State, "R1OPEN");
+				if(id == Releaser2) MainCabin_SetState(g_maincabin_data_pack.releaser2State, "R2OPEN");
 				return 0; //发送成功
 			}
 			else
@@ -284,15 +313,15 @@ int MainCabin_SwitchPowerDevice(MainCabin_Control_DeviceID id, int power)
 			if(ret < 0) 
     		{
         	// [新增] 发送失败也认为是断开
-       		 printf("[MainCabin] 发送指令失败，连接可能已断开\n");
+       		 LOG_E(LOG_MOD_MAINCABIN, "[MainCabin] 发送指令失败，连接可能已断开\n");
         	 g_maincabin_tcpcliConnectFlag = -1; 
         	 return -1;
     		}
 			if(ret == sizeof(g_control_power_cmd[0][0]))
 			{
 				*temp = -1;
-				if(id == Releaser1) strcpy(g_maincabin_data_pack.releaser1State,"R1CLOSE");
-				if(id == Releaser2) strcpy(g_maincabin_data_pack.releaser2State,"R2CLOSE");
+				if(id == Releaser1) MainCabin_SetState(g_maincabin_data_pack.releaser1State, "R1CLOSE");
+				if(id == Releaser2) MainCabin_SetState(g_maincabin_data_pack.releaser2State, "R2CLOSE");
 				return 0; //发送成功
 			}
 			else
@@ -326,13 +355,14 @@ int MainCabin_PowerOnAllDeviceExceptReleaser(void)
 		usleep(200000);
 	}
 
-	strcpy(g_maincabin_data_pack.deviceState, "DEVOPEN");
+	MainCabin_SetState(g_maincabin_data_pack.deviceState, "DEVOPEN");
 
 	/*	温盐深初始化	*/
 	if(g_ctd_power_flag == 1)
 	{
 		pthread_t tid;
 		pthread_create(&tid, NULL, (void *)MainCabin_CTD_PowerOnHandle, NULL);
+		ProcStat_setThreadName(tid, "pwr-ctd");
 		g_tid_ctd = tid;
 	}
 
@@ -341,6 +371,7 @@ int MainCabin_PowerOnAllDeviceExceptReleaser(void)
 	{
 		pthread_t tid;
 		pthread_create(&tid, NULL, (void *)MainCabin_DVL_PowerOnHandle, NULL);
+		ProcStat_setThreadName(tid, "pwr-dvl");
 		g_tid_dvl = tid;
 	}
 
@@ -349,6 +380,7 @@ int MainCabin_PowerOnAllDeviceExceptReleaser(void)
 	{
 		pthread_t tid;
 		pthread_create(&tid, NULL, (void *)MainCabin_DTU_PowerOnHandle, NULL);
+		ProcStat_setThreadName(tid, "pwr-dtu");
 		g_tid_dtu = tid;
 	}
 
@@ -357,6 +389,7 @@ int MainCabin_PowerOnAllDeviceExceptReleaser(void)
 	{
 		pthread_t tid;
 		pthread_create(&tid, NULL, (void *)MainCabin_USBL_PowerOnHandle, NULL);
+		ProcStat_setThreadName(tid, "pwr-usbl");
 		g_tid_usbl = tid;
 	}
 
@@ -391,7 +424,7 @@ int MainCabin_PowerOffAllDeviceExceptReleaser(void)
 		usleep(200000);
 	}
 
-	strcpy(g_maincabin_data_pack.deviceState, "DEVCLOS");
+	MainCabin_SetState(g_maincabin_data_pack.deviceState, "DEVCLOS");
 
 	printf("传感器已经全部断电\n");
 
@@ -454,7 +487,7 @@ int MainCabin_ReadRawData(void)
     // [关键修改] 如果接收失败（返回-1）或 长度不对
     if(nbyte != g_maincabin_data_protocol.length)
     {
-        printf("[MainCabin] 读取错误或连接断开 (nbyte=%d)\n", nbyte);
+        LOG_W(LOG_MOD_MAINCABIN, "[MainCabin] 读取错误或连接断开 (nbyte=%d)\n", nbyte);
         
         // 标记连接断开，以便下次循环触发重连
         g_maincabin_tcpcliConnectFlag = -1; 
@@ -462,6 +495,9 @@ int MainCabin_ReadRawData(void)
         pthread_rwlock_unlock(&g_maincabin_rwlock);
         return -1;
     }
+    g_maincabin_readStampNs = Clock_nowNs();
+    Metrics_add(METRICS_DEV_MAINCABIN, METRICS_FRAMES, 1);
+    Metrics_add(METRICS_DEV_MAINCABIN, METRICS_BYTES_READ, nbyte);
     pthread_rwlock_unlock(&g_maincabin_rwlock);
     return 0;
 }
@@ -478,7 +514,7 @@ int MainCabin_ParseData(void)
 	/*	0.入口检查	*/
 	if(strncmp((const char *)g_maincabin_readbuf, "invalid", 7) == 0)
 	{
-		printf("CTD_parseData:原始数据无效\n");
+		LOG_W(LOG_MOD_MAINCABIN, "CTD_parseData:原始数据无效\n");
 		return -1;
 	}
 
@@ -545,12 +581,34 @@ int MainCabin_ParseData(void)
 		strcpy(g_maincabin_data_pack.isLeak02, "01GOOD");
 	}
 
-	pthread_rwlock_wrlock(&g_maincabin_rwlock);
+	Bus_publish(&g_maincabin_bus, &g_maincabin_data_pack, g_maincabin_readStampNs);
+	pthread_rwlock_unlock(&g_maincabin_rwlock);
 
 	return 0;
 }	
 
 
+/*******************************************************************
+* 函数原型:int MainCabin_getDataPack(maincabinDataPack_t *out, int64_t *stampNs)
+* 函数简介:获取主控舱数据的最新快照(任何线程都可以调用，不阻塞解析线程)
+* 函数参数:out:输出数据
+* 函数参数:stampNs:输出数据的时间戳(原始数据读入的时间，Clock_nowNs)，可以为NULL，用Bus_ageMs判断数据新旧
+* 函数返回值:成功返回0，还没有数据返回1(此时out为初始状态)
+*****************************************************************/
+int MainCabin_getDataPack(maincabinDataPack_t *out, int64_t *stampNs)
+{
+	if(Bus_read(&g_maincabin_bus, out, stampNs) == 0)
+	{
+		return 0;
+	}
+
+	pthread_rwlock_rdlock(&g_maincabin_rwlock);
+	memcpy(out, &g_maincabin_data_pack, sizeof(*out));
+	pthread_rwlock_unlock(&g_maincabin_rwlock);
+	return 1;
+}
+
+
 /*******************************************************************
 * 函数原型:char *MainCabin_DataPackageProcessing(void)
 * 函数简介:将MainCabin的数据进行按格式打包
@@ -560,12 +618,14 @@ int MainCabin_ParseData(void)
 char *MainCabin_DataPackageProcessing(void)
 {	
 	static char maincabinSendDataBuf[100] = {0};
-		
+	maincabinDataPack_t pack;
+
+	MainCabin_getDataPack(&pack, NULL);
 	snprintf(maincabinSendDataBuf, sizeof(maincabinSendDataBuf), \
 					"@%f@%f@%f@%s@%s@%s@%s@%s@", \
-					g_maincabin_data_pack.temperature, g_maincabin_data_pack.humidity, g_maincabin_data_pack.pressure, \
-				g_maincabin_data_pack.isLeak01, g_maincabin_data_pack.isLeak02, \
-				g_maincabin_data_pack.deviceState, g_maincabin_data_pack.releaser1State, g_maincabin_data_pack.releaser2State);
+					pack.temperature, pack.humidity, pack.pressure, \
+				pack.isLeak01, pack.isLeak02, \
+				pack.deviceState, pack.releaser1State, pack.releaser2State);
 		
 	return maincabinSendDataBuf;
 }
@@ -579,20 +639,21 @@ char *MainCabin_DataPackageProcessing(void)
 *****************************************************************/ 	
 void MainCabin_PrintSensorData(void)
 {	
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-    printf("TIME: %d-%02d-%02d %02d:%02d:%02d\n",nowtime->tm_year + 1900,nowtime->tm_mon + 1,nowtime->tm_mday,\
-    											nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
+	char timeStr[CLOCK_FORMAT_LEN];
+    printf("TIME: %s\n", Clock_format(Clock_nowNs(), timeStr, sizeof(timeStr)));
     										
+    maincabinDataPack_t pack;
+    MainCabin_getDataPack(&pack, NULL);
+
     printf("************主控舱数据信息**************\n");
-    printf("温度:%f ℃\n", g_maincabin_data_pack.temperature);
-	printf("湿度:%f %%\n", g_maincabin_data_pack.humidity);
-	printf("气压:%f hPa\n", g_maincabin_data_pack.pressure);
-	printf("泄露01:%s \n", g_maincabin_data_pack.isLeak01);
-	printf("泄露02:%s \n", g_maincabin_data_pack.isLeak02);
-	printf("传感器设备上电:%s \n", g_maincabin_data_pack.deviceState);
-	printf("释放器1:%s \n", g_maincabin_data_pack.releaser1State);
-	printf("释放器2:%s \n", g_maincabin_data_pack.releaser2State);
+    printf("温度:%f ℃\n", pack.temperature);
+	printf("湿度:%f %%\n", pack.humidity);
+	printf("气压:%f hPa\n", pack.pressure);
+	printf("泄露01:%s \n", pack.isLeak01);
+	printf("泄露02:%s \n", pack.isLeak02);
+	printf("传感器设备上电:%s \n", pack.deviceState);
+	printf("释放器1:%s \n", pack.releaser1State);
+	printf("释放器2:%s \n", pack.releaser2State);
 	printf("************************************\n");
 }
 
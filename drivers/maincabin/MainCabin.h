@@ -26,6 +26,7 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include "../../sys/bus/bus.h"
 
 
 /************************************************************************************
@@ -87,6 +88,9 @@ int MainCabin_PowerOffAllDeviceExceptReleaser(void);
 int MainCabin_ReadRawData(void);
 int MainCabin_ParseData(void);
 
+/*  获取数据    */
+int MainCabin_getDataPack(maincabinDataPack_t *out, int64_t *stampNs);
+
 /*  打包数据    */
 char *MainCabin_DataPackageProcessing(void);
 
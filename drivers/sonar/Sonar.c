@@ -8,6 +8,8 @@
 
 #include "../../tool/tool.h"
 #include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/log/log.h"
+#include "../../sys/metrics/metrics.h"
 #include "../../sys/epoll/epoll_manager.h"
 
 /************************************************************************************
@@ -24,12 +26,6 @@ extern pthread_t g_tid_sonar;
 /*  工作状态    */
 volatile int g_sonar_status = -1;			//-1为不可工作，1为可以工作
 
-/*	保存解析后的数据	*/
-sonarDataPack_t g_sonar_dataPack = {
-    .obstaclesBearing = 0,
-    .obstaclesDistance = 0
-};
-
 /************************************************************************************
  									全局变量(仅可本文件使用)
 *************************************************************************************/
@@ -45,9 +41,23 @@ static struct termios g_sonar_oldSerialPortConfig = {0};
 /*	读取原始数据之后 存放的数组	*/
 static unsigned char g_sonar_readbuf[144] = {0};
 
+/*	串口接收缓冲区与帧格式(定长64字节，0x40 0x30开头，0x0A结尾)	*/
+static serialPortStream_t g_sonar_stream;
+static const serialPortFramer_t g_sonar_framer = {SerialPort_extractFixed, "\x40\x30", 2, 0x0A, 1, 64};
+
 /*	读写锁	*/
 static pthread_rwlock_t g_sonar_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
+/*	解析中的数据(只在解析线程中使用)，解析完整后发布到总线	*/
+static sonarDataPack_t g_sonar_dataPack = {
+    .obstaclesBearing = 0,
+    .obstaclesDistance = 0
+};
+
+/*	最新值总线:其他线程通过Sonar_getDataPack取快照	*/
+static sonarDataPack_t g_sonar_sample = {0};
+static busSlot_t g_sonar_bus = BUS_SLOT_INITIALIZER(g_sonar_sample);
+
 pthread_t g_sonarTasktid = 0;
 
 /************************************************************************************
@@ -110,11 +120,35 @@ int Sonar_Init(void)
 		return -1;
 	}
 
+	/*	3.初始化接收缓冲区	*/
+	SerialPort_streamInit(&g_sonar_stream, g_sonar_fd, "Sonar", &g_sonar_framer);
+
 	sleep(5);	//数据延时等待
 
 	return 0;
 }
 
+ /*******************************************************************
+ * 函数原型:int Sonar_Reopen(void)
+ * 函数简介:串口挂断(如USB串口拔出)后重新打开Sonar。旧的文件描述符已失效，直接关闭、不恢复旧配置，再重新初始化
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int Sonar_Reopen(void)
+{
+	/*	1.关闭失效的文件描述符	*/
+	pthread_rwlock_wrlock(&g_sonar_rwlock);
+	if(g_sonar_fd >= 0)
+	{
+		close(g_sonar_fd);
+		g_sonar_fd = -1;
+	}
+	pthread_rwlock_unlock(&g_sonar_rwlock);
+
+	/*	2.重新打开并配置串口	*/
+	return Sonar_Init();
+}
+
 
  /*******************************************************************
  * 函数原型:int Sonar_Close(void)
@@ -178,12 +212,12 @@ int Sonar_writeCmd_mtStopAlive(void)
 	/*	发送Cmd_mtStopAlive命令	*/
     if(14 != write(g_sonar_fd, Cmd_mtStopAlive, 14))
 	{
-		printf("Sonar_writeCmd_mtStopAlive:发送 Cmd_mtStopAlive 出错\n");
+		LOG_E(LOG_MOD_SONAR, "Sonar_writeCmd_mtStopAlive:发送 Cmd_mtStopAlive 出错\n");
 		return -1;
 	}
 
 	sleep(2);
-    tcflush(g_sonar_fd, TCIOFLUSH);
+    Metrics_flushed(METRICS_DEV_SONAR, SerialPort_flush(g_sonar_fd, TCIOFLUSH));
 
     return 0;
 }
@@ -206,12 +240,12 @@ int Sonar_writeCmd_mtSendVersion(void)
 	/*	2.发送Cmd_mtSendVersion命令	*/
 	if(14 != write(g_sonar_fd, Cmd_mtSendVersion, 14))
 	{
-		printf("Sonar_writeCmd_mtSendVersion:发送 Cmd_mtSendVersion 出错\n");
+		LOG_E(LOG_MOD_SONAR, "Sonar_writeCmd_mtSendVersion:发送 Cmd_mtSendVersion 出错\n");
 		return -1;
 	}
 
 	sleep(2);
-    tcflush(g_sonar_fd, TCIOFLUSH);
+    Metrics_flushed(METRICS_DEV_SONAR, SerialPort_flush(g_sonar_fd, TCIOFLUSH));
 
     return 0;
 }
@@ -234,12 +268,12 @@ int Sonar_writeCmd_mtHeadCommand(void)
     /*	2.发送Cmd_mtHeadCommand命令	*/
 	if(82 != write(g_sonar_fd, Cmd_mtHeadCommand, 82))
 	{
-		printf("Sonar_writeCmd_mtHeadCommand:发送 Cmd_mtSendVersion 出错\n");
+		LOG_E(LOG_MOD_SONAR, "Sonar_writeCmd_mtHeadCommand:发送 Cmd_mtSendVersion 出错\n");
 		return -1;
 	}
 
 	sleep(2);
-    tcflush(g_sonar_fd, TCIOFLUSH);
+    Metrics_flushed(METRICS_DEV_SONAR, SerialPort_flush(g_sonar_fd, TCIOFLUSH));
 
     return 0;
 }
@@ -327,7 +361,7 @@ int Sonar_SendDataRequest(void)
     nwrite = write(g_sonar_fd, Cmd_mtSendData, 18);
     if(nwrite != 18)
     {
-        tcflush(g_sonar_fd, TCIFLUSH);
+        Metrics_flushed(METRICS_DEV_SONAR, SerialPort_flush(g_sonar_fd, TCIFLUSH));
         return -1;
     }
 
@@ -337,65 +371,65 @@ int Sonar_SendDataRequest(void)
 
 /*******************************************************************
  * 函数原型:ssize_t Sonar_ReadRawData(void)
- * 函数简介:声呐从串口读取数据
+ * 函数简介:声呐从接收缓冲区取出一帧64字节的应答，缓冲区中没有完整的应答时再读串口
  * 函数参数:无
- * 函数返回值: 成功返回0，失败就返回-1
+ * 函数返回值: 成功返回应答长度，应答还不完整返回0，失败就返回-1:
+ *           读取错误时errno为read的错误，应答无效时errno为EBADMSG
  *****************************************************************/ 
 ssize_t Sonar_ReadRawData(void)
 {
     /*  入口检测    */
     if(g_sonar_fd < 0 || g_sonar_readbuf == NULL || sizeof(g_sonar_readbuf) < 128)
     {
+        errno = EBADF;
         return -1;
     }
 
-    /*  读取数据    */
     pthread_rwlock_wrlock(&g_sonar_rwlock);
-	memset(g_sonar_readbuf, 0, sizeof(g_sonar_readbuf));
 
-    ssize_t nread = 0;
-    unsigned char uc = 0;
-    int start = 0, i = 0;
-
-    while(1)
+    /*  1.取出一帧应答，应答还不完整时等待下次数据    */
+    int nread = SerialPort_streamRead(&g_sonar_stream, g_sonar_readbuf, sizeof(g_sonar_readbuf));
+    if(nread == 0)
     {
-        nread = read(g_sonar_fd, &uc, 1);
-        
-        if(nread == 1)
-        {
-            if(uc == 0x40)
-                start = 1;
-            if(start)
-            {
-                g_sonar_readbuf[i++] = uc;
-            }
-            if(i == 64)
-                break;
-        }
-        else if(nread == 0)
-        {
-            continue;
-        }
-        else
-        {
-            break;
-        }
+        pthread_rwlock_unlock(&g_sonar_rwlock);
+        return 0;
+    }
+    else if(nread < 0)
+    {
+        int err = errno;
+        memset(g_sonar_readbuf, 0, sizeof(g_sonar_readbuf));
+        pthread_rwlock_unlock(&g_sonar_rwlock);
+        LOG_E(LOG_MOD_SONAR, "Sonar_ReadRawData:read:%s\n", strerror(err));
+        errno = err;
+        return -1;
     }
 
     /*  数据检查    */
     if(*(g_sonar_readbuf+0) != 0x40 || *(g_sonar_readbuf+1) != 0x30 || *(g_sonar_readbuf+63) != 0x0A)
     {
-        printf("Sonar_ReadRawData:sonar data invalid\n");
+        LOG_W(LOG_MOD_SONAR, "Sonar_ReadRawData:sonar data invalid\n");
         memset(g_sonar_readbuf, 0, sizeof(g_sonar_readbuf));
         strcpy((char *)g_sonar_readbuf, "invalid");
-        tcflush(g_sonar_fd, TCIFLUSH);
+        g_sonar_stream.stats.badFrames++;
         pthread_rwlock_unlock(&g_sonar_rwlock);
+        errno = EBADMSG;
         return -1;
     }
 		
     pthread_rwlock_unlock(&g_sonar_rwlock);
-    tcflush(g_sonar_fd, TCIFLUSH);
-    return 0;
+    return nread;
+}
+
+
+ /*******************************************************************
+ * 函数原型:serialPortStream_t *Sonar_getStream(void)
+ * 函数简介:返回串口接收缓冲区，用于设置取帧策略和查看接收统计
+ * 函数参数:无
+ * 函数返回值: 接收缓冲区
+ *****************************************************************/
+serialPortStream_t *Sonar_getStream(void)
+{
+    return &g_sonar_stream;
 }
 
 
@@ -414,7 +448,7 @@ int Sonar_ParseData(void)
 	}
 	else if(strncmp((char *)g_sonar_readbuf, "invalid", 7) == 0)
 	{
-		printf("Sonar_ParseData:声呐数据无效\n");
+		LOG_W(LOG_MOD_SONAR, "Sonar_ParseData:声呐数据无效\n");
 		return -1;
 	}
 
@@ -424,7 +458,6 @@ int Sonar_ParseData(void)
     unsigned int bearingHex = 0;
     float bearing = 0.0f;
 
-    pthread_rwlock_wrlock(&g_sonar_rwlock);
     bearingH = *(g_sonar_readbuf + 41);
     bearingL = *(g_sonar_readbuf + 40);
     bearingHex = (unsigned int)(bearingH << 8 | bearingL);
@@ -448,10 +481,22 @@ int Sonar_ParseData(void)
     }
     g_sonar_dataPack.obstaclesDistance = distance;
 
-    pthread_rwlock_unlock(&g_sonar_rwlock);
+    Bus_publish(&g_sonar_bus, &g_sonar_dataPack, g_sonar_stream.frameStampNs);
     return 0;
 }
 
+/*******************************************************************
+* 函数原型:int Sonar_getDataPack(sonarDataPack_t *out, int64_t *stampNs)
+* 函数简介:获取最新一次解析结果的快照(任何线程都可以调用，不阻塞解析线程)
+* 函数参数:out:输出数据
+* 函数参数:stampNs:输出数据的时间戳(原始数据读入的时间，Clock_nowNs)，可以为NULL，用Bus_ageMs判断数据新旧
+* 函数返回值:成功返回0，还没有数据返回1
+*****************************************************************/
+int Sonar_getDataPack(sonarDataPack_t *out, int64_t *stampNs)
+{
+    return Bus_read(&g_sonar_bus, out, stampNs);
+}
+
 /*******************************************************************
 * 函数原型:float Sonar_getObstaclesBearingValue(void)
 * 函数简介:获得障碍物方位数值。单位是角度
@@ -460,7 +505,9 @@ int Sonar_ParseData(void)
 *****************************************************************/ 
 float Sonar_getObstaclesBearingValue(void)
 {
-    return g_sonar_dataPack.obstaclesBearing;
+    sonarDataPack_t pack;
+    Sonar_getDataPack(&pack, NULL);
+    return pack.obstaclesBearing;
 }
 
 /*******************************************************************
@@ -471,7 +518,9 @@ float Sonar_getObstaclesBearingValue(void)
 *****************************************************************/ 
 float Sonar_getObstaclesDistanceValue(void)
 {
-    return g_sonar_dataPack.obstaclesDistance;
+    sonarDataPack_t pack;
+    Sonar_getDataPack(&pack, NULL);
+    return pack.obstaclesDistance;
 }
 
 /*******************************************************************
@@ -497,10 +546,8 @@ char *Sonar_DataPackageProcessing(void)
 *****************************************************************/ 
 void Sonar_PrintSensorData(void)
 {
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-    printf("TIME: %d-%02d-%02d %02d:%02d:%02d\n",nowtime->tm_year + 1900,nowtime->tm_mon + 1,nowtime->tm_mday,\
-    											nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
+	char timeStr[CLOCK_FORMAT_LEN];
+    printf("TIME: %s\n", Clock_format(Clock_nowNs(), timeStr, sizeof(timeStr)));
 	
 	printf("************声呐数据信息**************\n");
 	printf("方位:%05.1f °\n", g_sonar_dataPack.obstaclesBearing);
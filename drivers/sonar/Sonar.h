@@ -25,6 +25,8 @@
 #include <termios.h>
 #include <pthread.h>
 #include <time.h>
+#include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/bus/bus.h"
 
 
 /************************************************************************************
@@ -46,6 +48,7 @@ int Sonar_getFD(void);
 
 /*	初始化	*/
 int Sonar_Init(void);
+int Sonar_Reopen(void);
 
 /*	关闭声呐	*/
 int Sonar_Close(void);
@@ -60,9 +63,11 @@ int Sonar_SendDataRequest(void);
 
 /*	读取/解析数据	*/
 ssize_t Sonar_ReadRawData(void);
+serialPortStream_t *Sonar_getStream(void);
 int Sonar_ParseData(void);
 
 /*	数据获取	*/
+int Sonar_getDataPack(sonarDataPack_t *out, int64_t *stampNs);
 float Sonar_getObstaclesBearingValue(void);
 float Sonar_getObstaclesDistanceValue(void);
 
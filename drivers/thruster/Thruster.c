@@ -5,7 +5,113 @@
  ************************************************************************************/
 
 #include "Thruster.h"
+#include <poll.h>
+#include <limits.h>
+#include <sys/eventfd.h>
 #include "../../sys/SerialPort/SerialPort.h"
+#include "../../tool/tool.h"
+#include "../../sys/latency/latency.h"
+#include "../../sys/trace/trace.h"
+#include "../../sys/log/log.h"
+#include "../../sys/metrics/metrics.h"
+#include "../../sys/procstat/procstat.h"
+#include "../../sys/rt/rt.h"
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+#define THRUSTER_FRAME_MAX_LEN      13          //控制指令的最大长度
+
+/*  Modbus RTU帧间隔:3.5个字符的静默时间(1个字符 = 1起始位 + 8数据位 + 1停止位 + 1余量 = 11位)    */
+#define THRUSTER_BAUDRATE           115200
+#define THRUSTER_CHAR_US            ((11 * 1000000 + THRUSTER_BAUDRATE - 1) / THRUSTER_BAUDRATE)
+#define THRUSTER_T35_US             (THRUSTER_CHAR_US * 7 / 2)
+
+/*  应答超时(从开始发送算起)    */
+#define THRUSTER_RESPONSE_TIMEOUT_MS    10          //控制、心跳指令
+#define THRUSTER_CONFIG_TIMEOUT_MS      50          //上电配置指令
+
+/*  转速设定值与电机已确认的值相同时不再发送，但超过这个时间仍重发一次，防止电机侧状态丢失  */
+#define THRUSTER_REFRESH_INTERVAL_MS    1000
+
+/*  总线调度:心跳每THRUSTER_HEARTBEAT_PERIOD_MS发一帧，8帧(4个电机 x 2)一个周期，共4s   */
+#define THRUSTER_HEARTBEAT_NUM          8
+#define THRUSTER_HEARTBEAT_PERIOD_MS    500
+
+/*  反馈寄存器(0x03读取):实际转速(32位有符号，2个寄存器) 电流(0.01A) 故障码。
+    地址和布局还没有按推进器控制器手册确认，反馈轮询默认关闭(主程序-f打开)，确认前不要默认启用   */
+#define THRUSTER_REG_FEEDBACK       0x1780
+#define THRUSTER_REG_FEEDBACK_NUM   4
+
+/*  反馈轮询:每个电机每THRUSTER_TELEMETRY_PERIOD_MS读一次，各电机错开，优先级最低  */
+#define THRUSTER_TELEMETRY_PERIOD_MS    200
+
+/*  实际转速与设定值相差不超过设定值的10%(最少THRUSTER_SETTLE_MIN)视为跟上  */
+#define THRUSTER_SETTLE_PERCENT     10
+#define THRUSTER_SETTLE_MIN         (THRUSTER_SPEED_PER_LEVEL / 10)
+
+/*  设定转速不小于1档，超过THRUSTER_STALL_MS实际转速仍低于设定值的20%，认为堵转或被缠绕   */
+#define THRUSTER_STALL_MS           1000
+#define THRUSTER_STALL_PERCENT      20
+
+/*  一次总线事务最长占用时间:帧间隔 + 发送最长指令 + 等待应答    */
+#define THRUSTER_SLOT_US            (THRUSTER_T35_US + THRUSTER_CHAR_US * THRUSTER_FRAME_MAX_LEN + THRUSTER_RESPONSE_TIMEOUT_MS * 1000)
+
+/*  控制指令最坏等待时间:正在进行的一次事务(心跳或反馈轮询) + 一帧过期的心跳 + 其他电机各一帧控制指令 */
+#define THRUSTER_CONTROL_WORST_US   ((THRUSTER_MOTOR_NUM + 1) * THRUSTER_SLOT_US)
+
+/*  原始指令(Thruster_SendCommand)的转速未知    */
+#define THRUSTER_SPEED_UNKNOWN      INT_MIN
+
+/*  水平电机(1, 2号)、垂直电机(3, 4号)在g_thruster_stopped_mask中的位   */
+#define THRUSTER_HORIZONTAL_MASK    ((1u << (THRUSTER_MOTOR_1 - 1)) | (1u << (THRUSTER_MOTOR_2 - 1)))
+#define THRUSTER_VERTICAL_MASK      ((1u << (THRUSTER_MOTOR_3 - 1)) | (1u << (THRUSTER_MOTOR_4 - 1)))
+
+/*  Modbus功能码    */
+#define MODBUS_FC_READ_HOLDING      0x03
+#define MODBUS_FC_WRITE_SINGLE      0x06
+#define MODBUS_FC_WRITE_MULTIPLE    0x10
+#define MODBUS_EXCEPTION_FLAG       0x80
+
+/*  转速设定寄存器:2个寄存器，32位有符号数，高字在前    */
+#define THRUSTER_REG_SPEED          0x1773
+#define THRUSTER_REG_SPEED_NUM      2
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  每个电机的最新指令槽:控制接口只覆盖槽中的指令，由总线发送线程取走发送    */
+typedef struct {
+    unsigned char frame[THRUSTER_FRAME_MAX_LEN];   //指令
+    size_t len;                                     //指令长度
+    int pending;                                    //1为等待发送
+    int isStop;                                     //1为停止指令，优先发送
+    int speed;                                      //指令对应的转速，原始指令为THRUSTER_SPEED_UNKNOWN
+    int motorIdx;                                   //电机下标(0开始)
+    struct timespec postedAt;                       //进入槽的时间(被合并时保留最早的时间)
+    int64_t sampleStampNs;                          //产生该指令的传感器样本时间戳(延时统计用)，0为无
+} thrusterSlot_t;
+
+/*  每个电机最近一次被应答确认的转速    */
+typedef struct {
+    int valid;                                      //1为电机状态已知
+    int speed;                                      //已确认的转速
+    struct timespec ackedAt;                        //确认时间(CLOCK_MONOTONIC)
+} thrusterSetpoint_t;
+
+/*  每个电机的设定值跟踪(计算响应时间和判断堵转)   */
+typedef struct {
+    int target;                                     //最近一次确认的设定值
+    struct timespec setAt;                          //设定值确认的时间
+    int settling;                                   //1为实际转速还没跟上
+} thrusterTrack_t;
+
+/*  总线调度线程每次发送的指令种类  */
+typedef enum {
+    THRUSTER_FRAME_CONTROL = 0,                     //控制指令
+    THRUSTER_FRAME_HEARTBEAT,                       //心跳
+    THRUSTER_FRAME_TELEMETRY                        //反馈轮询
+} thrusterFrameKind_t;
 
 /************************************************************************************
  									全局变量(可以extern的变量)
@@ -30,9 +136,54 @@ static struct termios g_oldSerialPortConfig = {0};
 
 /*  线程标志    */
 static volatile int g_heartbeat_running = 0;
+static volatile int g_buswriter_running = 0;
+static pthread_t g_buswriter_tid = 0;
+
+/*  总线发送队列:每个电机一个槽，槽的访问由g_thruster_queue_mutex保护   */
+static thrusterSlot_t g_thruster_slots[THRUSTER_MOTOR_NUM];
+static pthread_mutex_t g_thruster_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_thruster_queue_cond;                                   //有新指令(CLOCK_MONOTONIC，只初始化一次)
+static pthread_once_t g_thruster_queue_cond_once = PTHREAD_ONCE_INIT;
+static pthread_cond_t g_thruster_idle_cond = PTHREAD_COND_INITIALIZER;         //队列已发空
+static int g_thruster_inflight = 0;                 //发送线程正在发送的指令数
+
+/*  各种指令的追踪事件名(按thrusterFrameKind_t排列)    */
+static const char *g_thruster_frame_trace_name[] = {"Control", "Heartbeat", "Poll"};
+
+static int g_thruster_next_slot = 0;                //轮询发送的起始槽
+static thrusterBusStats_t g_thruster_bus_stats = {0};
+static thrusterSetpoint_t g_thruster_setpoints[THRUSTER_MOTOR_NUM];    //已确认的转速缓存
+static unsigned int g_thruster_stopped_mask = 0;    //最近一次请求的转速为0的电机(第i位为电机i+1)，停止日志只在变化时输出
+
+/*  心跳时间表(由g_thruster_queue_mutex保护)  */
+static int g_thruster_heartbeat_idx = 0;                //下一帧心跳
+static struct timespec g_thruster_heartbeat_due = {0};  //下一帧心跳的发送时间(CLOCK_MONOTONIC)
+
+/*  反馈轮询(由g_thruster_queue_mutex保护)    */
+static volatile int g_telemetry_running = 0;
+static int g_thruster_telemetry_idx = 0;                //下一个轮询的电机
+static struct timespec g_thruster_telemetry_due = {0};  //下一次轮询的时间(CLOCK_MONOTONIC)
+static thrusterDataPack_t g_thruster_telemetry = {0};   //总线调度线程写入的最新反馈
+static int64_t g_thruster_telemetry_stampNs = 0;         //最新一轮反馈收齐的时间(Clock_nowNs)
+
+/*  调用线程当前使用的传感器样本时间戳，随指令进入槽(每个线程各自一份) */
+static __thread int64_t g_thruster_sample_stampNs = 0;
+
+/*  反馈数据(由Thruster_ReadTelemetry更新，只在取数据的线程中使用)，更新后发布到总线  */
+static thrusterDataPack_t g_thruster_dataPack = {0};
+
+/*  最新值总线:其他线程通过Thruster_getDataPack取快照  */
+static thrusterDataPack_t g_thruster_sample = {0};
+static busSlot_t g_thruster_bus = BUS_SLOT_INITIALIZER(g_thruster_sample);
+static thrusterTrack_t g_thruster_track[THRUSTER_MOTOR_NUM];
+static int g_thruster_event_fd = -1;                    //每轮询完一轮所有电机通知一次
+
+/*  Modbus应答统计与总线时序(由g_thruster_mutex保护)   */
+static thrusterModbusStats_t g_thruster_modbus_stats[THRUSTER_MOTOR_NUM];
+static struct timespec g_thruster_bus_idle_since = {0};        //总线最近一次变为空闲的时间
 
 /*  电机心跳包命令  */
-static const unsigned char HEARTBEAT_CMDS[8][8] = {
+static const unsigned char HEARTBEAT_CMDS[THRUSTER_HEARTBEAT_NUM][8] = {
     {0x01, 0x06, 0x17, 0x70, 0x00, 0x01, 0x4C, 0x65},       //电机1_1
     {0x02, 0x06, 0x17, 0x70, 0x00, 0x01, 0x4C, 0x56},       //电机2_1
     {0x03, 0x06, 0x17, 0x70, 0x00, 0x01, 0x4D, 0x87},       //电机3_1
@@ -52,96 +203,8 @@ static const unsigned char STARTUP_CMDS[4][8] = {
     {0x04, 0x06, 0x17, 0x71, 0x00, 0x01, 0x1D, 0xF0}        //电机4初始化
 };
 
-/*  电机控制命令 (正向/反向 x 5个级别)  */
-static const unsigned char MOTOR_CMDS[4][2][5][13] = {
-    // 电机1
-    {
-        // 正向
-        {
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xEF, 0x98, 0x12, 0xD0}, //级别1
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xDF, 0xF8, 0x06, 0xFB}, //级别2
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xCE, 0xC8, 0x0A, 0xBC}, //级别3
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xBE, 0x60, 0x2E, 0xC2}, //级别4
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xAD, 0xF8, 0x22, 0x58}  //级别5
-        },
-        // 反向
-        {
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x10, 0x68, 0x53, 0x40}, //级别1
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x20, 0x0D, 0x47, 0x32}, //级别2
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x31, 0x38, 0x4B, 0x2C}, //级别3
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x41, 0xA0, 0x6F, 0x46}, //级别4
-            {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x52, 0x08, 0x63, 0xC8}  //级别5
-        }
-    },
-
-    //电机2
-    {
-        //正向
-        {
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x10, 0x68, 0x5C, 0x04}, //级别1
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x20, 0xD0, 0x48, 0x76}, //级别2
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x31, 0x38, 0x44, 0x68}, //级别3
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x41, 0xA0, 0x60, 0x02}, //级别4
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x52, 0x08, 0x6C, 0x8C}  //级别5
-        },
-        //反向
-        {
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xEF, 0x98, 0x1D, 0x94}, //级别1
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xDF, 0xF8, 0x09, 0xBC}, //级别2
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xCE, 0xC8, 0x05, 0xFB}, //级别3
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xBE, 0x60, 0x21, 0x86}, //级别4
-            {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xAD, 0xF8, 0x2D, 0x1C}  //级别5
-        }
-    },
-
-    //电机3
-    {
-        //正向
-        {
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xEF, 0x98, 0x19, 0x68}, //级别1
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xDF, 0xF8, 0x0D, 0x40}, //级别2
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xCE, 0xC8, 0x01, 0x04}, //级别3
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xBE, 0x60, 0x25, 0x7A}, //级别4
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xAD, 0xF8, 0x29, 0xE0}  //级别5
-        },
-        //反向
-        {
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x10, 0x68, 0x58, 0xF8}, //级别1
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x20, 0xD0, 0x4C, 0x8A}, //级别2
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x31, 0x38, 0x40, 0x94}, //级别3
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x41, 0xA0, 0x64, 0xFE}, //级别4
-            {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x52, 0x08, 0x68, 0x70}  //级别5
-        }
-    },
-
-    //电机4
-    {
-        //正向
-        {
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x10, 0x68, 0x42, 0x8C}, //级别1
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x20, 0xD0, 0x56, 0xFE}, //级别2
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x31, 0x38, 0x5A, 0xE0}, //级别3
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x41, 0xA0, 0x7E, 0x8A}, //级别4
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x52, 0x08, 0x72, 0x04}  //级别5
-        },
-        //反向
-        {
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xEF, 0x98, 0x03, 0x1C}, //级别1
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xDF, 0xF8, 0x17, 0x34}, //级别2
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xCE, 0xC8, 0x1B, 0x70}, //级别3
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xBE, 0x60, 0x3F, 0x0E}, //级别4
-            {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0xFF, 0xFF, 0xAD, 0xF8, 0x33, 0x94}  //级别5
-        }
-    }
-};
-
-/*  停止命令    */
-static const unsigned char STOP_CMDS[4][13] = {
-    {0x01, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x5F, 0x6E}, //电机1停止
-    {0x02, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x50, 0x2A}, //电机2停止
-    {0x03, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x54, 0xD6}, //电机3停止
-    {0x04, 0x10, 0x17, 0x73, 0x00, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x4E, 0xA2}  //电机4停止
-};
+/*  各电机"正转"对应的转速寄存器符号(电机安装方向不同)    */
+static const int THRUSTER_POLARITY[THRUSTER_MOTOR_NUM] = {-1, 1, -1, 1};
 
 /************************************************************************************
  									辅助函数(仅本文件可使用)
@@ -191,40 +254,634 @@ static int Thruster_ConfigureSerial(int fd)
 }
 
 
+/*******************************************************************
+* 函数原型:static long Thruster_ElapsedUs(const struct timespec *since)
+* 函数简介:计算从since到现在经过的时间。
+* 函数参数:since:起始时间(CLOCK_MONOTONIC)
+* 函数返回值:经过的微秒数
+*****************************************************************/
+static long Thruster_ElapsedUs(const struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - since->tv_sec) * 1000000L + (now.tv_nsec - since->tv_nsec) / 1000L;
+}
+
+
+/*******************************************************************
+* 函数原型:static size_t Thruster_ExpectedResponseLen(const unsigned char *cmd, size_t len)
+* 函数简介:根据请求计算正常应答的长度。
+* 函数参数:cmd:请求
+* 函数参数:len:请求长度
+* 函数返回值:应答长度，不需要应答(广播或未知功能码)返回0
+*****************************************************************/
+static size_t Thruster_ExpectedResponseLen(const unsigned char *cmd, size_t len)
+{
+    if (len < 8 || cmd[0] == 0) {
+        return 0;
+    }
+
+    switch (cmd[1]) {
+        case MODBUS_FC_WRITE_SINGLE:                //原样返回:地址 功能码 寄存器(2) 数值(2) CRC(2)
+        case MODBUS_FC_WRITE_MULTIPLE:              //地址 功能码 起始寄存器(2) 寄存器个数(2) CRC(2)
+            return 8;
+        case MODBUS_FC_READ_HOLDING:                //地址 功能码 字节数 数据(2*N) CRC(2)
+            return 5 + 2 * (((size_t)cmd[4] << 8) | cmd[5]);
+        default:
+            return 0;
+    }
+}
+
+
+/*******************************************************************
+* 函数原型:static int Thruster_ReadResponse(const unsigned char *cmd, size_t len, unsigned char *response,
+                                size_t resp_len, int timeout_ms, thrusterModbusStats_t *st)
+* 函数简介:读取并检查Modbus RTU应答:长度、CRC16、地址和功能码、异常应答、回显内容。
+* 函数参数:cmd/len:请求
+* 函数参数:response/resp_len:存放应答的数组
+* 函数参数:timeout_ms:超时时间(从开始发送算起)
+* 函数参数:st:该电机的应答统计
+* 函数返回值:应答正确返回0，否则返回-1。
+*****************************************************************/
+static int Thruster_ReadResponse(const unsigned char *cmd, size_t len, unsigned char *response,
+                                 size_t resp_len, int timeout_ms, thrusterModbusStats_t *st)
+{
+    size_t expect = Thruster_ExpectedResponseLen(cmd, len);
+    if (expect == 0) {
+        return 0;
+    }
+    if (expect > resp_len) {
+        return -1;
+    }
+
+    /*  1.在超时时间内收齐应答  */
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t got = 0;
+    while (got < expect) {
+        int remain = timeout_ms - (int)(Thruster_ElapsedUs(&start) / 1000);
+        struct pollfd pfd = {g_thruster_fd, POLLIN, 0};
+        int n = (remain > 0) ? poll(&pfd, 1, remain) : 0;
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            st->timeouts++;
+            if (++st->consecutiveTimeouts == 1) {
+                LOG_W(LOG_MOD_THRUSTER, "推进器：电机%d应答超时\n", cmd[0]);
+            }
+            return -1;
+        }
+
+        ssize_t r = read(g_thruster_fd, response + got, expect - got);
+        if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        if (r <= 0) {
+            perror("Thruster_ReadResponse:read");
+            return -1;
+        }
+        got += r;
+        Metrics_add(METRICS_DEV_THRUSTER, METRICS_BYTES_READ, r);
+
+        /*  异常应答只有5个字节:地址 功能码|0x80 异常码 CRC(2)  */
+        if (got >= 2 && (response[1] & MODBUS_EXCEPTION_FLAG)) {
+            expect = 5;
+        }
+    }
+    st->consecutiveTimeouts = 0;
+
+    /*  2.CRC16(低字节在前)    */
+    unsigned short crc = Tool_modbusCRC16(response, expect - 2);
+    if (response[expect - 2] != (crc & 0xFF) || response[expect - 1] != (crc >> 8)) {
+        st->crcErrors++;
+        Metrics_add(METRICS_DEV_THRUSTER, METRICS_FRAMES_INVALID, 1);
+        return -1;
+    }
+
+    /*  3.地址和功能码  */
+    if (response[0] != cmd[0] || (response[1] & ~MODBUS_EXCEPTION_FLAG) != cmd[1]) {
+        st->mismatches++;
+        Metrics_add(METRICS_DEV_THRUSTER, METRICS_FRAMES_INVALID, 1);
+        return -1;
+    }
+
+    /*  4.异常应答:电机拒绝了请求   */
+    if (response[1] & MODBUS_EXCEPTION_FLAG) {
+        st->exceptions++;
+        st->lastException = response[2];
+        LOG_W(LOG_MOD_THRUSTER, "推进器：电机%d拒绝请求(功能码0x%02X，异常码0x%02X)\n", cmd[0], cmd[1], response[2]);
+        return -1;
+    }
+
+    /*  5.回显内容:写单个寄存器原样返回，写多个寄存器返回起始地址和个数，读寄存器返回字节数  */
+    if ((cmd[1] == MODBUS_FC_READ_HOLDING && response[2] != expect - 5) ||
+        (cmd[1] != MODBUS_FC_READ_HOLDING && memcmp(response, cmd, 6) != 0)) {
+        st->mismatches++;
+        Metrics_add(METRICS_DEV_THRUSTER, METRICS_FRAMES_INVALID, 1);
+        return -1;
+    }
+
+    st->ok++;
+    Metrics_add(METRICS_DEV_THRUSTER, METRICS_FRAMES, 1);
+    return 0;
+}
+
+
 /*******************************************************************
 * 函数原型:static int Thruster_SendCommandWithResponse(const unsigned char *cmd, size_t len, 
-                                 unsigned char *response, size_t resp_len) 
-* 函数简介:向推进器发送命令，并且等待回应。
+                                 unsigned char *response, size_t resp_len, int timeout_ms) 
+* 函数简介:向推进器发送命令，并且等待回应。发送前保证总线已静默3.5个字符时间。
 * 函数参数:cmd:命令
 * 函数参数:len:命令长度
 * 函数参数:response:回应的数据
 * 函数参数:resp_len:回应的长度
+* 函数参数:timeout_ms:应答超时时间
 * 函数返回值:成功返回0，失败返回-1。
 *****************************************************************/
 static int Thruster_SendCommandWithResponse(const unsigned char *cmd, size_t len, 
-                                 unsigned char *response, size_t resp_len) 
+                                 unsigned char *response, size_t resp_len, int timeout_ms) 
 {
-    if (g_thruster_fd < 0) return -1;
+    if (g_thruster_fd < 0 || len < 2 || cmd[0] < 1 || cmd[0] > THRUSTER_MOTOR_NUM) return -1;
+
+    thrusterModbusStats_t *st = &g_thruster_modbus_stats[cmd[0] - 1];
     
     pthread_mutex_lock(&g_thruster_mutex);
     
-    // 清空缓冲区
-    tcflush(g_thruster_fd, TCIOFLUSH);
+    // 帧间隔:距离总线上一次空闲至少3.5个字符
+    long idle = Thruster_ElapsedUs(&g_thruster_bus_idle_since);
+    if (idle >= 0 && idle < THRUSTER_T35_US) {
+        usleep(THRUSTER_T35_US - idle);
+    }
+
+    // 丢弃上一次应答之后残留的字节
+    Metrics_flushed(METRICS_DEV_THRUSTER, SerialPort_flush(g_thruster_fd, TCIFLUSH));
     
     // 发送命令
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     if (write(g_thruster_fd, cmd, len) != len) {
+        clock_gettime(CLOCK_MONOTONIC, &g_thruster_bus_idle_since);
         pthread_mutex_unlock(&g_thruster_mutex);
         return -1;
     }
+    st->requests++;
 
-    usleep(20000);
-    
     // 读取响应
-    //int n = read(g_thruster_fd, response, resp_len);
-    
+    int ret = Thruster_ReadResponse(cmd, len, response, resp_len, timeout_ms, st);
+    if (ret == 0) {
+        st->lastRttUs = Thruster_ElapsedUs(&start);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &g_thruster_bus_idle_since);
     pthread_mutex_unlock(&g_thruster_mutex);
     
-    return 0;//(n > 0) ? 0 : -1;
+    return ret;
+}
+
+
+/*******************************************************************
+* 函数原型:static size_t Thruster_BuildSpeedFrame(ThrusterMotorID motor, long value, unsigned char *frame)
+* 函数简介:生成写转速寄存器的Modbus指令(功能码0x10)，CRC16在这里现算。
+* 函数参数:motor:电机ID
+* 函数参数:value:写入寄存器的转速值(已按电机安装方向换算)
+* 函数参数:frame:指令缓冲区，长度不小于THRUSTER_FRAME_MAX_LEN
+* 函数返回值:指令长度。
+*****************************************************************/
+static size_t Thruster_BuildSpeedFrame(ThrusterMotorID motor, long value, unsigned char *frame)
+{
+    unsigned long raw = (unsigned long)value;
+    size_t len = 0;
+
+    frame[len++] = (unsigned char)motor;
+    frame[len++] = MODBUS_FC_WRITE_MULTIPLE;
+    frame[len++] = (THRUSTER_REG_SPEED >> 8) & 0xFF;
+    frame[len++] = THRUSTER_REG_SPEED & 0xFF;
+    frame[len++] = 0x00;
+    frame[len++] = THRUSTER_REG_SPEED_NUM;
+    frame[len++] = THRUSTER_REG_SPEED_NUM * 2;
+    frame[len++] = (raw >> 24) & 0xFF;
+    frame[len++] = (raw >> 16) & 0xFF;
+    frame[len++] = (raw >> 8) & 0xFF;
+    frame[len++] = raw & 0xFF;
+
+    unsigned short crc = Tool_modbusCRC16(frame, len);
+    frame[len++] = crc & 0xFF;
+    frame[len++] = (crc >> 8) & 0xFF;
+
+    return len;
+}
+
+
+/*******************************************************************
+* 函数原型:static void Thruster_UpdateSetpoint(int motorIdx, int speed, int acked)
+* 函数简介:根据一条指令的发送结果更新转速缓存(持有g_thruster_queue_mutex时调用)。
+*          电机没有确认的指令和原始指令都会让缓存失效，下一次设定一定会发送
+* 函数参数:motorIdx:电机下标(0开始)
+* 函数参数:speed:指令对应的转速
+* 函数参数:acked:1为收到了正确应答
+* 函数返回值:无
+*****************************************************************/
+static void Thruster_UpdateSetpoint(int motorIdx, int speed, int acked)
+{
+    thrusterSetpoint_t *sp = &g_thruster_setpoints[motorIdx];
+
+    if (acked && speed != THRUSTER_SPEED_UNKNOWN) {
+        sp->valid = 1;
+        sp->speed = speed;
+        clock_gettime(CLOCK_MONOTONIC, &sp->ackedAt);
+
+        /*  设定值变化:开始计算实际转速跟上的时间   */
+        thrusterTrack_t *track = &g_thruster_track[motorIdx];
+        if (track->target != speed) {
+            track->target = speed;
+            track->setAt = sp->ackedAt;
+            track->settling = 1;
+            g_thruster_telemetry.motor[motorIdx].speedSet = speed;
+            g_thruster_telemetry.motor[motorIdx].responseMs = -1;
+        }
+    } else {
+        sp->valid = 0;
+    }
+}
+
+
+/*******************************************************************
+* 函数原型:static int Thruster_IsRedundant(int motorIdx, int speed)
+* 函数简介:判断转速设定是否不会改变电机状态(持有g_thruster_queue_mutex时调用)。
+*          槽中有待发送的指令时和待发送的比较，否则和已确认的比较，
+*          已确认的值超过THRUSTER_REFRESH_INTERVAL_MS后要重发(记为refreshed)
+* 函数参数:motorIdx:电机下标(0开始)
+* 函数参数:speed:新的转速
+* 函数返回值:可以不发送返回1，需要发送返回0。
+*****************************************************************/
+static int Thruster_IsRedundant(int motorIdx, int speed)
+{
+    const thrusterSlot_t *slot = &g_thruster_slots[motorIdx];
+    const thrusterSetpoint_t *sp = &g_thruster_setpoints[motorIdx];
+
+    if (slot->pending) {
+        return slot->speed == speed;
+    }
+
+    if (!sp->valid || sp->speed != speed) {
+        return 0;
+    }
+
+    if (Thruster_ElapsedUs(&sp->ackedAt) >= THRUSTER_REFRESH_INTERVAL_MS * 1000L) {
+        g_thruster_bus_stats.refreshed++;
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/*******************************************************************
+* 函数原型:static int Thruster_PostCommand(ThrusterMotorID motor, const unsigned char *cmd, size_t len, int isStop, int speed)
+* 函数简介:把指令放进电机的最新指令槽并唤醒总线发送线程，不等待串口，调用者不会被阻塞。
+*          槽中还没发送的旧指令直接被覆盖(合并)，和电机当前状态相同的转速设定直接丢弃。
+*          发送线程没有运行时退回同步发送
+* 函数参数:motor:电机ID
+* 函数参数:cmd:命令
+* 函数参数:len:命令长度
+* 函数参数:isStop:1为停止指令
+* 函数参数:speed:指令对应的转速，原始指令填THRUSTER_SPEED_UNKNOWN
+* 函数返回值:成功返回0，失败返回-1。
+*****************************************************************/
+static int Thruster_PostCommand(ThrusterMotorID motor, const unsigned char *cmd, size_t len, int isStop, int speed)
+{
+    if (motor < 1 || motor > THRUSTER_MOTOR_NUM || cmd == NULL || len > THRUSTER_FRAME_MAX_LEN) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    g_thruster_bus_stats.posted++;
+    if (speed == 0) {
+        g_thruster_stopped_mask |= 1u << (motor - 1);
+    } else {
+        g_thruster_stopped_mask &= ~(1u << (motor - 1));
+    }
+    if (speed != THRUSTER_SPEED_UNKNOWN && Thruster_IsRedundant(motor - 1, speed)) {
+        g_thruster_bus_stats.suppressed++;
+        pthread_mutex_unlock(&g_thruster_queue_mutex);
+        return 0;
+    }
+
+    if (!g_buswriter_running) {
+        g_thruster_setpoints[motor - 1].valid = 0;         //发送期间电机状态未知
+        pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+        unsigned char response[16];
+        int ret = Thruster_SendCommandWithResponse(cmd, len, response, sizeof(response), THRUSTER_RESPONSE_TIMEOUT_MS);
+
+        pthread_mutex_lock(&g_thruster_queue_mutex);
+        Thruster_UpdateSetpoint(motor - 1, speed, ret == 0);
+        pthread_mutex_unlock(&g_thruster_queue_mutex);
+        if (ret == 0) {
+            Latency_recordSince(LATENCY_STAGE_TOTAL, g_thruster_sample_stampNs);
+        }
+        return ret;
+    }
+
+    thrusterSlot_t *slot = &g_thruster_slots[motor - 1];
+    if (slot->pending) {
+        g_thruster_bus_stats.coalesced++;
+    } else {
+        clock_gettime(CLOCK_MONOTONIC, &slot->postedAt);
+    }
+    memcpy(slot->frame, cmd, len);
+    slot->len = len;
+    slot->isStop = isStop;
+    slot->speed = speed;
+    slot->motorIdx = motor - 1;
+    slot->sampleStampNs = g_thruster_sample_stampNs;
+    slot->pending = 1;
+    pthread_cond_signal(&g_thruster_queue_cond);
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+    return 0;
+}
+
+
+/*******************************************************************
+* 函数原型:static int Thruster_TakeSlot(thrusterSlot_t *out)
+* 函数简介:取出下一条要发送的指令(持有g_thruster_queue_mutex时调用)。
+*          停止指令优先，其余按电机轮询，避免某个电机一直占用总线
+* 函数参数:out:取出的指令
+* 函数返回值:取到返回1，队列为空返回0。
+*****************************************************************/
+static int Thruster_TakeSlot(thrusterSlot_t *out)
+{
+    int pick = -1;
+
+    for (int i = 0; i < THRUSTER_MOTOR_NUM; i++) {
+        int idx = (g_thruster_next_slot + i) % THRUSTER_MOTOR_NUM;
+        if (g_thruster_slots[idx].pending && g_thruster_slots[idx].isStop) {
+            pick = idx;
+            break;
+        }
+        if (pick < 0 && g_thruster_slots[idx].pending) {
+            pick = idx;
+        }
+    }
+
+    if (pick < 0) {
+        return 0;
+    }
+
+    *out = g_thruster_slots[pick];
+    g_thruster_slots[pick].pending = 0;
+    g_thruster_setpoints[pick].valid = 0;              //发送期间电机状态未知，等应答后再确认
+    g_thruster_next_slot = (pick + 1) % THRUSTER_MOTOR_NUM;
+
+    return 1;
+}
+
+
+/*******************************************************************
+* 函数原型:static void Thruster_AddMs(struct timespec *ts, long ms)
+* 函数简介:时间加上若干毫秒。
+* 函数参数:ts:时间
+* 函数参数:ms:毫秒数
+* 函数返回值:无
+*****************************************************************/
+static void Thruster_AddMs(struct timespec *ts, long ms)
+{
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+
+/*******************************************************************
+* 函数原型:static int Thruster_TakeHeartbeat(thrusterSlot_t *out, long overdueUs)
+* 函数简介:心跳到时间时取出下一帧心跳(持有g_thruster_queue_mutex时调用)。
+*          落后超过一个周期时不补发，从现在开始重新排时间表
+* 函数参数:out:取出的指令
+* 函数参数:overdueUs:只有超过发送时间这么久才取出(0为到时间就取)
+* 函数返回值:取到返回1，没有到时间或心跳关闭返回0。
+*****************************************************************/
+static int Thruster_TakeHeartbeat(thrusterSlot_t *out, long overdueUs)
+{
+    if (!g_heartbeat_running || Thruster_ElapsedUs(&g_thruster_heartbeat_due) < overdueUs) {
+        return 0;
+    }
+
+    const unsigned char *cmd = HEARTBEAT_CMDS[g_thruster_heartbeat_idx];
+    memcpy(out->frame, cmd, 8);
+    out->len = 8;
+    out->isStop = 0;
+    out->speed = THRUSTER_SPEED_UNKNOWN;
+    out->motorIdx = cmd[0] - 1;
+    out->postedAt = g_thruster_heartbeat_due;
+
+    g_thruster_heartbeat_idx = (g_thruster_heartbeat_idx + 1) % THRUSTER_HEARTBEAT_NUM;
+    if (Thruster_ElapsedUs(&g_thruster_heartbeat_due) >= THRUSTER_HEARTBEAT_PERIOD_MS * 1000L) {
+        clock_gettime(CLOCK_MONOTONIC, &g_thruster_heartbeat_due);
+    }
+    Thruster_AddMs(&g_thruster_heartbeat_due, THRUSTER_HEARTBEAT_PERIOD_MS);
+    g_thruster_bus_stats.heartbeats++;
+
+    return 1;
+}
+
+
+/*******************************************************************
+* 函数原型:static int Thruster_TakeTelemetry(thrusterSlot_t *out)
+* 函数简介:轮询时间到时生成下一个电机的反馈读取指令(持有g_thruster_queue_mutex时调用)。
+* 函数参数:out:取出的指令
+* 函数返回值:取到返回1，没有到时间或轮询关闭返回0。
+*****************************************************************/
+static int Thruster_TakeTelemetry(thrusterSlot_t *out)
+{
+    if (!g_telemetry_running || Thruster_ElapsedUs(&g_thruster_telemetry_due) < 0) {
+        return 0;
+    }
+
+    size_t len = 0;
+    out->frame[len++] = (unsigned char)(g_thruster_telemetry_idx + 1);
+    out->frame[len++] = MODBUS_FC_READ_HOLDING;
+    out->frame[len++] = (THRUSTER_REG_FEEDBACK >> 8) & 0xFF;
+    out->frame[len++] = THRUSTER_REG_FEEDBACK & 0xFF;
+    out->frame[len++] = 0x00;
+    out->frame[len++] = THRUSTER_REG_FEEDBACK_NUM;
+    unsigned short crc = Tool_modbusCRC16(out->frame, len);
+    out->frame[len++] = crc & 0xFF;
+    out->frame[len++] = (crc >> 8) & 0xFF;
+
+    out->len = len;
+    out->isStop = 0;
+    out->speed = THRUSTER_SPEED_UNKNOWN;
+    out->motorIdx = g_thruster_telemetry_idx;
+    out->postedAt = g_thruster_telemetry_due;
+
+    g_thruster_telemetry_idx = (g_thruster_telemetry_idx + 1) % THRUSTER_MOTOR_NUM;
+    if (Thruster_ElapsedUs(&g_thruster_telemetry_due) >= THRUSTER_TELEMETRY_PERIOD_MS * 1000L) {
+        clock_gettime(CLOCK_MONOTONIC, &g_thruster_telemetry_due);
+    }
+    Thruster_AddMs(&g_thruster_telemetry_due, THRUSTER_TELEMETRY_PERIOD_MS / THRUSTER_MOTOR_NUM);
+
+    return 1;
+}
+
+
+/*******************************************************************
+* 函数原型:static void Thruster_UpdateTelemetry(int motorIdx, const unsigned char *response)
+* 函数简介:解析反馈读取的应答，更新响应时间和堵转判断(持有g_thruster_queue_mutex时调用)。
+*          轮询完一轮所有电机后通过eventfd通知取数据的线程
+* 函数参数:motorIdx:电机下标(0开始)
+* 函数参数:response:已校验过的应答(地址 功能码 字节数 数据 CRC)
+* 函数返回值:无
+*****************************************************************/
+static void Thruster_UpdateTelemetry(int motorIdx, const unsigned char *response)
+{
+    thrusterMotorData_t *m = &g_thruster_telemetry.motor[motorIdx];
+    thrusterTrack_t *track = &g_thruster_track[motorIdx];
+    const unsigned char *d = response + 3;
+
+    m->speed = (int)(((unsigned long)d[0] << 24) | ((unsigned long)d[1] << 16) | ((unsigned long)d[2] << 8) | d[3])
+               * THRUSTER_POLARITY[motorIdx];
+    m->current = (((unsigned short)d[4] << 8) | d[5]) / 100.0;
+
+    unsigned short fault = ((unsigned short)d[6] << 8) | d[7];
+    if (fault != m->fault && fault != 0) {
+        LOG_E(LOG_MOD_THRUSTER, "推进器：电机%d故障，故障码0x%04X\n", motorIdx + 1, fault);
+    }
+    m->fault = fault;
+    m->valid = 1;
+
+    /*  1.响应时间:设定值变化后实际转速第一次进入允许误差  */
+    long band = labs((long)track->target) * THRUSTER_SETTLE_PERCENT / 100;
+    if (band < THRUSTER_SETTLE_MIN) {
+        band = THRUSTER_SETTLE_MIN;
+    }
+    long sinceSetMs = Thruster_ElapsedUs(&track->setAt) / 1000;
+    if (track->settling && labs((long)m->speed - track->target) <= band) {
+        track->settling = 0;
+        m->responseMs = sinceSetMs;
+    }
+
+    /*  2.堵转:有足够的设定转速，过了一段时间实际转速仍然很低  */
+    int stalled = labs((long)track->target) >= THRUSTER_SPEED_PER_LEVEL && sinceSetMs >= THRUSTER_STALL_MS &&
+                  labs((long)m->speed) * 100 < labs((long)track->target) * THRUSTER_STALL_PERCENT;
+    if (stalled && !m->stalled) {
+        LOG_W(LOG_MOD_THRUSTER, "推进器：电机%d疑似堵转或被缠绕(设定%d，实际%d)\n", motorIdx + 1, track->target, m->speed);
+    }
+    m->stalled = stalled;
+
+    /*  3.一轮轮询完成，通知取数据的线程    */
+    if (motorIdx == THRUSTER_MOTOR_NUM - 1 && g_thruster_event_fd >= 0) {
+        uint64_t one = 1;
+        g_thruster_telemetry_stampNs = Clock_nowNs();
+        if (write(g_thruster_event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            perror("Thruster_UpdateTelemetry:eventfd write");
+        }
+    }
+}
+
+
+/*******************************************************************
+* 函数原型:static void *Thruster_BusWriterThread(void *arg)
+* 函数简介:总线调度线程，唯一把指令写到RS485总线上的线程。每次空闲时按优先级选下一帧:
+*          1.过期超过一个周期的心跳(防止控制指令一直占满总线把电机饿到掉线)
+*          2.控制指令(停止指令优先，其余按电机轮询)
+*          3.到时间的心跳
+*          4.到时间的反馈轮询
+*          都没有时睡到下一帧心跳或下一次轮询的时间，或有新指令为止。
+*          控制指令最多等待THRUSTER_CONTROL_WORST_US
+* 函数参数:arg:参数
+* 函数返回值:无
+*****************************************************************/
+static void *Thruster_BusWriterThread(void *arg)
+{
+    (void)arg;
+    thrusterSlot_t slot;
+    unsigned char response[16];
+
+    Rt_enterThread(RT_ROLE_BUS);
+
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    while (g_buswriter_running) {
+        thrusterFrameKind_t kind = THRUSTER_FRAME_HEARTBEAT;
+
+        if (Thruster_TakeHeartbeat(&slot, THRUSTER_HEARTBEAT_PERIOD_MS * 1000L)) {
+            kind = THRUSTER_FRAME_HEARTBEAT;
+        } else if (Thruster_TakeSlot(&slot)) {
+            kind = THRUSTER_FRAME_CONTROL;
+        } else if (Thruster_TakeHeartbeat(&slot, 0)) {
+            kind = THRUSTER_FRAME_HEARTBEAT;
+        } else if (Thruster_TakeTelemetry(&slot)) {
+            kind = THRUSTER_FRAME_TELEMETRY;
+        } else {
+            pthread_cond_broadcast(&g_thruster_idle_cond);
+
+            /*  睡到最近的一个到期时间  */
+            const struct timespec *due = NULL;
+            if (g_heartbeat_running) {
+                due = &g_thruster_heartbeat_due;
+            }
+            if (g_telemetry_running && (due == NULL || Thruster_ElapsedUs(due) < Thruster_ElapsedUs(&g_thruster_telemetry_due))) {
+                due = &g_thruster_telemetry_due;
+            }
+            if (due != NULL) {
+                struct timespec wake = *due;
+                pthread_cond_timedwait(&g_thruster_queue_cond, &g_thruster_queue_mutex, &wake);
+            } else {
+                pthread_cond_wait(&g_thruster_queue_cond, &g_thruster_queue_mutex);
+            }
+            continue;
+        }
+
+        if (kind == THRUSTER_FRAME_CONTROL) {
+            long waitUs = Thruster_ElapsedUs(&slot.postedAt);
+            if (waitUs > (long)g_thruster_bus_stats.maxWaitUs) {
+                g_thruster_bus_stats.maxWaitUs = waitUs;
+            }
+            Latency_record(LATENCY_STAGE_QUEUE, waitUs);
+        }
+
+        /*  发送时不持有队列锁，控制接口可以继续提交新指令  */
+        g_thruster_inflight = 1;
+        pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Trace_begin("thruster", g_thruster_frame_trace_name[kind]);
+        int ret = Thruster_SendCommandWithResponse(slot.frame, slot.len, response, sizeof(response), THRUSTER_RESPONSE_TIMEOUT_MS);
+        Trace_end("thruster", g_thruster_frame_trace_name[kind]);
+        long busyUs = Thruster_ElapsedUs(&start);
+
+        pthread_mutex_lock(&g_thruster_queue_mutex);
+        g_thruster_inflight = 0;
+        g_thruster_bus_stats.busyUs += busyUs;
+        if (kind == THRUSTER_FRAME_TELEMETRY) {
+            g_thruster_bus_stats.polls++;
+            if (ret == 0) {
+                Thruster_UpdateTelemetry(slot.motorIdx, response);
+            }
+            continue;
+        }
+        if (kind != THRUSTER_FRAME_CONTROL) {
+            continue;
+        }
+        Thruster_UpdateSetpoint(slot.motorIdx, slot.speed, ret == 0);
+        if (ret < 0) {
+            g_thruster_bus_stats.failed++;
+        } else {
+            g_thruster_bus_stats.sent++;
+            Latency_record(LATENCY_STAGE_WRITE, busyUs);
+            Latency_recordSince(LATENCY_STAGE_TOTAL, slot.sampleStampNs);
+        }
+    }
+    pthread_cond_broadcast(&g_thruster_idle_cond);
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+    return NULL;
 }
 
 
@@ -298,7 +955,8 @@ int Thruster_Init(void)
 
 /*******************************************************************
 * 函数原型:int Thruster_SendInitConfig(void)
-* 函数简介:发送上电配置指令(必须执行一次)。
+* 函数简介:发送上电配置指令(必须执行一次)。没有正确应答的电机只打印提示，
+*          不影响其他电机(应答情况见Thruster_GetModbusStats)。
 * 函数参数:无
 * 函数返回值:成功返回0，失败返回-1。
 *****************************************************************/
@@ -310,8 +968,8 @@ int Thruster_SendInitConfig(void)
 
     unsigned char response[8] = {0};
     for (int i = 0; i < 4; i++) {
-            if (Thruster_SendCommandWithResponse(STARTUP_CMDS[i], 8, response, 8) < 0) {
-                return -1;
+            if (Thruster_SendCommandWithResponse(STARTUP_CMDS[i], 8, response, 8, THRUSTER_CONFIG_TIMEOUT_MS) < 0) {
+                LOG_W(LOG_MOD_THRUSTER, "推进器：电机%d上电配置没有正确应答\n", i + 1);
             }
             usleep(50000);
     }
@@ -322,7 +980,7 @@ int Thruster_SendInitConfig(void)
 
 /*******************************************************************
 * 函数原型:void Thruster_Cleanup_default(void) 
-* 函数简介:推进器的默认结束清理函数。
+* 函数简介:推进器的默认结束清理函数。停止电机，等停止指令发出后结束心跳和总线调度线程，再关闭串口
 * 函数参数:无
 * 函数返回值:无
 *****************************************************************/
@@ -330,6 +988,10 @@ void Thruster_Cleanup_default(void)
 {
     if (g_thruster_fd >= 0) {
         Thruster_Stop();
+        Thruster_Flush(500);
+        /*  先停掉心跳和总线调度线程，再关闭串口，避免往已关闭(或被复用)的fd上写  */
+        Thruster_StopHeartbeatThread(g_buswriter_tid);
+        Thruster_StopBusWriterThread(g_buswriter_tid);
         close(g_thruster_fd);
         g_thruster_fd = -1;
     }
@@ -338,7 +1000,7 @@ void Thruster_Cleanup_default(void)
 
 /*******************************************************************
 * 函数原型:void Thruster_Cleanup(void) 
-* 函数简介:推进器的默认结束清理函数。
+* 函数简介:推进器的结束清理函数。停止电机，等停止指令发出后结束心跳和总线调度线程，再恢复串口配置并关闭
 * 函数参数:无
 * 函数返回值:无
 *****************************************************************/
@@ -346,6 +1008,10 @@ void Thruster_Cleanup(void)
 {
     if (g_thruster_fd >= 0) {
         Thruster_Stop();
+        Thruster_Flush(500);
+        /*  先停掉心跳和总线调度线程，再关闭串口，避免往已关闭(或被复用)的fd上写  */
+        Thruster_StopHeartbeatThread(g_buswriter_tid);
+        Thruster_StopBusWriterThread(g_buswriter_tid);
         SerialPort_close(g_thruster_fd, &g_oldSerialPortConfig);
         g_thruster_fd = -1;
     }
@@ -354,7 +1020,7 @@ void Thruster_Cleanup(void)
 
 /*******************************************************************
 * 函数原型:int Thruster_SendCommand(ThrusterMotorID motor, const unsigned char *cmd, size_t len)
-* 函数简介:向推进器发送命令。
+* 函数简介:向推进器发送命令(放进发送队列，由总线发送线程发送)。
 * 函数参数:motor:电机ID的枚举
 * 函数参数:cmd:命令
 * 函数参数:len:命令长度
@@ -362,14 +1028,39 @@ void Thruster_Cleanup(void)
 *****************************************************************/
 int Thruster_SendCommand(ThrusterMotorID motor, const unsigned char *cmd, size_t len)
 {
-    unsigned char response[16];
-    return Thruster_SendCommandWithResponse(cmd, len, response, sizeof(response));
+    return Thruster_PostCommand(motor, cmd, len, 0, THRUSTER_SPEED_UNKNOWN);
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_SetMotorSpeed(ThrusterMotorID motor, int speed)
+* 函数简介:设置某个电机的转速，指令在运行时生成。
+* 函数参数:motor:电机ID的枚举
+* 函数参数:speed:转速，正值为正转，负值为反转，0为停止，
+*                超出±THRUSTER_SPEED_MAX时按最大值处理
+* 函数返回值:成功返回0，失败返回-1。
+*****************************************************************/
+int Thruster_SetMotorSpeed(ThrusterMotorID motor, int speed)
+{
+    unsigned char frame[THRUSTER_FRAME_MAX_LEN];
+
+    if (motor < 1 || motor > THRUSTER_MOTOR_NUM) return -1;
+
+    if (speed > THRUSTER_SPEED_MAX) {
+        speed = THRUSTER_SPEED_MAX;
+    } else if (speed < -THRUSTER_SPEED_MAX) {
+        speed = -THRUSTER_SPEED_MAX;
+    }
+
+    size_t len = Thruster_BuildSpeedFrame(motor, (long)speed * THRUSTER_POLARITY[motor - 1], frame);
+
+    return Thruster_PostCommand(motor, frame, len, speed == 0, speed);
 }
 
 
 /*******************************************************************
 * 函数原型:int Thruster_SetMotorPower(ThrusterMotorID motor, ThrusterPowerLevel level, ThrusterDirection dir)
-* 函数简介:设置某个电机的转动档位和方向。
+* 函数简介:设置某个电机的转动档位和方向(档位换算成转速，每档THRUSTER_SPEED_PER_LEVEL)。
 * 函数参数:motor:电机ID的枚举
 * 函数参数:level:档位
 * 函数参数:dir:转动方向
@@ -377,58 +1068,103 @@ int Thruster_SendCommand(ThrusterMotorID motor, const unsigned char *cmd, size_t
 *****************************************************************/
 int Thruster_SetMotorPower(ThrusterMotorID motor, ThrusterPowerLevel level, ThrusterDirection dir)
 {
-#if 0
-    if (motor == THRUSTER_ALL_MOTORS) {
-        for (int i = 0; i < 4; i++) {
-            if (Thruster_SetMotorPower(i+1, level, dir) < 0) {
-                return -1;
-            }
-        }
-        return 0;
-    }
-#endif
-
-    if (motor < 1 || motor > 4) return -1;
     if (level < THRUSTER_STOP || level > THRUSTER_LEVEL_5) return -1;
-    
-    const unsigned char (*cmd)[13] = NULL;
-    
-    if (level == THRUSTER_STOP) {
-        cmd = &STOP_CMDS[motor-1];
-    } else {
-        cmd = &MOTOR_CMDS[motor-1][dir][level-1];
+
+    int speed = (int)level * THRUSTER_SPEED_PER_LEVEL;
+
+    return Thruster_SetMotorSpeed(motor, dir == THRUSTER_DIR_FORWARD ? speed : -speed);
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_SetVertical(int speed)
+* 函数简介:设置垂直电机(3, 4号)的转速，用于定深/定高的连续输出。
+* 函数参数:speed:转速，正值下沉，负值上浮，0为停止
+* 函数返回值:成功返回0，失败返回-1。
+*****************************************************************/
+int Thruster_SetVertical(int speed)
+{
+    if (Thruster_SetMotorSpeed(THRUSTER_MOTOR_3, speed) < 0) return -1;
+    if (Thruster_SetMotorSpeed(THRUSTER_MOTOR_4, speed) < 0) return -1;
+    return 0;
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_SetHorizontal(int surge, int yaw)
+* 函数简介:设置水平电机(1, 2号)的转速，前进量与转向量叠加成差速。
+*          某个电机超出最大转速时两个电机按同一比例缩小，保持转向比例不变
+* 函数参数:surge:前进量，正值前进，负值后退
+* 函数参数:yaw:转向量，正值右转，负值左转
+* 函数返回值:成功返回0，失败返回-1。
+*****************************************************************/
+int Thruster_SetHorizontal(int surge, int yaw)
+{
+    long left = (long)surge - yaw;          //电机1
+    long right = (long)surge + yaw;         //电机2
+    long peak = labs(left) > labs(right) ? labs(left) : labs(right);
+
+    if (peak > THRUSTER_SPEED_MAX) {
+        left = left * THRUSTER_SPEED_MAX / peak;
+        right = right * THRUSTER_SPEED_MAX / peak;
     }
-    
-    return Thruster_SendCommand(motor, *cmd, 13);
+
+    if (Thruster_SetMotorSpeed(THRUSTER_MOTOR_1, (int)left) < 0) return -1;
+    if (Thruster_SetMotorSpeed(THRUSTER_MOTOR_2, (int)right) < 0) return -1;
+    return 0;
 }
 
 
+/*******************************************************************
+* 函数原型:static int Thruster_IsStopped(unsigned int mask)
+* 函数简介:mask中的电机最近一次请求的转速是否都为0(控制周期内反复停止时不重复输出日志)
+* 函数参数:mask:电机位(第i位为电机i+1)
+* 函数返回值:都已停止返回1，否则返回0
+*****************************************************************/
+static int Thruster_IsStopped(unsigned int mask)
+{
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    int stopped = (g_thruster_stopped_mask & mask) == mask;
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+    return stopped;
+}
+
 // [新增] 仅停止水平电机 (用于导航到达、手动接管水平方向)
 int Thruster_StopHorizontal(void) {
+    int wasStopped = Thruster_IsStopped(THRUSTER_HORIZONTAL_MASK);
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_1, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_2, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
-    printf("推进器：水平电机停止\n");
+    if (!wasStopped) {
+        LOG_I(LOG_MOD_THRUSTER, "推进器：水平电机停止\n");
+    }
     return 0;
 }
 
 // [新增] 仅停止垂直电机 (用于定深/定高到达、手动接管垂直方向)
 int Thruster_StopVertical(void) {
+    int wasStopped = Thruster_IsStopped(THRUSTER_VERTICAL_MASK);
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_3, THRUSTER_STOP, THRUSTER_DIR_BACKWARD) < 0) return -1;
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_4, THRUSTER_STOP, THRUSTER_DIR_BACKWARD) < 0) return -1;
-    printf("推进器：垂直电机停止\n");
+    if (!wasStopped) {
+        LOG_I(LOG_MOD_THRUSTER, "推进器：垂直电机停止\n");
+    }
     return 0;
 }
 /*******************************************************************
 * 函数原型:int Thruster_Stop(void)
-* 函数简介:停止所有电机。
+* 函数简介:停止所有电机。已经全部停止时不再输出日志(控制周期内会反复调用)
 * 函数参数:无
 * 函数返回值:成功返回0，失败返回-1。
 *****************************************************************/
 int Thruster_Stop(void) {
+    int wasStopped = Thruster_IsStopped(THRUSTER_HORIZONTAL_MASK | THRUSTER_VERTICAL_MASK);
     int ret1 = Thruster_StopHorizontal();
     int ret2 = Thruster_StopVertical();
     if (ret1 < 0 || ret2 < 0) return -1;
-    printf("推进器：全部停止\n");
+    if (!wasStopped) {
+        LOG_I(LOG_MOD_THRUSTER, "推进器：全部停止\n");
+    }
     return 0;
 }
 
@@ -447,7 +1183,7 @@ int Thruster_Floating(ThrusterPowerLevel level)
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_2, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_3, level, THRUSTER_DIR_BACKWARD) < 0) return -1;
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_4, level, THRUSTER_DIR_BACKWARD) < 0) return -1;
-    printf("推进器：上浮，档位：%d\n", level);
+    LOG_I(LOG_MOD_THRUSTER, "推进器：上浮，档位：%d\n", level);
     return 0;
 }
 
@@ -464,7 +1200,7 @@ int Thruster_Sinking(ThrusterPowerLevel level)
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_2, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_3, level, THRUSTER_DIR_FORWARD) < 0) return -1;
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_4, level, THRUSTER_DIR_FORWARD) < 0) return -1;
-    printf("推进器：下沉，档位：%d\n", level);
+    LOG_I(LOG_MOD_THRUSTER, "推进器：下沉，档位：%d\n", level);
     return 0;
 }
 
@@ -481,7 +1217,7 @@ int Thruster_Forward(ThrusterPowerLevel level)
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_2, level, THRUSTER_DIR_FORWARD) < 0) return -1;
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_3, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_4, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
-    printf("推进器：前进，档位：%d\n", level);
+    LOG_I(LOG_MOD_THRUSTER, "推进器：前进，档位：%d\n", level);
     return 0;
 }
 
@@ -498,7 +1234,7 @@ int Thruster_Backward(ThrusterPowerLevel level)
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_2, level, THRUSTER_DIR_BACKWARD) < 0) return -1;
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_3, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_4, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
-    printf("推进器：后退，档位：%d\n", level);
+    LOG_I(LOG_MOD_THRUSTER, "推进器：后退，档位：%d\n", level);
     return 0;
 }
 
@@ -515,7 +1251,7 @@ int Thruster_TurnLeft(ThrusterPowerLevel level)
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_2, level, THRUSTER_DIR_BACKWARD) < 0) return -1;
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_3, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_4, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
-    printf("推进器：左转，档位：%d\n", level);
+    LOG_I(LOG_MOD_THRUSTER, "推进器：左转，档位：%d\n", level);
     return 0;
 }
 
@@ -532,68 +1268,374 @@ int Thruster_TurnRight(ThrusterPowerLevel level)
     if (Thruster_SetMotorPower(THRUSTER_MOTOR_2, level, THRUSTER_DIR_FORWARD) < 0) return -1;
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_3, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
     //if (Thruster_SetMotorPower(THRUSTER_MOTOR_4, THRUSTER_STOP, THRUSTER_DIR_FORWARD) < 0) return -1;
-    printf("推进器：右转，档位：%d\n", level);
+    LOG_I(LOG_MOD_THRUSTER, "推进器：右转，档位：%d\n", level);
     return 0;
 }
 
 
 /*******************************************************************
-* 函数原型:static void *Thruster_HeartbeatThread(void *arg)
-* 函数简介:心跳线程函数。
-* 函数参数:arg:参数
+* 函数原型:static void Thruster_InitQueueCond(void)
+* 函数简介:初始化发送队列的条件变量(pthread_once只调用一次，启停总线调度线程时不再重复初始化)。
+*          心跳按CLOCK_MONOTONIC排时间表，等待条件变量也用同一个时钟
+* 函数参数:无
 * 函数返回值:无
 *****************************************************************/
-static void *Thruster_HeartbeatThread(void *arg)
+static void Thruster_InitQueueCond(void)
 {
-    (void)arg;
-    unsigned char response[8];
-    
-    while (g_heartbeat_running) {
-        for (int i = 0; i < 8 && g_heartbeat_running; i++) {
-            Thruster_SendCommandWithResponse(HEARTBEAT_CMDS[i], 8, response, sizeof(response));
-            usleep(100000);
-        }
-    }
-    
-    return NULL;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_thruster_queue_cond, &attr);
+    pthread_condattr_destroy(&attr);
 }
 
 
 /*******************************************************************
 * 函数原型:pthread_t Thruster_StartHeartbeatThread(void)
-* 函数简介:创建开始发送心跳线程函数。
+* 函数简介:开始发送心跳。心跳由总线调度线程按时间表发送(见Thruster_BusWriterThread)，
+*          不再单独开线程，调度线程没有运行时先启动它。
 * 函数参数:无
-* 函数返回值:成功返回线程的tid，失败返回0
+* 函数返回值:成功(或已在发送)返回总线调度线程的tid，失败返回0
 *****************************************************************/
 pthread_t Thruster_StartHeartbeatThread(void)
 {
     if (g_heartbeat_running) {
-        return 0;
+        return g_buswriter_tid;
     }
-    
-    g_heartbeat_running = 1;
-    pthread_t tid;
-    if (pthread_create(&tid, NULL, Thruster_HeartbeatThread, NULL) != 0) {
-        g_heartbeat_running = 0;
+
+    if (!g_buswriter_running && Thruster_StartBusWriterThread() == 0) {
         return 0;
     }
-    usleep(100000);
-    return tid;
+
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    g_thruster_heartbeat_idx = 0;
+    clock_gettime(CLOCK_MONOTONIC, &g_thruster_heartbeat_due);
+    g_heartbeat_running = 1;
+    pthread_cond_signal(&g_thruster_queue_cond);
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+    return g_buswriter_tid;
 }
 
 
 /*******************************************************************
 * 函数原型:void Thruster_StopHeartbeatThread(pthread_t tid)
-* 函数简介:停止发送心跳，即结束心跳线程。
-* 函数参数:tid:心跳线程的tid
+* 函数简介:停止发送心跳(总线调度线程继续运行，由Thruster_StopBusWriterThread结束)。
+* 函数参数:tid:Thruster_StartHeartbeatThread的返回值，不再使用
 * 函数返回值:无
 *****************************************************************/
 void Thruster_StopHeartbeatThread(pthread_t tid)
 {
+    (void)tid;
+
+    pthread_mutex_lock(&g_thruster_queue_mutex);
     g_heartbeat_running = 0;
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+}
+
+
+/*******************************************************************
+* 函数原型:pthread_t Thruster_StartBusWriterThread(void)
+* 函数简介:创建总线发送线程。之后控制接口只提交指令，不再等待串口。
+* 函数参数:无
+* 函数返回值:成功(或已在运行)返回线程的tid，失败返回0
+*****************************************************************/
+pthread_t Thruster_StartBusWriterThread(void)
+{
+    if (g_buswriter_running) {
+        return g_buswriter_tid;
+    }
+
+    pthread_once(&g_thruster_queue_cond_once, Thruster_InitQueueCond);
+
+    LOG_I(LOG_MOD_THRUSTER, "推进器：总线调度启动，心跳周期%dms，控制指令最坏等待%dus\n",
+           THRUSTER_HEARTBEAT_PERIOD_MS * THRUSTER_HEARTBEAT_NUM, THRUSTER_CONTROL_WORST_US);
+
+    g_buswriter_running = 1;
+    if (pthread_create(&g_buswriter_tid, NULL, Thruster_BusWriterThread, NULL) != 0) {
+        g_buswriter_running = 0;
+        g_buswriter_tid = 0;
+        return 0;
+    }
+    ProcStat_setThreadName(g_buswriter_tid, "thr-bus");
+    return g_buswriter_tid;
+}
+
+
+/*******************************************************************
+* 函数原型:void Thruster_StopBusWriterThread(pthread_t tid)
+* 函数简介:结束总线发送线程(队列中没发完的指令会先发完)。之后的指令退回同步发送。
+* 函数参数:tid:总线发送线程的tid
+* 函数返回值:无
+*****************************************************************/
+void Thruster_StopBusWriterThread(pthread_t tid)
+{
+    pthread_once(&g_thruster_queue_cond_once, Thruster_InitQueueCond);
+    Thruster_Flush(500);
+
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    g_buswriter_running = 0;
+    pthread_cond_signal(&g_thruster_queue_cond);
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+
     if (tid) {
         pthread_join(tid, NULL);
     }
+    g_buswriter_tid = 0;
+}
+
+
+/*******************************************************************
+* 函数原型:void Thruster_SetSampleStamp(int64_t stampNs)
+* 函数简介:设置调用线程接下来提交的指令所依据的传感器样本时间戳，
+*          指令收到应答时记录样本到推进器的端到端延时(只对调用线程有效)
+* 函数参数:stampNs:样本时间戳(Clock_nowNs)，0为不记录
+* 函数返回值:无
+*****************************************************************/
+void Thruster_SetSampleStamp(int64_t stampNs)
+{
+    g_thruster_sample_stampNs = stampNs;
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_Flush(int timeout_ms)
+* 函数简介:等待发送队列中的指令全部写到总线上(如清理前确保停止指令已发出)。
+* 函数参数:timeout_ms:最长等待时间
+* 函数返回值:发完返回0，超时返回-1。
+*****************************************************************/
+int Thruster_Flush(int timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    while (g_buswriter_running && ret == 0) {
+        int pending = g_thruster_inflight;
+        for (int i = 0; i < THRUSTER_MOTOR_NUM; i++) {
+            pending |= g_thruster_slots[i].pending;
+        }
+        if (!pending) {
+            break;
+        }
+        if (pthread_cond_timedwait(&g_thruster_idle_cond, &g_thruster_queue_mutex, &deadline) == ETIMEDOUT) {
+            ret = -1;
+        }
+    }
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+    return ret;
+}
+
+
+/*******************************************************************
+* 函数原型:void Thruster_GetBusStats(thrusterBusStats_t *stats)
+* 函数简介:获取总线发送统计。
+* 函数参数:stats:输出
+* 函数返回值:无
+*****************************************************************/
+void Thruster_GetBusStats(thrusterBusStats_t *stats)
+{
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    *stats = g_thruster_bus_stats;
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_GetModbusStats(ThrusterMotorID motor, thrusterModbusStats_t *stats)
+* 函数简介:获取某个电机的Modbus应答统计(超时、CRC错误、异常应答等)。
+* 函数参数:motor:电机ID
+* 函数参数:stats:输出
+* 函数返回值:成功返回0，失败返回-1。
+*****************************************************************/
+int Thruster_GetModbusStats(ThrusterMotorID motor, thrusterModbusStats_t *stats)
+{
+    if (motor < 1 || motor > THRUSTER_MOTOR_NUM || stats == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_thruster_mutex);
+    *stats = g_thruster_modbus_stats[motor - 1];
+    pthread_mutex_unlock(&g_thruster_mutex);
+
+    return 0;
+}
+
+
+/*******************************************************************
+* 函数原型:void Thruster_PrintBusStats(void)
+* 函数简介:打印总线发送统计，串口没有打开时不打印。
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Thruster_PrintBusStats(void)
+{
+    static struct timespec lastPrint = {0};
+    static unsigned long lastBusyUs = 0;
+    thrusterBusStats_t bus;
+
+    if (g_thruster_fd < 0) {
+        return;
+    }
+
+    Thruster_GetBusStats(&bus);
+
+    /*  总线占用率:上次打印以来总线事务占用的时间比例   */
+    double load = 0.0;
+    if (lastPrint.tv_sec != 0) {
+        long wallUs = Thruster_ElapsedUs(&lastPrint);
+        if (wallUs > 0) {
+            load = 100.0 * (double)(bus.busyUs - lastBusyUs) / wallUs;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &lastPrint);
+    lastBusyUs = bus.busyUs;
+
+    printf("%-8s 提交:%lu 发送:%lu 抑制:%lu 刷新:%lu 合并:%lu 失败:%lu 心跳:%lu 轮询:%lu 占用率:%.1f%% 最大等待:%luus\n", "thruster",
+           bus.posted, bus.sent, bus.suppressed, bus.refreshed, bus.coalesced, bus.failed,
+           bus.heartbeats, bus.polls, load, bus.maxWaitUs);
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_StartTelemetry(void)
+* 函数简介:开始轮询各电机的转速、电流和故障码(由总线调度线程在空闲时发送)，
+*          调度线程没有运行时先启动它。每轮询完一轮所有电机，Thruster_getEventFD可读
+* 函数参数:无
+* 函数返回值:成功返回0，失败返回-1。
+*****************************************************************/
+int Thruster_StartTelemetry(void)
+{
+    if (g_telemetry_running) {
+        return 0;
+    }
+
+    if (g_thruster_event_fd < 0) {
+        g_thruster_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (g_thruster_event_fd < 0) {
+            perror("Thruster_StartTelemetry:eventfd");
+            return -1;
+        }
+    }
+
+    if (!g_buswriter_running && Thruster_StartBusWriterThread() == 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    for (int i = 0; i < THRUSTER_MOTOR_NUM; i++) {
+        g_thruster_telemetry.motor[i].responseMs = -1;
+    }
+    g_thruster_telemetry_idx = 0;
+    clock_gettime(CLOCK_MONOTONIC, &g_thruster_telemetry_due);
+    g_telemetry_running = 1;
+    pthread_cond_signal(&g_thruster_queue_cond);
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+    return 0;
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_getEventFD(void)
+* 函数简介:获取反馈数据的通知fd(eventfd)，用于加入Epoll监听。
+* 函数参数:无
+* 函数返回值:fd，没有开始轮询时返回-1。
+*****************************************************************/
+int Thruster_getEventFD(void)
+{
+    return g_thruster_event_fd;
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_ReadTelemetry(void)
+* 函数简介:取出最新一轮反馈数据到g_thruster_dataPack，并发布到总线。
+* 函数参数:无
+* 函数返回值:有新数据返回0，没有新数据返回1，失败返回-1。
+*****************************************************************/
+int Thruster_ReadTelemetry(void)
+{
+    uint64_t count = 0;
+
+    if (g_thruster_event_fd < 0) {
+        return -1;
+    }
+
+    if (read(g_thruster_event_fd, &count, sizeof(count)) != sizeof(count)) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return 1;
+        }
+        perror("Thruster_ReadTelemetry:eventfd read");
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_thruster_queue_mutex);
+    g_thruster_dataPack = g_thruster_telemetry;
+    int64_t stampNs = g_thruster_telemetry_stampNs;
+    pthread_mutex_unlock(&g_thruster_queue_mutex);
+
+    Bus_publish(&g_thruster_bus, &g_thruster_dataPack, stampNs);
+    return 0;
+}
+
+
+/*******************************************************************
+* 函数原型:int Thruster_getDataPack(thrusterDataPack_t *out, int64_t *stampNs)
+* 函数简介:获取最新一轮反馈数据的快照(任何线程都可以调用)
+* 函数参数:out:输出数据
+* 函数参数:stampNs:输出数据的时间戳(原始数据读入的时间，Clock_nowNs)，可以为NULL，用Bus_ageMs判断数据新旧
+* 函数返回值:成功返回0，还没有数据返回1
+*****************************************************************/
+int Thruster_getDataPack(thrusterDataPack_t *out, int64_t *stampNs)
+{
+    return Bus_read(&g_thruster_bus, out, stampNs);
+}
+
+
+/*******************************************************************
+* 函数原型:char *Thruster_DataPackageProcessing(void)
+* 函数简介:将推进器反馈数据按格式打包，每个电机:设定转速 实际转速 电流 故障码 堵转
+* 函数参数:无
+* 函数返回值:成功返回打包好的数据地址
+*****************************************************************/
+char *Thruster_DataPackageProcessing(void)
+{
+    static char thrusterSendDataBuf[200] = {0};
+    size_t len = 0;
+
+    thrusterSendDataBuf[len++] = '!';
+    for (int i = 0; i < THRUSTER_MOTOR_NUM; i++) {
+        const thrusterMotorData_t *m = &g_thruster_dataPack.motor[i];
+        len += snprintf(thrusterSendDataBuf + len, sizeof(thrusterSendDataBuf) - len, "%d!%d!%.2f!%u!%d!",
+                        m->speedSet, m->speed, m->current, m->fault, m->stalled);
+    }
+
+    return thrusterSendDataBuf;
+}
+
+
+/*******************************************************************
+* 函数原型:void Thruster_PrintAllData(void)
+* 函数简介:打印推进器反馈数据
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Thruster_PrintAllData(void)
+{
+    for (int i = 0; i < THRUSTER_MOTOR_NUM; i++) {
+        const thrusterMotorData_t *m = &g_thruster_dataPack.motor[i];
+        printf("电机%d:设定%d 实际%d 电流%.2fA 故障码0x%04X%s 响应%ldms\n", i + 1, m->speedSet, m->speed,
+               m->current, m->fault, m->stalled ? " 堵转" : "", m->responseMs);
+    }
 }
 
 
@@ -642,7 +1684,13 @@ int Thruster_Task(void)
         return -1;
     }
 
-    /*  3.打开心跳  */
+    /*  3.打开总线发送线程  */
+    if(Thruster_StartBusWriterThread() == 0)
+    {
+        return -1;
+    }
+
+    /*  4.打开心跳(由总线调度线程按时间表发送)  */
     if(Thruster_StartHeartbeatThread() == 0)
     {
         return -1;
@@ -20,6 +20,19 @@
 #include <termios.h>
 #include <pthread.h>
 #include <stddef.h>
+#include <time.h>
+#include "../../sys/bus/bus.h"
+
+
+/************************************************************************************
+								宏定义
+*************************************************************************************/
+/*  转速设定值:每个档位对应的转速，以及允许的最大转速(5档)  */
+#define THRUSTER_SPEED_PER_LEVEL    4200
+#define THRUSTER_SPEED_MAX          (THRUSTER_SPEED_PER_LEVEL * 5)
+
+/*  电机个数    */
+#define THRUSTER_MOTOR_NUM          4
 
 
 /************************************************************************************
@@ -51,6 +64,54 @@ typedef enum {
 } ThrusterDirection;
 
 
+/************************************************************************************
+								数据类型
+*************************************************************************************/
+/*  总线发送统计    */
+typedef struct {
+    unsigned long posted;               //控制接口提交的指令数
+    unsigned long suppressed;           //和电机当前状态相同、没有发送的指令数
+    unsigned long refreshed;            //状态相同但超过刷新间隔而重发的指令数
+    unsigned long coalesced;            //还没发送就被新指令覆盖的指令数
+    unsigned long sent;                 //写到总线上的指令数
+    unsigned long failed;               //发送失败的指令数
+    unsigned long heartbeats;           //按时间表发送的心跳帧数
+    unsigned long polls;                //反馈轮询次数
+    unsigned long busyUs;               //总线事务累计占用时间(微秒)，用于计算总线占用率
+    unsigned long maxWaitUs;            //控制指令从提交到开始发送的最长等待(微秒)
+} thrusterBusStats_t;
+
+/*  Modbus应答统计(每个电机一份)   */
+typedef struct {
+    unsigned long requests;             //请求数
+    unsigned long ok;                   //应答正确
+    unsigned long timeouts;             //应答超时
+    unsigned long crcErrors;            //应答CRC错误
+    unsigned long exceptions;           //异常应答(电机拒绝了请求)
+    unsigned long mismatches;           //应答与请求不匹配
+    unsigned long consecutiveTimeouts;  //连续超时次数，收到正确应答后清零
+    unsigned char lastException;        //最近一次异常码
+    unsigned long lastRttUs;            //最近一次从发送到收完应答的时间(微秒)
+} thrusterModbusStats_t;
+
+
+/*  单个电机的反馈数据  */
+typedef struct {
+    int valid;                          //1为收到过反馈
+    int speedSet;                       //电机已确认的转速设定值
+    int speed;                          //实际转速(反馈，与设定值同单位)
+    double current;                     //电流，单位A
+    unsigned short fault;               //故障码，0为正常
+    int stalled;                        //1为疑似堵转/缠绕(有设定转速但转不起来)
+    long responseMs;                    //最近一次设定值变化到实际转速跟上的时间(毫秒)，-1为还没跟上
+} thrusterMotorData_t;
+
+/*  推进器数据(所有电机)    */
+typedef struct {
+    thrusterMotorData_t motor[THRUSTER_MOTOR_NUM];
+} thrusterDataPack_t;
+
+
 /************************************************************************************
  									函数原型
 *************************************************************************************/
@@ -66,6 +127,7 @@ int Thruster_SendInitConfig(void);
 /*  基础控制    */
 int Thruster_SendCommand(ThrusterMotorID motor, const unsigned char *cmd, size_t len);
 int Thruster_SetMotorPower(ThrusterMotorID motor, ThrusterPowerLevel level, ThrusterDirection dir);
+int Thruster_SetMotorSpeed(ThrusterMotorID motor, int speed);
 
 /*  运动控制    */
 int Thruster_Stop(void);
@@ -80,9 +142,30 @@ int Thruster_Backward(ThrusterPowerLevel level);
 int Thruster_TurnLeft(ThrusterPowerLevel level);
 int Thruster_TurnRight(ThrusterPowerLevel level);
 
+/*  连续转速控制(供闭环控制使用)    */
+int Thruster_SetVertical(int speed);
+int Thruster_SetHorizontal(int surge, int yaw);
+
 /*  线程控制    */
 pthread_t Thruster_StartHeartbeatThread(void);
 void Thruster_StopHeartbeatThread(pthread_t tid);
+pthread_t Thruster_StartBusWriterThread(void);
+void Thruster_StopBusWriterThread(pthread_t tid);
+
+/*  总线发送队列    */
+void Thruster_SetSampleStamp(int64_t stampNs);
+int Thruster_Flush(int timeout_ms);
+void Thruster_GetBusStats(thrusterBusStats_t *stats);
+int Thruster_GetModbusStats(ThrusterMotorID motor, thrusterModbusStats_t *stats);
+void Thruster_PrintBusStats(void);
+
+/*  反馈数据(转速、电流、故障码)    */
+int Thruster_StartTelemetry(void);
+int Thruster_getEventFD(void);
+int Thruster_ReadTelemetry(void);
+int Thruster_getDataPack(thrusterDataPack_t *out, int64_t *stampNs);
+char *Thruster_DataPackageProcessing(void);
+void Thruster_PrintAllData(void);
 
 /*  高级控制接口    */
 void Thruster_ControlHandle(const char *cmd, int arg);
@@ -0,0 +1,209 @@
+/*
+ * 推进器Modbus RTU应答解析与CRC16测试(不需要推进器，应答从socketpair送入)
+ * 直接包含Thruster.c以测试其中的静态函数。放在子目录中，避免被main/build.sh按drivers下每个模块目录的通配编入主程序。
+ * 编译(在本目录下):
+ * gcc -o test_Thruster test_Thruster.c ../../../sys/SerialPort/SerialPort.c ../../../tool/tool.c \
+ *     ../../../sys/bus/bus.c ../../../sys/latency/latency.c ../../../sys/trace/trace.c ../../../sys/log/log.c \
+ *     ../../../sys/metrics/metrics.c ../../../sys/socket/TCP/tcp.c ../../../sys/epoll/epoll_manager.c \
+ *     ../../../sys/ring/ring.c ../../../sys/procstat/procstat.c ../../../sys/rt/rt.c ../../../sys/clock/clock.c \
+ *     -lpthread -lm
+ * 全部通过返回0
+ */
+#include "../Thruster.c"
+#include <sys/socket.h>
+
+/******************** 测试工具函数 ********************/
+static int g_failed = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            g_failed++; \
+        } \
+    } while (0)
+
+/* 在data[0, len)后面补上CRC16(低字节在前)，返回总长度 */
+static size_t append_crc(unsigned char *data, size_t len)
+{
+    unsigned short crc = Tool_modbusCRC16(data, len);
+    data[len++] = crc & 0xFF;
+    data[len++] = (crc >> 8) & 0xFF;
+    return len;
+}
+
+/* 分两次发送应答，中间间隔delay_us，模拟应答被拆成两段到达 */
+typedef struct {
+    int fd;
+    const unsigned char *data;
+    size_t len;
+    size_t split;
+    int delay_us;
+} replyWriter_t;
+
+static void *reply_thread(void *arg)
+{
+    replyWriter_t *w = (replyWriter_t *)arg;
+    if (write(w->fd, w->data, w->split) != (ssize_t)w->split) {
+        perror("write");
+    }
+    usleep(w->delay_us);
+    if (write(w->fd, w->data + w->split, w->len - w->split) != (ssize_t)(w->len - w->split)) {
+        perror("write");
+    }
+    return NULL;
+}
+
+/* 送入应答(split为0时一次送完，不送任何数据时len为0)，返回Thruster_ReadResponse的结果 */
+static int read_reply(int peer, const unsigned char *cmd, size_t cmdlen,
+                      const unsigned char *reply, size_t len, size_t split, thrusterModbusStats_t *st)
+{
+    unsigned char response[64];
+    pthread_t tid;
+    replyWriter_t w = {peer, reply, len, split, 2000};
+
+    if (split > 0) {
+        pthread_create(&tid, NULL, reply_thread, &w);
+    } else if (len > 0 && write(peer, reply, len) != (ssize_t)len) {
+        perror("write");
+    }
+
+    int ret = Thruster_ReadResponse(cmd, cmdlen, response, sizeof(response), THRUSTER_RESPONSE_TIMEOUT_MS, st);
+
+    if (split > 0) {
+        pthread_join(tid, NULL);
+    }
+    while (read(g_thruster_fd, response, sizeof(response)) > 0);       //清空残留(socketpair不支持tcflush)
+    return ret;
+}
+
+/******************** CRC16 ********************/
+static void test_crc(void)
+{
+    printf("\n=== CRC16 ===\n");
+
+    /* Modbus协议文档中的例子:01 03 00 00 00 0A -> C5 CD */
+    const unsigned char sample[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A};
+    CHECK(Tool_modbusCRC16(sample, sizeof(sample)) == 0xCDC5);
+
+    /* 心跳和上电设置命令中固定的CRC */
+    for (int i = 0; i < THRUSTER_HEARTBEAT_NUM; i++) {
+        unsigned short crc = Tool_modbusCRC16(HEARTBEAT_CMDS[i], 6);
+        CHECK(HEARTBEAT_CMDS[i][6] == (crc & 0xFF) && HEARTBEAT_CMDS[i][7] == (crc >> 8));
+    }
+    for (int i = 0; i < 4; i++) {
+        unsigned short crc = Tool_modbusCRC16(STARTUP_CMDS[i], 6);
+        CHECK(STARTUP_CMDS[i][6] == (crc & 0xFF) && STARTUP_CMDS[i][7] == (crc >> 8));
+    }
+
+    /* 现算CRC的转速指令:整帧(含CRC)再算一次CRC为0 */
+    unsigned char frame[THRUSTER_FRAME_MAX_LEN];
+    size_t len = Thruster_BuildSpeedFrame(THRUSTER_MOTOR_3, -1200, frame);
+    CHECK(len == THRUSTER_FRAME_MAX_LEN);
+    CHECK(Tool_modbusCRC16(frame, len) == 0);
+}
+
+/******************** 应答解析 ********************/
+static void test_response(void)
+{
+    printf("\n=== Response ===\n");
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        perror("socketpair");
+        g_failed++;
+        return;
+    }
+    fcntl(sv[0], F_SETFL, O_NONBLOCK);
+    g_thruster_fd = sv[0];
+
+    thrusterModbusStats_t st;
+    memset(&st, 0, sizeof(st));
+    const unsigned char *hb = HEARTBEAT_CMDS[0];
+    unsigned char reply[32];
+    size_t len;
+
+    /* 1.写单个寄存器:原样返回 */
+    CHECK(read_reply(sv[1], hb, 8, hb, 8, 0, &st) == 0);
+    CHECK(st.ok == 1);
+
+    /* 2.应答分两段到达 */
+    CHECK(read_reply(sv[1], hb, 8, hb, 8, 3, &st) == 0);
+    CHECK(st.ok == 2);
+
+    /* 3.写多个寄存器:返回起始地址和个数 */
+    unsigned char cmd[THRUSTER_FRAME_MAX_LEN];
+    size_t cmdlen = Thruster_BuildSpeedFrame(THRUSTER_MOTOR_2, 1000, cmd);
+    memcpy(reply, cmd, 6);
+    len = append_crc(reply, 6);
+    CHECK(read_reply(sv[1], cmd, cmdlen, reply, len, 0, &st) == 0);
+    CHECK(st.ok == 3);
+
+    /* 4.读寄存器:地址 功能码 字节数 数据 CRC */
+    unsigned char rd[8] = {0x01, MODBUS_FC_READ_HOLDING, THRUSTER_REG_FEEDBACK >> 8, THRUSTER_REG_FEEDBACK & 0xFF,
+                           0x00, THRUSTER_REG_FEEDBACK_NUM};
+    append_crc(rd, 6);
+    unsigned char data[] = {0x01, MODBUS_FC_READ_HOLDING, 8, 0, 0, 0x03, 0xE8, 0, 0x0A, 0, 0};
+    memcpy(reply, data, sizeof(data));
+    len = append_crc(reply, sizeof(data));
+    CHECK(read_reply(sv[1], rd, 8, reply, len, 5, &st) == 0);
+    CHECK(st.ok == 4);
+
+    /* 5.CRC错误 */
+    memcpy(reply, hb, 8);
+    reply[7] ^= 0xFF;
+    CHECK(read_reply(sv[1], hb, 8, reply, 8, 0, &st) == -1);
+    CHECK(st.crcErrors == 1);
+
+    /* 6.异常应答:只有5个字节，记录异常码 */
+    unsigned char exc[8] = {0x01, MODBUS_FC_WRITE_SINGLE | MODBUS_EXCEPTION_FLAG, 0x02};
+    len = append_crc(exc, 3);
+    CHECK(read_reply(sv[1], hb, 8, exc, len, 2, &st) == -1);
+    CHECK(st.exceptions == 1);
+    CHECK(st.lastException == 0x02);
+    CHECK(st.crcErrors == 1);
+
+    /* 7.异常应答的CRC错误 */
+    exc[4] ^= 0xFF;
+    CHECK(read_reply(sv[1], hb, 8, exc, len, 0, &st) == -1);
+    CHECK(st.crcErrors == 2);
+    CHECK(st.exceptions == 1);
+
+    /* 8.其他电机的应答 */
+    CHECK(read_reply(sv[1], hb, 8, HEARTBEAT_CMDS[1], 8, 0, &st) == -1);
+    CHECK(st.mismatches == 1);
+
+    /* 9.回显内容不对(CRC正确) */
+    memcpy(reply, hb, 6);
+    reply[5] = 0x7F;
+    len = append_crc(reply, 6);
+    CHECK(read_reply(sv[1], hb, 8, reply, len, 0, &st) == -1);
+    CHECK(st.mismatches == 2);
+
+    /* 10.没有应答和应答不完整都算超时 */
+    CHECK(read_reply(sv[1], hb, 8, NULL, 0, 0, &st) == -1);
+    CHECK(read_reply(sv[1], hb, 8, hb, 5, 0, &st) == -1);
+    CHECK(st.timeouts == 2);
+    CHECK(st.consecutiveTimeouts == 2);
+    CHECK(read_reply(sv[1], hb, 8, hb, 8, 0, &st) == 0);
+    CHECK(st.consecutiveTimeouts == 0);
+
+    /* 11.广播不等待应答 */
+    unsigned char bc[8];
+    memcpy(bc, hb, 8);
+    bc[0] = 0;
+    CHECK(read_reply(sv[1], bc, 8, NULL, 0, 0, &st) == 0);
+
+    g_thruster_fd = -1;
+    close(sv[0]);
+    close(sv[1]);
+}
+
+int main()
+{
+    Clock_init();
+
+    test_crc();
+    test_response();
+
+    printf("\n%s: %d failed\n", g_failed ? "FAIL" : "PASS", g_failed);
+    return g_failed ? 1 : 0;
+}
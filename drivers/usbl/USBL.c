@@ -7,6 +7,7 @@
 #include "USBL.h"
 #include "../../sys/epoll/epoll_manager.h"
 #include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/log/log.h"
 #include "../thruster/Thruster.h"
 /* 引入主控舱头文件，用于控制释放器 */
 #include "../../drivers/maincabin/MainCabin.h" 
@@ -30,11 +31,6 @@ extern pthread_t g_tid_usbl;
 /* 工作状态    */
 volatile int g_usbl_status = -1;			//-1为不可工作，1为可以工作
 
-/*	数据结构体	*/
-usblDataPack_t g_usbl_dataPack = {
-	.recvdata = {0}
-};
-
 /************************************************************************************
  									全局变量(仅可本文件使用)
 *************************************************************************************/
@@ -50,9 +46,23 @@ static struct termios g_usbl_oldSerialPortConfig = {0};
 /*	读写锁	*/
 static pthread_rwlock_t g_usbl_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
+/*	解析中的数据(只在解析线程中使用)，解析完整后发布到总线	*/
+static usblDataPack_t g_usbl_dataPack = {
+	.recvdata = {0}
+};
+
+/*	最新值总线:其他线程通过USBL_getDataPack取快照	*/
+static usblDataPack_t g_usbl_sample = {0};
+static busSlot_t g_usbl_bus = BUS_SLOT_INITIALIZER(g_usbl_sample);
+
 /*	接收数据缓冲区	*/
 static char g_usbl_readbuf[128] = {0}; 
 
+/*	串口接收缓冲区与帧格式(帧提取器见USBL_ExtractFrame)	*/
+static int USBL_ExtractFrame(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start);
+static serialPortStream_t g_usbl_stream;
+static const serialPortFramer_t g_usbl_framer = {USBL_ExtractFrame, NULL, 0, '\n', 1, sizeof(g_usbl_readbuf) - 1};
+
  /*******************************************************************
  * 函数原型:int USBL_getFD(void)
  * 函数简介:返回文件描述符
@@ -89,9 +99,32 @@ int USBL_Init(void)
 		return -1;
 	}
 
+	SerialPort_streamInit(&g_usbl_stream, g_usbl_fd, "USBL", &g_usbl_framer);
+
 	return 0;
 }
 
+ /*******************************************************************
+ * 函数原型:int USBL_Reopen(void)
+ * 函数简介:串口挂断(如USB串口拔出)后重新打开USBL。旧的文件描述符已失效，直接关闭、不恢复旧配置，再重新初始化
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int USBL_Reopen(void)
+{
+	/*	1.关闭失效的文件描述符	*/
+	pthread_rwlock_wrlock(&g_usbl_rwlock);
+	if(g_usbl_fd >= 0)
+	{
+		close(g_usbl_fd);
+		g_usbl_fd = -1;
+	}
+	pthread_rwlock_unlock(&g_usbl_rwlock);
+
+	/*	2.重新打开并配置串口	*/
+	return USBL_Init();
+}
+
 
  /*******************************************************************
  * 函数原型:int USBL_Close(void)
@@ -130,73 +163,94 @@ int USBL_Close(void)
 
 
 /*******************************************************************
-* 函数原型:ssize_t USBL_ReadRawData(void)
-* 函数简介:USBL从串口读取数据
-*****************************************************************/ 
-ssize_t USBL_ReadRawData(void)
+* 函数原型:static int USBL_ExtractFrame(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+* 函数简介:USBL帧提取器，支持三种帧:
+*          '$'开头'\n'结尾的应答；'#'开头，第二个'#'(长度大于5)或'\n'结尾的指令；8个'&'的急停指令
+*****************************************************************/
+static int USBL_ExtractFrame(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
 {
-	if(g_usbl_fd < 0 || g_usbl_readbuf == NULL)
+	size_t head = 0;
+
+	while(head < len)
 	{
-		return -1;
-	}
+		/*	1.查找帧头	*/
+		if(data[head] != '$' && data[head] != '#' && data[head] != '&')
+		{
+			head++;
+			continue;
+		}
 
-	pthread_rwlock_wrlock(&g_usbl_rwlock);
-	memset(g_usbl_readbuf, 0, sizeof(g_usbl_readbuf));
-		
-	ssize_t nread = 0;
-	int totalnByte = 0;
-    char tmp_char = 0;
+		/*	2.8个'&'	*/
+		if(data[head] == '&')
+		{
+			size_t n = 0;
+			while(head + n < len && n < 8 && data[head + n] == '&')
+			{
+				n++;
+			}
+			if(n == 8)
+			{
+				*start = head;
+				return 8;
+			}
+			if(head + n == len)
+			{
+				*start = head;		//还没收完
+				return 0;
+			}
+			*start = head + n;		//'&'不足8个
+			return -1;
+		}
 
-	while(totalnByte < sizeof(g_usbl_readbuf) - 1)
-	{
-		nread = read(g_usbl_fd, &tmp_char, 1);
-		if(nread > 0)
+		/*	3.'$'或'#'开头，查找帧尾	*/
+		size_t i = head + 1;
+		for(; i < len && i - head < framer->frameLen; i++)
 		{
-            g_usbl_readbuf[totalnByte++] = tmp_char;
-            
-            // 快速结束判断: '#' 结尾
-            if(g_usbl_readbuf[0] == '#' && totalnByte > 5 && tmp_char == '#')
-            {
-                break; 
-            }
-            // 换行符结尾
-            if(tmp_char == '\n')
-            {
-                break;
-            }
-            // 简单保护：如果读到8个&，直接截断处理
-            if(totalnByte == 8 && strncmp(g_usbl_readbuf, "&&&&&&&&", 8) == 0) 
-            {
-                break; 
-            }
+			if(data[i] == '\n' || (data[head] == '#' && data[i] == '#' && i - head + 1 > 5))
+			{
+				*start = head;
+				return (int)(i - head + 1);
+			}
 		}
-		else
+
+		if(i - head >= framer->frameLen)
 		{
-			break;
+			*start = head + 1;		//超长，重新同步
+			return -1;
 		}
+
+		*start = head;				//还没收完
+		return 0;
 	}
 
-    if(totalnByte == 0)
-    {
-        pthread_rwlock_unlock(&g_usbl_rwlock);
-        return 0;
-    }
+	*start = len;
+	return 0;
+}
 
-	g_usbl_readbuf[totalnByte] = '\0';
+/*******************************************************************
+* 函数原型:ssize_t USBL_ReadRawData(void)
+* 函数简介:USBL从接收缓冲区取出一帧完整数据，缓冲区中没有完整的帧时再读串口
+* 函数返回值:成功返回帧长度，没有完整的帧返回0，读取错误返回-1(errno为read的错误)
+*****************************************************************/ 
+ssize_t USBL_ReadRawData(void)
+{
+	if(g_usbl_fd < 0 || g_usbl_readbuf == NULL)
+	{
+		errno = EBADF;
+		return -1;
+	}
 
-	/* 数据初步校验 */
-    int is_valid = 0;
-	if(g_usbl_readbuf[0] == '$' && g_usbl_readbuf[totalnByte-1] == '\n') is_valid = 1;
-    else if(g_usbl_readbuf[0] == '#' && g_usbl_readbuf[totalnByte-1] == '#') is_valid = 1;
-    else if(g_usbl_readbuf[0] == '#') is_valid = 1;
-    // [新增] 放行 &&&&&&&&
-    else if(strncmp(g_usbl_readbuf, "&&&&&&&&", 8) == 0) is_valid = 1;
+	pthread_rwlock_wrlock(&g_usbl_rwlock);
 
-	if(is_valid == 0)
+	/*	1.取出一帧，帧不完整时等待下次数据	*/
+	int totalnByte = SerialPort_streamRead(&g_usbl_stream, g_usbl_readbuf, sizeof(g_usbl_readbuf));
+	if(totalnByte < 0)
 	{
+		int err = errno;
 		memset(g_usbl_readbuf, 0, sizeof(g_usbl_readbuf));
-		tcflush(g_usbl_fd, TCIFLUSH);
 		pthread_rwlock_unlock(&g_usbl_rwlock);
+		LOG_E(LOG_MOD_USBL, "USBL_ReadRawData:read:%s\n", strerror(err));
+		errno = err;
 		return -1;
 	}
 
@@ -204,6 +258,15 @@ ssize_t USBL_ReadRawData(void)
 	return totalnByte;
 }
 
+ /*******************************************************************
+ * 函数原型:serialPortStream_t *USBL_getStream(void)
+ * 函数简介:返回串口接收缓冲区，用于设置取帧策略和查看接收统计
+ *****************************************************************/
+serialPortStream_t *USBL_getStream(void)
+{
+	return &g_usbl_stream;
+}
+
 /* ==========================================================
  * 辅助函数：将字符转换为动作枚举 
  * 'U'=UP, 'D'=DOWN, 'L'=LEFT, 'R'=RIGHT, 'F'=FORWARD, 'B'=BACKWARD
@@ -251,7 +314,7 @@ int USBL_ParseData(void)
      * ========================================================== */
     if(strncmp(g_usbl_readbuf, "&&&&&&&&", 8) == 0)
     {
-        printf("[USBL MISSION] 收到强制中断指令 &&&&&&&&\n");
+        LOG_W(LOG_MOD_USBL, "[USBL MISSION] 收到强制中断指令 &&&&&&&&\n");
         Task_Mission_Stop(); // 立即停止任务
         
         memset(g_usbl_readbuf, 0, sizeof(g_usbl_readbuf));
@@ -282,12 +345,12 @@ int USBL_ParseData(void)
             sscanf(&g_usbl_readbuf[1], "%2s", ctl_cmd);
             sscanf(&g_usbl_readbuf[5], "%2d", &ctl_arg);
             
-            printf("[USBL EXEC] 执行动作 -> CMD:%s ARG:%d\n", ctl_cmd, ctl_arg);
+            LOG_I(LOG_MOD_USBL, "[USBL EXEC] 执行动作 -> CMD:%s ARG:%d\n", ctl_cmd, ctl_arg);
             Thruster_ControlHandle(ctl_cmd, ctl_arg);
         }
         else
         {
-            printf("[USBL ERR] 指令格式错误 (无$$): %s\n", g_usbl_readbuf);
+            LOG_W(LOG_MOD_USBL, "[USBL ERR] 指令格式错误 (无$$): %s\n", g_usbl_readbuf);
         }
 
         memset(g_usbl_readbuf, 0, sizeof(g_usbl_readbuf));
@@ -337,7 +400,7 @@ int USBL_ParseData(void)
             {
                 // 1. 状态检查：如果当前有任务在跑，直接忽略新指令！
                 if(Task_Mission_IsRunning()) {
-                    printf("[USBL MISSION] 警告：任务正在执行中，新指令被拒绝！(请先发送 &&&&&&&& 中止)\n");
+                    LOG_W(LOG_MOD_USBL, "[USBL MISSION] 警告：任务正在执行中，新指令被拒绝！(请先发送 &&&&&&&& 中止)\n");
                 }
                 else {
                     MissionStep_t steps[MISSION_STEP_COUNT];
@@ -354,14 +417,14 @@ int USBL_ParseData(void)
                     steps[2].action   = USBL_CharToAction(tempHexArrey[5]);
                     steps[2].duration = USBL_CharToDuration(tempHexArrey[6]);
 
-                    printf("[USBL MISSION] 解析成功: %c%c -> %c%c -> %c%c\n",
+                    LOG_I(LOG_MOD_USBL, "[USBL MISSION] 解析成功: %c%c -> %c%c -> %c%c\n",
                            tempHexArrey[1], tempHexArrey[2],
                            tempHexArrey[3], tempHexArrey[4],
                            tempHexArrey[5], tempHexArrey[6]);
                            
-                    printf("  Step1: Act=%d, Time=%ds\n", steps[0].action, steps[0].duration);
-                    printf("  Step2: Act=%d, Time=%ds\n", steps[1].action, steps[1].duration);
-                    printf("  Step3: Act=%d, Time=%ds\n", steps[2].action, steps[2].duration);
+                    LOG_I(LOG_MOD_USBL, "  Step1: Act=%d, Time=%ds\n", steps[0].action, steps[0].duration);
+                    LOG_I(LOG_MOD_USBL, "  Step2: Act=%d, Time=%ds\n", steps[1].action, steps[1].duration);
+                    LOG_I(LOG_MOD_USBL, "  Step3: Act=%d, Time=%ds\n", steps[2].action, steps[2].duration);
 
                     // 3. 启动任务
                     Task_Mission_UpdateAndStart(steps);
@@ -380,7 +443,7 @@ int USBL_ParseData(void)
         if (sscanf((char*)tempHexArrey, "+%lf+%lf+", &lat, &lon) == 2) {
             Nav_SetTarget(lat, lon);
         } else {
-            printf("[USBL ERR] 目标坐标解析失败: %s\n", tempHexArrey);
+            LOG_W(LOG_MOD_USBL, "[USBL ERR] 目标坐标解析失败: %s\n", tempHexArrey);
         }
     }
     
@@ -402,7 +465,7 @@ int USBL_ParseData(void)
                 sscanf((char *)(&tempHexArrey[1]), "%2s", ctl_cmd);
                 sscanf((char *)(&tempHexArrey[5]), "%2d", &ctl_arg);
                 
-                printf("[USBL EXEC THRUSTER] 匹配成功 -> CMD:%s ARG:%d\n", ctl_cmd, ctl_arg);
+                LOG_I(LOG_MOD_USBL, "[USBL EXEC THRUSTER] 匹配成功 -> CMD:%s ARG:%d\n", ctl_cmd, ctl_arg);
                 Thruster_ControlHandle(ctl_cmd, ctl_arg);
             } 
             /* B. 解析释放器指令 (@...) */
@@ -435,7 +498,7 @@ int USBL_ParseData(void)
                     if(strncmp(cmd_str, "!AD:OFFF!", 9) == 0)
                     {
                         DepthControl_Stop();
-                        printf("[USBL] 定深模式已关闭\n");
+                        LOG_I(LOG_MOD_USBL, "[USBL] 定深模式已关闭\n");
                     }
                     else
                     {
@@ -444,7 +507,7 @@ int USBL_ParseData(void)
                         if(sscanf(cmd_str, "!AD:%lf!", &target) == 1)
                         {
                             DepthControl_Start(target);
-                            printf("[USBL] 定深启动，目标: %.2f 米\n", target);
+                            LOG_I(LOG_MOD_USBL, "[USBL] 定深启动，目标: %.2f 米\n", target);
                         }
                     }
                 }
@@ -457,7 +520,7 @@ int USBL_ParseData(void)
                     if(strncmp(cmd_str, "!AH:OFFF!", 9) == 0)
                     {
                         AltitudeControl_Stop();
-                        printf("[USBL] 定高模式已关闭\n");
+                        LOG_I(LOG_MOD_USBL, "[USBL] 定高模式已关闭\n");
                     }
                     else
                     {
@@ -465,7 +528,7 @@ int USBL_ParseData(void)
                         if(sscanf(cmd_str, "!AH:%lf!", &target) == 1)
                         {
                             AltitudeControl_Start(target);
-                            printf("[USBL] 定高启动，目标: %.2f 米\n", target);
+                            LOG_I(LOG_MOD_USBL, "[USBL] 定高启动，目标: %.2f 米\n", target);
                         }
                     }
                 }
@@ -473,8 +536,10 @@ int USBL_ParseData(void)
         }
         else
         {
-             printf("[USBL ERR] 解析长度 len=%d 异常或过长，跳过解析\n", len);
+             LOG_W(LOG_MOD_USBL, "[USBL ERR] 解析长度 len=%d 异常或过长，跳过解析\n", len);
         }
+
+        Bus_publish(&g_usbl_bus, &g_usbl_dataPack, g_usbl_stream.frameStampNs);
     }
 
     // 清理静态变量
@@ -485,4 +550,17 @@ int USBL_ParseData(void)
 
 	pthread_rwlock_unlock(&g_usbl_rwlock);
 	return 0;	
+}
+
+
+ /*******************************************************************
+ * 函数原型:int USBL_getDataPack(usblDataPack_t *out, int64_t *stampNs)
+ * 函数简介:获取最新一次收到的数据包快照(任何线程都可以调用，不阻塞解析线程)
+ * 函数参数:out:输出数据
+ * 函数参数:stampNs:输出数据的时间戳(原始数据读入的时间，Clock_nowNs)，可以为NULL，用Bus_ageMs判断数据新旧
+ * 函数返回值:成功返回0，还没有数据返回1
+ *****************************************************************/
+int USBL_getDataPack(usblDataPack_t *out, int64_t *stampNs)
+{
+	return Bus_read(&g_usbl_bus, out, stampNs);
 }
\ No newline at end of file
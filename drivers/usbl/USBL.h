@@ -24,6 +24,8 @@
 #include <pthread.h>
 #include <time.h>
 #include "../../tool/tool.h"
+#include "../../sys/SerialPort/SerialPort.h"
+#include "../../sys/bus/bus.h"
 
  
 /************************************************************************************
@@ -41,12 +43,17 @@ int USBL_getFD(void);
 
 /*	初始化	*/
 int USBL_Init(void);
+int USBL_Reopen(void);
 
 /*	关闭	*/
 int USBL_Close(void);
 
 /*	读取/解析数据	*/
 ssize_t USBL_ReadRawData(void);
+serialPortStream_t *USBL_getStream(void);
 int USBL_ParseData(void);
 
+/*	获取数据	*/
+int USBL_getDataPack(usblDataPack_t *out, int64_t *stampNs);
+
 #endif
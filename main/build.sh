@@ -1,4 +1,4 @@
 #! /bin/bash
 
 # 注意：加入了 ../control/*.c
-gcc *.c ../control/*.c ../drivers/*/*.c  ../sys/SerialPort/SerialPort.c ../sys/socket/TCP/tcp.c ../sys/epoll/epoll_manager.c  ../sys/sqlite3_db/Database.c ../tool/tool.c -lpthread ../task/*.c -lm -lsqlite3 -Wall
\ No newline at end of file
+gcc *.c ../control/*.c ../drivers/*/*.c  ../sys/SerialPort/SerialPort.c ../sys/socket/TCP/tcp.c ../sys/epoll/epoll_manager.c ../sys/bus/bus.c ../sys/clock/clock.c ../sys/latency/latency.c ../sys/trace/trace.c ../sys/ring/ring.c ../sys/log/log.c ../sys/metrics/metrics.c ../sys/procstat/procstat.c ../sys/rt/rt.c ../sys/pool/pool.c ../sys/binlog/binlog.c ../sys/sqlite3_db/Database.c ../tool/tool.c -lpthread ../task/*.c -lm -lsqlite3 -Wall
\ No newline at end of file
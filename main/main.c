@@ -9,20 +9,212 @@
 #include "../control/altitude_control.h"
 #include "../task/task_mission.h"
 #include "../control/navigation_control.h"
+#include "../control/control_executor.h"
+#include "../sys/clock/clock.h"
+#include "../sys/latency/latency.h"
+#include "../sys/trace/trace.h"
+#include "../sys/log/log.h"
+#include "../sys/procstat/procstat.h"
+#include "../sys/rt/rt.h"
+#include "../sys/pool/pool.h"
+#include "../sys/sqlite3_db/Database.h"
+#include "../sys/binlog/binlog.h"
+#include <signal.h>
 
 extern volatile int g_maincabin_tcpcliConnectFlag;
 extern int MainCabin_ReConnect(void);
 
+/*  串口接收统计的打印间隔(秒)  */
+#define MAIN_SERIAL_STATS_INTERVAL_S    60
+
+/*  启动后多久封存内存池(秒):等各设备上电初始化、工作线程都起来之后，再有堆分配即为稳定运行中的分配  */
+#define MAIN_POOL_SEAL_DELAY_S          10
+
+/*  事件追踪导出目录(收到SIGUSR1时导出，文件名带时间)    */
+#define MAIN_TRACE_DUMP_DIR             "../database/"
+
+/*  收到SIGUSR1后置1，由主循环导出事件追踪(信号处理函数中不能做文件操作)    */
+static volatile sig_atomic_t g_main_trace_dump_request = 0;
+
+/*******************************************************************
+ * 函数原型:static void Main_OnTraceSignal(int sig)
+ * 函数简介:SIGUSR1处理函数，请求导出事件追踪
+ * 函数参数:sig:信号
+ * 函数返回值: 无
+ *****************************************************************/
+static void Main_OnTraceSignal(int sig)
+{
+    (void)sig;
+    g_main_trace_dump_request = 1;
+}
+
+/*******************************************************************
+ * 函数原型:static void Main_DumpTrace(void)
+ * 函数简介:导出事件追踪到MAIN_TRACE_DUMP_DIR/trace-<时间>.json
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Main_DumpTrace(void)
+{
+    char timeStr[CLOCK_FORMAT_LEN];
+    char path[128];
+
+    Clock_format(Clock_nowNs(), timeStr, sizeof(timeStr));
+    timeStr[10] = '-';
+    snprintf(path, sizeof(path), "%strace-%s.json", MAIN_TRACE_DUMP_DIR, timeStr);
+
+    int num = Trace_Dump(path);
+    if(num >= 0)
+    {
+        printf("事件追踪已导出:%s(%d个事件)\n", path, num);
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Main_PrintUsage(const char *prog)
+ * 函数简介:打印命令行参数说明
+ * 函数参数:prog:程序名
+ * 函数返回值: 无
+ *****************************************************************/
+static void Main_PrintUsage(const char *prog)
+{
+    printf("用法: %s [-t | -e] [-r 频率] [-l 文件] [-o 文件] [-v 级别] [-m 地址] [-n] [-c CPU] [-b] [-f] [-z] [-u 数据库文件...]\n", prog);
+    printf("  -t  多线程模式(默认):每个设备一个工作线程\n");
+    printf("  -e  事件循环模式:所有设备在Epoll线程中直接读取、解析、发布\n");
+    printf("  -r  定深/定高/导航控制频率，%d~%dHz(默认%dHz)\n", CONTROL_RATE_MIN_HZ, CONTROL_RATE_MAX_HZ, CONTROL_RATE_DEFAULT_HZ);
+    printf("  -l  链路延时直方图导出文件，每%d秒覆盖写一次\n", MAIN_SERIAL_STATS_INTERVAL_S);
+    printf("  -o  日志输出文件(默认输出到终端)\n");
+    printf("  -v  日志级别，如 info 或 warn,nav=debug,thruster=info(级别:off/error/warn/info/debug)\n");
+    printf("  -m  运行指标(Prometheus文本格式):[ip:]端口提供HTTP(默认127.0.0.1)，或UNIX套接字路径\n");
+    printf("  -n  不使用实时调度配置(调试时使用)，默认推进器总线、控制、CTD/DVL等线程使用SCHED_FIFO并锁定内存\n");
+    printf("  -c  实时线程使用的CPU(默认多核时用最后一个核，单核时不绑定)\n");
+    printf("  -b  DVL、声纳、推进器反馈写入二进制日志(%s)，不逐行入库，事后用tool/binlog2db转换\n", BINLOG_DIR);
+    printf("  -f  轮询推进器反馈(转速、电流、故障码)，反馈寄存器地址按推进器控制器手册确认后再使用\n");
+    printf("  -z  零分配模式:启动%d秒后封存内存池，之后一旦有堆分配，输出分配位置后abort(联调、测试时使用，SIGUSR1导出追踪也会分配)\n", MAIN_POOL_SEAL_DELAY_S);
+    printf("  -u  把旧格式的数据库文件(time为时分秒字符串)转换为新格式后退出，旧表名保留为兼容视图\n");
+    printf("运行中 kill -USR1 <pid> 导出事件追踪(Chrome trace格式)到%s\n", MAIN_TRACE_DUMP_DIR);
+}
+
 int main(int argc, const char *argv[])
 {
+    const char *latencyDumpPath = NULL;
+    const char *logPath = NULL;
+    const char *metricsAddr = NULL;
+    int rtEnable = 1;
+    int rtCpu = RT_CPU_AUTO;
+    int binlogEnable = 0;
+
     printf("程序正在运行......\n");
 
+    /*  记录墙上时间与单调时钟的差值，之后的时间戳都按单调时钟换算  */
+    Clock_init();
+
+    /*  SIGUSR1导出事件追踪 */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = Main_OnTraceSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+
+    /*  0.命令行参数    */
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-e") == 0)
+        {
+            Task_SetRunMode(TASK_RUN_MODE_EVENTLOOP);
+        }
+        else if(strcmp(argv[i], "-t") == 0)
+        {
+            Task_SetRunMode(TASK_RUN_MODE_THREAD);
+        }
+        else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+        {
+            if(ControlExec_SetRate(atoi(argv[++i])) < 0)
+            {
+                Main_PrintUsage(argv[0]);
+                return 0;
+            }
+        }
+        else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+        {
+            latencyDumpPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            logPath = argv[++i];
+        }
+        else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+        {
+            metricsAddr = argv[++i];
+        }
+        else if(strcmp(argv[i], "-n") == 0)
+        {
+            rtEnable = 0;
+        }
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            rtCpu = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-b") == 0)
+        {
+            binlogEnable = 1;
+        }
+        else if(strcmp(argv[i], "-f") == 0)
+        {
+            Task_SetThrusterTelemetry(1);
+        }
+        else if(strcmp(argv[i], "-z") == 0)
+        {
+            Pool_setStrict(1);
+        }
+        else if(strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+        {
+            int failed = 0;
+            while(++i < argc)
+            {
+                failed += Database_migrate(argv[i]) < 0;
+            }
+            return failed ? 1 : 0;
+        }
+        else if(strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+        {
+            if(Log_setFilter(argv[++i]) < 0)
+            {
+                Main_PrintUsage(argv[0]);
+                return 0;
+            }
+        }
+        else
+        {
+            Main_PrintUsage(argv[0]);
+            return 0;
+        }
+    }
+    /*  实时调度配置:在创建线程之前锁定内存，各线程在入口处按角色设置优先级和CPU，
+        没有权限时继续以普通调度运行    */
+    Rt_Init(rtEnable, rtCpu);
+
+    /*  日志由后台线程输出，控制和通信线程不再等终端    */
+    if(Log_Init(logPath) < 0)
+    {
+        return 0;
+    }
+
+    /*  定期采样各线程的CPU时间、上下文切换和进程内存，随串口统计打印，也通过运行指标提供  */
+    ProcStat_Start(PROCSTAT_DEFAULT_INTERVAL_MS);
+    printf("运行模式:%s 控制频率:%dHz\n", Task_GetRunMode() == TASK_RUN_MODE_EVENTLOOP ? "事件循环" : "多线程", ControlExec_GetRate());
+
     /*  1.数据库  */
     if(Task_Database_Init() < 0)
     {
         goto end;
     }
     printf("数据库初始化完毕......\n");
+    if(binlogEnable && Task_Binlog_Init() < 0)
+    {
+        printf("二进制日志启动失败，高频数据仍入库\n");
+    }
 
     /*  2.Epoll管理器相关任务初始化   */
     if(Task_Epoll_Init() < 0)
@@ -75,7 +267,22 @@ int main(int argc, const char *argv[])
     Nav_Init();
     printf("任务模块初始化完毕......\n");
 
+    /*  8.控制执行器:按固定频率运行定深、定高、导航控制器   */
+    if(Task_Control_Init() < 0)
+    {
+        goto end;
+    }
+    printf("控制执行器初始化完毕(%dHz).......\n", ControlExec_GetRate());
+
+    /*  9.运行指标(监听失败不影响下潜)  */
+    if(metricsAddr != NULL && Task_Metrics_Init(metricsAddr) < 0)
+    {
+        printf("运行指标初始化失败，继续运行.......\n");
+    }
+
 
+    int statsTick = 0;
+    int sealTick = 0;
     while(1) {
         // 每 1秒 检查一次系统安全
         DepthControl_SafetyCheck();
@@ -86,11 +293,46 @@ int main(int argc, const char *argv[])
             // 尝试重连（非阻塞或快速返回）
             MainCabin_ReConnect();
         }
+        // 3. 定期打印串口接收统计(丢帧情况)
+        if(++statsTick >= MAIN_SERIAL_STATS_INTERVAL_S)
+        {
+            statsTick = 0;
+            Task_PrintSerialStats();
+            if(latencyDumpPath != NULL)
+            {
+                Latency_Dump(latencyDumpPath);
+            }
+        }
+        // 4. 启动完成后封存内存池，之后定期检查是否还有堆分配(SIGUSR1导出事件追踪时的分配也会被记录)
+        if(sealTick < MAIN_POOL_SEAL_DELAY_S && ++sealTick == MAIN_POOL_SEAL_DELAY_S)
+        {
+            if(latencyDumpPath != NULL)
+            {
+                Latency_Dump(latencyDumpPath);      //先打开导出文件，之后一直复用
+            }
+            Pool_seal();
+        }
+        Pool_checkSealed();
+        // 5. 收到SIGUSR1时导出事件追踪
+        if(g_main_trace_dump_request)
+        {
+            g_main_trace_dump_request = 0;
+            Main_DumpTrace();
+        }
+
         sleep(1); // 防止占用 CPU
     }
 
 end:
+    if(latencyDumpPath != NULL)
+    {
+        Latency_Dump(latencyDumpPath);
+    }
+    Binlog_Shutdown();
+    Database_StopWriter();
+    Database_close(g_database);             //WAL写回数据库，删除-wal、-shm文件
     printf("程序异常退出!\n");
+    Log_Shutdown();
     return 0;
 }
 
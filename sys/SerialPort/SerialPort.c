@@ -6,6 +6,9 @@
  ************************************************************************************/
 
 #include "SerialPort.h"
+#include "../../tool/tool.h"
+#include "../trace/trace.h"
+#include "../log/log.h"
 
 /************************************************************************************
  									全局变量
@@ -571,3 +574,488 @@ void SerialPort_printConfig(int fd, const char *serialportName)
 
     printf("\n=== 结束 ===\n");
 }
+
+
+/*******************************************************************
+ * 函数原型:int SerialPort_setNonBlock(int fd, int enable)
+ * 函数简介:设置串口为非阻塞/阻塞模式(事件循环模式下使用非阻塞)
+ * 函数参数:fd:串口设备的文件描述符
+ * 函数参数:enable:1为非阻塞，0为阻塞
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int SerialPort_setNonBlock(int fd, int enable)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if(flags < 0)
+    {
+        return -1;
+    }
+
+    flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if(fcntl(fd, F_SETFL, flags) < 0)
+    {
+        perror("SerialPort_setNonBlock:fcntl");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:int SerialPort_flush(int fd, int queue)
+ * 函数简介:tcflush丢弃内核缓冲区中的数据，丢弃前先查出丢了多少字节(统计用)
+ * 函数参数:fd:串口设备的文件描述符
+ * 函数参数:queue:TCIFLUSH/TCOFLUSH/TCIOFLUSH
+ * 函数返回值: 成功返回丢弃的字节数(输入+输出)，失败返回-1
+ *****************************************************************/
+int SerialPort_flush(int fd, int queue)
+{
+    int inBytes = 0, outBytes = 0;
+
+    if(queue != TCOFLUSH && ioctl(fd, FIONREAD, &inBytes) < 0)
+    {
+        inBytes = 0;
+    }
+    if(queue != TCIFLUSH && ioctl(fd, TIOCOUTQ, &outBytes) < 0)
+    {
+        outBytes = 0;
+    }
+
+    if(tcflush(fd, queue) < 0)
+    {
+        perror("SerialPort_flush:tcflush");
+        return -1;
+    }
+
+    return inBytes + outBytes;
+}
+
+
+/************************************************************************************
+ 									接收缓冲区与帧提取
+ ************************************************************************************/
+/*******************************************************************
+ * 函数原型:static size_t SerialPort_findHead(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t pos)
+ * 函数简介:从pos开始查找帧头
+ * 函数参数:framer:帧格式
+ * 函数参数:data/len:待查找的数据
+ * 函数参数:pos:开始查找的位置
+ * 函数返回值: 帧头位置，找不到返回len
+ *****************************************************************/
+static size_t SerialPort_findHead(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t pos)
+{
+    for(size_t i = pos; i + framer->headLen <= len; i++)
+    {
+        if(memcmp(data + i, framer->head, framer->headLen) == 0)
+        {
+            return i;
+        }
+    }
+
+    return len;
+}
+
+/*******************************************************************
+ * 函数原型:static size_t SerialPort_keepPartialHead(const serialPortFramer_t *framer, size_t len)
+ * 函数简介:找不到帧头时可以丢弃的字节数，末尾可能是被截断的帧头，需要保留
+ * 函数参数:framer:帧格式
+ * 函数参数:len:数据长度
+ * 函数返回值: 可以丢弃的字节数
+ *****************************************************************/
+static size_t SerialPort_keepPartialHead(const serialPortFramer_t *framer, size_t len)
+{
+    return (len >= framer->headLen) ? len - (framer->headLen - 1) : 0;
+}
+
+/*******************************************************************
+ * 函数原型:int SerialPort_extractHeadCount(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+ * 函数简介:帧头+计数方式:从帧头开始，到第tailCount个帧尾为止(如DVL的6行':'数据)。
+ *          帧内出现新的帧头或超过最大帧长时，丢弃这个不完整的帧，从下一个帧头重新同步
+ * 函数参数:framer:帧格式
+ * 函数参数:data/len:待查找的数据
+ * 函数参数:start:输出，帧起始位置/可丢弃字节数/重新同步的位置
+ * 函数返回值: 找到返回帧长度，数据不够返回0，帧不完整返回-1
+ *****************************************************************/
+int SerialPort_extractHeadCount(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+{
+    /*  1.查找帧头  */
+    size_t head = SerialPort_findHead(framer, data, len, 0);
+    if(head == len)
+    {
+        *start = SerialPort_keepPartialHead(framer, len);
+        return 0;
+    }
+
+    /*  2.统计帧尾  */
+    int tails = 0;
+    size_t i = head + framer->headLen;
+    for(; i < len && i - head < framer->frameLen; i++)
+    {
+        if(data[i] == framer->tail && ++tails == framer->tailCount)
+        {
+            *start = head;
+            return (int)(i - head + 1);
+        }
+
+        /*  3.帧内出现新的帧头，说明这一帧不完整  */
+        if(i + framer->headLen <= len && memcmp(data + i, framer->head, framer->headLen) == 0)
+        {
+            *start = i;
+            return -1;
+        }
+    }
+
+    /*  4.超过最大帧长  */
+    if(i - head >= framer->frameLen)
+    {
+        *start = head + 1;
+        return -1;
+    }
+
+    /*  5.数据还没收完  */
+    *start = head;
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:int SerialPort_extractDelimited(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+ * 函数简介:分隔符方式:从帧头开始，到第一个帧尾为止(如NMEA语句、CTD的'$'...'\n')。
+ *          文本协议的帧内不会出现帧头的第一个字节，出现时说明前一帧不完整，从这里重新同步
+ * 函数参数:framer:帧格式
+ * 函数参数:data/len:待查找的数据
+ * 函数参数:start:输出，帧起始位置/可丢弃字节数/重新同步的位置
+ * 函数返回值: 找到返回帧长度，数据不够返回0，帧不完整返回-1
+ *****************************************************************/
+int SerialPort_extractDelimited(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+{
+    size_t head = SerialPort_findHead(framer, data, len, 0);
+    if(head == len)
+    {
+        *start = SerialPort_keepPartialHead(framer, len);
+        return 0;
+    }
+
+    size_t i = head + framer->headLen;
+    for(; i < len && i - head < framer->frameLen; i++)
+    {
+        if(data[i] == framer->tail)
+        {
+            *start = head;
+            return (int)(i - head + 1);
+        }
+
+        if(data[i] == (unsigned char)framer->head[0])
+        {
+            *start = i;
+            return -1;
+        }
+    }
+
+    if(i - head >= framer->frameLen)
+    {
+        *start = head + 1;
+        return -1;
+    }
+
+    *start = head;
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:int SerialPort_extractFixed(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+ * 函数简介:定长二进制方式:帧头开始的frameLen个字节，tailCount不为0时检查最后一个字节(如Sonar的0x40...0x0A)
+ * 函数参数:framer:帧格式
+ * 函数参数:data/len:待查找的数据
+ * 函数参数:start:输出，帧起始位置/可丢弃字节数/重新同步的位置
+ * 函数返回值: 找到返回帧长度，数据不够返回0，帧尾错误返回-1
+ *****************************************************************/
+int SerialPort_extractFixed(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start)
+{
+    size_t head = SerialPort_findHead(framer, data, len, 0);
+    if(head == len)
+    {
+        *start = SerialPort_keepPartialHead(framer, len);
+        return 0;
+    }
+
+    /*  数据还没收完    */
+    if(len - head < framer->frameLen)
+    {
+        *start = head;
+        return 0;
+    }
+
+    /*  帧尾不对，从帧头的下一个字节重新同步  */
+    if(framer->tailCount > 0 && data[head + framer->frameLen - 1] != framer->tail)
+    {
+        *start = head + 1;
+        return -1;
+    }
+
+    *start = head;
+    return (int)framer->frameLen;
+}
+
+/*******************************************************************
+ * 函数原型:int SerialPort_streamInit(serialPortStream_t *stream, int fd, const char *name, const serialPortFramer_t *framer)
+ * 函数简介:初始化串口接收缓冲区
+ * 函数参数:stream:接收缓冲区
+ * 函数参数:fd:串口设备的文件描述符
+ * 函数参数:name:设备名称(打印用)
+ * 函数参数:framer:帧格式
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int SerialPort_streamInit(serialPortStream_t *stream, int fd, const char *name, const serialPortFramer_t *framer)
+{
+    if(stream == NULL || framer == NULL || framer->extract == NULL)
+    {
+        return -1;
+    }
+
+    memset(&stream->stats, 0, sizeof(stream->stats));
+    stream->fd = fd;
+    stream->name = name;
+    stream->framer = framer;
+    stream->policy = SERIALPORT_FRAME_ALL;
+    stream->rpos = 0;
+    stream->wpos = 0;
+    stream->readStampNs = 0;
+    stream->frameStampNs = 0;
+    stream->overflowLogNs = 0;
+
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:void SerialPort_streamReset(serialPortStream_t *stream)
+ * 函数简介:清空接收缓冲区中未处理的数据
+ * 函数参数:stream:接收缓冲区
+ * 函数返回值: 无
+ *****************************************************************/
+void SerialPort_streamReset(serialPortStream_t *stream)
+{
+    stream->rpos = 0;
+    stream->wpos = 0;
+}
+
+/*******************************************************************
+ * 函数原型:void SerialPort_streamSetPolicy(serialPortStream_t *stream, serialPortFramePolicy_t policy)
+ * 函数简介:设置取帧策略
+ * 函数参数:stream:接收缓冲区
+ * 函数参数:policy:SERIALPORT_FRAME_ALL处理每一帧，SERIALPORT_FRAME_LATEST只处理最新的一帧
+ * 函数返回值: 无
+ *****************************************************************/
+void SerialPort_streamSetPolicy(serialPortStream_t *stream, serialPortFramePolicy_t policy)
+{
+    stream->policy = policy;
+}
+
+/*******************************************************************
+ * 函数原型:ssize_t SerialPort_streamFill(serialPortStream_t *stream)
+ * 函数简介:用FIONREAD查看内核中已收到的字节数，一次read全部读入接收缓冲区
+ * 函数参数:stream:接收缓冲区
+ * 函数返回值: 成功返回本次读到的字节数(可以为0)，失败返回-1(errno为read的错误)
+ *****************************************************************/
+ssize_t SerialPort_streamFill(serialPortStream_t *stream)
+{
+    if(stream == NULL || stream->fd < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    /*  1.把未处理的数据移到缓冲区开头  */
+    if(stream->rpos > 0)
+    {
+        memmove(stream->buf, stream->buf + stream->rpos, stream->wpos - stream->rpos);
+        stream->wpos -= stream->rpos;
+        stream->rpos = 0;
+    }
+
+    /*  2.缓冲区满了还没有完整的帧，全部丢弃    */
+    if(stream->wpos >= sizeof(stream->buf))
+    {
+        stream->stats.bytesDiscarded += stream->wpos;
+        stream->stats.overflows++;
+        /*  溢出次数记在统计里，日志每个串口每秒最多一条，避免在读取路径上刷屏    */
+        if(stream->overflowLogNs == 0 || Clock_sinceMs(stream->overflowLogNs) >= SERIALPORT_OVERFLOW_LOG_MS)
+        {
+            stream->overflowLogNs = Clock_nowNs();
+            LOG_W(LOG_MOD_MAIN, "SerialPort_streamFill:%s 接收缓冲区溢出(累计%lu次)\n", stream->name, stream->stats.overflows);
+        }
+        stream->wpos = 0;
+    }
+
+    /*  3.内核中有多少就读多少  */
+    size_t space = sizeof(stream->buf) - stream->wpos;
+    int avail = Tool_getSerialportReadBufferCount(stream->fd);
+    if(avail == 0)
+    {
+        return 0;
+    }
+    if(avail < 0 && errno != ENOTTY)
+    {
+        stream->stats.readErrors++;             //串口已挂断(EIO)等，不支持FIONREAD时按缓冲区剩余空间读
+        return -1;
+    }
+
+    size_t want = (avail < 0 || (size_t)avail > space) ? space : (size_t)avail;
+    ssize_t nread = read(stream->fd, stream->buf + stream->wpos, want);
+    if(nread < 0)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            return 0;
+        }
+        stream->stats.readErrors++;
+        return -1;
+    }
+
+    stream->stats.readCalls++;
+    stream->stats.bytesRead += nread;
+    stream->wpos += nread;
+    if(nread > 0)
+    {
+        stream->readStampNs = Clock_nowNs();
+    }
+
+    return nread;
+}
+
+/*******************************************************************
+ * 函数原型:int SerialPort_streamNextFrame(serialPortStream_t *stream, void *frame, size_t framesize)
+ * 函数简介:从接收缓冲区取出下一帧完整数据(最新帧策略下取最新的一帧)，并在末尾添加'\0'。
+ *          不完整的帧留在缓冲区等待后续数据；损坏的帧丢弃并计数
+ * 函数参数:stream:接收缓冲区
+ * 函数参数:frame:存放帧数据的数组
+ * 函数参数:framesize:数组大小(需要比帧长多1个字节)
+ * 函数返回值: 取到一帧返回帧长度，没有完整的帧返回0，失败返回-1
+ *****************************************************************/
+int SerialPort_streamNextFrame(serialPortStream_t *stream, void *frame, size_t framesize)
+{
+    if(stream == NULL || frame == NULL || framesize == 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const unsigned char *last = NULL;
+    int lastLen = 0;
+
+    while(stream->rpos < stream->wpos)
+    {
+        size_t start = 0;
+        int len = stream->framer->extract(stream->framer, stream->buf + stream->rpos, stream->wpos - stream->rpos, &start);
+
+        /*  1.丢弃帧之前的无用字节  */
+        if(len < 0 && start == 0)
+        {
+            start = 1;
+        }
+        stream->rpos += start;
+        stream->stats.bytesDiscarded += start;
+
+        if(len < 0)
+        {
+            stream->stats.badFrames++;
+            continue;
+        }
+        else if(len == 0)
+        {
+            break;
+        }
+
+        const unsigned char *data = stream->buf + stream->rpos;
+        stream->rpos += len;
+
+        /*  2.帧比调用者的数组还大，丢弃    */
+        if((size_t)len >= framesize)
+        {
+            stream->stats.bytesDiscarded += len;
+            stream->stats.badFrames++;
+            continue;
+        }
+
+        /*  3.最新帧策略:继续向后找，前面的帧计入跳过统计  */
+        if(last != NULL)
+        {
+            stream->stats.framesSkipped++;
+        }
+        last = data;
+        lastLen = len;
+
+        if(stream->policy == SERIALPORT_FRAME_ALL)
+        {
+            break;
+        }
+    }
+
+    if(last == NULL)
+    {
+        return 0;
+    }
+
+    /*  4.取出一帧(在下次streamFill之前缓冲区不会被覆盖)。
+          缓冲区中的完整帧都是在最近一次read时收齐的，用那次read的时间作为帧的时间戳   */
+    memcpy(frame, last, lastLen);
+    ((unsigned char *)frame)[lastLen] = '\0';
+    stream->stats.frames++;
+    stream->frameStampNs = stream->readStampNs;
+
+    return lastLen;
+}
+
+/*******************************************************************
+ * 函数原型:int SerialPort_streamRead(serialPortStream_t *stream, void *frame, size_t framesize)
+ * 函数简介:取一帧数据。缓冲区中已有完整的帧时不访问串口；
+ *          否则(或最新帧策略下)先把串口中已有的数据读进来再取
+ * 函数参数:stream:接收缓冲区
+ * 函数参数:frame:存放帧数据的数组
+ * 函数参数:framesize:数组大小(需要比帧长多1个字节)
+ * 函数返回值: 取到一帧返回帧长度，没有完整的帧返回0，读取失败返回-1(errno为read的错误)
+ *****************************************************************/
+int SerialPort_streamRead(serialPortStream_t *stream, void *frame, size_t framesize)
+{
+    if(stream == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(stream->policy == SERIALPORT_FRAME_ALL)
+    {
+        int len = SerialPort_streamNextFrame(stream, frame, framesize);
+        if(len != 0)
+        {
+            return len;
+        }
+    }
+
+    Trace_begin("read", stream->name);
+    ssize_t nread = SerialPort_streamFill(stream);
+    Trace_end("read", stream->name);
+    if(nread < 0)
+    {
+        int err = errno;
+        SerialPort_streamReset(stream);
+        errno = err;
+        return -1;
+    }
+
+    return SerialPort_streamNextFrame(stream, frame, framesize);
+}
+
+/*******************************************************************
+ * 函数原型:void SerialPort_streamPrintStats(const serialPortStream_t *stream)
+ * 函数简介:打印接收统计
+ * 函数参数:stream:接收缓冲区
+ * 函数返回值: 无
+ *****************************************************************/
+void SerialPort_streamPrintStats(const serialPortStream_t *stream)
+{
+    const serialPortStreamStats_t *st = &stream->stats;
+
+    printf("%-8s read:%lu 字节:%lu 帧:%lu 跳过:%lu 丢帧:%lu 丢弃字节:%lu 溢出:%lu 读取错误:%lu\n",
+            stream->name ? stream->name : "?", st->readCalls, st->bytesRead, st->frames,
+            st->framesSkipped, st->badFrames, st->bytesDiscarded, st->overflows, st->readErrors);
+}
@@ -22,6 +22,73 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include "../clock/clock.h"
+
+
+/************************************************************************************
+					宏定义
+*************************************************************************************/
+#define SERIALPORT_STREAM_BUF_SIZE		2048		//每个串口接收缓冲区的大小
+#define SERIALPORT_OVERFLOW_LOG_MS		1000		//同一串口溢出日志的最小间隔(ms)
+
+
+/************************************************************************************
+					数据类型
+*************************************************************************************/
+struct serialPortFramer;
+
+/*	帧提取器:在data[0,len)中查找一帧完整数据
+	找到时返回帧长度，*start为帧在data中的起始位置(之前的字节会被丢弃)
+	没找到时返回0，*start为可以丢弃的字节数(剩下的字节可能是不完整的帧，留到下次再找)
+	遇到不完整/损坏的帧时返回-1，*start为重新同步的位置(必须大于0)，计入丢帧统计	*/
+typedef int (*serialPortExtractor_fn)(const struct serialPortFramer *framer, const unsigned char *data, size_t len, size_t *start);
+
+/*	帧格式描述	*/
+typedef struct serialPortFramer
+{
+	serialPortExtractor_fn extract;			//帧提取函数
+	const char *head;						//帧头(字节序列)
+	size_t headLen;							//帧头长度
+	unsigned char tail;						//帧尾/分隔符
+	int tailCount;							//帧尾出现的次数(分隔符方式为1；定长方式为0时不检查帧尾)
+	size_t frameLen;						//定长方式为帧长，其他方式为最大帧长
+}serialPortFramer_t;
+
+/*	取帧策略	*/
+typedef enum
+{
+	SERIALPORT_FRAME_ALL = 0,				//按顺序处理缓冲区中的每一帧
+	SERIALPORT_FRAME_LATEST					//只处理缓冲区中最新的一帧，较旧的帧计入跳过统计
+}serialPortFramePolicy_t;
+
+/*	接收统计	*/
+typedef struct
+{
+	unsigned long readCalls;				//read系统调用次数
+	unsigned long bytesRead;				//读取的字节数
+	unsigned long frames;					//交给调用者的完整帧数
+	unsigned long framesSkipped;			//按最新帧策略跳过的完整帧数
+	unsigned long badFrames;				//丢弃的不完整/损坏/超长帧数
+	unsigned long bytesDiscarded;			//重同步时丢弃的字节数
+	unsigned long overflows;				//缓冲区写满仍找不到帧的次数
+	unsigned long readErrors;				//read失败次数(如USB串口拔出后的EIO)
+}serialPortStreamStats_t;
+
+/*	串口接收缓冲区:每次就绪时把内核中已有的数据一次读完，再按帧格式逐帧取出	*/
+typedef struct
+{
+	int fd;									//串口文件描述符
+	const char *name;						//设备名称(打印用)
+	const serialPortFramer_t *framer;		//帧格式
+	serialPortFramePolicy_t policy;			//取帧策略
+	unsigned char buf[SERIALPORT_STREAM_BUF_SIZE];
+	size_t rpos;							//未处理数据的起始位置
+	size_t wpos;							//已接收数据的结束位置
+	serialPortStreamStats_t stats;			//接收统计
+	int64_t readStampNs;					//最近一次read读到数据的时间(Clock_nowNs)
+	int64_t frameStampNs;					//最近取出的一帧的时间戳:收到该帧最后一个字节的那次read的时间
+	int64_t overflowLogNs;					//最近一次输出溢出日志的时间，0表示还未输出过
+}serialPortStream_t;
 
 
 /************************************************************************************
@@ -37,6 +104,22 @@ int SerialPort_setFlowControl(int fd, int enable);
 int SerialPort_setDTR(int fd, int enable);
 int SerialPort_configBaseParams(int fd, int baudrate, int stopbit, int databits, char parity);
 void SerialPort_printConfig(int fd, const char *serialportName);
+int SerialPort_setNonBlock(int fd, int enable);
+int SerialPort_flush(int fd, int queue);
+
+/*	接收缓冲区与帧提取	*/
+int SerialPort_streamInit(serialPortStream_t *stream, int fd, const char *name, const serialPortFramer_t *framer);
+void SerialPort_streamReset(serialPortStream_t *stream);
+void SerialPort_streamSetPolicy(serialPortStream_t *stream, serialPortFramePolicy_t policy);
+ssize_t SerialPort_streamFill(serialPortStream_t *stream);
+int SerialPort_streamNextFrame(serialPortStream_t *stream, void *frame, size_t framesize);
+int SerialPort_streamRead(serialPortStream_t *stream, void *frame, size_t framesize);
+void SerialPort_streamPrintStats(const serialPortStream_t *stream);
+
+/*	内置帧提取器	*/
+int SerialPort_extractDelimited(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start);
+int SerialPort_extractHeadCount(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start);
+int SerialPort_extractFixed(const serialPortFramer_t *framer, const unsigned char *data, size_t len, size_t *start);
 
 
 #endif
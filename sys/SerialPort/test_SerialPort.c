@@ -0,0 +1,209 @@
+/*
+ * 串口接收缓冲区与帧提取器测试(不需要串口设备，数据从管道送入)
+ * 编译(在本目录下):
+ * gcc -o test_SerialPort test_SerialPort.c SerialPort.c ../../tool/tool.c ../trace/trace.c ../log/log.c \
+ *     ../ring/ring.c ../procstat/procstat.c ../rt/rt.c ../clock/clock.c -lpthread
+ * 全部通过返回0
+ */
+#include "SerialPort.h"
+#include "../../tool/tool.h"
+
+/******************** 测试工具函数 ********************/
+static int g_failed = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            g_failed++; \
+        } \
+    } while (0)
+
+/* 调用提取器，返回帧长度，*start为输出位置 */
+static int extract(const serialPortFramer_t *framer, const char *data, size_t *start)
+{
+    *start = (size_t)-1;
+    return framer->extract(framer, (const unsigned char *)data, strlen(data), start);
+}
+
+/* 与各驱动相同的帧格式(最大帧长按测试需要取小一些) */
+static const serialPortFramer_t g_gps_framer = {SerialPort_extractDelimited, "$GNGGA", 6, '\n', 1, 64};
+static const serialPortFramer_t g_dvl_framer = {SerialPort_extractHeadCount, ":SA", 3, '\r', 6, 128};
+static const serialPortFramer_t g_sonar_framer = {SerialPort_extractFixed, "\x40\x30", 2, 0x0A, 1, 8};
+
+#define GGA "$GNGGA,023634.00,4004.7,N,11614.2,E,1,05,2.0,45.9,M,-5.7,M,,*7E\n"
+#define DVL ":SA,1,2,3\r:TS,4\r:WI,5\r:BI,6\r:BS,7\r:BE,8\r"
+
+/******************** 分隔符方式 ********************/
+static void test_delimited(void)
+{
+    printf("\n=== Delimited ===\n");
+    const serialPortFramer_t *f = &g_gps_framer;
+    size_t start;
+    int len;
+
+    /* 帧前的无用字节 */
+    len = extract(f, "xx\r\n" GGA, &start);
+    CHECK(len == (int)strlen(GGA));
+    CHECK(start == 4);
+
+    /* 帧被拆成两次收到:前半部分保留，不丢弃 */
+    len = extract(f, "$GNGGA,023634.00,40", &start);
+    CHECK(len == 0);
+    CHECK(start == 0);
+
+    /* 只有无用字节，末尾是被截断的帧头，需要保留 */
+    len = extract(f, "abcdef$GNG", &start);
+    CHECK(len == 0);
+    CHECK(start == 5);
+
+    /* 帧内出现新的帧头:前一帧不完整，从新帧头重新同步 */
+    len = extract(f, "$GNGGA,0236$GNGGA,1\n", &start);
+    CHECK(len == -1);
+    CHECK(start == 11);
+
+    /* 超过最大帧长仍没有帧尾 */
+    len = extract(f, "$GNGGA,0123456789012345678901234567890123456789012345678901234567890123456789", &start);
+    CHECK(len == -1);
+    CHECK(start == 1);
+}
+
+/******************** 帧头+计数方式 ********************/
+static void test_head_count(void)
+{
+    printf("\n=== HeadCount ===\n");
+    const serialPortFramer_t *f = &g_dvl_framer;
+    size_t start;
+    int len;
+
+    len = extract(f, "\r\n" DVL ":SA", &start);
+    CHECK(len == (int)strlen(DVL));
+    CHECK(start == 2);
+
+    /* 只收到5行 */
+    len = extract(f, ":SA,1,2,3\r:TS,4\r:WI,5\r:BI,6\r:BS,7\r", &start);
+    CHECK(len == 0);
+    CHECK(start == 0);
+
+    /* 第6行之前出现新的帧头 */
+    len = extract(f, ":SA,1\r:TS,4\r:SA,1,2,3\r", &start);
+    CHECK(len == -1);
+    CHECK(start == 12);
+
+    /* 超过最大帧长 */
+    char longFrame[200];
+    memset(longFrame, 'x', sizeof(longFrame) - 1);
+    longFrame[sizeof(longFrame) - 1] = '\0';
+    memcpy(longFrame, ":SA", 3);
+    len = extract(f, longFrame, &start);
+    CHECK(len == -1);
+    CHECK(start == 1);
+}
+
+/******************** 定长二进制方式 ********************/
+static void test_fixed(void)
+{
+    printf("\n=== Fixed ===\n");
+    const serialPortFramer_t *f = &g_sonar_framer;
+    size_t start;
+    int len;
+
+    len = extract(f, "\x01\x02\x40\x30" "abcde\x0A", &start);
+    CHECK(len == 8);
+    CHECK(start == 2);
+
+    /* 数据不够一帧 */
+    len = extract(f, "\x40\x30" "ab", &start);
+    CHECK(len == 0);
+    CHECK(start == 0);
+
+    /* 帧尾不对，从帧头的下一个字节重新同步 */
+    len = extract(f, "\x40\x30" "abcdeX", &start);
+    CHECK(len == -1);
+    CHECK(start == 1);
+}
+
+/******************** 接收缓冲区 ********************/
+static void pipe_write(int fd, const char *data, size_t len)
+{
+    if (write(fd, data, len) != (ssize_t)len) {
+        perror("write");
+        g_failed++;
+    }
+}
+
+static void test_stream(void)
+{
+    printf("\n=== Stream ===\n");
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        g_failed++;
+        return;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    serialPortStream_t stream;
+    char frame[128];
+    int len;
+    CHECK(SerialPort_streamInit(&stream, fds[0], "test", &g_gps_framer) == 0);
+
+    /* 1.一帧分两次到达:第一次没有完整的帧，第二次取出 */
+    pipe_write(fds[1], "junk" GGA, 20);
+    len = SerialPort_streamRead(&stream, frame, sizeof(frame));
+    CHECK(len == 0);
+    pipe_write(fds[1], GGA + 16, strlen(GGA) - 16);
+    len = SerialPort_streamRead(&stream, frame, sizeof(frame));
+    CHECK(len == (int)strlen(GGA));
+    CHECK(len > 0 && strcmp(frame, GGA) == 0);
+    CHECK(stream.stats.bytesDiscarded == 4);
+
+    /* 2.损坏的帧丢弃并计数，后面的帧照常取出 */
+    pipe_write(fds[1], "$GNGGA,bad" GGA, 10 + strlen(GGA));
+    len = SerialPort_streamRead(&stream, frame, sizeof(frame));
+    CHECK(len == (int)strlen(GGA));
+    CHECK(stream.stats.badFrames == 1);
+
+    /* 3.帧比调用者的数组还大 */
+    pipe_write(fds[1], GGA, strlen(GGA));
+    len = SerialPort_streamRead(&stream, frame, 16);
+    CHECK(len == 0);
+    CHECK(stream.stats.badFrames == 2);
+
+    /* 4.最新帧策略:只取最后一帧 */
+    SerialPort_streamSetPolicy(&stream, SERIALPORT_FRAME_LATEST);
+    pipe_write(fds[1], GGA GGA GGA, 3 * strlen(GGA));
+    len = SerialPort_streamRead(&stream, frame, sizeof(frame));
+    CHECK(len == (int)strlen(GGA));
+    CHECK(stream.stats.framesSkipped == 2);
+    CHECK(stream.stats.frames == 3);
+
+    /* 5.缓冲区写满仍没有帧尾:整个缓冲区丢弃，计入溢出 */
+    static const serialPortFramer_t bigFramer = {SerialPort_extractDelimited, "$", 1, '\n', 1, 2 * SERIALPORT_STREAM_BUF_SIZE};
+    char fill[SERIALPORT_STREAM_BUF_SIZE + 64];
+    memset(fill, 'A', sizeof(fill));
+    fill[0] = '$';
+    CHECK(SerialPort_streamInit(&stream, fds[0], "test", &bigFramer) == 0);
+    pipe_write(fds[1], fill, sizeof(fill));
+    CHECK(SerialPort_streamRead(&stream, frame, sizeof(frame)) == 0);
+    CHECK(stream.wpos == SERIALPORT_STREAM_BUF_SIZE);
+    CHECK(SerialPort_streamRead(&stream, frame, sizeof(frame)) == 0);
+    CHECK(stream.stats.overflows == 1);
+    CHECK(stream.stats.bytesDiscarded == sizeof(fill));      //溢出丢弃的2048字节 + 之后没有帧头的64字节
+
+    SerialPort_streamPrintStats(&stream);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+int main()
+{
+    Clock_init();
+
+    test_delimited();
+    test_head_count();
+    test_fixed();
+    test_stream();
+
+    printf("\n%s: %d failed\n", g_failed ? "FAIL" : "PASS", g_failed);
+    return g_failed ? 1 : 0;
+}
@@ -0,0 +1,834 @@
+/************************************************************************************
+					文件名：binlog.c
+					描述：二进制追加日志实现
+ ************************************************************************************/
+
+#include "binlog.h"
+#include "../clock/clock.h"
+#include "../ring/ring.h"
+#include "../rt/rt.h"
+#include "../procstat/procstat.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  每个段的块数(第0块为段头)、每块可放记录的字节数  */
+#define BINLOG_BLOCKS_PER_SEGMENT   (BINLOG_SEGMENT_SIZE / BINLOG_BLOCK_SIZE)
+#define BINLOG_BLOCK_PAYLOAD        (BINLOG_BLOCK_SIZE - sizeof(binlogBlockHeader_t))
+
+/*  同时存在的段:正在写入、预先建好的下一个、正在收尾的上一个  */
+#define BINLOG_SEGMENT_SLOTS        3
+
+/*  记录数据补齐到8字节 */
+#define BINLOG_ALIGN8(size)         (((size) + 7) & ~(size_t)7)
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  一个段文件  */
+typedef struct
+{
+    int inUse;
+    int fd;
+    unsigned char *base;
+    uint32_t seq;
+    char path[160];
+}binlogSegment_t;
+
+/*  交给后台线程的工作:封存一个块，或收尾一个写满的段(block为已用的块数)  */
+typedef struct
+{
+    binlogSegment_t *segment;
+    uint32_t block;
+    int retire;
+}binlogSealReq_t;
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+static binlogTypeDesc_t g_binlog_types[BINLOG_MAX_TYPES];
+static char g_binlog_dir[128];
+static int64_t g_binlog_run = 0;
+
+static binlogSegment_t g_binlog_segments[BINLOG_SEGMENT_SLOTS];
+static uint32_t g_binlog_segment_seq = 0;
+static binlogSegment_t *g_binlog_next = NULL;           //后台线程预先建好的段
+
+/*  写入状态，由g_binlog_mutex保护(临界区内只有一次memcpy)    */
+static pthread_mutex_t g_binlog_mutex = PTHREAD_MUTEX_INITIALIZER;
+static binlogSegment_t *g_binlog_cur = NULL;
+static uint32_t g_binlog_block = 0;                     //当前块在段中的序号
+static binlogBlockHeader_t *g_binlog_block_hdr = NULL;  //当前块，NULL为没有打开的块
+static int64_t g_binlog_block_openNs = 0;
+static uint32_t g_binlog_block_seq = 0;
+static binlogStats_t g_binlog_stats;
+
+static ringQueue_t g_binlog_seal_queue;
+static int g_binlog_seal_missed = 0;                    //有块因队列满没有交出去，后台线程补封
+static pthread_t g_binlog_tid;
+static int g_binlog_running = 0;
+
+static uint32_t g_binlog_crc_table[256];
+static pthread_once_t g_binlog_crc_once = PTHREAD_ONCE_INIT;
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static void Binlog_initCrcTable(void)
+* 函数简介:生成CRC-32查找表(多项式0xEDB88320)
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+static void Binlog_initCrcTable(void)
+{
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for(int k = 0; k < 8; k++)
+        {
+            c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+        }
+        g_binlog_crc_table[i] = c;
+    }
+}
+
+/*******************************************************************
+* 函数原型:static uint32_t Binlog_blockCrc(const binlogBlockHeader_t *hdr)
+* 函数简介:计算块的CRC:块头(magic按已封存、crc按0计算)和bytes字节的记录
+* 函数参数:hdr:块头(bytes已检查不超过块的容量)
+* 函数返回值:CRC
+*****************************************************************/
+static uint32_t Binlog_blockCrc(const binlogBlockHeader_t *hdr)
+{
+    binlogBlockHeader_t copy = *hdr;
+
+    copy.magic = BINLOG_BLOCK_SEALED;
+    copy.crc = 0;
+
+    return Binlog_crc32(Binlog_crc32(0, &copy, sizeof(copy)), hdr + 1, hdr->bytes);
+}
+
+/*******************************************************************
+* 函数原型:static binlogSegment_t *Binlog_openSegment(void)
+* 函数简介:新建一个段文件:占一个空闲的段，文件扩到段大小后映射并预先分配页面，写入段头
+* 函数参数:无
+* 函数返回值:成功返回段，失败返回NULL
+*****************************************************************/
+static binlogSegment_t *Binlog_openSegment(void)
+{
+    binlogSegment_t *seg = NULL;
+
+    for(int i = 0; i < BINLOG_SEGMENT_SLOTS && seg == NULL; i++)
+    {
+        int expected = 0;
+        if(__atomic_compare_exchange_n(&g_binlog_segments[i].inUse, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            seg = &g_binlog_segments[i];
+        }
+    }
+    if(seg == NULL)
+    {
+        printf("Binlog_openSegment:上一个段还没有收尾\n");
+        return NULL;
+    }
+
+    seg->seq = __atomic_fetch_add(&g_binlog_segment_seq, 1, __ATOMIC_RELAXED);
+    snprintf(seg->path, sizeof(seg->path), "%s/%lld-%04u.blog", g_binlog_dir, (long long)g_binlog_run, seg->seq);
+
+    seg->fd = open(seg->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(seg->fd < 0 || ftruncate(seg->fd, BINLOG_SEGMENT_SIZE) < 0)
+    {
+        perror("Binlog_openSegment");
+        if(seg->fd >= 0)
+        {
+            close(seg->fd);
+            unlink(seg->path);
+        }
+        __atomic_store_n(&seg->inUse, 0, __ATOMIC_RELEASE);
+        return NULL;
+    }
+
+    seg->base = mmap(NULL, BINLOG_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, seg->fd, 0);
+    if(seg->base == MAP_FAILED)
+    {
+        perror("Binlog_openSegment:mmap");
+        close(seg->fd);
+        unlink(seg->path);
+        __atomic_store_n(&seg->inUse, 0, __ATOMIC_RELEASE);
+        return NULL;
+    }
+
+    binlogSegmentHeader_t *header = (binlogSegmentHeader_t *)seg->base;
+    header->version = BINLOG_VERSION;
+    header->headerSize = sizeof(binlogSegmentHeader_t);
+    header->segmentSeq = seg->seq;
+    header->blockSize = BINLOG_BLOCK_SIZE;
+    header->run = g_binlog_run;
+    header->epochOffsetNs = Clock_toEpochNs(0);
+    memcpy(header->types, g_binlog_types, sizeof(header->types));
+    header->magic = BINLOG_MAGIC;
+
+    return seg;
+}
+
+/*******************************************************************
+* 函数原型:static void Binlog_closeSegment(binlogSegment_t *seg, uint32_t blocks)
+* 函数简介:收尾一个段:写回磁盘，截掉未用的块，释放段
+* 函数参数:seg:段
+* 函数参数:blocks:已用的块数(含段头)，0为未使用(删除文件)
+* 函数返回值:无
+*****************************************************************/
+static void Binlog_closeSegment(binlogSegment_t *seg, uint32_t blocks)
+{
+    if(blocks > 0)
+    {
+        msync(seg->base, (size_t)blocks * BINLOG_BLOCK_SIZE, MS_SYNC);
+    }
+    munmap(seg->base, BINLOG_SEGMENT_SIZE);
+    if(blocks > 0)
+    {
+        if(ftruncate(seg->fd, (off_t)blocks * BINLOG_BLOCK_SIZE) < 0)
+        {
+            perror("Binlog_closeSegment");
+        }
+    }
+    else
+    {
+        unlink(seg->path);
+    }
+    close(seg->fd);
+    seg->base = NULL;
+    __atomic_store_n(&seg->inUse, 0, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************
+* 函数原型:static void Binlog_pushReq(binlogSegment_t *seg, uint32_t block, int retire)
+* 函数简介:把封存或收尾工作交给后台线程(持有g_binlog_mutex时调用)。队列满时封存的块
+*          先留为未封存，由后台线程下一轮补封；收尾必须交出去，等待后台线程
+* 函数参数:seg:段
+* 函数参数:block:块序号，收尾时为已用的块数
+* 函数参数:retire:1为收尾
+* 函数返回值:无
+*****************************************************************/
+static void Binlog_pushReq(binlogSegment_t *seg, uint32_t block, int retire)
+{
+    binlogSealReq_t req = {seg, block, retire};
+    struct timespec wait = {0, 1000000L};
+
+    while(Ring_push(&g_binlog_seal_queue, &req) < 0)
+    {
+        if(!retire)
+        {
+            g_binlog_stats.sealMissed++;
+            __atomic_store_n(&g_binlog_seal_missed, 1, __ATOMIC_RELEASE);
+            return;
+        }
+        nanosleep(&wait, NULL);
+    }
+}
+
+/*******************************************************************
+* 函数原型:static void Binlog_closeBlock(void)
+* 函数简介:结束当前块并交给后台线程封存(持有g_binlog_mutex时调用)
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+static void Binlog_closeBlock(void)
+{
+    Binlog_pushReq(g_binlog_cur, g_binlog_block, 0);
+    g_binlog_block_hdr = NULL;
+    g_binlog_block++;
+}
+
+/*******************************************************************
+* 函数原型:static int Binlog_openBlock(int64_t stampNs)
+* 函数简介:打开下一个块(持有g_binlog_mutex时调用)，当前段写满时换到预先建好的段
+* 函数参数:stampNs:块中第一条记录的时间
+* 函数返回值:成功返回0，没有可用的段返回-1
+*****************************************************************/
+static int Binlog_openBlock(int64_t stampNs)
+{
+    if(g_binlog_cur == NULL || g_binlog_block >= BINLOG_BLOCKS_PER_SEGMENT)
+    {
+        if(g_binlog_cur != NULL)
+        {
+            Binlog_pushReq(g_binlog_cur, g_binlog_block, 1);
+            g_binlog_cur = NULL;
+        }
+
+        /*  后台线程来不及预先建段时在这里建(有文件操作，较慢)  */
+        binlogSegment_t *next = __atomic_exchange_n(&g_binlog_next, NULL, __ATOMIC_ACQ_REL);
+        if(next == NULL && (next = Binlog_openSegment()) == NULL)
+        {
+            return -1;
+        }
+        g_binlog_cur = next;
+        g_binlog_block = 1;
+        g_binlog_stats.segments++;
+    }
+
+    binlogBlockHeader_t *hdr = (binlogBlockHeader_t *)(g_binlog_cur->base + (size_t)g_binlog_block * BINLOG_BLOCK_SIZE);
+    hdr->seq = g_binlog_block_seq++;
+    hdr->bytes = 0;
+    hdr->records = 0;
+    hdr->crc = 0;
+    hdr->firstNs = stampNs;
+    hdr->magic = BINLOG_BLOCK_OPEN;
+
+    g_binlog_block_hdr = hdr;
+    g_binlog_block_openNs = Clock_nowNs();
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:static void Binlog_sealBlock(binlogSegment_t *seg, uint32_t block)
+* 函数简介:封存一个块:计算CRC后把块头改为已封存(已被补封的块跳过)
+* 函数参数:seg:段
+* 函数参数:block:块序号
+* 函数返回值:无
+*****************************************************************/
+static void Binlog_sealBlock(binlogSegment_t *seg, uint32_t block)
+{
+    binlogBlockHeader_t *hdr = (binlogBlockHeader_t *)(seg->base + (size_t)block * BINLOG_BLOCK_SIZE);
+
+    if(hdr->magic != BINLOG_BLOCK_OPEN)
+    {
+        return;
+    }
+    hdr->crc = Binlog_blockCrc(hdr);
+    __atomic_store_n(&hdr->magic, BINLOG_BLOCK_SEALED, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&g_binlog_stats.blocks, 1, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************
+* 函数原型:static void Binlog_doReq(const binlogSealReq_t *req)
+* 函数简介:封存一个块，或收尾一个段(收尾前补封还未封存的块)
+* 函数参数:req:工作
+* 函数返回值:无
+*****************************************************************/
+static void Binlog_doReq(const binlogSealReq_t *req)
+{
+    if(!req->retire)
+    {
+        Binlog_sealBlock(req->segment, req->block);
+        return;
+    }
+
+    for(uint32_t block = 1; block < req->block; block++)
+    {
+        const binlogBlockHeader_t *hdr = (const binlogBlockHeader_t *)(req->segment->base + (size_t)block * BINLOG_BLOCK_SIZE);
+        if(hdr->magic == BINLOG_BLOCK_OPEN)
+        {
+            Binlog_sealBlock(req->segment, block);
+        }
+    }
+    Binlog_closeSegment(req->segment, req->block);
+}
+
+/*******************************************************************
+* 函数原型:static void Binlog_sealMissed(void)
+* 函数简介:补封当前段中因队列满没有交出去的块。段只由本线程收尾，解锁后仍然有效；
+*          当前块之前的块不会再写入。写入方持锁等待队列时不抢锁，下一轮再补
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+static void Binlog_sealMissed(void)
+{
+    if(pthread_mutex_trylock(&g_binlog_mutex) != 0)
+    {
+        return;
+    }
+    binlogSegment_t *seg = g_binlog_cur;
+    uint32_t end = g_binlog_block;
+    __atomic_store_n(&g_binlog_seal_missed, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_binlog_mutex);
+
+    for(uint32_t block = 1; seg != NULL && block < end; block++)
+    {
+        const binlogBlockHeader_t *hdr = (const binlogBlockHeader_t *)(seg->base + (size_t)block * BINLOG_BLOCK_SIZE);
+        if(__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == BINLOG_BLOCK_OPEN)
+        {
+            Binlog_sealBlock(seg, block);
+        }
+    }
+}
+
+/*******************************************************************
+* 函数原型:static void *Binlog_SealThread(void *arg)
+* 函数简介:后台线程:封存写满的块、收尾写满的段、预先建好下一个段，
+*          未写满的块超过BINLOG_FLUSH_MS时结束并封存
+* 函数参数:arg:无
+* 函数返回值:无
+*****************************************************************/
+static void *Binlog_SealThread(void *arg)
+{
+    (void)arg;
+    binlogSealReq_t req;
+    struct timespec idle = {0, BINLOG_IDLE_SLEEP_MS * 1000000L};
+
+    Rt_enterThread(RT_ROLE_BACKGROUND);
+
+    for(;;)
+    {
+        int running = __atomic_load_n(&g_binlog_running, __ATOMIC_ACQUIRE);
+
+        while(Ring_pop(&g_binlog_seal_queue, &req) == 0)
+        {
+            Binlog_doReq(&req);
+        }
+        if(!running)
+        {
+            break;
+        }
+        if(__atomic_load_n(&g_binlog_seal_missed, __ATOMIC_ACQUIRE))
+        {
+            Binlog_sealMissed();
+        }
+
+        if(__atomic_load_n(&g_binlog_next, __ATOMIC_ACQUIRE) == NULL)
+        {
+            __atomic_store_n(&g_binlog_next, Binlog_openSegment(), __ATOMIC_RELEASE);
+        }
+
+        /*  写入方可能持锁等待本线程腾出队列，只尝试加锁    */
+        if(pthread_mutex_trylock(&g_binlog_mutex) == 0)
+        {
+            if(g_binlog_block_hdr != NULL && g_binlog_block_hdr->records > 0 &&
+               Clock_sinceMs(g_binlog_block_openNs) >= BINLOG_FLUSH_MS)
+            {
+                Binlog_closeBlock();
+            }
+            pthread_mutex_unlock(&g_binlog_mutex);
+        }
+
+        nanosleep(&idle, NULL);
+    }
+
+    /*  预先建好但没有用到的段  */
+    binlogSegment_t *next = __atomic_exchange_n(&g_binlog_next, NULL, __ATOMIC_ACQ_REL);
+    if(next != NULL)
+    {
+        Binlog_closeSegment(next, 0);
+    }
+
+    return NULL;
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:int Binlog_registerType(uint16_t id, const char *name, uint16_t size)
+* 函数简介:登记一种记录，写入之后每个段的段头
+* 函数参数:id:记录类型(小于BINLOG_MAX_TYPES)
+* 函数参数:name:名称(转换工具按名称找到对应的表)
+* 函数参数:size:数据大小
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Binlog_registerType(uint16_t id, const char *name, uint16_t size)
+{
+    if(id >= BINLOG_MAX_TYPES || name == NULL || size == 0 || size > BINLOG_BLOCK_PAYLOAD - sizeof(binlogRecordHeader_t) ||
+       g_binlog_running)
+    {
+        printf("Binlog_registerType:登记失败(%u)\n", id);
+        return -1;
+    }
+
+    g_binlog_types[id].id = id;
+    g_binlog_types[id].size = size;
+    snprintf(g_binlog_types[id].name, sizeof(g_binlog_types[id].name), "%s", name);
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int Binlog_Init(const char *dir, int64_t run)
+* 函数简介:建目录和第一个段文件，启动后台封存线程
+* 函数参数:dir:目录，NULL为BINLOG_DIR
+* 函数参数:run:运行编号(写入段头，文件名以它开头)
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Binlog_Init(const char *dir, int64_t run)
+{
+    if(g_binlog_running)
+    {
+        return -1;
+    }
+
+    snprintf(g_binlog_dir, sizeof(g_binlog_dir), "%s", dir != NULL ? dir : BINLOG_DIR);
+    size_t len = strlen(g_binlog_dir);
+    while(len > 1 && g_binlog_dir[len - 1] == '/')
+    {
+        g_binlog_dir[--len] = '\0';
+    }
+    if(mkdir(g_binlog_dir, 0755) < 0 && errno != EEXIST)
+    {
+        perror("Binlog_Init");
+        return -1;
+    }
+    g_binlog_run = run;
+
+    if(Ring_init(&g_binlog_seal_queue, BINLOG_SEAL_QUEUE_SIZE, sizeof(binlogSealReq_t)) < 0)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_binlog_mutex);
+    int ret = Binlog_openBlock(Clock_nowNs());
+    pthread_mutex_unlock(&g_binlog_mutex);
+    if(ret < 0)
+    {
+        Ring_destroy(&g_binlog_seal_queue);
+        return -1;
+    }
+
+    __atomic_store_n(&g_binlog_running, 1, __ATOMIC_RELEASE);
+    if(pthread_create(&g_binlog_tid, NULL, Binlog_SealThread, NULL) != 0)
+    {
+        printf("Binlog_Init:封存线程创建错误\n");
+        __atomic_store_n(&g_binlog_running, 0, __ATOMIC_RELEASE);
+        Binlog_closeSegment(g_binlog_cur, 0);
+        g_binlog_cur = NULL;
+        g_binlog_block_hdr = NULL;
+        Ring_destroy(&g_binlog_seal_queue);
+        return -1;
+    }
+    ProcStat_setThreadName(g_binlog_tid, "binlog");
+
+    printf("二进制日志:%s，段%dMB，块%dKB\n", g_binlog_cur->path, BINLOG_SEGMENT_SIZE / (1024 * 1024), BINLOG_BLOCK_SIZE / 1024);
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:void Binlog_Shutdown(void)
+* 函数简介:停止写入，封存当前块、收尾当前段后等待后台线程退出
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Binlog_Shutdown(void)
+{
+    if(!g_binlog_running)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&g_binlog_mutex);
+    if(g_binlog_block_hdr != NULL)
+    {
+        if(g_binlog_block_hdr->records > 0)
+        {
+            Binlog_closeBlock();
+        }
+        else
+        {
+            g_binlog_block_hdr->magic = 0;          //空块不算已用
+            g_binlog_block_hdr = NULL;
+        }
+    }
+    if(g_binlog_cur != NULL)
+    {
+        Binlog_pushReq(g_binlog_cur, g_binlog_block, 1);
+        g_binlog_cur = NULL;
+    }
+    __atomic_store_n(&g_binlog_running, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&g_binlog_mutex);
+
+    pthread_join(g_binlog_tid, NULL);
+    Ring_destroy(&g_binlog_seal_queue);
+}
+
+/*******************************************************************
+* 函数原型:int Binlog_isEnabled(void)
+* 函数简介:是否已启动
+* 函数参数:无
+* 函数返回值:已启动返回1，否则返回0
+*****************************************************************/
+int Binlog_isEnabled(void)
+{
+    return __atomic_load_n(&g_binlog_running, __ATOMIC_ACQUIRE);
+}
+
+/*******************************************************************
+* 函数原型:int Binlog_write(uint16_t type, int64_t stampNs, const void *data)
+* 函数简介:写入一条记录:在当前块中写记录头并拷贝数据，块写满时交给后台线程封存
+* 函数参数:type:记录类型(已登记)
+* 函数参数:stampNs:采样时间(单调时钟纳秒)，0为当前时间
+* 函数参数:data:登记大小的数据
+* 函数返回值:成功返回0，失败返回-1(计入丢弃)
+*****************************************************************/
+int Binlog_write(uint16_t type, int64_t stampNs, const void *data)
+{
+    if(!__atomic_load_n(&g_binlog_running, __ATOMIC_ACQUIRE) || type >= BINLOG_MAX_TYPES ||
+       g_binlog_types[type].size == 0 || data == NULL)
+    {
+        __atomic_fetch_add(&g_binlog_stats.dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    uint16_t size = g_binlog_types[type].size;
+    size_t need = sizeof(binlogRecordHeader_t) + BINLOG_ALIGN8(size);
+    if(stampNs == 0)
+    {
+        stampNs = Clock_nowNs();
+    }
+
+    pthread_mutex_lock(&g_binlog_mutex);
+    if(!g_binlog_running)
+    {
+        pthread_mutex_unlock(&g_binlog_mutex);
+        __atomic_fetch_add(&g_binlog_stats.dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    if(g_binlog_block_hdr != NULL && g_binlog_block_hdr->bytes + need > BINLOG_BLOCK_PAYLOAD)
+    {
+        Binlog_closeBlock();
+    }
+    if(g_binlog_block_hdr == NULL && Binlog_openBlock(stampNs) < 0)
+    {
+        pthread_mutex_unlock(&g_binlog_mutex);
+        __atomic_fetch_add(&g_binlog_stats.dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    binlogBlockHeader_t *hdr = g_binlog_block_hdr;
+    binlogRecordHeader_t *rec = (binlogRecordHeader_t *)((unsigned char *)(hdr + 1) + hdr->bytes);
+    rec->type = type;
+    rec->size = size;
+    rec->reserved = 0;
+    rec->stampNs = stampNs;
+    memcpy(rec + 1, data, size);
+    hdr->bytes += need;
+    hdr->records++;
+
+    g_binlog_stats.records++;
+    g_binlog_stats.bytes += need;
+    pthread_mutex_unlock(&g_binlog_mutex);
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:void Binlog_getStats(binlogStats_t *stats)
+* 函数简介:取写入统计
+* 函数参数:stats:输出
+* 函数返回值:无
+*****************************************************************/
+void Binlog_getStats(binlogStats_t *stats)
+{
+    pthread_mutex_lock(&g_binlog_mutex);
+    *stats = g_binlog_stats;
+    pthread_mutex_unlock(&g_binlog_mutex);
+
+    stats->dropped = __atomic_load_n(&g_binlog_stats.dropped, __ATOMIC_RELAXED);
+    stats->blocks = __atomic_load_n(&g_binlog_stats.blocks, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************
+* 函数原型:void Binlog_Print(void)
+* 函数简介:打印写入统计
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Binlog_Print(void)
+{
+    binlogStats_t stats;
+
+    if(!Binlog_isEnabled())
+    {
+        return;
+    }
+    Binlog_getStats(&stats);
+    printf("[Binlog] 记录:%lu 字节:%lu 已封存块:%lu 段:%lu 丢弃:%lu 补封块:%lu\n", stats.records, stats.bytes,
+           stats.blocks, stats.segments, stats.dropped, stats.sealMissed);
+}
+
+/*******************************************************************
+* 函数原型:int Binlog_openReader(binlogReader_t *reader, const char *path, int acceptOpen)
+* 函数简介:打开一个段文件并检查段头
+* 函数参数:reader:读取状态
+* 函数参数:path:段文件
+* 函数参数:acceptOpen:1为也读取未封存的块
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Binlog_openReader(binlogReader_t *reader, const char *path, int acceptOpen)
+{
+    struct stat st;
+
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(reader->fd < 0 || fstat(reader->fd, &st) < 0)
+    {
+        perror(path);
+        if(reader->fd >= 0)
+        {
+            close(reader->fd);
+        }
+        return -1;
+    }
+
+    reader->size = (size_t)st.st_size;
+    if(reader->size < sizeof(binlogSegmentHeader_t) ||
+       (reader->base = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, reader->fd, 0)) == MAP_FAILED)
+    {
+        printf("%s:不是二进制日志段文件\n", path);
+        close(reader->fd);
+        return -1;
+    }
+
+    reader->header = (const binlogSegmentHeader_t *)reader->base;
+    if(reader->header->magic != BINLOG_MAGIC || reader->header->version != BINLOG_VERSION ||
+       reader->header->headerSize != sizeof(binlogSegmentHeader_t) ||
+       reader->header->blockSize < sizeof(binlogSegmentHeader_t) || reader->header->blockSize % 8 != 0)
+    {
+        printf("%s:段头错误或版本不支持\n", path);
+        Binlog_closeReader(reader);
+        return -1;
+    }
+
+    reader->acceptOpen = acceptOpen;
+    reader->block = 1;
+    reader->offset = 0;
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int Binlog_nextRecord(binlogReader_t *reader, const binlogRecordHeader_t **rec, const void **data)
+* 函数简介:取下一条记录。进入一个块时先检查:已封存的块校验CRC，未封存的块按acceptOpen决定，
+*          错误的块整块跳过并计数
+* 函数参数:reader:读取状态
+* 函数参数:rec:输出记录头
+* 函数参数:data:输出数据(指向文件映射，关闭后失效)
+* 函数返回值:取到返回1，读完返回0
+*****************************************************************/
+int Binlog_nextRecord(binlogReader_t *reader, const binlogRecordHeader_t **rec, const void **data)
+{
+    size_t blockSize = reader->header->blockSize;
+    size_t payload = blockSize - sizeof(binlogBlockHeader_t);
+
+    for(;;)
+    {
+        if((reader->block + 1) * blockSize > reader->size)
+        {
+            return 0;
+        }
+
+        const binlogBlockHeader_t *hdr = (const binlogBlockHeader_t *)(reader->base + reader->block * blockSize);
+
+        /*  1.进入块时检查  */
+        if(reader->offset == 0)
+        {
+            int ok = 0;
+            if(hdr->magic == 0)
+            {
+                return 0;                               //之后没有写过
+            }
+            else if(hdr->bytes > payload)
+            {
+                reader->badBlocks++;
+            }
+            else if(hdr->magic == BINLOG_BLOCK_SEALED)
+            {
+                ok = Binlog_blockCrc(hdr) == hdr->crc;
+                reader->badBlocks += !ok;
+            }
+            else if(hdr->magic == BINLOG_BLOCK_OPEN)
+            {
+                reader->openBlocks++;
+                ok = reader->acceptOpen;
+            }
+            else
+            {
+                reader->badBlocks++;
+            }
+
+            if(!ok)
+            {
+                reader->block++;
+                continue;
+            }
+            reader->offset = sizeof(binlogBlockHeader_t);
+        }
+
+        /*  2.块中的下一条记录  */
+        size_t end = sizeof(binlogBlockHeader_t) + hdr->bytes;
+        if(reader->offset + sizeof(binlogRecordHeader_t) > end)
+        {
+            reader->block++;
+            reader->offset = 0;
+            continue;
+        }
+
+        const binlogRecordHeader_t *r = (const binlogRecordHeader_t *)((const unsigned char *)hdr + reader->offset);
+        size_t need = sizeof(binlogRecordHeader_t) + BINLOG_ALIGN8((size_t)r->size);
+        if(reader->offset + need > end)
+        {
+            reader->badBlocks++;
+            reader->block++;
+            reader->offset = 0;
+            continue;
+        }
+
+        reader->offset += need;
+        *rec = r;
+        *data = r + 1;
+        return 1;
+    }
+}
+
+/*******************************************************************
+* 函数原型:void Binlog_closeReader(binlogReader_t *reader)
+* 函数简介:关闭段文件
+* 函数参数:reader:读取状态
+* 函数返回值:无
+*****************************************************************/
+void Binlog_closeReader(binlogReader_t *reader)
+{
+    if(reader->base != NULL && reader->base != MAP_FAILED)
+    {
+        munmap((void *)reader->base, reader->size);
+    }
+    if(reader->fd >= 0)
+    {
+        close(reader->fd);
+    }
+    reader->base = NULL;
+    reader->fd = -1;
+}
+
+/*******************************************************************
+* 函数原型:uint32_t Binlog_crc32(uint32_t crc, const void *data, size_t len)
+* 函数简介:CRC-32，可分段计算(把上一段的结果作为crc传入，第一段传0)
+* 函数参数:crc:上一段的结果
+* 函数参数:data:数据
+* 函数参数:len:长度
+* 函数返回值:CRC
+*****************************************************************/
+uint32_t Binlog_crc32(uint32_t crc, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    pthread_once(&g_binlog_crc_once, Binlog_initCrcTable);
+
+    crc = ~crc;
+    while(len--)
+    {
+        crc = g_binlog_crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
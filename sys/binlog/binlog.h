@@ -0,0 +1,145 @@
+/************************************************************************************
+					文件名：binlog.h
+					描述：二进制追加日志。DVL、声纳、推进器反馈等高频数据不逐行入库，
+						  按定长记录拷贝到内存映射的段文件中，写入一条只是一次memcpy。
+						  段文件开头描述每种记录(编号、名称、大小)，之后按定长块存放记录，
+						  写满或超过BINLOG_FLUSH_MS的块由后台线程计算CRC并封存；
+						  段写满后换下一个(后台线程预先建好)。事后用tool/binlog2db转换到数据库
+ ************************************************************************************/
+
+#ifndef __BINLOG_H__
+#define __BINLOG_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  默认目录(与数据库目录并列)  */
+#define BINLOG_DIR                  "../binlog/"
+
+/*  段文件、块的大小:段满后换下一个文件，块是CRC校验和封存的单位(第0块为段头)  */
+#define BINLOG_SEGMENT_SIZE         (8 * 1024 * 1024)
+#define BINLOG_BLOCK_SIZE           (16 * 1024)
+
+/*  最多的记录类型数、类型名长度(含结束符)   */
+#define BINLOG_MAX_TYPES            16
+#define BINLOG_TYPE_NAME_LEN        24
+
+/*  未写满的块最多等待BINLOG_FLUSH_MS后封存；后台线程空闲时的休眠时间、待封存块的队列容量(2的幂)   */
+#define BINLOG_FLUSH_MS             1000
+#define BINLOG_IDLE_SLEEP_MS        10
+#define BINLOG_SEAL_QUEUE_SIZE      64
+
+/*  文件格式    */
+#define BINLOG_MAGIC                0x474f4c42      //段头"BLOG"
+#define BINLOG_VERSION              1
+#define BINLOG_BLOCK_OPEN           0x4e45504f      //块正在写入(异常退出时留下的块)"OPEN"
+#define BINLOG_BLOCK_SEALED         0x4c414553      //块已封存，CRC有效"SEAL"
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  一种记录的描述(写在段头中，转换工具按名称和大小识别) */
+typedef struct
+{
+    uint16_t id;
+    uint16_t size;                      //数据大小，0为未登记
+    uint32_t reserved;
+    char name[BINLOG_TYPE_NAME_LEN];
+}binlogTypeDesc_t;
+
+/*  段头(第0块)  */
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;                //sizeof(binlogSegmentHeader_t)
+    uint32_t segmentSeq;                //本次运行中的段序号，从0开始
+    uint32_t blockSize;
+    int64_t run;                        //运行编号(与数据库Run表一致)
+    int64_t epochOffsetNs;              //墙上时间与单调时钟的差值，记录时间+该值为墙上时间
+    binlogTypeDesc_t types[BINLOG_MAX_TYPES];
+}binlogSegmentHeader_t;
+
+/*  块头:CRC覆盖块头(magic为BINLOG_BLOCK_SEALED、crc为0)和bytes字节的记录  */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;                       //本次运行中的块序号
+    uint32_t bytes;                     //记录占用的字节数
+    uint32_t records;
+    uint32_t crc;
+    uint32_t reserved;
+    int64_t firstNs;                    //块中第一条记录的时间
+}binlogBlockHeader_t;
+
+/*  记录头，之后是size字节的数据(补齐到8字节)  */
+typedef struct
+{
+    uint16_t type;
+    uint16_t size;
+    uint32_t reserved;
+    int64_t stampNs;                    //采样时间(单调时钟纳秒)
+}binlogRecordHeader_t;
+
+/*  写入统计    */
+typedef struct
+{
+    unsigned long records;              //已写入的记录
+    unsigned long bytes;
+    unsigned long dropped;              //未启动、类型未登记、换段失败时丢弃的记录
+    unsigned long blocks;               //已封存的块
+    unsigned long segments;             //已使用的段文件
+    unsigned long sealMissed;           //封存队列满，由后台线程补封的块
+}binlogStats_t;
+
+/*  读取一个段文件  */
+typedef struct
+{
+    int fd;
+    const unsigned char *base;
+    size_t size;
+    const binlogSegmentHeader_t *header;
+    int acceptOpen;                     //1为也读取未封存的块(异常退出时最后的数据，无CRC保护)
+    size_t block;                       //当前块
+    size_t offset;                      //当前块中下一条记录的位置
+    unsigned long badBlocks;            //CRC或格式错误，已跳过
+    unsigned long openBlocks;           //未封存的块
+}binlogReader_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  登记记录类型(在Binlog_Init之前)  */
+int Binlog_registerType(uint16_t id, const char *name, uint16_t size);
+
+/*  启动:建第一个段文件和后台封存线程；停止时封存所有块并截掉段文件未用的部分  */
+int Binlog_Init(const char *dir, int64_t run);
+void Binlog_Shutdown(void);
+int Binlog_isEnabled(void);
+
+/*  写入一条记录(data为登记大小的数据，任意线程可调用) */
+int Binlog_write(uint16_t type, int64_t stampNs, const void *data);
+
+/*  统计    */
+void Binlog_getStats(binlogStats_t *stats);
+void Binlog_Print(void);
+
+/*  读取段文件:依次取出记录，返回1为取到，0为读完  */
+int Binlog_openReader(binlogReader_t *reader, const char *path, int acceptOpen);
+int Binlog_nextRecord(binlogReader_t *reader, const binlogRecordHeader_t **rec, const void **data);
+void Binlog_closeReader(binlogReader_t *reader);
+
+/*  CRC-32(与zlib相同)  */
+uint32_t Binlog_crc32(uint32_t crc, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,111 @@
+/************************************************************************************
+					文件名：bus.c
+					描述：传感器最新值总线(seqlock)实现
+ ************************************************************************************/
+
+#include "bus.h"
+#include <sched.h>
+#include <limits.h>
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  读者连续遇到正在写的次数超过这个值就让出CPU，避免和发布者抢同一个核    */
+#define BUS_READ_SPIN_MAX       64
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:void Bus_publish(busSlot_t *slot, const void *sample, int64_t stampNs)
+* 函数简介:发布一个样本。写入期间seq为奇数，读者据此丢弃写了一半的数据并重读
+* 函数参数:slot:槽
+* 函数参数:sample:样本，大小为slot->size
+* 函数参数:stampNs:样本时间戳(Clock_nowNs，一般取原始数据读入的时间)，为0时取当前时间
+* 函数返回值:无
+*****************************************************************/
+void Bus_publish(busSlot_t *slot, const void *sample, int64_t stampNs)
+{
+    if(stampNs == 0)
+    {
+        stampNs = Clock_nowNs();
+    }
+
+    pthread_mutex_lock(&slot->writeLock);
+
+    unsigned int seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(slot->data, sample, slot->size);
+    slot->stampNs = stampNs;
+    slot->count++;
+
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&slot->writeLock);
+}
+
+
+/*******************************************************************
+* 函数原型:int Bus_read(busSlot_t *slot, void *out, int64_t *stampNs)
+* 函数简介:读取最新样本的快照。读的过程中有新的发布就重读，保证拿到的是同一次发布的数据
+* 函数参数:slot:槽
+* 函数参数:out:输出样本，大小为slot->size，可以为NULL(只取时间戳)
+* 函数参数:stampNs:输出样本的时间戳，没有样本时为0，可以为NULL
+* 函数返回值:成功返回0，还没有样本返回1。
+*****************************************************************/
+int Bus_read(busSlot_t *slot, void *out, int64_t *stampNs)
+{
+    unsigned int begin = 0;
+    unsigned long count = 0;
+    int64_t ts = 0;
+    int spin = 0;
+
+    do
+    {
+        begin = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if(begin & 1)
+        {
+            if(++spin > BUS_READ_SPIN_MAX)
+            {
+                sched_yield();
+            }
+            continue;
+        }
+
+        if(out != NULL)
+        {
+            memcpy(out, slot->data, slot->size);
+        }
+        ts = slot->stampNs;
+        count = slot->count;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    }while((begin & 1) || begin != __atomic_load_n(&slot->seq, __ATOMIC_RELAXED));
+
+    if(stampNs != NULL)
+    {
+        *stampNs = ts;
+    }
+
+    return count == 0 ? 1 : 0;
+}
+
+
+/*******************************************************************
+* 函数原型:long Bus_ageMs(int64_t stampNs)
+* 函数简介:计算样本年龄
+* 函数参数:stampNs:Bus_read输出的时间戳
+* 函数返回值:距现在的毫秒数，还没有样本(时间戳为0)时返回LONG_MAX，超时判断自然不通过。
+*****************************************************************/
+long Bus_ageMs(int64_t stampNs)
+{
+    if(stampNs == 0)
+    {
+        return LONG_MAX;
+    }
+
+    return (long)Clock_sinceMs(stampNs);
+}
@@ -0,0 +1,50 @@
+/************************************************************************************
+					文件名：bus.h
+					描述：传感器最新值总线(seqlock)。每个传感器一个槽，发布者写入带时间戳的样本，
+						  读者随时取一份完整的快照，不加锁、不阻塞发布者
+ ************************************************************************************/
+
+#ifndef __BUS_H__
+#define __BUS_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "../clock/clock.h"
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  最新值槽:seq为偶数时样本稳定，为奇数时发布者正在写  */
+typedef struct
+{
+    unsigned int seq;                   //序号，每次发布加2
+    pthread_mutex_t writeLock;          //多个发布者之间互斥(读者不使用)
+    unsigned long count;                //发布次数，0为还没有样本
+    int64_t stampNs;                    //样本的时间戳(Clock_nowNs)
+    size_t size;                        //样本大小
+    void *data;                         //样本存放位置
+}busSlot_t;
+
+/*  静态定义槽:sample为存放样本的变量(由槽独占，其他代码不要直接访问)   */
+#define BUS_SLOT_INITIALIZER(sample)    {0, PTHREAD_MUTEX_INITIALIZER, 0, 0, sizeof(sample), &(sample)}
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  发布样本(时间戳为0时取当前时间)  */
+void Bus_publish(busSlot_t *slot, const void *sample, int64_t stampNs);
+
+/*  读取最新样本的快照  */
+int Bus_read(busSlot_t *slot, void *out, int64_t *stampNs);
+
+/*  样本年龄    */
+long Bus_ageMs(int64_t stampNs);
+
+#endif
@@ -0,0 +1,142 @@
+/************************************************************************************
+					文件名：clock.c
+					描述：统一时间基准实现
+ ************************************************************************************/
+
+#include "clock.h"
+#include <pthread.h>
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+/*  墙上时间 - 单调时间(纳秒)，启动时记录一次，之后系统校时不影响已有时间戳的换算 */
+static int64_t g_clock_epoch_offset_ns = 0;
+static pthread_once_t g_clock_once = PTHREAD_ONCE_INIT;
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static void Clock_recordOffset(void)
+* 函数简介:记录墙上时间与单调时间的差值。前后各读一次单调时间取中点，减小两次读取之间的误差
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+static void Clock_recordOffset(void)
+{
+    struct timespec wall;
+    int64_t before = Clock_nowNs();
+    clock_gettime(CLOCK_REALTIME, &wall);
+    int64_t after = Clock_nowNs();
+
+    g_clock_epoch_offset_ns = (int64_t)wall.tv_sec * CLOCK_NS_PER_SEC + wall.tv_nsec - (before + (after - before) / 2);
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:void Clock_init(void)
+* 函数简介:记录墙上时间与单调时间的差值，只有第一次调用有效
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Clock_init(void)
+{
+    pthread_once(&g_clock_once, Clock_recordOffset);
+}
+
+/*******************************************************************
+* 函数原型:int64_t Clock_nowNs(void)
+* 函数简介:当前单调时间(纳秒)
+* 函数参数:无
+* 函数返回值:纳秒数
+*****************************************************************/
+int64_t Clock_nowNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * CLOCK_NS_PER_SEC + now.tv_nsec;
+}
+
+/*******************************************************************
+* 函数原型:int64_t Clock_nowUs(void)
+* 函数简介:当前单调时间(微秒)
+* 函数参数:无
+* 函数返回值:微秒数
+*****************************************************************/
+int64_t Clock_nowUs(void)
+{
+    return Clock_nowNs() / CLOCK_NS_PER_US;
+}
+
+/*******************************************************************
+* 函数原型:int64_t Clock_nowMs(void)
+* 函数简介:当前单调时间(毫秒)
+* 函数参数:无
+* 函数返回值:毫秒数
+*****************************************************************/
+int64_t Clock_nowMs(void)
+{
+    return Clock_nowNs() / CLOCK_NS_PER_MS;
+}
+
+/*******************************************************************
+* 函数原型:int64_t Clock_sinceMs(int64_t stampNs)
+* 函数简介:从stampNs到现在经过的毫秒数
+* 函数参数:stampNs:单调时间戳(纳秒)
+* 函数返回值:毫秒数
+*****************************************************************/
+int64_t Clock_sinceMs(int64_t stampNs)
+{
+    return (Clock_nowNs() - stampNs) / CLOCK_NS_PER_MS;
+}
+
+/*******************************************************************
+* 函数原型:int64_t Clock_toEpochNs(int64_t stampNs)
+* 函数简介:单调时间戳换算为墙上时间(自1970年起的纳秒数)
+* 函数参数:stampNs:单调时间戳(纳秒)
+* 函数返回值:墙上时间(纳秒)
+*****************************************************************/
+int64_t Clock_toEpochNs(int64_t stampNs)
+{
+    Clock_init();
+    return stampNs + g_clock_epoch_offset_ns;
+}
+
+/*******************************************************************
+* 函数原型:void Clock_setEpochOffsetNs(int64_t offsetNs)
+* 函数简介:改用给定的墙上时间与单调时间的差值(事后转换记录的数据时，用记录时的差值换算)
+* 函数参数:offsetNs:差值(记录时Clock_toEpochNs(0)的结果)
+* 函数返回值:无
+*****************************************************************/
+void Clock_setEpochOffsetNs(int64_t offsetNs)
+{
+    Clock_init();
+    g_clock_epoch_offset_ns = offsetNs;
+}
+
+/*******************************************************************
+* 函数原型:char *Clock_format(int64_t stampNs, char *buf, size_t size)
+* 函数简介:单调时间戳格式化为本地时间"YYYY-MM-DD HH:MM:SS.mmm"
+* 函数参数:stampNs:单调时间戳(纳秒)
+* 函数参数:buf:输出缓冲区，至少CLOCK_FORMAT_LEN个字节
+* 函数参数:size:缓冲区大小
+* 函数返回值:buf
+*****************************************************************/
+char *Clock_format(int64_t stampNs, char *buf, size_t size)
+{
+    int64_t epochNs = Clock_toEpochNs(stampNs);
+    time_t sec = (time_t)(epochNs / CLOCK_NS_PER_SEC);
+    struct tm tmNow;
+
+    localtime_r(&sec, &tmNow);
+    snprintf(buf, size, "%04d-%02d-%02d %02d:%02d:%02d.%03d", tmNow.tm_year + 1900, tmNow.tm_mon + 1, tmNow.tm_mday,
+             tmNow.tm_hour, tmNow.tm_min, tmNow.tm_sec, (int)(epochNs % CLOCK_NS_PER_SEC / CLOCK_NS_PER_MS));
+
+    return buf;
+}
@@ -0,0 +1,52 @@
+/************************************************************************************
+					文件名：clock.h
+					描述：统一时间基准。所有时间戳、超时判断、耗时统计都用CLOCK_MONOTONIC的纳秒数，
+						  不受系统时间跳变影响；启动时记录一次与墙上时间的差值，用于打印和入库
+ ************************************************************************************/
+
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+#define CLOCK_NS_PER_US     1000LL
+#define CLOCK_NS_PER_MS     1000000LL
+#define CLOCK_NS_PER_SEC    1000000000LL
+
+/*  Clock_format输出的长度("YYYY-MM-DD HH:MM:SS.mmm"加'\0') */
+#define CLOCK_FORMAT_LEN    24
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  初始化:记录墙上时间与单调时间的差值(启动时调用一次，不调用时第一次换算时自动记录)  */
+void Clock_init(void);
+
+/*  当前单调时间    */
+int64_t Clock_nowNs(void);
+int64_t Clock_nowUs(void);
+int64_t Clock_nowMs(void);
+
+/*  从stampNs到现在经过的毫秒数 */
+int64_t Clock_sinceMs(int64_t stampNs);
+
+/*  单调时间换算为墙上时间(自1970年起的纳秒数)  */
+int64_t Clock_toEpochNs(int64_t stampNs);
+
+/*  改用给定的差值换算(转换其他进程记录的时间戳时使用)  */
+void Clock_setEpochOffsetNs(int64_t offsetNs);
+
+/*  单调时间格式化为本地时间"YYYY-MM-DD HH:MM:SS.mmm"  */
+char *Clock_format(int64_t stampNs, char *buf, size_t size);
+
+#endif
@@ -149,3 +149,125 @@ void epoll_manager_cleanup(int epoll_fd)
         epoll_fd = -1;
     }
 }
+
+/*******************************************************************
+* 函数原型:int epoll_manager_add_handler(int epoll_fd, epollHandler_t *handler, uint32_t events)
+* 函数简介:将处理器注册到指定的epoll管理器，处理器指针存放在epoll_event.data.ptr中
+* 函数参数:epoll_fd:epoll管理器
+* 函数参数:handler:处理器对象(fd和handler必须已填好，生命周期需覆盖整个注册期间)
+* 函数参数:events 要监控的事件(EPOLLIN、EPOLLONESHOT等)
+* 函数返回值:成功0，失败返回-1。
+*****************************************************************/
+int epoll_manager_add_handler(int epoll_fd, epollHandler_t *handler, uint32_t events)
+{
+    if(epoll_fd < 0 || handler == NULL || handler->fd < 0 || handler->handler == NULL)
+    {
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = handler;
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, handler->fd, &ev) == -1)
+    {
+        printf("epoll_manager_add_handler:添加处理器 %s(fd %d) 到Epoll管理器 %d 失败\n", handler->name, handler->fd, epoll_fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int epoll_manager_mod_handler(int epoll_fd, epollHandler_t *handler, uint32_t events)
+* 函数简介:修改处理器监控的事件，EPOLLONESHOT方式下也用于重新使能
+* 函数参数:epoll_fd:epoll管理器
+* 函数参数:handler:已注册的处理器对象
+* 函数参数:events 新的事件
+* 函数返回值:成功0，失败返回-1。
+*****************************************************************/
+int epoll_manager_mod_handler(int epoll_fd, epollHandler_t *handler, uint32_t events)
+{
+    if(epoll_fd < 0 || handler == NULL || handler->fd < 0)
+    {
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = handler;
+
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_MOD, handler->fd, &ev) == -1)
+    {
+        printf("epoll_manager_mod_handler:Epoll管理器 %d 中的处理器 %s(fd %d) 修改监控事件失败\n", epoll_fd, handler->name, handler->fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int epoll_manager_del_handler(int epoll_fd, epollHandler_t *handler)
+* 函数简介:从epoll监控中移除处理器
+* 函数参数:epoll_fd:epoll管理器
+* 函数参数:handler:已注册的处理器对象
+* 函数返回值:成功0，失败返回-1。
+*****************************************************************/
+int epoll_manager_del_handler(int epoll_fd, epollHandler_t *handler)
+{
+    if(handler == NULL)
+    {
+        return -1;
+    }
+
+    return epoll_manager_del_fd(epoll_fd, handler->fd);
+}
+
+/*******************************************************************
+* 函数原型:int epoll_manager_dispatch(int epoll_fd, struct epoll_event *events, int maxevents, int timeout)
+* 函数简介:等待事件发生，并直接调用data.ptr中处理器的回调，同时记录分发统计
+* 函数参数:epoll_fd:epoll管理器
+* 函数参数:events 事件缓存
+* 函数参数:maxevents 最多返回的事件数
+* 函数参数:timeout 超时时间(毫秒)，-1表示阻塞
+* 函数返回值:成功返回已分发的事件数，失败返回-1。
+*****************************************************************/
+int epoll_manager_dispatch(int epoll_fd, struct epoll_event *events, int maxevents, int timeout)
+{
+    int nfds = epoll_manager_wait(epoll_fd, events, maxevents, timeout);
+    if(nfds <= 0)
+    {
+        return nfds;
+    }
+
+    for(int i = 0; i < nfds; i++)
+    {
+        epollHandler_t *handler = (epollHandler_t *)events[i].data.ptr;
+        if(handler == NULL || handler->handler == NULL)
+        {
+            continue;
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        handler->handler(handler, events[i].events);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        unsigned long cost = (end.tv_sec - start.tv_sec) * 1000000UL + (end.tv_nsec - start.tv_nsec) / 1000;
+
+        handler->stats.dispatchCount++;
+        /*  挂断、错误事件由回调处理(移出监听等)，否则会在每次等待时立即返回，这里只计数    */
+        if(events[i].events & (EPOLLERR | EPOLLHUP))
+        {
+            handler->stats.errorCount++;
+        }
+        handler->stats.lastCostUs = cost;
+        if(cost > handler->stats.maxCostUs)
+        {
+            handler->stats.maxCostUs = cost;
+        }
+    }
+
+    return nfds;
+}
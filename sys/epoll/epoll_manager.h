@@ -8,9 +8,39 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/epoll.h>
 
 
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+struct epoll_handler;
+
+/*  fd就绪回调:handler为注册时的处理器对象，events为epoll返回的事件  */
+typedef void (*epoll_handler_fn)(struct epoll_handler *handler, uint32_t events);
+
+/*  处理器统计信息  */
+typedef struct
+{
+    unsigned long dispatchCount;        //分发次数
+    unsigned long errorCount;           //EPOLLERR/EPOLLHUP次数
+    unsigned long lastCostUs;           //最近一次回调耗时(微秒)
+    unsigned long maxCostUs;            //最长回调耗时(微秒)
+}epollHandlerStats_t;
+
+/*  fd处理器，注册后存放在epoll_event.data.ptr中，就绪时直接回调，无需逐个比较fd  */
+typedef struct epoll_handler
+{
+    int fd;                             //监听的文件描述符
+    const char *name;                   //处理器名称(打印用)
+    epoll_handler_fn handler;           //就绪回调
+    void *context;                      //回调上下文
+    epollHandlerStats_t stats;          //统计信息
+}epollHandler_t;
+
+
 /************************************************************************************
  									函数原型
 *************************************************************************************/
@@ -21,5 +51,11 @@ int epoll_manager_del_fd(int epoll_fd, int fd);
 int epoll_manager_wait(int epoll_fd, struct epoll_event *events, int maxevents, int timeout);
 void epoll_manager_cleanup(int epoll_fd);
 
+/*  处理器方式:注册时存入data.ptr，由epoll_manager_dispatch直接回调。同一个epoll管理器中不要和add_fd混用  */
+int epoll_manager_add_handler(int epoll_fd, epollHandler_t *handler, uint32_t events);
+int epoll_manager_mod_handler(int epoll_fd, epollHandler_t *handler, uint32_t events);
+int epoll_manager_del_handler(int epoll_fd, epollHandler_t *handler);
+int epoll_manager_dispatch(int epoll_fd, struct epoll_event *events, int maxevents, int timeout);
+
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,315 @@
+/************************************************************************************
+					文件名：latency.c
+					描述：链路延时统计实现
+ ************************************************************************************/
+
+#include "latency.h"
+#include <string.h>
+#include <unistd.h>
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  每段的直方图，所有字段用原子操作更新，记录时不加锁    */
+typedef struct
+{
+    unsigned long long sumUs;
+    long maxUs;
+    unsigned long buckets[LATENCY_BUCKET_NUM];
+}latencyHist_t;
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+static latencyHist_t g_latency_hist[LATENCY_STAGE_NUM];
+
+static const char *g_latency_stage_name[LATENCY_STAGE_NUM] = {
+    "Epoll唤醒->线程处理",
+    "开始处理->完整帧",
+    "完整帧->解析发布",
+    "TCP上传",
+    "SQLite入库",
+    "完整帧->定深控制",
+    "推进器指令排队",
+    "推进器写出->应答",
+    "完整帧->推进器应答"
+};
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static int Latency_bucketOf(int64_t us)
+* 函数简介:耗时所在的桶
+* 函数参数:us:耗时(微秒)
+* 函数返回值:桶下标
+*****************************************************************/
+static int Latency_bucketOf(int64_t us)
+{
+    if(us <= 0)
+    {
+        return 0;
+    }
+
+    int bucket = 64 - __builtin_clzll((unsigned long long)us);
+    return bucket < LATENCY_BUCKET_NUM ? bucket : LATENCY_BUCKET_NUM - 1;
+}
+
+/*******************************************************************
+* 函数原型:static long Latency_percentile(const latencyStats_t *stats, int percent)
+* 函数简介:由直方图估算百分位
+* 函数参数:stats:统计
+* 函数参数:percent:百分位(1~100)
+* 函数返回值:所在桶的上界(微秒)，最后一桶取最长耗时
+*****************************************************************/
+static long Latency_percentile(const latencyStats_t *stats, int percent)
+{
+    unsigned long target = (stats->count * percent + 99) / 100;
+    unsigned long seen = 0;
+
+    for(int i = 0; i < LATENCY_BUCKET_NUM; i++)
+    {
+        seen += stats->buckets[i];
+        if(seen >= target && seen > 0)
+        {
+            long upper = (i == LATENCY_BUCKET_NUM - 1) ? stats->maxUs : (1L << i);
+            return upper < stats->maxUs ? upper : stats->maxUs;
+        }
+    }
+
+    return stats->maxUs;
+}
+
+/*******************************************************************
+* 函数原型:static void Latency_fprint(FILE *fp, int withBuckets)
+* 函数简介:输出所有段的统计
+* 函数参数:fp:输出文件
+* 函数参数:withBuckets:1为同时输出每个桶的计数
+* 函数返回值:无
+*****************************************************************/
+static void Latency_fprint(FILE *fp, int withBuckets)
+{
+    latencyStats_t stats;
+
+    fprintf(fp, "%-24s %10s %10s %10s %10s %10s %10s\n", "链路延时(us)", "次数", "平均", "P50", "P90", "P99", "最长");
+    for(int i = 0; i < LATENCY_STAGE_NUM; i++)
+    {
+        Latency_getStats((latencyStage_t)i, &stats);
+        fprintf(fp, "%-24s %10lu %10llu %10ld %10ld %10ld %10ld\n", g_latency_stage_name[i], stats.count,
+                stats.count ? stats.sumUs / stats.count : 0, stats.p50Us, stats.p90Us, stats.p99Us, stats.maxUs);
+        if(!withBuckets || stats.count == 0)
+        {
+            continue;
+        }
+        for(int b = 0; b < LATENCY_BUCKET_NUM; b++)
+        {
+            if(stats.buckets[b] != 0)
+            {
+                fprintf(fp, "    <%-10ld %lu\n", 1L << b, stats.buckets[b]);
+            }
+        }
+    }
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:void Latency_record(latencyStage_t stage, int64_t us)
+* 函数简介:记录一段耗时
+* 函数参数:stage:段
+* 函数参数:us:耗时(微秒)，负数(时间点顺序不对)时不记录
+* 函数返回值:无
+*****************************************************************/
+void Latency_record(latencyStage_t stage, int64_t us)
+{
+    if(stage < 0 || stage >= LATENCY_STAGE_NUM || us < 0)
+    {
+        return;
+    }
+
+    latencyHist_t *hist = &g_latency_hist[stage];
+    long maxUs = __atomic_load_n(&hist->maxUs, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&hist->buckets[Latency_bucketOf(us)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sumUs, (unsigned long long)us, __ATOMIC_RELAXED);
+    while(us > maxUs && !__atomic_compare_exchange_n(&hist->maxUs, &maxUs, (long)us, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+/*******************************************************************
+* 函数原型:void Latency_recordSince(latencyStage_t stage, int64_t startNs)
+* 函数简介:记录从startNs到现在的耗时
+* 函数参数:stage:段
+* 函数参数:startNs:起点(Clock_nowNs)，为0时不记录
+* 函数返回值:无
+*****************************************************************/
+void Latency_recordSince(latencyStage_t stage, int64_t startNs)
+{
+    if(startNs != 0)
+    {
+        Latency_record(stage, (Clock_nowNs() - startNs) / CLOCK_NS_PER_US);
+    }
+}
+
+/*******************************************************************
+* 函数原型:void Latency_traceMark(latencyTrace_t *trace, latencyPoint_t point, int64_t stampNs)
+* 函数简介:样本经过某个时间点
+* 函数参数:trace:样本的时间点
+* 函数参数:point:时间点
+* 函数参数:stampNs:时间(Clock_nowNs)，为0时取当前时间
+* 函数返回值:无
+*****************************************************************/
+void Latency_traceMark(latencyTrace_t *trace, latencyPoint_t point, int64_t stampNs)
+{
+    if(point < 0 || point >= LATENCY_POINT_NUM)
+    {
+        return;
+    }
+
+    trace->stampNs[point] = stampNs != 0 ? stampNs : Clock_nowNs();
+}
+
+/*******************************************************************
+* 函数原型:void Latency_traceCommit(const latencyTrace_t *trace)
+* 函数简介:样本处理完后把相邻时间点之差记入对应的段，缺少的点不记录
+* 函数参数:trace:样本的时间点
+* 函数返回值:无
+*****************************************************************/
+void Latency_traceCommit(const latencyTrace_t *trace)
+{
+    for(int i = 1; i < LATENCY_POINT_NUM; i++)
+    {
+        if(trace->stampNs[i - 1] != 0 && trace->stampNs[i] != 0)
+        {
+            Latency_record((latencyStage_t)(LATENCY_STAGE_HANDOFF + i - 1), (trace->stampNs[i] - trace->stampNs[i - 1]) / CLOCK_NS_PER_US);
+        }
+    }
+}
+
+/*******************************************************************
+* 函数原型:int Latency_getStats(latencyStage_t stage, latencyStats_t *stats)
+* 函数简介:获取某一段的统计(各字段分别读取，和记录同时进行时可能差一两次)
+* 函数参数:stage:段
+* 函数参数:stats:输出统计
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Latency_getStats(latencyStage_t stage, latencyStats_t *stats)
+{
+    if(stage < 0 || stage >= LATENCY_STAGE_NUM || stats == NULL)
+    {
+        return -1;
+    }
+
+    latencyHist_t *hist = &g_latency_hist[stage];
+
+    memset(stats, 0, sizeof(*stats));
+    for(int i = 0; i < LATENCY_BUCKET_NUM; i++)
+    {
+        stats->buckets[i] = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        stats->count += stats->buckets[i];
+    }
+    stats->sumUs = __atomic_load_n(&hist->sumUs, __ATOMIC_RELAXED);
+    stats->maxUs = __atomic_load_n(&hist->maxUs, __ATOMIC_RELAXED);
+    stats->p50Us = Latency_percentile(stats, 50);
+    stats->p90Us = Latency_percentile(stats, 90);
+    stats->p99Us = Latency_percentile(stats, 99);
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:const char *Latency_stageName(latencyStage_t stage)
+* 函数简介:段的名称
+* 函数参数:stage:段
+* 函数返回值:名称
+*****************************************************************/
+const char *Latency_stageName(latencyStage_t stage)
+{
+    if(stage < 0 || stage >= LATENCY_STAGE_NUM)
+    {
+        return "?";
+    }
+
+    return g_latency_stage_name[stage];
+}
+
+/*******************************************************************
+* 函数原型:void Latency_reset(void)
+* 函数简介:清零所有统计
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Latency_reset(void)
+{
+    for(int i = 0; i < LATENCY_STAGE_NUM; i++)
+    {
+        latencyHist_t *hist = &g_latency_hist[i];
+
+        for(int b = 0; b < LATENCY_BUCKET_NUM; b++)
+        {
+            __atomic_store_n(&hist->buckets[b], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&hist->sumUs, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&hist->maxUs, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/*******************************************************************
+* 函数原型:void Latency_Print(void)
+* 函数简介:打印所有段的统计
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Latency_Print(void)
+{
+    Latency_fprint(stdout, 0);
+}
+
+/*******************************************************************
+* 函数原型:int Latency_Dump(const char *path)
+* 函数简介:把所有段的统计和直方图写入文件(覆盖)。文件第一次打开后一直保持打开，
+*          之后每次清空重写，定期导出时不再有打开文件的堆分配
+* 函数参数:path:文件路径(只在主线程中定期调用，路径不变)
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Latency_Dump(const char *path)
+{
+    static FILE *fp = NULL;
+    static char openedPath[256];
+    char timeStr[CLOCK_FORMAT_LEN];
+
+    if(fp != NULL && strcmp(openedPath, path) != 0)
+    {
+        fclose(fp);
+        fp = NULL;
+    }
+    if(fp == NULL)
+    {
+        if((fp = fopen(path, "w")) == NULL)
+        {
+            perror("Latency_Dump:fopen");
+            return -1;
+        }
+        snprintf(openedPath, sizeof(openedPath), "%s", path);
+    }
+    else
+    {
+        rewind(fp);
+        if(ftruncate(fileno(fp), 0) < 0)
+        {
+            perror("Latency_Dump:ftruncate");
+        }
+    }
+
+    fprintf(fp, "# %s\n", Clock_format(Clock_nowNs(), timeStr, sizeof(timeStr)));
+    Latency_fprint(fp, 1);
+    fflush(fp);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/************************************************************************************
+					文件名：latency.h
+					描述：链路延时统计。深度样本从Epoll唤醒到推进器指令写出的每一段耗时
+						  记入按2的幂分桶(微秒)的直方图，运行中可查询，也可以导出到文件
+ ************************************************************************************/
+
+#ifndef __LATENCY_H__
+#define __LATENCY_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include "../clock/clock.h"
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  直方图桶数:第0桶为0~1us，第i桶为[2^(i-1), 2^i)us，最后一桶收容所有更大的值(>=8.4s)    */
+#define LATENCY_BUCKET_NUM      24
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  链路上的各段    */
+typedef enum
+{
+    LATENCY_STAGE_HANDOFF = 0,          //Epoll唤醒 -> 工作线程开始处理(条件变量交接)
+    LATENCY_STAGE_READ,                 //开始处理 -> 读到完整帧
+    LATENCY_STAGE_PARSE,                //读到完整帧 -> 解析完并发布到总线
+    LATENCY_STAGE_SEND,                 //TCP上传
+    LATENCY_STAGE_DB,                   //SQLite入库
+    LATENCY_STAGE_CONTROL,              //读到完整帧 -> 定深控制器使用该样本
+    LATENCY_STAGE_QUEUE,                //控制器提交推进器指令 -> 总线线程取走
+    LATENCY_STAGE_WRITE,                //推进器指令写出 -> 收到应答
+    LATENCY_STAGE_TOTAL,                //读到完整帧 -> 推进器应答(端到端)
+    LATENCY_STAGE_NUM
+}latencyStage_t;
+
+/*  采集端随样本携带的时间点，相邻两点之差对应LATENCY_STAGE_HANDOFF ~ LATENCY_STAGE_DB    */
+typedef enum
+{
+    LATENCY_POINT_WAKE = 0,             //Epoll唤醒
+    LATENCY_POINT_START,                //工作线程开始处理
+    LATENCY_POINT_FRAME,                //读到完整帧(串口read的时间)
+    LATENCY_POINT_PARSED,               //解析完并发布
+    LATENCY_POINT_SENT,                 //TCP上传完
+    LATENCY_POINT_STORED,               //入库完
+    LATENCY_POINT_NUM
+}latencyPoint_t;
+
+/*  一个样本的时间点(Clock_nowNs)，0为没有经过该点  */
+typedef struct
+{
+    int64_t stampNs[LATENCY_POINT_NUM];
+}latencyTrace_t;
+
+/*  某一段的统计(百分位取所在桶的上界)   */
+typedef struct
+{
+    unsigned long count;                //样本数
+    unsigned long long sumUs;           //累计耗时(微秒)
+    long maxUs;                         //最长耗时(微秒)
+    long p50Us;                         //中位数上界(微秒)
+    long p90Us;
+    long p99Us;
+    unsigned long buckets[LATENCY_BUCKET_NUM];
+}latencyStats_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  记录一段耗时(任意线程可调用，不加锁)  */
+void Latency_record(latencyStage_t stage, int64_t us);
+void Latency_recordSince(latencyStage_t stage, int64_t startNs);
+
+/*  采集端时间点:打点，样本处理完后提交    */
+void Latency_traceMark(latencyTrace_t *trace, latencyPoint_t point, int64_t stampNs);
+void Latency_traceCommit(const latencyTrace_t *trace);
+
+/*  查询、清零  */
+int Latency_getStats(latencyStage_t stage, latencyStats_t *stats);
+const char *Latency_stageName(latencyStage_t stage);
+void Latency_reset(void);
+
+/*  打印、导出到文件    */
+void Latency_Print(void);
+int Latency_Dump(const char *path);
+
+#endif
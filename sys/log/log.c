@@ -0,0 +1,430 @@
+/************************************************************************************
+					文件名：log.c
+					描述：异步分级日志实现
+ ************************************************************************************/
+
+#include "log.h"
+#include "../ring/ring.h"
+#include "../procstat/procstat.h"
+#include "../rt/rt.h"
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  队列空时后台线程的休眠时间(毫秒)，日志最多晚这么久输出    */
+#define LOG_IDLE_SLEEP_MS       10
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  队列中的一条日志    */
+typedef struct
+{
+    int64_t stampNs;
+    unsigned char level;
+    unsigned char module;
+    char msg[LOG_MSG_LEN];
+}logRecord_t;
+
+/*  每个模块的限速状态(按秒计数)    */
+typedef struct
+{
+    int64_t second;                     //当前计数的秒
+    unsigned int count;                 //这一秒已经记录的条数
+    unsigned long suppressed;           //被限速丢弃、还没有报告的条数
+}logRate_t;
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+static const char *g_log_module_name[LOG_MOD_NUM] = {
+    "main", "thruster", "depth", "altitude", "nav", "mission", "ctd", "dvl",
+    "gps", "usbl", "sonar", "dtu", "maincabin", "host", "db"
+};
+static const char *g_log_level_name[] = {"off", "error", "warn", "info", "debug"};
+static const char g_log_level_tag[] = {'-', 'E', 'W', 'I', 'D'};
+
+/*  各模块的级别(默认info)  */
+static volatile unsigned char g_log_level[LOG_MOD_NUM] = {
+    [0 ... LOG_MOD_NUM - 1] = LOG_LEVEL_INFO
+};
+
+static logRate_t g_log_rate[LOG_MOD_NUM];
+static logStats_t g_log_stats = {0};
+
+/*  队列与后台线程  */
+static ringQueue_t g_log_queue;
+static volatile int g_log_running = 0;
+static pthread_t g_log_tid;
+static FILE *g_log_fp = NULL;
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static void Log_output(FILE *fp, const logRecord_t *rec)
+* 函数简介:输出一条日志:"HH:MM:SS.mmm 级别 [模块] 内容"
+* 函数参数:fp:输出文件
+* 函数参数:rec:日志
+* 函数返回值:无
+*****************************************************************/
+static void Log_output(FILE *fp, const logRecord_t *rec)
+{
+    char timeStr[CLOCK_FORMAT_LEN];
+
+    Clock_format(rec->stampNs, timeStr, sizeof(timeStr));
+    fprintf(fp, "%s %c [%s] %s\n", timeStr + 11, g_log_level_tag[rec->level], g_log_module_name[rec->module], rec->msg);
+    __atomic_fetch_add(&g_log_stats.written, 1, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************
+* 函数原型:static void Log_submit(const logRecord_t *rec)
+* 函数简介:日志入队，后台线程没有运行时直接输出
+* 函数参数:rec:日志
+* 函数返回值:无
+*****************************************************************/
+static void Log_submit(const logRecord_t *rec)
+{
+    if(!g_log_running)
+    {
+        Log_output(stdout, rec);
+        return;
+    }
+
+    if(Ring_push(&g_log_queue, rec) < 0)
+    {
+        __atomic_fetch_add(&g_log_stats.dropped, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*******************************************************************
+* 函数原型:static int Log_rateAllow(logModule_t module, unsigned long *suppressed)
+* 函数简介:按模块限速，每秒最多LOG_RATE_PER_SEC条
+* 函数参数:module:模块
+* 函数参数:suppressed:进入新的一秒时输出上一段时间被丢弃的条数，否则为0
+* 函数返回值:允许记录返回1，丢弃返回0
+*****************************************************************/
+static int Log_rateAllow(logModule_t module, unsigned long *suppressed)
+{
+    logRate_t *rate = &g_log_rate[module];
+    int64_t second = Clock_nowMs() / 1000;
+    int64_t last = __atomic_load_n(&rate->second, __ATOMIC_RELAXED);
+
+    *suppressed = 0;
+    if(second != last && __atomic_compare_exchange_n(&rate->second, &last, second, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&rate->count, 0, __ATOMIC_RELAXED);
+        *suppressed = __atomic_exchange_n(&rate->suppressed, 0, __ATOMIC_RELAXED);
+    }
+
+    if(__atomic_fetch_add(&rate->count, 1, __ATOMIC_RELAXED) < LOG_RATE_PER_SEC)
+    {
+        return 1;
+    }
+
+    __atomic_fetch_add(&rate->suppressed, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_log_stats.limited, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:static void *Log_WriterThread(void *arg)
+* 函数简介:后台输出线程，把队列中的日志写到终端或文件；停止时写完剩下的再退出
+* 函数参数:arg:参数
+* 函数返回值:无
+*****************************************************************/
+static void *Log_WriterThread(void *arg)
+{
+    (void)arg;
+    logRecord_t rec;
+    struct timespec idle = {0, LOG_IDLE_SLEEP_MS * 1000000L};
+
+    Rt_enterThread(RT_ROLE_BACKGROUND);
+
+    for(;;)
+    {
+        if(Ring_pop(&g_log_queue, &rec) == 0)
+        {
+            Log_output(g_log_fp, &rec);
+            continue;
+        }
+
+        fflush(g_log_fp);
+        if(!g_log_running)
+        {
+            break;
+        }
+        nanosleep(&idle, NULL);
+    }
+
+    return NULL;
+}
+
+/*******************************************************************
+* 函数原型:static int Log_parseLevel(const char *str, size_t len)
+* 函数简介:解析级别名
+* 函数参数:str:级别名(off/error/warn/info/debug)
+* 函数参数:len:长度
+* 函数返回值:级别，无法识别返回-1
+*****************************************************************/
+static int Log_parseLevel(const char *str, size_t len)
+{
+    for(int i = 0; i <= LOG_LEVEL_DEBUG; i++)
+    {
+        if(strlen(g_log_level_name[i]) == len && strncasecmp(str, g_log_level_name[i], len) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:int Log_Init(const char *path)
+* 函数简介:创建队列并启动后台输出线程
+* 函数参数:path:日志文件(追加写)，为NULL时输出到终端
+* 函数返回值:成功返回0，失败返回-1(之后的日志直接输出到终端)
+*****************************************************************/
+int Log_Init(const char *path)
+{
+    if(g_log_running)
+    {
+        return 0;
+    }
+
+    g_log_fp = stdout;
+    if(path != NULL && (g_log_fp = fopen(path, "a")) == NULL)
+    {
+        perror("Log_Init:fopen");
+        g_log_fp = stdout;
+        return -1;
+    }
+
+    if(Ring_init(&g_log_queue, LOG_QUEUE_SIZE, sizeof(logRecord_t)) < 0)
+    {
+        return -1;
+    }
+
+    g_log_running = 1;
+    if(pthread_create(&g_log_tid, NULL, Log_WriterThread, NULL) != 0)
+    {
+        printf("Log_Init:日志线程创建错误\n");
+        g_log_running = 0;
+        Ring_destroy(&g_log_queue);
+        return -1;
+    }
+    ProcStat_setThreadName(g_log_tid, "log");
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:void Log_Shutdown(void)
+* 函数简介:停止后台线程，队列中剩下的日志写完后返回
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Log_Shutdown(void)
+{
+    if(!g_log_running)
+    {
+        return;
+    }
+
+    g_log_running = 0;
+    pthread_join(g_log_tid, NULL);
+
+    /*  停止前最后一刻入队的日志    */
+    logRecord_t rec;
+    while(Ring_pop(&g_log_queue, &rec) == 0)
+    {
+        Log_output(g_log_fp, &rec);
+    }
+    fflush(g_log_fp);
+    if(g_log_fp != stdout)
+    {
+        fclose(g_log_fp);
+    }
+    g_log_fp = NULL;
+}
+
+/*******************************************************************
+* 函数原型:void Log_setLevel(logModule_t module, logLevel_t level)
+* 函数简介:设置模块的级别
+* 函数参数:module:模块
+* 函数参数:level:级别，低于该级别的日志不记录
+* 函数返回值:无
+*****************************************************************/
+void Log_setLevel(logModule_t module, logLevel_t level)
+{
+    if(module >= 0 && module < LOG_MOD_NUM)
+    {
+        g_log_level[module] = level;
+    }
+}
+
+/*******************************************************************
+* 函数原型:void Log_setAllLevels(logLevel_t level)
+* 函数简介:设置所有模块的级别
+* 函数参数:level:级别
+* 函数返回值:无
+*****************************************************************/
+void Log_setAllLevels(logLevel_t level)
+{
+    for(int i = 0; i < LOG_MOD_NUM; i++)
+    {
+        g_log_level[i] = level;
+    }
+}
+
+/*******************************************************************
+* 函数原型:int Log_setFilter(const char *spec)
+* 函数简介:按配置设置级别，如"warn,nav=debug,thruster=info":
+*          不带模块名的项设置所有模块，之后的项覆盖单个模块
+* 函数参数:spec:配置
+* 函数返回值:成功返回0，有无法识别的项返回-1(其余项照常生效)
+*****************************************************************/
+int Log_setFilter(const char *spec)
+{
+    int ret = 0;
+    const char *p = spec;
+
+    while(p != NULL && *p != '\0')
+    {
+        size_t len = strcspn(p, ",");
+        const char *eq = memchr(p, '=', len);
+        int level;
+        int bad = 0;
+
+        if(eq == NULL)
+        {
+            if((level = Log_parseLevel(p, len)) < 0)
+            {
+                bad = 1;
+            }
+            else
+            {
+                Log_setAllLevels((logLevel_t)level);
+            }
+        }
+        else
+        {
+            int module = -1;
+            for(int i = 0; i < LOG_MOD_NUM; i++)
+            {
+                if(strlen(g_log_module_name[i]) == (size_t)(eq - p) && strncasecmp(p, g_log_module_name[i], eq - p) == 0)
+                {
+                    module = i;
+                    break;
+                }
+            }
+            if(module < 0 || (level = Log_parseLevel(eq + 1, len - (eq - p) - 1)) < 0)
+            {
+                bad = 1;
+            }
+            else
+            {
+                Log_setLevel((logModule_t)module, (logLevel_t)level);
+            }
+        }
+
+        if(bad)
+        {
+            printf("Log_setFilter:无法识别的配置 %.*s\n", (int)len, p);
+            ret = -1;
+        }
+        p += len;
+        if(*p == ',')
+        {
+            p++;
+        }
+    }
+
+    return ret;
+}
+
+/*******************************************************************
+* 函数原型:int Log_enabled(logModule_t module, logLevel_t level)
+* 函数简介:该级别的日志是否会被记录(日志内容需要额外计算时先判断)
+* 函数参数:module:模块
+* 函数参数:level:级别
+* 函数返回值:记录返回1，否则返回0
+*****************************************************************/
+int Log_enabled(logModule_t module, logLevel_t level)
+{
+    return module >= 0 && module < LOG_MOD_NUM && level != LOG_LEVEL_OFF && level <= g_log_level[module];
+}
+
+/*******************************************************************
+* 函数原型:void Log_write(logModule_t module, logLevel_t level, const char *fmt, ...)
+* 函数简介:记录一条日志。调用线程只做格式化和入队，末尾的换行会被去掉
+* 函数参数:module:模块
+* 函数参数:level:级别
+* 函数参数:fmt:格式，同printf
+* 函数返回值:无
+*****************************************************************/
+void Log_write(logModule_t module, logLevel_t level, const char *fmt, ...)
+{
+    unsigned long suppressed;
+    logRecord_t rec;
+    va_list ap;
+
+    if(!Log_enabled(module, level) || !Log_rateAllow(module, &suppressed))
+    {
+        return;
+    }
+
+    rec.stampNs = Clock_nowNs();
+    rec.module = (unsigned char)module;
+
+    if(suppressed != 0)
+    {
+        rec.level = LOG_LEVEL_WARN;
+        snprintf(rec.msg, sizeof(rec.msg), "限速丢弃%lu条", suppressed);
+        Log_submit(&rec);
+    }
+
+    rec.level = (unsigned char)level;
+    va_start(ap, fmt);
+    int len = vsnprintf(rec.msg, sizeof(rec.msg), fmt, ap);
+    va_end(ap);
+
+    if(len > (int)sizeof(rec.msg) - 1)
+    {
+        len = sizeof(rec.msg) - 1;
+    }
+    while(len > 0 && rec.msg[len - 1] == '\n')
+    {
+        rec.msg[--len] = '\0';
+    }
+
+    Log_submit(&rec);
+}
+
+/*******************************************************************
+* 函数原型:void Log_getStats(logStats_t *stats)
+* 函数简介:获取统计
+* 函数参数:stats:输出统计
+* 函数返回值:无
+*****************************************************************/
+void Log_getStats(logStats_t *stats)
+{
+    stats->written = __atomic_load_n(&g_log_stats.written, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&g_log_stats.dropped, __ATOMIC_RELAXED);
+    stats->limited = __atomic_load_n(&g_log_stats.limited, __ATOMIC_RELAXED);
+    stats->queued = Ring_count(&g_log_queue);
+}
@@ -0,0 +1,112 @@
+/************************************************************************************
+					文件名：log.h
+					描述：异步分级日志。调用线程只格式化一条记录放入无锁队列，由后台线程
+						  写到终端或文件，串口终端再慢也不会卡住和硬件通信的线程；
+						  支持按模块设置级别和按模块限速，队列满时丢弃并计数
+ ************************************************************************************/
+
+#ifndef __LOG_H__
+#define __LOG_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include "../clock/clock.h"
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  单条日志最大长度(超出截断)  */
+#define LOG_MSG_LEN             200
+
+/*  队列容量(2的幂)  */
+#define LOG_QUEUE_SIZE          1024
+
+/*  每个模块每秒最多输出的条数，超出的丢弃，下一秒补一条"限速丢弃N条"  */
+#define LOG_RATE_PER_SEC        50
+
+/*  记录日志，级别低于模块设定时不格式化、不入队  */
+#define LOG_E(module, ...)      Log_write(module, LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_W(module, ...)      Log_write(module, LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_I(module, ...)      Log_write(module, LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_D(module, ...)      Log_write(module, LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/*  同一调用点每intervalMs毫秒最多记录一次(控制循环中的周期性打印)  */
+#define LOG_EVERY_MS(intervalMs, module, level, ...)                            \
+    do {                                                                        \
+        static int64_t _logNextMs = 0;                                          \
+        int64_t _logNowMs = Clock_nowMs();                                      \
+        if(_logNowMs >= _logNextMs) {                                           \
+            _logNextMs = _logNowMs + (intervalMs);                              \
+            Log_write(module, level, __VA_ARGS__);                              \
+        }                                                                       \
+    } while(0)
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  级别    */
+typedef enum
+{
+    LOG_LEVEL_OFF = 0,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+}logLevel_t;
+
+/*  模块    */
+typedef enum
+{
+    LOG_MOD_MAIN = 0,
+    LOG_MOD_THRUSTER,
+    LOG_MOD_DEPTH,
+    LOG_MOD_ALTITUDE,
+    LOG_MOD_NAV,
+    LOG_MOD_MISSION,
+    LOG_MOD_CTD,
+    LOG_MOD_DVL,
+    LOG_MOD_GPS,
+    LOG_MOD_USBL,
+    LOG_MOD_SONAR,
+    LOG_MOD_DTU,
+    LOG_MOD_MAINCABIN,
+    LOG_MOD_HOST,
+    LOG_MOD_DB,
+    LOG_MOD_NUM
+}logModule_t;
+
+/*  统计    */
+typedef struct
+{
+    unsigned long written;              //已输出
+    unsigned long dropped;              //队列满丢弃
+    unsigned long limited;              //限速丢弃
+    unsigned long queued;               //队列中等待输出的条数
+}logStats_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  启动后台输出线程(path为NULL时输出到终端)，停止时先写完队列中的日志 */
+int Log_Init(const char *path);
+void Log_Shutdown(void);
+
+/*  级别过滤:单个模块、全部模块，或解析"info,nav=debug,thruster=warn"这样的配置   */
+void Log_setLevel(logModule_t module, logLevel_t level);
+void Log_setAllLevels(logLevel_t level);
+int Log_setFilter(const char *spec);
+int Log_enabled(logModule_t module, logLevel_t level);
+
+/*  记录一条日志    */
+void Log_write(logModule_t module, logLevel_t level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+/*  统计    */
+void Log_getStats(logStats_t *stats);
+
+#endif
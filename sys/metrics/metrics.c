@@ -0,0 +1,860 @@
+/************************************************************************************
+					文件名：metrics.c
+					描述：运行指标实现
+ ************************************************************************************/
+
+#include "metrics.h"
+#include "../latency/latency.h"
+#include "../socket/TCP/tcp.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/un.h>
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  耗时直方图，所有字段用原子操作更新，记录时不加锁    */
+typedef struct
+{
+    unsigned long count;
+    unsigned long long sumUs;
+    unsigned long buckets[METRICS_BUCKET_NUM];
+}metricsHist_t;
+
+/*  登记的瞬时值    */
+typedef struct
+{
+    const char *name;
+    const char *help;
+    metricsGauge_fn read;
+}metricsGauge_t;
+
+/*  一个连接:收齐请求头(HTTP)后把回复渲染到连接自己的缓冲区，对端可写时发出，发完关闭   */
+typedef struct
+{
+    epollHandler_t handler;
+    int64_t acceptMs;                   //接受连接的时间(Clock_nowMs)，超时未收齐请求头或未发完回复则关闭
+    size_t len;
+    char request[METRICS_REQUEST_SIZE];
+    size_t sendOff;                     //回复在response中待发送的起止位置，sendEnd为0表示还在接收请求
+    size_t sendEnd;
+    char response[METRICS_HEADER_SIZE + METRICS_BODY_SIZE];
+}metricsClient_t;
+
+/*  输出缓冲区  */
+typedef struct
+{
+    char *buf;
+    size_t size;
+    size_t len;
+    int overflow;
+}metricsWriter_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+static void Metrics_onAccept(epollHandler_t *handler, uint32_t events);
+static void Metrics_onRequest(epollHandler_t *handler, uint32_t events);
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+static const char *g_metrics_device_name[METRICS_DEV_NUM] = {
+    "MainCabin", "GPS", "CTD", "DVL", "DTU", "USBL", "Sonar", "Thruster"
+};
+
+/*  与latencyStage_t一一对应    */
+static const char *g_metrics_latency_stage[LATENCY_STAGE_NUM] = {
+    "handoff", "read", "parse", "send", "db", "control", "queue", "write", "total"
+};
+
+static const char *g_metrics_timer_name[METRICS_TIME_NUM] = {
+    "auv_parse_seconds", "auv_db_insert_seconds", "auv_tcp_send_seconds"
+};
+static const char *g_metrics_timer_help[METRICS_TIME_NUM] = {
+    "解析一帧的耗时", "一条数据入库的耗时", "一包数据TCP上传的耗时"
+};
+
+static unsigned long g_metrics_counters[METRICS_DEV_NUM][METRICS_COUNTER_NUM];
+static metricsHist_t g_metrics_hist[METRICS_DEV_NUM][METRICS_TIME_NUM];
+
+/*  登记的统计(Metrics_Init之前登记，之后只读)  */
+static const serialPortStream_t *g_metrics_streams[METRICS_DEV_NUM];
+static const epollHandler_t *g_metrics_handlers[METRICS_MAX_HANDLERS];
+static int g_metrics_handler_num = 0;
+static metricsGauge_t g_metrics_gauges[METRICS_MAX_GAUGES];
+static int g_metrics_gauge_num = 0;
+static metricsCollector_fn g_metrics_collectors[METRICS_MAX_COLLECTORS];
+static int g_metrics_collector_num = 0;
+
+/*  服务端:只在Epoll线程中使用  */
+static int g_metrics_epoll_fd = -1;
+static int g_metrics_http = 1;          //1为TCP上的HTTP，0为UNIX套接字上的纯文本
+static epollHandler_t g_metrics_listen_handler = {-1, "Metrics", Metrics_onAccept, NULL, {0}};
+static metricsClient_t g_metrics_clients[METRICS_MAX_CLIENTS];
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static int Metrics_bucketOf(int64_t us)
+* 函数简介:耗时所在的桶
+* 函数参数:us:耗时(微秒)
+* 函数返回值:桶下标
+*****************************************************************/
+static int Metrics_bucketOf(int64_t us)
+{
+    if(us <= 0)
+    {
+        return 0;
+    }
+
+    int bucket = 64 - __builtin_clzll((unsigned long long)us);
+    return bucket < METRICS_BUCKET_NUM ? bucket : METRICS_BUCKET_NUM - 1;
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_printf(metricsWriter_t *w, const char *fmt, ...)
+* 函数简介:追加到输出缓冲区，写不下时标记溢出
+* 函数参数:w:输出缓冲区
+* 函数参数:fmt:格式
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_printf(metricsWriter_t *w, const char *fmt, ...)
+{
+    if(w->overflow)
+    {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(w->buf + w->len, w->size - w->len, fmt, ap);
+    va_end(ap);
+
+    if(n < 0 || (size_t)n >= w->size - w->len)
+    {
+        w->overflow = 1;
+        return;
+    }
+    w->len += n;
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_header(metricsWriter_t *w, const char *name, const char *type, const char *help)
+* 函数简介:输出一个指标的HELP和TYPE行
+* 函数参数:w:输出缓冲区
+* 函数参数:name:指标名
+* 函数参数:type:counter/gauge/histogram
+* 函数参数:help:说明
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_header(metricsWriter_t *w, const char *name, const char *type, const char *help)
+{
+    Metrics_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_histogram(metricsWriter_t *w, const char *name, const char *label, const char *value,
+*                                       unsigned long count, unsigned long long sumUs, const unsigned long *buckets)
+* 函数简介:输出一条直方图(桶的上界换算成秒，计数累加)
+* 函数参数:w:输出缓冲区
+* 函数参数:name:指标名
+* 函数参数:label/value:标签
+* 函数参数:count:样本数
+* 函数参数:sumUs:累计耗时(微秒)
+* 函数参数:buckets:各桶计数(METRICS_BUCKET_NUM个)
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_histogram(metricsWriter_t *w, const char *name, const char *label, const char *value,
+                              unsigned long count, unsigned long long sumUs, const unsigned long *buckets)
+{
+    unsigned long cumulative = 0;
+
+    for(int i = 0; i < METRICS_BUCKET_NUM - 1; i++)
+    {
+        cumulative += buckets[i];
+        Metrics_printf(w, "%s_bucket{%s=\"%s\",le=\"%g\"} %lu\n", name, label, value, (double)(1L << i) / 1e6, cumulative);
+    }
+    Metrics_printf(w, "%s_bucket{%s=\"%s\",le=\"+Inf\"} %lu\n", name, label, value, count);
+    Metrics_printf(w, "%s_sum{%s=\"%s\"} %.6f\n", name, label, value, (double)sumUs / 1e6);
+    Metrics_printf(w, "%s_count{%s=\"%s\"} %lu\n", name, label, value, count);
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_deviceCounter(metricsWriter_t *w, const char *name, const char *help,
+*                                           metricsCounter_t counter, size_t streamField)
+* 函数简介:输出按设备的计数器，登记了接收缓冲区的设备加上缓冲区中对应的统计
+* 函数参数:w:输出缓冲区
+* 函数参数:name:指标名
+* 函数参数:help:说明
+* 函数参数:counter:计数器
+* 函数参数:streamField:serialPortStreamStats_t中对应字段的偏移，没有对应字段时为(size_t)-1
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_deviceCounter(metricsWriter_t *w, const char *name, const char *help,
+                                  metricsCounter_t counter, size_t streamField)
+{
+    Metrics_header(w, name, "counter", help);
+    for(int dev = 0; dev < METRICS_DEV_NUM; dev++)
+    {
+        unsigned long value = __atomic_load_n(&g_metrics_counters[dev][counter], __ATOMIC_RELAXED);
+        const serialPortStream_t *stream = g_metrics_streams[dev];
+
+        if(stream != NULL && streamField != (size_t)-1)
+        {
+            value += *(const unsigned long *)((const char *)&stream->stats + streamField);
+        }
+        Metrics_printf(w, "%s{device=\"%s\"} %lu\n", name, g_metrics_device_name[dev], value);
+    }
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_streamCounter(metricsWriter_t *w, const char *name, const char *help, size_t streamField)
+* 函数简介:输出串口接收缓冲区的一项统计(只输出已初始化的设备)
+* 函数参数:w:输出缓冲区
+* 函数参数:name:指标名
+* 函数参数:help:说明
+* 函数参数:streamField:serialPortStreamStats_t中字段的偏移
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_streamCounter(metricsWriter_t *w, const char *name, const char *help, size_t streamField)
+{
+    Metrics_header(w, name, "counter", help);
+    for(int dev = 0; dev < METRICS_DEV_NUM; dev++)
+    {
+        const serialPortStream_t *stream = g_metrics_streams[dev];
+        if(stream != NULL && stream->name != NULL)
+        {
+            Metrics_printf(w, "%s{device=\"%s\"} %lu\n", name, g_metrics_device_name[dev],
+                           *(const unsigned long *)((const char *)&stream->stats + streamField));
+        }
+    }
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_prepare(metricsClient_t *client, int status)
+* 函数简介:把回复渲染到连接的缓冲区。正文从METRICS_HEADER_SIZE处开始，HTTP响应头紧贴在正文前面，
+*          不需要再拷贝。status不是200时只回复状态行
+* 函数参数:client:连接
+* 函数参数:status:HTTP状态码
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_prepare(metricsClient_t *client, int status)
+{
+    char *body = client->response + METRICS_HEADER_SIZE;
+    char header[METRICS_HEADER_SIZE];
+    int len = 0;
+    int hlen = 0;
+
+    if(status == 200)
+    {
+        len = Metrics_Render(body, METRICS_BODY_SIZE);
+        if(len < 0)
+        {
+            status = 500;
+            len = 0;
+        }
+    }
+
+    if(g_metrics_http)
+    {
+        hlen = snprintf(header, sizeof(header),
+                        "HTTP/1.1 %d %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: %d\r\nConnection: close\r\n\r\n",
+                        status, status == 200 ? "OK" : "Error", len);
+        memcpy(body - hlen, header, hlen);
+    }
+
+    client->sendOff = METRICS_HEADER_SIZE - hlen;
+    client->sendEnd = METRICS_HEADER_SIZE + len;
+}
+
+/*******************************************************************
+* 函数原型:static int Metrics_flush(metricsClient_t *client)
+* 函数简介:非阻塞地写出回复，写到发送缓冲区满为止
+* 函数参数:client:连接
+* 函数返回值:发完返回1，还有未发的返回0，失败返回-1
+*****************************************************************/
+static int Metrics_flush(metricsClient_t *client)
+{
+    while(client->sendOff < client->sendEnd)
+    {
+        ssize_t n = write(client->handler.fd, client->response + client->sendOff, client->sendEnd - client->sendOff);
+        if(n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return 0;
+        }
+        if(n <= 0)
+        {
+            return -1;
+        }
+        client->sendOff += n;
+    }
+
+    return 1;
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_closeClient(metricsClient_t *client)
+* 函数简介:关闭HTTP连接并释放
+* 函数参数:client:连接
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_closeClient(metricsClient_t *client)
+{
+    epoll_manager_del_handler(g_metrics_epoll_fd, &client->handler);
+    close(client->handler.fd);
+    client->handler.fd = -1;
+    client->len = 0;
+    client->sendOff = 0;
+    client->sendEnd = 0;
+}
+
+/*******************************************************************
+* 函数原型:static metricsClient_t *Metrics_allocClient(void)
+* 函数简介:取一个空闲的连接，顺便关闭超时还没收齐请求头的连接
+* 函数参数:无
+* 函数返回值:空闲连接，没有时返回NULL
+*****************************************************************/
+static metricsClient_t *Metrics_allocClient(void)
+{
+    metricsClient_t *idle = NULL;
+
+    for(int i = 0; i < METRICS_MAX_CLIENTS; i++)
+    {
+        metricsClient_t *client = &g_metrics_clients[i];
+        if(client->handler.fd >= 0 && Clock_sinceMs(client->acceptMs) > METRICS_CLIENT_TIMEOUT_MS)
+        {
+            Metrics_closeClient(client);
+        }
+        if(client->handler.fd < 0 && idle == NULL)
+        {
+            idle = client;
+        }
+    }
+
+    return idle;
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_send(metricsClient_t *client)
+* 函数简介:发出已渲染的回复，发完关闭连接，发送缓冲区满时改为监听可写，剩下的在Metrics_onRequest中发
+* 函数参数:client:连接(已加入监听)
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_send(metricsClient_t *client)
+{
+    int ret = Metrics_flush(client);
+
+    if(ret == 0 && epoll_manager_mod_handler(g_metrics_epoll_fd, &client->handler, EPOLLOUT) == 0)
+    {
+        return;
+    }
+
+    Metrics_closeClient(client);
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_onAccept(epollHandler_t *handler, uint32_t events)
+* 函数简介:监听套接字就绪。UNIX套接字直接输出，HTTP连接等请求头收齐再回复
+* 函数参数:handler:就绪的处理器
+* 函数参数:events:就绪事件
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_onAccept(epollHandler_t *handler, uint32_t events)
+{
+    int fd;
+
+    while((fd = accept(handler->fd, NULL, NULL)) >= 0)
+    {
+        TCP_SetNonBlock(fd);
+
+        metricsClient_t *client = Metrics_allocClient();
+        if(client == NULL)
+        {
+            close(fd);
+            continue;
+        }
+
+        client->handler.fd = fd;
+        client->acceptMs = Clock_nowMs();
+        client->len = 0;
+        client->sendOff = 0;
+        client->sendEnd = 0;
+        if(epoll_manager_add_handler(g_metrics_epoll_fd, &client->handler, EPOLLIN) < 0)
+        {
+            close(fd);
+            client->handler.fd = -1;
+            continue;
+        }
+
+        /*  UNIX套接字不需要请求，直接输出 */
+        if(!g_metrics_http)
+        {
+            Metrics_prepare(client, 200);
+            Metrics_send(client);
+        }
+    }
+}
+
+/*******************************************************************
+* 函数原型:static void Metrics_onRequest(epollHandler_t *handler, uint32_t events)
+* 函数简介:连接就绪。收齐请求头后GET回复指标，其他方法回复405；回复没发完时在可写时接着发
+* 函数参数:handler:就绪的处理器
+* 函数参数:events:就绪事件
+* 函数返回值:无
+*****************************************************************/
+static void Metrics_onRequest(epollHandler_t *handler, uint32_t events)
+{
+    metricsClient_t *client = (metricsClient_t *)handler->context;
+
+    /*  1.正在发送回复:对端可写时接着发   */
+    if(client->sendEnd > 0)
+    {
+        if(events & (EPOLLERR | EPOLLHUP))
+        {
+            Metrics_closeClient(client);
+            return;
+        }
+        Metrics_send(client);
+        return;
+    }
+
+    /*  2.接收请求头    */
+    size_t space = sizeof(client->request) - 1 - client->len;
+
+    ssize_t n = read(handler->fd, client->request + client->len, space);
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        return;
+    }
+    if(n <= 0)
+    {
+        Metrics_closeClient(client);
+        return;
+    }
+
+    client->len += n;
+    client->request[client->len] = '\0';
+    if(strstr(client->request, "\r\n\r\n") == NULL && client->len < sizeof(client->request) - 1)
+    {
+        return;
+    }
+
+    Metrics_prepare(client, strncmp(client->request, "GET ", 4) == 0 ? 200 : 405);
+    Metrics_send(client);
+}
+
+/*******************************************************************
+* 函数原型:static int Metrics_listenUnix(const char *path)
+* 函数简介:创建UNIX套接字监听(先删除残留的同名文件)
+* 函数参数:path:套接字路径
+* 函数返回值:成功返回监听套接字，失败返回-1
+*****************************************************************/
+static int Metrics_listenUnix(const char *path)
+{
+    struct sockaddr_un addr = {0};
+
+    if(strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("Metrics_listenUnix:路径过长 %s\n", path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd < 0)
+    {
+        perror("Metrics_listenUnix:socket");
+        return -1;
+    }
+
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, METRICS_MAX_CLIENTS) < 0)
+    {
+        perror("Metrics_listenUnix:bind/listen");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:void Metrics_add(metricsDevice_t dev, metricsCounter_t counter, unsigned long n)
+* 函数简介:计数器加n
+* 函数参数:dev:设备
+* 函数参数:counter:计数器
+* 函数参数:n:增量
+* 函数返回值:无
+*****************************************************************/
+void Metrics_add(metricsDevice_t dev, metricsCounter_t counter, unsigned long n)
+{
+    if(dev < 0 || dev >= METRICS_DEV_NUM || counter < 0 || counter >= METRICS_COUNTER_NUM)
+    {
+        return;
+    }
+
+    __atomic_fetch_add(&g_metrics_counters[dev][counter], n, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************
+* 函数原型:void Metrics_flushed(metricsDevice_t dev, int discarded)
+* 函数简介:记录一次tcflush
+* 函数参数:dev:设备
+* 函数参数:discarded:SerialPort_flush的返回值(丢弃的字节数，-1为失败)
+* 函数返回值:无
+*****************************************************************/
+void Metrics_flushed(metricsDevice_t dev, int discarded)
+{
+    if(discarded < 0)
+    {
+        return;
+    }
+
+    Metrics_add(dev, METRICS_FLUSHES, 1);
+    Metrics_add(dev, METRICS_FLUSHED_BYTES, discarded);
+}
+
+/*******************************************************************
+* 函数原型:void Metrics_observe(metricsDevice_t dev, metricsTimer_t timer, int64_t us)
+* 函数简介:记录一次耗时
+* 函数参数:dev:设备
+* 函数参数:timer:直方图
+* 函数参数:us:耗时(微秒)
+* 函数返回值:无
+*****************************************************************/
+void Metrics_observe(metricsDevice_t dev, metricsTimer_t timer, int64_t us)
+{
+    if(dev < 0 || dev >= METRICS_DEV_NUM || timer < 0 || timer >= METRICS_TIME_NUM)
+    {
+        return;
+    }
+
+    metricsHist_t *h = &g_metrics_hist[dev][timer];
+    if(us < 0)
+    {
+        us = 0;
+    }
+
+    __atomic_fetch_add(&h->buckets[Metrics_bucketOf(us)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sumUs, (unsigned long long)us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************
+* 函数原型:void Metrics_observeSince(metricsDevice_t dev, metricsTimer_t timer, int64_t startNs)
+* 函数简介:记录从startNs到现在的耗时
+* 函数参数:dev:设备
+* 函数参数:timer:直方图
+* 函数参数:startNs:开始时间(Clock_nowNs)
+* 函数返回值:无
+*****************************************************************/
+void Metrics_observeSince(metricsDevice_t dev, metricsTimer_t timer, int64_t startNs)
+{
+    Metrics_observe(dev, timer, (Clock_nowNs() - startNs) / CLOCK_NS_PER_US);
+}
+
+/*******************************************************************
+* 函数原型:const char *Metrics_deviceName(metricsDevice_t dev)
+* 函数简介:设备名(常量字符串，也用作追踪事件名)
+* 函数参数:dev:设备
+* 函数返回值:设备名
+*****************************************************************/
+const char *Metrics_deviceName(metricsDevice_t dev)
+{
+    return (dev >= 0 && dev < METRICS_DEV_NUM) ? g_metrics_device_name[dev] : "?";
+}
+
+/*******************************************************************
+* 函数原型:int Metrics_registerStream(metricsDevice_t dev, const serialPortStream_t *stream)
+* 函数简介:登记设备的串口接收缓冲区，帧数、字节数等直接取缓冲区中的统计
+* 函数参数:dev:设备
+* 函数参数:stream:接收缓冲区
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Metrics_registerStream(metricsDevice_t dev, const serialPortStream_t *stream)
+{
+    if(dev < 0 || dev >= METRICS_DEV_NUM || stream == NULL)
+    {
+        return -1;
+    }
+
+    g_metrics_streams[dev] = stream;
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int Metrics_registerHandler(const epollHandler_t *handler)
+* 函数简介:登记Epoll处理器，输出分发次数、错误次数和最长回调耗时
+* 函数参数:handler:处理器
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Metrics_registerHandler(const epollHandler_t *handler)
+{
+    if(handler == NULL || g_metrics_handler_num >= METRICS_MAX_HANDLERS)
+    {
+        printf("Metrics_registerHandler:登记失败\n");
+        return -1;
+    }
+
+    g_metrics_handlers[g_metrics_handler_num++] = handler;
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int Metrics_registerGauge(const char *name, const char *help, metricsGauge_fn read)
+* 函数简介:登记瞬时值(队列深度等)，输出时调用read读取
+* 函数参数:name:指标名(常量字符串)
+* 函数参数:help:说明(常量字符串)
+* 函数参数:read:读取函数
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Metrics_registerGauge(const char *name, const char *help, metricsGauge_fn read)
+{
+    if(name == NULL || read == NULL || g_metrics_gauge_num >= METRICS_MAX_GAUGES)
+    {
+        printf("Metrics_registerGauge:登记失败\n");
+        return -1;
+    }
+
+    g_metrics_gauges[g_metrics_gauge_num].name = name;
+    g_metrics_gauges[g_metrics_gauge_num].help = help ? help : name;
+    g_metrics_gauges[g_metrics_gauge_num].read = read;
+    g_metrics_gauge_num++;
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int Metrics_registerCollector(metricsCollector_fn collect)
+* 函数简介:登记采集函数，输出时由它自己写一组指标(线程资源等标签不固定的指标)
+* 函数参数:collect:采集函数
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Metrics_registerCollector(metricsCollector_fn collect)
+{
+    if(collect == NULL || g_metrics_collector_num >= METRICS_MAX_COLLECTORS)
+    {
+        printf("Metrics_registerCollector:登记失败\n");
+        return -1;
+    }
+
+    g_metrics_collectors[g_metrics_collector_num++] = collect;
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int Metrics_Render(char *buf, size_t size)
+* 函数简介:生成Prometheus文本格式的全部指标
+* 函数参数:buf:输出缓冲区
+* 函数参数:size:缓冲区大小
+* 函数返回值:成功返回长度，缓冲区不够返回-1
+*****************************************************************/
+int Metrics_Render(char *buf, size_t size)
+{
+    metricsWriter_t w = {buf, size, 0, 0};
+
+    /*  1.按设备的计数器    */
+    Metrics_deviceCounter(&w, "auv_frames_total", "收到的完整帧", METRICS_FRAMES,
+                          offsetof(serialPortStreamStats_t, frames));
+    Metrics_deviceCounter(&w, "auv_frames_invalid_total", "解析时判定无效的帧", METRICS_FRAMES_INVALID, (size_t)-1);
+    Metrics_deviceCounter(&w, "auv_bytes_read_total", "读到的字节", METRICS_BYTES_READ,
+                          offsetof(serialPortStreamStats_t, bytesRead));
+    Metrics_deviceCounter(&w, "auv_tcflush_total", "tcflush次数", METRICS_FLUSHES, (size_t)-1);
+    Metrics_deviceCounter(&w, "auv_tcflush_bytes_total", "tcflush丢弃的字节", METRICS_FLUSHED_BYTES, (size_t)-1);
+
+    /*  2.串口接收缓冲区    */
+    Metrics_streamCounter(&w, "auv_serial_read_calls_total", "read系统调用次数",
+                          offsetof(serialPortStreamStats_t, readCalls));
+    Metrics_streamCounter(&w, "auv_serial_frames_skipped_total", "按最新帧策略跳过的帧",
+                          offsetof(serialPortStreamStats_t, framesSkipped));
+    Metrics_streamCounter(&w, "auv_serial_bad_frames_total", "不完整、损坏或超长的帧",
+                          offsetof(serialPortStreamStats_t, badFrames));
+    Metrics_streamCounter(&w, "auv_serial_bytes_discarded_total", "重同步时丢弃的字节",
+                          offsetof(serialPortStreamStats_t, bytesDiscarded));
+    Metrics_streamCounter(&w, "auv_serial_overflows_total", "接收缓冲区溢出次数",
+                          offsetof(serialPortStreamStats_t, overflows));
+    Metrics_streamCounter(&w, "auv_serial_read_errors_total", "read失败次数(如USB串口拔出)",
+                          offsetof(serialPortStreamStats_t, readErrors));
+
+    Metrics_header(&w, "auv_serial_buffered_bytes", "gauge", "接收缓冲区中还未取出的字节");
+    for(int dev = 0; dev < METRICS_DEV_NUM; dev++)
+    {
+        const serialPortStream_t *stream = g_metrics_streams[dev];
+        if(stream != NULL && stream->name != NULL)
+        {
+            Metrics_printf(&w, "auv_serial_buffered_bytes{device=\"%s\"} %zu\n", g_metrics_device_name[dev],
+                           stream->wpos - stream->rpos);
+        }
+    }
+
+    /*  3.按设备的耗时直方图(没有样本的设备不输出) */
+    for(int t = 0; t < METRICS_TIME_NUM; t++)
+    {
+        Metrics_header(&w, g_metrics_timer_name[t], "histogram", g_metrics_timer_help[t]);
+        for(int dev = 0; dev < METRICS_DEV_NUM; dev++)
+        {
+            metricsHist_t h;
+            const metricsHist_t *src = &g_metrics_hist[dev][t];
+
+            h.count = __atomic_load_n(&src->count, __ATOMIC_RELAXED);
+            if(h.count == 0)
+            {
+                continue;
+            }
+            h.sumUs = __atomic_load_n(&src->sumUs, __ATOMIC_RELAXED);
+            for(int i = 0; i < METRICS_BUCKET_NUM; i++)
+            {
+                h.buckets[i] = __atomic_load_n(&src->buckets[i], __ATOMIC_RELAXED);
+            }
+            Metrics_histogram(&w, g_metrics_timer_name[t], "device", g_metrics_device_name[dev], h.count, h.sumUs, h.buckets);
+        }
+    }
+
+    /*  4.链路延时  */
+    Metrics_header(&w, "auv_latency_seconds", "histogram", "CTD样本链路各段耗时");
+    for(int stage = 0; stage < LATENCY_STAGE_NUM; stage++)
+    {
+        latencyStats_t st;
+        if(Latency_getStats((latencyStage_t)stage, &st) == 0 && st.count > 0)
+        {
+            Metrics_histogram(&w, "auv_latency_seconds", "stage", g_metrics_latency_stage[stage], st.count, st.sumUs, st.buckets);
+        }
+    }
+
+    /*  5.Epoll处理器   */
+    Metrics_header(&w, "auv_epoll_dispatch_total", "counter", "Epoll分发次数");
+    for(int i = 0; i < g_metrics_handler_num; i++)
+    {
+        Metrics_printf(&w, "auv_epoll_dispatch_total{handler=\"%s\"} %lu\n", g_metrics_handlers[i]->name, g_metrics_handlers[i]->stats.dispatchCount);
+    }
+    Metrics_header(&w, "auv_epoll_errors_total", "counter", "EPOLLERR/EPOLLHUP次数");
+    for(int i = 0; i < g_metrics_handler_num; i++)
+    {
+        Metrics_printf(&w, "auv_epoll_errors_total{handler=\"%s\"} %lu\n", g_metrics_handlers[i]->name, g_metrics_handlers[i]->stats.errorCount);
+    }
+    Metrics_header(&w, "auv_epoll_callback_max_seconds", "gauge", "Epoll回调最长耗时");
+    for(int i = 0; i < g_metrics_handler_num; i++)
+    {
+        Metrics_printf(&w, "auv_epoll_callback_max_seconds{handler=\"%s\"} %.6f\n", g_metrics_handlers[i]->name, g_metrics_handlers[i]->stats.maxCostUs / 1e6);
+    }
+
+    /*  6.队列深度等瞬时值  */
+    for(int i = 0; i < g_metrics_gauge_num; i++)
+    {
+        Metrics_header(&w, g_metrics_gauges[i].name, "gauge", g_metrics_gauges[i].help);
+        Metrics_printf(&w, "%s %ld\n", g_metrics_gauges[i].name, g_metrics_gauges[i].read());
+    }
+
+    /*  7.采集函数  */
+    for(int i = 0; i < g_metrics_collector_num && !w.overflow; i++)
+    {
+        int n = g_metrics_collectors[i](w.buf + w.len, w.size - w.len);
+        if(n < 0)
+        {
+            w.overflow = 1;
+            break;
+        }
+        w.len += n;
+    }
+
+    if(w.overflow)
+    {
+        printf("Metrics_Render:输出缓冲区不够(%zu字节)\n", size);
+        return -1;
+    }
+
+    return (int)w.len;
+}
+
+/*******************************************************************
+* 函数原型:int Metrics_Init(int epoll_fd, const char *addr)
+* 函数简介:创建监听套接字并加入Epoll管理器，请求在Epoll线程中处理
+* 函数参数:epoll_fd:Epoll管理器
+* 函数参数:addr:"[ip:]端口"提供HTTP(默认127.0.0.1)，含'/'时为UNIX套接字路径
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Metrics_Init(int epoll_fd, const char *addr)
+{
+    int fd = -1;
+
+    if(epoll_fd < 0 || addr == NULL)
+    {
+        return -1;
+    }
+
+    if(strchr(addr, '/') != NULL)
+    {
+        g_metrics_http = 0;
+        fd = Metrics_listenUnix(addr);
+    }
+    else
+    {
+        char ip[INET_ADDRSTRLEN] = "127.0.0.1";
+        const char *colon = strchr(addr, ':');
+        const char *portStr = addr;
+
+        if(colon != NULL)
+        {
+            snprintf(ip, sizeof(ip), "%.*s", (int)(colon - addr), addr);
+            portStr = colon + 1;
+        }
+
+        int port = atoi(portStr);
+        if(port <= 0 || port > 65535)
+        {
+            printf("Metrics_Init:端口无效 %s\n", addr);
+            return -1;
+        }
+
+        g_metrics_http = 1;
+        fd = TCP_InitServer(ip, (unsigned short)port);
+    }
+
+    if(fd < 0 || TCP_SetNonBlock(fd) < 0)
+    {
+        printf("Metrics_Init:监听 %s 失败\n", addr);
+        if(fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    for(int i = 0; i < METRICS_MAX_CLIENTS; i++)
+    {
+        g_metrics_clients[i].handler.fd = -1;
+        g_metrics_clients[i].handler.name = "MetricsClient";
+        g_metrics_clients[i].handler.handler = Metrics_onRequest;
+        g_metrics_clients[i].handler.context = &g_metrics_clients[i];
+    }
+
+    g_metrics_epoll_fd = epoll_fd;
+    g_metrics_listen_handler.fd = fd;
+    if(epoll_manager_add_handler(epoll_fd, &g_metrics_listen_handler, EPOLLIN) < 0)
+    {
+        close(fd);
+        g_metrics_listen_handler.fd = -1;
+        return -1;
+    }
+
+    printf("运行指标:%s %s\n", g_metrics_http ? "HTTP" : "UNIX", addr);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/************************************************************************************
+					文件名：metrics.h
+					描述：运行指标。按设备统计帧数、无效帧、读到的字节、tcflush丢弃的数据，
+						  解析、入库、TCP上传的耗时直方图，再加上串口接收缓冲区、Epoll处理器、
+						  链路延时和队列深度，在Epoll线程中以Prometheus文本格式对外提供
+ ************************************************************************************/
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include "../clock/clock.h"
+#include "../SerialPort/SerialPort.h"
+#include "../epoll/epoll_manager.h"
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  直方图桶数:与链路延时相同，第0桶为0~1us，第i桶为[2^(i-1), 2^i)us   */
+#define METRICS_BUCKET_NUM          24
+
+/*  可登记的Epoll处理器、瞬时值、采集函数个数 */
+#define METRICS_MAX_HANDLERS        16
+#define METRICS_MAX_GAUGES          8
+#define METRICS_MAX_COLLECTORS      4
+
+/*  同时服务的连接数、请求头最大长度、连接最长保留时间(毫秒，含发送回复)   */
+#define METRICS_MAX_CLIENTS         4
+#define METRICS_REQUEST_SIZE        1024
+#define METRICS_CLIENT_TIMEOUT_MS   2000
+
+/*  一次输出的最大长度(HTTP响应头、指标正文)，每个连接一份，对端可写时分批发出  */
+#define METRICS_HEADER_SIZE         160
+#define METRICS_BODY_SIZE           (128 * 1024)
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  设备    */
+typedef enum
+{
+    METRICS_DEV_MAINCABIN = 0,
+    METRICS_DEV_GPS,
+    METRICS_DEV_CTD,
+    METRICS_DEV_DVL,
+    METRICS_DEV_DTU,
+    METRICS_DEV_USBL,
+    METRICS_DEV_SONAR,
+    METRICS_DEV_THRUSTER,
+    METRICS_DEV_NUM
+}metricsDevice_t;
+
+/*  计数器  */
+typedef enum
+{
+    METRICS_FRAMES = 0,                 //收到的完整帧(登记了接收缓冲区的串口设备不用再计)
+    METRICS_FRAMES_INVALID,             //无效帧(解析时遇到"invalid"标记、校验错误)
+    METRICS_BYTES_READ,                 //读到的字节(登记了接收缓冲区的串口设备不用再计)
+    METRICS_FLUSHES,                    //tcflush次数
+    METRICS_FLUSHED_BYTES,              //tcflush丢弃的字节
+    METRICS_COUNTER_NUM
+}metricsCounter_t;
+
+/*  耗时直方图  */
+typedef enum
+{
+    METRICS_TIME_PARSE = 0,             //解析
+    METRICS_TIME_DB,                    //入库
+    METRICS_TIME_SEND,                  //TCP上传
+    METRICS_TIME_NUM
+}metricsTimer_t;
+
+/*  瞬时值(队列深度等)的读取函数，在Epoll线程中调用  */
+typedef long (*metricsGauge_fn)(void);
+
+/*  采集函数:把一组指标按Prometheus文本格式写入buf，返回长度，写不下返回-1(在Epoll线程中调用) */
+typedef int (*metricsCollector_fn)(char *buf, size_t size);
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  记录(任意线程可调用，不加锁)    */
+void Metrics_add(metricsDevice_t dev, metricsCounter_t counter, unsigned long n);
+void Metrics_flushed(metricsDevice_t dev, int discarded);
+void Metrics_observe(metricsDevice_t dev, metricsTimer_t timer, int64_t us);
+void Metrics_observeSince(metricsDevice_t dev, metricsTimer_t timer, int64_t startNs);
+const char *Metrics_deviceName(metricsDevice_t dev);
+
+/*  登记已有的统计，输出时直接读取(在Metrics_Init之前登记)   */
+int Metrics_registerStream(metricsDevice_t dev, const serialPortStream_t *stream);
+int Metrics_registerHandler(const epollHandler_t *handler);
+int Metrics_registerGauge(const char *name, const char *help, metricsGauge_fn read);
+int Metrics_registerCollector(metricsCollector_fn collect);
+
+/*  生成Prometheus文本  */
+int Metrics_Render(char *buf, size_t size);
+
+/*  在Epoll管理器中监听:addr为"[ip:]端口"时提供HTTP(默认只监听127.0.0.1)，
+    为UNIX套接字路径(含'/')时连上即输出一次文本后关闭   */
+int Metrics_Init(int epoll_fd, const char *addr);
+
+#endif
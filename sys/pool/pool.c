@@ -0,0 +1,610 @@
+/************************************************************************************
+					文件名：pool.c
+					描述：固定块内存池与堆分配计数实现
+ ************************************************************************************/
+
+#define _GNU_SOURCE                     //dladdr
+#include "pool.h"
+#include "../log/log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <dlfcn.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  块按16字节对齐(与malloc相同)    */
+#define POOL_ALIGN                  16
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+/*  分级堆(按块大小从小到大)    */
+static pool_t g_pool_heap[POOL_MAX_CLASSES];
+static int g_pool_heap_num = 0;
+static unsigned long g_pool_heap_overflows = 0;
+
+/*  堆分配计数  */
+static poolHeapStats_t g_pool_heap_stats;
+static unsigned long g_pool_reported = 0;       //Pool_checkSealed已报告的次数
+static int g_pool_reported_callers = 0;
+static int g_pool_strict = 0;                   //1为零分配模式:封存后有堆分配时终止程序
+
+
+/************************************************************************************
+ 									glibc分配函数(定义在程序中的malloc会替换掉库中的，用于计数)
+*************************************************************************************/
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static void Pool_countAlloc(void *caller)
+* 函数简介:记一次堆分配，封存之后记录调用地址
+* 函数参数:caller:调用malloc的地址
+* 函数返回值:无
+*****************************************************************/
+static inline void Pool_countAlloc(void *caller)
+{
+    __atomic_fetch_add(&g_pool_heap_stats.allocs, 1, __ATOMIC_RELAXED);
+    if(__atomic_load_n(&g_pool_heap_stats.sealed, __ATOMIC_RELAXED))
+    {
+        __atomic_fetch_add(&g_pool_heap_stats.allocsAfterSeal, 1, __ATOMIC_RELAXED);
+        int idx = __atomic_load_n(&g_pool_heap_stats.callerNum, __ATOMIC_RELAXED);
+        if(idx < POOL_SEAL_CALLERS)
+        {
+            /*  同一个地址只记一次  */
+            for(int i = 0; i < idx; i++)
+            {
+                if(__atomic_load_n(&g_pool_heap_stats.callers[i], __ATOMIC_RELAXED) == caller)
+                {
+                    return;
+                }
+            }
+            idx = __atomic_fetch_add(&g_pool_heap_stats.callerNum, 1, __ATOMIC_RELAXED);
+            if(idx < POOL_SEAL_CALLERS)
+            {
+                __atomic_store_n(&g_pool_heap_stats.callers[idx], caller, __ATOMIC_RELEASE);
+            }
+        }
+    }
+}
+
+/*******************************************************************
+* 函数原型:static pool_t *Pool_heapClassOf(const void *ptr)
+* 函数简介:找到块所在的级
+* 函数参数:ptr:块
+* 函数返回值:所在的级，不是分级堆中的块返回NULL
+*****************************************************************/
+static pool_t *Pool_heapClassOf(const void *ptr)
+{
+    for(int i = 0; i < g_pool_heap_num; i++)
+    {
+        if(Pool_contains(&g_pool_heap[i], ptr))
+        {
+            return &g_pool_heap[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*  替换libc的分配函数，只计数，实际分配仍由glibc完成(free不需要计数，不替换)    */
+void *malloc(size_t size)
+{
+    Pool_countAlloc(__builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+    Pool_countAlloc(__builtin_return_address(0));
+    return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    Pool_countAlloc(__builtin_return_address(0));
+    return __libc_realloc(ptr, size);
+}
+
+/*  对齐分配同样计数:glibc没有导出posix_memalign、aligned_alloc的内部入口，都用__libc_memalign实现   */
+void *memalign(size_t alignment, size_t size)
+{
+    Pool_countAlloc(__builtin_return_address(0));
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    Pool_countAlloc(__builtin_return_address(0));
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    if(alignment == 0 || alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+
+    Pool_countAlloc(__builtin_return_address(0));
+    void *ptr = __libc_memalign(alignment, size);
+    if(ptr == NULL)
+    {
+        return ENOMEM;
+    }
+
+    *memptr = ptr;
+    return 0;
+}
+
+void *valloc(size_t size)
+{
+    Pool_countAlloc(__builtin_return_address(0));
+    return __libc_valloc(size);
+}
+
+void *pvalloc(size_t size)
+{
+    Pool_countAlloc(__builtin_return_address(0));
+    return __libc_pvalloc(size);
+}
+
+/*******************************************************************
+* 函数原型:int Pool_init(pool_t *pool, size_t blockSize, unsigned int blockNum)
+* 函数简介:创建内存池，所有块一次分配好
+* 函数参数:pool:内存池
+* 函数参数:blockSize:块大小(按16字节向上取整)
+* 函数参数:blockNum:块数
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Pool_init(pool_t *pool, size_t blockSize, unsigned int blockNum)
+{
+    if(pool == NULL || blockSize == 0 || blockNum == 0)
+    {
+        printf("Pool_init:参数错误\n");
+        return -1;
+    }
+
+    memset(pool, 0, sizeof(*pool));
+    pool->blockSize = (blockSize + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+    pool->blockNum = blockNum;
+
+    size_t capacity = 1;
+    while(capacity < blockNum)
+    {
+        capacity <<= 1;
+    }
+    if(Ring_init(&pool->freeList, capacity, sizeof(void *)) < 0)
+    {
+        return -1;
+    }
+
+    pool->base = malloc(pool->blockSize * blockNum);
+    if(pool->base == NULL)
+    {
+        perror("Pool_init:malloc");
+        Ring_destroy(&pool->freeList);
+        return -1;
+    }
+
+    for(unsigned int i = 0; i < blockNum; i++)
+    {
+        void *block = pool->base + (size_t)i * pool->blockSize;
+        Ring_push(&pool->freeList, &block);
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:void Pool_destroy(pool_t *pool)
+* 函数简介:销毁内存池(块不能再被使用)
+* 函数参数:pool:内存池
+* 函数返回值:无
+*****************************************************************/
+void Pool_destroy(pool_t *pool)
+{
+    free(pool->base);
+    pool->base = NULL;
+    Ring_destroy(&pool->freeList);
+}
+
+/*******************************************************************
+* 函数原型:void *Pool_alloc(pool_t *pool)
+* 函数简介:取一个块
+* 函数参数:pool:内存池
+* 函数返回值:块，池空返回NULL
+*****************************************************************/
+void *Pool_alloc(pool_t *pool)
+{
+    void *block = NULL;
+
+    if(Ring_pop(&pool->freeList, &block) < 0)
+    {
+        __atomic_fetch_add(&pool->failed, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    unsigned long inUse = __atomic_add_fetch(&pool->inUse, 1, __ATOMIC_RELAXED);
+    if(inUse > __atomic_load_n(&pool->peak, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&pool->peak, inUse, __ATOMIC_RELAXED);
+    }
+
+    return block;
+}
+
+/*******************************************************************
+* 函数原型:void Pool_free(pool_t *pool, void *block)
+* 函数简介:归还一个块
+* 函数参数:pool:内存池
+* 函数参数:block:Pool_alloc取到的块
+* 函数返回值:无
+*****************************************************************/
+void Pool_free(pool_t *pool, void *block)
+{
+    if(block == NULL)
+    {
+        return;
+    }
+
+    __atomic_fetch_sub(&pool->inUse, 1, __ATOMIC_RELAXED);
+    Ring_push(&pool->freeList, &block);
+}
+
+/*******************************************************************
+* 函数原型:int Pool_contains(const pool_t *pool, const void *block)
+* 函数简介:判断块是否属于这个内存池
+* 函数参数:pool:内存池
+* 函数参数:block:块
+* 函数返回值:属于返回1，不属于返回0
+*****************************************************************/
+int Pool_contains(const pool_t *pool, const void *block)
+{
+    const unsigned char *p = block;
+
+    return pool->base != NULL && p >= pool->base && p < pool->base + pool->blockSize * pool->blockNum;
+}
+
+/*******************************************************************
+* 函数原型:int Pool_heapInit(const poolClassConfig_t *classes, int classNum)
+* 函数简介:创建分级堆(只能调用一次)
+* 函数参数:classes:各级的块大小和块数，按块大小从小到大排列
+* 函数参数:classNum:级数
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Pool_heapInit(const poolClassConfig_t *classes, int classNum)
+{
+    if(g_pool_heap_num != 0 || classNum <= 0 || classNum > POOL_MAX_CLASSES)
+    {
+        printf("Pool_heapInit:参数错误或已初始化\n");
+        return -1;
+    }
+
+    for(int i = 0; i < classNum; i++)
+    {
+        if(Pool_init(&g_pool_heap[i], classes[i].blockSize, classes[i].blockNum) < 0)
+        {
+            while(--i >= 0)
+            {
+                Pool_destroy(&g_pool_heap[i]);
+            }
+            return -1;
+        }
+    }
+    g_pool_heap_num = classNum;
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:void *Pool_heapAlloc(size_t size)
+* 函数简介:从分级堆分配，本级用完时取更大的级，都用完时退回malloc
+* 函数参数:size:大小
+* 函数返回值:内存，失败返回NULL
+*****************************************************************/
+void *Pool_heapAlloc(size_t size)
+{
+    for(int i = 0; i < g_pool_heap_num; i++)
+    {
+        if(g_pool_heap[i].blockSize >= size)
+        {
+            void *block = Pool_alloc(&g_pool_heap[i]);
+            if(block != NULL)
+            {
+                return block;
+            }
+        }
+    }
+
+    __atomic_fetch_add(&g_pool_heap_overflows, 1, __ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+/*******************************************************************
+* 函数原型:void *Pool_heapRealloc(void *ptr, size_t size)
+* 函数简介:改变大小，块中放得下时原样返回
+* 函数参数:ptr:原内存(可为NULL)
+* 函数参数:size:新大小
+* 函数返回值:新内存，失败返回NULL(原内存不变)
+*****************************************************************/
+void *Pool_heapRealloc(void *ptr, size_t size)
+{
+    if(ptr == NULL)
+    {
+        return Pool_heapAlloc(size);
+    }
+
+    size_t oldSize = Pool_heapSize(ptr);
+    if(size <= oldSize)
+    {
+        return ptr;
+    }
+
+    void *newPtr = Pool_heapAlloc(size);
+    if(newPtr != NULL)
+    {
+        memcpy(newPtr, ptr, oldSize);
+        Pool_heapFree(ptr);
+    }
+
+    return newPtr;
+}
+
+/*******************************************************************
+* 函数原型:void Pool_heapFree(void *ptr)
+* 函数简介:归还到所在的级，或free退回malloc的内存
+* 函数参数:ptr:内存(可为NULL)
+* 函数返回值:无
+*****************************************************************/
+void Pool_heapFree(void *ptr)
+{
+    if(ptr == NULL)
+    {
+        return;
+    }
+
+    pool_t *pool = Pool_heapClassOf(ptr);
+    if(pool != NULL)
+    {
+        Pool_free(pool, ptr);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+/*******************************************************************
+* 函数原型:size_t Pool_heapSize(void *ptr)
+* 函数简介:可用大小(不小于申请的大小)
+* 函数参数:ptr:内存
+* 函数返回值:可用大小
+*****************************************************************/
+size_t Pool_heapSize(void *ptr)
+{
+    if(ptr == NULL)
+    {
+        return 0;
+    }
+
+    pool_t *pool = Pool_heapClassOf(ptr);
+    return pool != NULL ? pool->blockSize : malloc_usable_size(ptr);
+}
+
+/*******************************************************************
+* 函数原型:unsigned long Pool_heapOverflows(void)
+* 函数简介:分级堆退回malloc的次数
+* 函数参数:无
+* 函数返回值:次数
+*****************************************************************/
+unsigned long Pool_heapOverflows(void)
+{
+    return __atomic_load_n(&g_pool_heap_overflows, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************
+* 函数原型:void Pool_seal(void)
+* 函数简介:启动完成，之后的每次堆分配都记为稳定运行中的分配
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Pool_seal(void)
+{
+    printf("内存池:启动完成，之前共%lu次堆分配，之后的堆分配将被记录\n", __atomic_load_n(&g_pool_heap_stats.allocs, __ATOMIC_RELAXED));
+    fflush(stdout);
+    __atomic_store_n(&g_pool_heap_stats.sealed, 1, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************
+* 函数原型:void Pool_setStrict(int strict)
+* 函数简介:零分配模式，Pool_checkSealed发现封存后有堆分配时输出分配位置后abort(留下core文件)
+* 函数参数:strict:1为开启，0为只记录(默认)
+* 函数返回值:无
+*****************************************************************/
+void Pool_setStrict(int strict)
+{
+    g_pool_strict = strict;
+}
+
+/*******************************************************************
+* 函数原型:void Pool_getHeapStats(poolHeapStats_t *stats)
+* 函数简介:取堆分配计数
+* 函数参数:stats:输出
+* 函数返回值:无
+*****************************************************************/
+void Pool_getHeapStats(poolHeapStats_t *stats)
+{
+    stats->allocs = __atomic_load_n(&g_pool_heap_stats.allocs, __ATOMIC_RELAXED);
+    stats->allocsAfterSeal = __atomic_load_n(&g_pool_heap_stats.allocsAfterSeal, __ATOMIC_RELAXED);
+    stats->sealed = __atomic_load_n(&g_pool_heap_stats.sealed, __ATOMIC_ACQUIRE);
+    stats->callerNum = __atomic_load_n(&g_pool_heap_stats.callerNum, __ATOMIC_RELAXED);
+    if(stats->callerNum > POOL_SEAL_CALLERS)
+    {
+        stats->callerNum = POOL_SEAL_CALLERS;
+    }
+    for(int i = 0; i < stats->callerNum; i++)
+    {
+        stats->callers[i] = __atomic_load_n(&g_pool_heap_stats.callers[i], __ATOMIC_ACQUIRE);
+    }
+}
+
+/*******************************************************************
+* 函数原型:int Pool_checkSealed(void)
+* 函数简介:检查封存之后是否又有堆分配，有则输出次数和新出现的调用位置(主循环中定期调用)，
+*          零分配模式下随后终止程序
+* 函数参数:无
+* 函数返回值:上次检查以来新增的堆分配次数
+*****************************************************************/
+int Pool_checkSealed(void)
+{
+    static poolHeapStats_t stats;
+
+    Pool_getHeapStats(&stats);
+    if(!stats.sealed || stats.allocsAfterSeal == g_pool_reported)
+    {
+        return 0;
+    }
+
+    int num = (int)(stats.allocsAfterSeal - g_pool_reported);
+    g_pool_reported = stats.allocsAfterSeal;
+    LOG_W(LOG_MOD_MAIN, "启动完成后仍有堆分配:新增%d次，共%lu次", num, stats.allocsAfterSeal);
+
+    for(; g_pool_reported_callers < stats.callerNum; g_pool_reported_callers++)
+    {
+        void *caller = stats.callers[g_pool_reported_callers];
+        Dl_info info;
+        if(dladdr(caller, &info) != 0 && info.dli_sname != NULL)
+        {
+            LOG_W(LOG_MOD_MAIN, "  堆分配位置:%p %s+0x%lx(%s)", caller, info.dli_sname,
+                  (unsigned long)((char *)caller - (char *)info.dli_saddr), info.dli_fname);
+        }
+        else
+        {
+            LOG_W(LOG_MOD_MAIN, "  堆分配位置:%p(用addr2line定位)", caller);
+        }
+    }
+
+    /*  零分配模式:写完日志后终止   */
+    if(g_pool_strict)
+    {
+        LOG_E(LOG_MOD_MAIN, "零分配模式:启动完成后仍有堆分配，程序终止");
+        Log_Shutdown();
+        abort();
+    }
+
+    return num;
+}
+
+/*******************************************************************
+* 函数原型:void Pool_Print(void)
+* 函数简介:打印堆分配计数和分级堆各级的使用情况
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void Pool_Print(void)
+{
+    poolHeapStats_t stats;
+
+    Pool_getHeapStats(&stats);
+    printf("堆分配:%lu次 启动完成后:%lu次%s 分级堆退回malloc:%lu次\n", stats.allocs, stats.allocsAfterSeal,
+           stats.sealed ? "" : "(尚未封存)", Pool_heapOverflows());
+
+    if(g_pool_heap_num == 0)
+    {
+        return;
+    }
+    printf("%8s %8s %8s %8s %8s\n", "块大小", "块数", "使用中", "峰值", "池空");
+    for(int i = 0; i < g_pool_heap_num; i++)
+    {
+        const pool_t *pool = &g_pool_heap[i];
+        printf("%8zu %8u %8lu %8lu %8lu\n", pool->blockSize, pool->blockNum, pool->inUse, pool->peak, pool->failed);
+    }
+}
+
+/*******************************************************************
+* 函数原型:int Pool_renderMetrics(char *buf, size_t size)
+* 函数简介:把堆分配计数和分级堆各级的使用情况生成Prometheus文本
+* 函数参数:buf:输出缓冲区
+* 函数参数:size:缓冲区大小
+* 函数返回值:成功返回长度，缓冲区不够返回-1
+*****************************************************************/
+int Pool_renderMetrics(char *buf, size_t size)
+{
+    static const struct
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+    }metric[] = {
+        {"auv_pool_blocks", "gauge", "分级堆各级的块数"},
+        {"auv_pool_blocks_in_use", "gauge", "分级堆各级正在使用的块"},
+        {"auv_pool_blocks_peak", "gauge", "分级堆各级使用峰值"},
+        {"auv_pool_exhausted_total", "counter", "分级堆各级池空的次数"},
+    };
+    poolHeapStats_t stats;
+    size_t len = 0;
+    int n;
+
+    Pool_getHeapStats(&stats);
+    n = snprintf(buf, size,
+                 "# HELP auv_heap_allocs_total 进程启动以来的堆分配次数\n# TYPE auv_heap_allocs_total counter\nauv_heap_allocs_total %lu\n"
+                 "# HELP auv_heap_allocs_after_seal_total 启动完成后的堆分配次数(稳定运行时应为0)\n# TYPE auv_heap_allocs_after_seal_total counter\nauv_heap_allocs_after_seal_total %lu\n"
+                 "# HELP auv_pool_heap_overflow_total 分级堆退回malloc的次数\n# TYPE auv_pool_heap_overflow_total counter\nauv_pool_heap_overflow_total %lu\n",
+                 stats.allocs, stats.allocsAfterSeal, Pool_heapOverflows());
+    if(n < 0 || (size_t)n >= size)
+    {
+        return -1;
+    }
+    len = n;
+
+    for(size_t m = 0; m < sizeof(metric) / sizeof(metric[0]) && g_pool_heap_num > 0; m++)
+    {
+        n = snprintf(buf + len, size - len, "# HELP %s %s\n# TYPE %s %s\n", metric[m].name, metric[m].help, metric[m].name, metric[m].type);
+        if(n < 0 || (size_t)n >= size - len)
+        {
+            return -1;
+        }
+        len += n;
+
+        for(int i = 0; i < g_pool_heap_num; i++)
+        {
+            const pool_t *pool = &g_pool_heap[i];
+            unsigned long value = 0;
+
+            switch(m)
+            {
+                case 0: value = pool->blockNum; break;
+                case 1: value = pool->inUse; break;
+                case 2: value = pool->peak; break;
+                default: value = pool->failed; break;
+            }
+
+            n = snprintf(buf + len, size - len, "%s{block=\"%zu\"} %lu\n", metric[m].name, pool->blockSize, value);
+            if(n < 0 || (size_t)n >= size - len)
+            {
+                return -1;
+            }
+            len += n;
+        }
+    }
+
+    return (int)len;
+}
@@ -0,0 +1,92 @@
+/************************************************************************************
+					文件名：pool.h
+					描述：固定块内存池与堆分配计数。内存池在初始化时一次分配好，运行中
+						  取用、归还只操作空闲链表；按块大小分级的池组成一个小堆，供SQLite
+						  等需要malloc接口的代码使用。进程中的malloc/calloc/realloc和对齐
+						  分配函数都经过计数，启动完成后调用Pool_seal，之后的每次堆分配都会被记录下来
+ ************************************************************************************/
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "../ring/ring.h"
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  分级堆最多的级数    */
+#define POOL_MAX_CLASSES            12
+
+/*  启动完成后记录的堆分配调用地址个数(用addr2line -e pxauv 地址 定位)  */
+#define POOL_SEAL_CALLERS           16
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  固定块内存池    */
+typedef struct
+{
+    size_t blockSize;
+    unsigned int blockNum;
+    unsigned char *base;                //所有块连续存放
+    ringQueue_t freeList;               //空闲块指针
+    unsigned long inUse;                //正在使用的块
+    unsigned long peak;                 //使用峰值
+    unsigned long failed;               //池空时取用失败的次数
+}pool_t;
+
+/*  分级堆的一级    */
+typedef struct
+{
+    size_t blockSize;
+    unsigned int blockNum;
+}poolClassConfig_t;
+
+/*  堆分配计数  */
+typedef struct
+{
+    unsigned long allocs;               //进程启动以来的malloc/calloc/realloc次数
+    unsigned long allocsAfterSeal;      //Pool_seal之后的次数，稳定运行时应为0
+    int sealed;
+    int callerNum;
+    void *callers[POOL_SEAL_CALLERS];   //Pool_seal之后分配的调用地址
+}poolHeapStats_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  固定块内存池(任意线程可取用、归还，不加锁)  */
+int Pool_init(pool_t *pool, size_t blockSize, unsigned int blockNum);
+void Pool_destroy(pool_t *pool);
+void *Pool_alloc(pool_t *pool);
+void Pool_free(pool_t *pool, void *block);
+int Pool_contains(const pool_t *pool, const void *block);
+
+/*  分级堆:按大小取最小的可用级，都用完或超过最大级时退回malloc(计入溢出次数)   */
+int Pool_heapInit(const poolClassConfig_t *classes, int classNum);
+void *Pool_heapAlloc(size_t size);
+void *Pool_heapRealloc(void *ptr, size_t size);
+void Pool_heapFree(void *ptr);
+size_t Pool_heapSize(void *ptr);
+unsigned long Pool_heapOverflows(void);
+
+/*  堆分配计数:启动完成后封存，之后的堆分配记录调用地址 */
+void Pool_seal(void);
+void Pool_setStrict(int strict);
+void Pool_getHeapStats(poolHeapStats_t *stats);
+int Pool_checkSealed(void);
+
+/*  打印、生成Prometheus文本(登记为运行指标的采集函数)   */
+void Pool_Print(void);
+int Pool_renderMetrics(char *buf, size_t size);
+
+#endif
@@ -0,0 +1,421 @@
+/************************************************************************************
+					文件名：procstat.c
+					描述：线程命名与线程资源采样实现
+ ************************************************************************************/
+
+#define _GNU_SOURCE                     //pthread_setname_np
+#include "procstat.h"
+#include "../rt/rt.h"
+#include "../clock/clock.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+/*  最近一次采样，采样线程写、其他线程读，都在锁内拷贝  */
+static procStat_t g_procstat_latest;
+static pthread_mutex_t g_procstat_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int g_procstat_interval_ms = PROCSTAT_DEFAULT_INTERVAL_MS;
+static pthread_t g_procstat_tid;
+static int g_procstat_running = 0;
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static int ProcStat_readFile(const char *path, char *buf, size_t size)
+* 函数简介:读取整个/proc文件(内容很短)
+* 函数参数:path:文件路径
+* 函数参数:buf:输出缓冲区
+* 函数参数:size:缓冲区大小
+* 函数返回值:成功返回读到的长度，失败返回-1(线程已退出等)
+*****************************************************************/
+static int ProcStat_readFile(const char *path, char *buf, size_t size)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if(n < 0)
+    {
+        return -1;
+    }
+    buf[n] = '\0';
+
+    return (int)n;
+}
+
+/*******************************************************************
+* 函数原型:static long ProcStat_statusField(const char *status, const char *key)
+* 函数简介:从status文件内容中取一个数值字段
+* 函数参数:status:status文件内容
+* 函数参数:key:字段名(含冒号)
+* 函数返回值:字段值，没有该字段返回0
+*****************************************************************/
+static long ProcStat_statusField(const char *status, const char *key)
+{
+    const char *p = strstr(status, key);
+    return p ? strtol(p + strlen(key), NULL, 10) : 0;
+}
+
+/*******************************************************************
+* 函数原型:static int ProcStat_readThread(pid_t tid, procThreadStat_t *th)
+* 函数简介:读取一个线程的stat、schedstat、status
+* 函数参数:tid:线程ID
+* 函数参数:th:输出
+* 函数返回值:成功返回0，线程已退出返回-1
+*****************************************************************/
+static int ProcStat_readThread(pid_t tid, procThreadStat_t *th)
+{
+    char path[64];
+    char buf[2048];
+
+    memset(th, 0, sizeof(*th));
+    th->tid = tid;
+
+    /*  1.stat:线程名在括号中(可能含空格)，其后第12、13个字段为utime、stime，第37个为processor  */
+    snprintf(path, sizeof(path), "/proc/self/task/%d/stat", (int)tid);
+    if(ProcStat_readFile(path, buf, sizeof(buf)) < 0)
+    {
+        return -1;
+    }
+
+    char *lp = strchr(buf, '(');
+    char *rp = strrchr(buf, ')');
+    if(lp == NULL || rp == NULL || rp < lp)
+    {
+        return -1;
+    }
+    snprintf(th->name, sizeof(th->name), "%.*s", (int)(rp - lp - 1), lp + 1);
+
+    unsigned long long utime = 0, stime = 0;
+    char *save = NULL;
+    int field = 0;
+    for(char *tok = strtok_r(rp + 1, " ", &save); tok != NULL; tok = strtok_r(NULL, " ", &save))
+    {
+        field++;
+        if(field == 12)
+        {
+            utime = strtoull(tok, NULL, 10);
+        }
+        else if(field == 13)
+        {
+            stime = strtoull(tok, NULL, 10);
+        }
+        else if(field == 37)
+        {
+            th->processor = atoi(tok);
+            break;
+        }
+    }
+
+    static long ticks = 0;
+    if(ticks <= 0)
+    {
+        ticks = sysconf(_SC_CLK_TCK);
+        ticks = ticks > 0 ? ticks : 100;
+    }
+    th->cpuNs = (int64_t)(utime + stime) * (CLOCK_NS_PER_SEC / ticks);
+
+    /*  2.schedstat:运行时间、就绪等待时间(纳秒)，内核没开调度统计时运行时间为0，保留滴答值  */
+    snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", (int)tid);
+    if(ProcStat_readFile(path, buf, sizeof(buf)) > 0)
+    {
+        long long runNs = 0, waitNs = 0;
+        if(sscanf(buf, "%lld %lld", &runNs, &waitNs) == 2)
+        {
+            th->waitNs = waitNs;
+            if(runNs > 0)
+            {
+                th->cpuNs = runNs;
+            }
+        }
+    }
+
+    /*  3.status:上下文切换次数 */
+    snprintf(path, sizeof(path), "/proc/self/task/%d/status", (int)tid);
+    if(ProcStat_readFile(path, buf, sizeof(buf)) > 0)
+    {
+        th->voluntary = ProcStat_statusField(buf, "\nvoluntary_ctxt_switches:");
+        th->involuntary = ProcStat_statusField(buf, "nonvoluntary_ctxt_switches:");
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:static void *ProcStat_SamplerThread(void *arg)
+* 函数简介:采样线程，按周期采样并计算每个线程在这个周期内的CPU占用率
+* 函数参数:arg:无
+* 函数返回值:无
+*****************************************************************/
+static void *ProcStat_SamplerThread(void *arg)
+{
+    static procStat_t prev, cur;
+
+    pthread_detach(pthread_self());
+    Rt_enterThread(RT_ROLE_BACKGROUND);
+    memset(&prev, 0, sizeof(prev));
+
+    while(g_procstat_running)
+    {
+        if(ProcStat_sample(&cur) == 0 && prev.stampNs > 0)
+        {
+            int64_t elapsedNs = cur.stampNs - prev.stampNs;
+            for(int i = 0; i < cur.threadNum; i++)
+            {
+                for(int j = 0; j < prev.threadNum; j++)
+                {
+                    if(prev.threads[j].tid == cur.threads[i].tid && elapsedNs > 0)
+                    {
+                        cur.threads[i].cpuPercent = 100.0 * (cur.threads[i].cpuNs - prev.threads[j].cpuNs) / elapsedNs;
+                        break;
+                    }
+                }
+            }
+        }
+
+        pthread_mutex_lock(&g_procstat_mutex);
+        g_procstat_latest = cur;
+        pthread_mutex_unlock(&g_procstat_mutex);
+
+        prev = cur;
+        usleep(g_procstat_interval_ms * 1000);
+    }
+
+    return NULL;
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:int ProcStat_setThreadName(pthread_t thread, const char *name)
+* 函数简介:设置线程名，超过15个字符截断
+* 函数参数:thread:线程
+* 函数参数:name:线程名
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int ProcStat_setThreadName(pthread_t thread, const char *name)
+{
+    char buf[PROCSTAT_NAME_LEN];
+
+    snprintf(buf, sizeof(buf), "%s", name);
+    if(pthread_setname_np(thread, buf) != 0)
+    {
+        printf("ProcStat_setThreadName:设置线程名%s失败\n", buf);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int ProcStat_sample(procStat_t *stat)
+* 函数简介:采样一次进程中所有线程和进程内存(不计算CPU占用率)
+* 函数参数:stat:输出
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int ProcStat_sample(procStat_t *stat)
+{
+    static DIR *dir = NULL;
+    static pthread_mutex_t dirMutex = PTHREAD_MUTEX_INITIALIZER;
+    struct dirent *ent;
+    char buf[2048];
+
+    /*  目录只打开一次，之后每次从头重新读(opendir每次都会分配目录缓冲区)  */
+    pthread_mutex_lock(&dirMutex);
+    if(dir == NULL)
+    {
+        dir = opendir("/proc/self/task");
+    }
+    else
+    {
+        rewinddir(dir);
+    }
+    if(dir == NULL)
+    {
+        pthread_mutex_unlock(&dirMutex);
+        perror("ProcStat_sample:opendir");
+        return -1;
+    }
+
+    memset(stat, 0, sizeof(*stat));
+    while((ent = readdir(dir)) != NULL && stat->threadNum < PROCSTAT_MAX_THREADS)
+    {
+        if(ent->d_name[0] < '0' || ent->d_name[0] > '9')
+        {
+            continue;
+        }
+        if(ProcStat_readThread((pid_t)atoi(ent->d_name), &stat->threads[stat->threadNum]) == 0)
+        {
+            stat->threadNum++;
+        }
+    }
+    pthread_mutex_unlock(&dirMutex);
+
+    if(ProcStat_readFile("/proc/self/status", buf, sizeof(buf)) > 0)
+    {
+        stat->rssBytes = ProcStat_statusField(buf, "VmRSS:") * 1024;
+        stat->rssPeakBytes = ProcStat_statusField(buf, "VmHWM:") * 1024;
+        stat->vmBytes = ProcStat_statusField(buf, "VmSize:") * 1024;
+    }
+
+    stat->stampNs = Clock_nowNs();
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int ProcStat_Start(int intervalMs)
+* 函数简介:启动采样线程
+* 函数参数:intervalMs:采样周期(毫秒)，<=0时用默认值
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int ProcStat_Start(int intervalMs)
+{
+    if(g_procstat_running)
+    {
+        return 0;
+    }
+
+    g_procstat_interval_ms = intervalMs > 0 ? intervalMs : PROCSTAT_DEFAULT_INTERVAL_MS;
+    g_procstat_running = 1;
+    if(pthread_create(&g_procstat_tid, NULL, ProcStat_SamplerThread, NULL) != 0)
+    {
+        printf("ProcStat_Start:采样线程创建错误\n");
+        g_procstat_running = 0;
+        return -1;
+    }
+    ProcStat_setThreadName(g_procstat_tid, "procstat");
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int ProcStat_get(procStat_t *stat)
+* 函数简介:取采样线程最近一次的结果
+* 函数参数:stat:输出
+* 函数返回值:成功返回0，还没有采样返回-1
+*****************************************************************/
+int ProcStat_get(procStat_t *stat)
+{
+    pthread_mutex_lock(&g_procstat_mutex);
+    *stat = g_procstat_latest;
+    pthread_mutex_unlock(&g_procstat_mutex);
+
+    return stat->stampNs > 0 ? 0 : -1;
+}
+
+/*******************************************************************
+* 函数原型:void ProcStat_Print(void)
+* 函数简介:打印各线程的CPU占用和进程内存
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+void ProcStat_Print(void)
+{
+    static procStat_t stat;
+
+    if(ProcStat_get(&stat) < 0)
+    {
+        return;
+    }
+
+    printf("%-7s %-15s %7s %10s %10s %9s %9s %4s\n", "tid", "线程", "CPU%", "CPU(s)", "等待(s)", "主动切换", "被抢占", "CPU");
+    for(int i = 0; i < stat.threadNum; i++)
+    {
+        const procThreadStat_t *th = &stat.threads[i];
+        printf("%-7d %-15s %7.1f %10.3f %10.3f %9lu %9lu %4d\n", (int)th->tid, th->name, th->cpuPercent,
+               (double)th->cpuNs / CLOCK_NS_PER_SEC, (double)th->waitNs / CLOCK_NS_PER_SEC,
+               th->voluntary, th->involuntary, th->processor);
+    }
+    printf("常驻内存:%ldKB 峰值:%ldKB 虚拟内存:%ldKB\n", stat.rssBytes / 1024, stat.rssPeakBytes / 1024, stat.vmBytes / 1024);
+}
+
+/*******************************************************************
+* 函数原型:int ProcStat_renderMetrics(char *buf, size_t size)
+* 函数简介:把最近一次采样生成Prometheus文本
+* 函数参数:buf:输出缓冲区
+* 函数参数:size:缓冲区大小
+* 函数返回值:成功返回长度，缓冲区不够返回-1
+*****************************************************************/
+int ProcStat_renderMetrics(char *buf, size_t size)
+{
+    static procStat_t stat;
+    static const struct
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+    }metric[] = {
+        {"auv_thread_cpu_seconds_total", "counter", "线程累计CPU时间"},
+        {"auv_thread_cpu_percent", "gauge", "线程上一个采样周期的CPU占用率(单核百分比)"},
+        {"auv_thread_runqueue_wait_seconds_total", "counter", "线程累计就绪等待时间"},
+        {"auv_thread_voluntary_switches_total", "counter", "线程主动切换次数"},
+        {"auv_thread_involuntary_switches_total", "counter", "线程被抢占次数"},
+    };
+    size_t len = 0;
+    int n;
+
+    if(ProcStat_get(&stat) < 0)
+    {
+        return 0;
+    }
+
+    for(size_t m = 0; m < sizeof(metric) / sizeof(metric[0]); m++)
+    {
+        n = snprintf(buf + len, size - len, "# HELP %s %s\n# TYPE %s %s\n", metric[m].name, metric[m].help, metric[m].name, metric[m].type);
+        if(n < 0 || (size_t)n >= size - len)
+        {
+            return -1;
+        }
+        len += n;
+
+        for(int i = 0; i < stat.threadNum; i++)
+        {
+            const procThreadStat_t *th = &stat.threads[i];
+            double value = 0;
+
+            switch(m)
+            {
+                case 0: value = (double)th->cpuNs / CLOCK_NS_PER_SEC; break;
+                case 1: value = th->cpuPercent; break;
+                case 2: value = (double)th->waitNs / CLOCK_NS_PER_SEC; break;
+                case 3: value = th->voluntary; break;
+                default: value = th->involuntary; break;
+            }
+
+            n = snprintf(buf + len, size - len, "%s{thread=\"%s\",tid=\"%d\"} %.6g\n", metric[m].name, th->name, (int)th->tid, value);
+            if(n < 0 || (size_t)n >= size - len)
+            {
+                return -1;
+            }
+            len += n;
+        }
+    }
+
+    n = snprintf(buf + len, size - len,
+                 "# HELP auv_process_resident_bytes 常驻内存\n# TYPE auv_process_resident_bytes gauge\nauv_process_resident_bytes %ld\n"
+                 "# HELP auv_process_resident_peak_bytes 常驻内存峰值\n# TYPE auv_process_resident_peak_bytes gauge\nauv_process_resident_peak_bytes %ld\n"
+                 "# HELP auv_process_virtual_bytes 虚拟内存\n# TYPE auv_process_virtual_bytes gauge\nauv_process_virtual_bytes %ld\n"
+                 "# HELP auv_process_threads 线程数\n# TYPE auv_process_threads gauge\nauv_process_threads %d\n",
+                 stat.rssBytes, stat.rssPeakBytes, stat.vmBytes, stat.threadNum);
+    if(n < 0 || (size_t)n >= size - len)
+    {
+        return -1;
+    }
+
+    return (int)(len + n);
+}
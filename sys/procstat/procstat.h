@@ -0,0 +1,76 @@
+/************************************************************************************
+					文件名：procstat.h
+					描述：线程命名与线程资源采样。后台线程定期读取/proc/self/task/<tid>/下的
+						  stat、schedstat、status，得到每个线程的CPU时间、CPU占用率、
+						  就绪等待时间和上下文切换次数，以及进程的常驻内存
+ ************************************************************************************/
+
+#ifndef __PROCSTAT_H__
+#define __PROCSTAT_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  最多采样的线程数    */
+#define PROCSTAT_MAX_THREADS        32
+
+/*  线程名最大长度(含结束符，内核限制)  */
+#define PROCSTAT_NAME_LEN           16
+
+/*  默认采样周期(毫秒)  */
+#define PROCSTAT_DEFAULT_INTERVAL_MS    1000
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  一个线程    */
+typedef struct
+{
+    pid_t tid;
+    char name[PROCSTAT_NAME_LEN];
+    int64_t cpuNs;                      //累计CPU时间(有schedstat时精确到纳秒，否则按时钟滴答)
+    int64_t waitNs;                     //累计就绪等待时间(没有schedstat时为0)
+    unsigned long voluntary;            //主动切换(阻塞、睡眠)
+    unsigned long involuntary;          //被抢占
+    int processor;                      //最近运行的CPU
+    double cpuPercent;                  //上一个采样周期的CPU占用率(单核百分比)
+}procThreadStat_t;
+
+/*  一次采样    */
+typedef struct
+{
+    int64_t stampNs;                    //采样时间(Clock_nowNs)，0为还没有采样
+    int threadNum;
+    procThreadStat_t threads[PROCSTAT_MAX_THREADS];
+    long rssBytes;                      //常驻内存
+    long rssPeakBytes;                  //常驻内存峰值
+    long vmBytes;                       //虚拟内存
+}procStat_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  线程命名(最多15个字符，top -H、ps -L、事件追踪中显示)    */
+int ProcStat_setThreadName(pthread_t thread, const char *name);
+
+/*  采样:一次性读取，或启动后台线程按周期采样后取最近一次结果  */
+int ProcStat_sample(procStat_t *stat);
+int ProcStat_Start(int intervalMs);
+int ProcStat_get(procStat_t *stat);
+
+/*  打印、生成Prometheus文本(登记为运行指标的采集函数)   */
+void ProcStat_Print(void);
+int ProcStat_renderMetrics(char *buf, size_t size);
+
+#endif
@@ -0,0 +1,170 @@
+/************************************************************************************
+					文件名：ring.c
+					描述：有界无锁队列(Vyukov MPMC)实现
+ ************************************************************************************/
+
+#include "ring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static size_t *Ring_cellSeq(const ringQueue_t *ring, size_t pos)
+* 函数简介:位置pos对应单元的序号
+* 函数参数:ring:队列
+* 函数参数:pos:入队/出队位置
+* 函数返回值:序号的地址，元素紧跟在序号后面
+*****************************************************************/
+static size_t *Ring_cellSeq(const ringQueue_t *ring, size_t pos)
+{
+    return (size_t *)(ring->cells + (pos & ring->mask) * ring->cellSize);
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:int Ring_init(ringQueue_t *ring, size_t capacity, size_t elemSize)
+* 函数简介:创建队列
+* 函数参数:ring:队列
+* 函数参数:capacity:容量，必须是2的幂且不小于2
+* 函数参数:elemSize:元素大小
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+int Ring_init(ringQueue_t *ring, size_t capacity, size_t elemSize)
+{
+    if(ring == NULL || capacity < 2 || (capacity & (capacity - 1)) != 0 || elemSize == 0)
+    {
+        printf("Ring_init:容量%zu必须是2的幂\n", capacity);
+        return -1;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->elemSize = elemSize;
+    ring->cellSize = (sizeof(size_t) + elemSize + 7) & ~(size_t)7;
+    ring->mask = capacity - 1;
+    ring->cells = malloc(ring->cellSize * capacity);
+    if(ring->cells == NULL)
+    {
+        perror("Ring_init:malloc");
+        return -1;
+    }
+
+    for(size_t i = 0; i < capacity; i++)
+    {
+        *Ring_cellSeq(ring, i) = i;
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:void Ring_destroy(ringQueue_t *ring)
+* 函数简介:销毁队列(调用时不能再有生产者、消费者)
+* 函数参数:ring:队列
+* 函数返回值:无
+*****************************************************************/
+void Ring_destroy(ringQueue_t *ring)
+{
+    free(ring->cells);
+    ring->cells = NULL;
+}
+
+/*******************************************************************
+* 函数原型:int Ring_push(ringQueue_t *ring, const void *elem)
+* 函数简介:入队。单元的序号等于入队位置时可写，抢到位置后拷贝元素，再把序号加1交给消费者
+* 函数参数:ring:队列
+* 函数参数:elem:元素，大小为elemSize
+* 函数返回值:成功返回0，队列满返回-1
+*****************************************************************/
+int Ring_push(ringQueue_t *ring, const void *elem)
+{
+    size_t pos = __atomic_load_n(&ring->enqueuePos, __ATOMIC_RELAXED);
+    size_t *seq;
+
+    for(;;)
+    {
+        seq = Ring_cellSeq(ring, pos);
+        intptr_t diff = (intptr_t)__atomic_load_n(seq, __ATOMIC_ACQUIRE) - (intptr_t)pos;
+
+        if(diff == 0)
+        {
+            if(__atomic_compare_exchange_n(&ring->enqueuePos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if(diff < 0)
+        {
+            return -1;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ring->enqueuePos, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(seq + 1, elem, ring->elemSize);
+    __atomic_store_n(seq, pos + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:int Ring_pop(ringQueue_t *ring, void *elem)
+* 函数简介:出队。单元的序号等于出队位置加1时可读，读完把序号加上容量交还给生产者
+* 函数参数:ring:队列
+* 函数参数:elem:输出元素，大小为elemSize
+* 函数返回值:成功返回0，队列空返回-1
+*****************************************************************/
+int Ring_pop(ringQueue_t *ring, void *elem)
+{
+    size_t pos = __atomic_load_n(&ring->dequeuePos, __ATOMIC_RELAXED);
+    size_t *seq;
+
+    for(;;)
+    {
+        seq = Ring_cellSeq(ring, pos);
+        intptr_t diff = (intptr_t)__atomic_load_n(seq, __ATOMIC_ACQUIRE) - (intptr_t)(pos + 1);
+
+        if(diff == 0)
+        {
+            if(__atomic_compare_exchange_n(&ring->dequeuePos, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if(diff < 0)
+        {
+            return -1;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ring->dequeuePos, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(elem, seq + 1, ring->elemSize);
+    __atomic_store_n(seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:size_t Ring_count(const ringQueue_t *ring)
+* 函数简介:当前元素个数，有并发入队出队时只是近似值
+* 函数参数:ring:队列
+* 函数返回值:元素个数
+*****************************************************************/
+size_t Ring_count(const ringQueue_t *ring)
+{
+    size_t enq = __atomic_load_n(&ring->enqueuePos, __ATOMIC_RELAXED);
+    size_t deq = __atomic_load_n(&ring->dequeuePos, __ATOMIC_RELAXED);
+
+    return enq > deq ? enq - deq : 0;
+}
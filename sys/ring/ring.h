@@ -0,0 +1,55 @@
+/************************************************************************************
+					文件名：ring.h
+					描述：有界无锁队列(Vyukov MPMC)。元素定长、按值拷贝，容量为2的幂；
+						  多个生产者、多个消费者都不加锁，队列满时入队失败(由调用者决定丢弃哪个)
+ ************************************************************************************/
+
+#ifndef __RING_H__
+#define __RING_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stddef.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+#define RING_CACHELINE      64
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  队列:入队、出队位置各占一个缓存行，生产者和消费者互不干扰   */
+typedef struct
+{
+    unsigned char *cells;               //cellSize * capacity，每个单元开头是序号
+    size_t cellSize;                    //单元大小(序号 + 元素，按8字节对齐)
+    size_t elemSize;                    //元素大小
+    size_t mask;                        //capacity - 1
+    char pad0[RING_CACHELINE];
+    size_t enqueuePos;
+    char pad1[RING_CACHELINE - sizeof(size_t)];
+    size_t dequeuePos;
+    char pad2[RING_CACHELINE - sizeof(size_t)];
+}ringQueue_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  创建、销毁(capacity必须是2的幂)  */
+int Ring_init(ringQueue_t *ring, size_t capacity, size_t elemSize);
+void Ring_destroy(ringQueue_t *ring);
+
+/*  入队、出队(不阻塞)    */
+int Ring_push(ringQueue_t *ring, const void *elem);
+int Ring_pop(ringQueue_t *ring, void *elem);
+
+/*  当前元素个数(近似值)    */
+size_t Ring_count(const ringQueue_t *ring);
+
+#endif
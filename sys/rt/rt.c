@@ -0,0 +1,264 @@
+/************************************************************************************
+					文件名：rt.c
+					描述：实时调度配置实现
+ ************************************************************************************/
+
+#define _GNU_SOURCE                     //pthread_setaffinity_np、CPU_SET
+#include "rt.h"
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  老内核没有MCL_ONFAULT时退回到只锁定当前内存  */
+#ifndef MCL_ONFAULT
+#define MCL_ONFAULT                 4
+#endif
+
+/*  CAP_IPC_LOCK在能力位图中的位置(有这个能力时锁定内存不受RLIMIT_MEMLOCK限制)  */
+#define RT_CAP_IPC_LOCK             14
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+/*  各角色的配置:实时角色之间总线调度最高，指令接收最低；非实时角色只用nice区分   */
+static const rtProfile_t g_rt_profile[RT_ROLE_NUM] = {
+    [RT_ROLE_BUS]        = {SCHED_FIFO,  80, -10,  1},
+    [RT_ROLE_CONTROL]    = {SCHED_FIFO,  70, -8,   1},
+    [RT_ROLE_SENSOR]     = {SCHED_FIFO,  60, -5,   1},
+    [RT_ROLE_COMMAND]    = {SCHED_FIFO,  50, -5,  -1},
+    [RT_ROLE_IO]         = {SCHED_OTHER, 0,   0,   0},
+    [RT_ROLE_BACKGROUND] = {SCHED_OTHER, 0,   10,  0},
+};
+
+static const char *g_rt_role_name[RT_ROLE_NUM] = {
+    "bus", "control", "sensor", "command", "io", "background"
+};
+
+static int g_rt_enabled = 0;
+static int g_rt_cpu = -1;               //实时CPU，-1为不绑定
+static int g_rt_fallback_reported = 0;  //没有实时权限的提示只打印一次
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static void Rt_prefaultStack(void)
+* 函数简介:访问一段栈，使这些页在启动时就分配好(已mlockall时同时被锁定)
+* 函数参数:无
+* 函数返回值:无
+*****************************************************************/
+static void __attribute__((noinline)) Rt_prefaultStack(void)
+{
+    volatile unsigned char stack[RT_STACK_PREFAULT_SIZE];
+
+    for(size_t i = 0; i < sizeof(stack); i += 4096)
+    {
+        stack[i] = 0;
+    }
+}
+
+/*******************************************************************
+* 函数原型:static int Rt_setAffinity(int rtCpu)
+* 函数简介:绑定本线程的CPU
+* 函数参数:rtCpu:1为绑定到实时CPU，0为绑定到其他CPU
+* 函数返回值:成功返回0，失败返回-1
+*****************************************************************/
+static int Rt_setAffinity(int rtCpu)
+{
+    long cpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for(long cpu = 0; cpu < cpuNum && cpu < CPU_SETSIZE; cpu++)
+    {
+        if((cpu == g_rt_cpu) == (rtCpu == 1))
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if(err != 0)
+    {
+        printf("Rt_setAffinity:%s\n", strerror(err));
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+* 函数原型:static int Rt_canLockAll(void)
+* 函数简介:判断能否锁定全部内存:有CAP_IPC_LOCK，或锁定上限为无限(不是时尝试提高)
+* 函数参数:无
+* 函数返回值:能锁定返回1，不能返回0
+*****************************************************************/
+static int Rt_canLockAll(void)
+{
+    char line[128];
+    unsigned long long capEff = 0;
+    FILE *fp = fopen("/proc/self/status", "r");
+    if(fp != NULL)
+    {
+        while(fgets(line, sizeof(line), fp) != NULL)
+        {
+            if(sscanf(line, "CapEff: %llx", &capEff) == 1)
+            {
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    if(capEff & (1ULL << RT_CAP_IPC_LOCK))
+    {
+        return 1;
+    }
+
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_MEMLOCK, &limit) < 0)
+    {
+        return 0;
+    }
+    if(limit.rlim_cur != RLIM_INFINITY)
+    {
+        limit.rlim_cur = limit.rlim_max = RLIM_INFINITY;
+        return setrlimit(RLIMIT_MEMLOCK, &limit) == 0;
+    }
+
+    return 1;
+}
+
+/*******************************************************************
+* 函数原型:static void Rt_setNice(int nice)
+* 函数简介:设置本线程的nice值(Linux上nice按线程生效)
+* 函数参数:nice:nice值，降低nice需要权限，失败时忽略
+* 函数返回值:无
+*****************************************************************/
+static void Rt_setNice(int nice)
+{
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), nice);
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:int Rt_Init(int enable, int rtCpu)
+* 函数简介:锁定内存(之后新分配的页在第一次访问时锁定)，关闭malloc把内存还给系统，
+*          决定实时CPU。没有权限时只打印提示，继续运行
+* 函数参数:enable:1为启用实时调度配置，0为保持默认调度
+* 函数参数:rtCpu:实时线程使用的CPU，RT_CPU_AUTO为自动
+* 函数返回值:成功返回0，内存锁定失败返回-1(不影响运行)
+*****************************************************************/
+int Rt_Init(int enable, int rtCpu)
+{
+    long cpuNum = sysconf(_SC_NPROCESSORS_ONLN);
+
+    g_rt_enabled = enable;
+    if(!enable)
+    {
+        printf("实时调度配置:未启用\n");
+        return 0;
+    }
+
+    /*  1.实时CPU:单核时不绑定  */
+    if(rtCpu == RT_CPU_AUTO)
+    {
+        g_rt_cpu = cpuNum > 1 ? (int)cpuNum - 1 : -1;
+    }
+    else
+    {
+        g_rt_cpu = (rtCpu >= 0 && rtCpu < cpuNum && cpuNum > 1) ? rtCpu : -1;
+    }
+
+    /*  2.释放的内存不还给系统，避免之后重新缺页    */
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    /*  3.锁定内存:MCL_ONFAULT只锁定访问过的页，不会把每个线程8MB的栈都分配出来。
+        锁定上限不是无限且无法提高时不锁定，否则MCL_FUTURE会让之后的线程栈、malloc分配失败 */
+    int ret = -1;
+    const char *lockResult = "无权限，未锁定";
+    if(Rt_canLockAll())
+    {
+        ret = mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT);
+        if(ret < 0 && errno == EINVAL)
+        {
+            ret = mlockall(MCL_CURRENT);
+        }
+        lockResult = ret == 0 ? "成功" : strerror(errno);
+    }
+
+    printf("实时调度配置:已启用，实时CPU:%d(共%ld核)，内存锁定:%s\n", g_rt_cpu, cpuNum, lockResult);
+
+    return ret == 0 ? 0 : -1;
+}
+
+/*******************************************************************
+* 函数原型:int Rt_enterThread(rtRole_t role)
+* 函数简介:在线程入口处调用，按角色设置本线程的调度策略、优先级、CPU亲和性，
+*          实时角色预先访问栈。没有实时调度权限时改用nice值
+* 函数参数:role:线程角色
+* 函数返回值:成功返回0，退回到nice时返回1，未启用或参数错误返回-1
+*****************************************************************/
+int Rt_enterThread(rtRole_t role)
+{
+    if(!g_rt_enabled || role < 0 || role >= RT_ROLE_NUM)
+    {
+        return -1;
+    }
+
+    const rtProfile_t *profile = &g_rt_profile[role];
+    int ret = 0;
+
+    /*  1.CPU亲和性 */
+    if(g_rt_cpu >= 0 && profile->rtCpu >= 0)
+    {
+        Rt_setAffinity(profile->rtCpu);
+    }
+
+    /*  2.调度策略  */
+    if(profile->policy == SCHED_FIFO)
+    {
+        struct sched_param param = {.sched_priority = profile->priority};
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(err != 0)
+        {
+            if(!__atomic_exchange_n(&g_rt_fallback_reported, 1, __ATOMIC_RELAXED))
+            {
+                printf("Rt_enterThread:无法使用SCHED_FIFO(%s)，改用nice值区分线程\n", strerror(err));
+            }
+            Rt_setNice(profile->nice);
+            ret = 1;
+        }
+        Rt_prefaultStack();
+    }
+    else
+    {
+        Rt_setNice(profile->nice);
+    }
+
+    return ret;
+}
+
+/*******************************************************************
+* 函数原型:const char *Rt_roleName(rtRole_t role)
+* 函数简介:角色名
+* 函数参数:role:线程角色
+* 函数返回值:角色名
+*****************************************************************/
+const char *Rt_roleName(rtRole_t role)
+{
+    return (role >= 0 && role < RT_ROLE_NUM) ? g_rt_role_name[role] : "?";
+}
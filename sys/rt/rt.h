@@ -0,0 +1,67 @@
+/************************************************************************************
+					文件名：rt.h
+					描述：实时调度配置。按线程角色设置调度策略、优先级和CPU亲和性，
+						  锁定内存并预先访问实时线程的栈，避免SQLite入库、TCP上传卡顿时
+						  推进器总线、控制周期和关键传感器被抢走CPU或缺页。
+						  没有实时调度权限时退回到nice值区分轻重
+ ************************************************************************************/
+
+#ifndef __RT_H__
+#define __RT_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  实时线程启动时预先访问的栈大小(缺页在启动时发生，运行中不再发生)  */
+#define RT_STACK_PREFAULT_SIZE      (64 * 1024)
+
+/*  实时线程使用的CPU:-1为自动(多核时用最后一个核，其余线程用其他核；单核时不绑定)  */
+#define RT_CPU_AUTO                 -1
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  线程角色    */
+typedef enum
+{
+    RT_ROLE_BUS = 0,                    //推进器总线调度(停止指令不能被耽误)
+    RT_ROLE_CONTROL,                    //Epoll线程(控制周期)、预编程任务
+    RT_ROLE_SENSOR,                     //CTD、DVL等控制用传感器的读取解析
+    RT_ROLE_COMMAND,                    //USBL、数传电台、上位机等指令接收
+    RT_ROLE_IO,                         //其余传感器、推进器反馈入库
+    RT_ROLE_BACKGROUND,                 //日志、资源采样、上电初始化等
+    RT_ROLE_NUM
+}rtRole_t;
+
+/*  一个角色的配置  */
+typedef struct
+{
+    int policy;                         //SCHED_FIFO或SCHED_OTHER
+    int priority;                       //SCHED_FIFO的优先级(1~99)
+    int nice;                           //SCHED_OTHER的nice值，没有实时权限时实时角色也用这个值
+    int rtCpu;                          //1为绑定到实时CPU，0为绑定到其他CPU，-1为不绑定
+}rtProfile_t;
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  启动时调用一次(在创建线程之前):锁定内存，enable为0时各线程保持默认调度  */
+int Rt_Init(int enable, int rtCpu);
+
+/*  线程入口处调用:按角色设置调度、亲和性，实时角色预先访问栈 */
+int Rt_enterThread(rtRole_t role);
+
+/*  角色名  */
+const char *Rt_roleName(rtRole_t role);
+
+#endif
@@ -176,6 +176,12 @@ int TCP_SendData(int tcpfd, const unsigned char *databuf, int datasize)
                 continue; // 被信号中断，重试
             }
             
+            /* 非阻塞套接字发送缓冲区已满，丢弃本次数据，避免阻塞事件循环 */
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return -1;
+            }
+
             // [新增] 优雅处理连接断开的情况
             if (errno == EPIPE || errno == ECONNRESET)
             {
@@ -341,4 +347,25 @@ int TCP_RecvData_Block(int tcpfd, unsigned char *tcpReadBuf, size_t bufsize, int
     }
 
     return (total_read > 0) ? total_read : -1;
-}
\ No newline at end of file
+}
+
+
+/*******************************************************************
+ * 函数原型: int TCP_SetNonBlock(int tcpfd)
+ * 功能: 把套接字设置为非阻塞模式(事件循环模式下使用)
+ * 参数:
+ *   tcpfd - 套接字文件描述符
+ * 返回值:
+ *   成功返回0，失败返回-1
+ ********************************************************************/
+int TCP_SetNonBlock(int tcpfd)
+{
+    int flags = fcntl(tcpfd, F_GETFL, 0);
+    if(flags < 0 || fcntl(tcpfd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        perror("TCP_SetNonBlock:fcntl");
+        return -1;
+    }
+
+    return 0;
+}
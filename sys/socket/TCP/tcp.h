@@ -41,6 +41,7 @@ int TCP_InitServer(char *ipaddr , unsigned short int port);
 int TCP_SendData(int tcpfd, const unsigned char *databuf, int datasize);
 int TCP_RecvData(int tcpfd, unsigned char *tcpReadBuf, size_t bufsize, int nbyte,int timeout_ms);
 int TCP_RecvData_Block(int tcpfd, unsigned char *tcpReadBuf, size_t bufsize, int nbyte);
+int TCP_SetNonBlock(int tcpfd);
 
 #endif
 
@@ -6,54 +6,1001 @@
 
 #include "Database.h"
 
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*	SQLite页缓存:预分配的页数(每页DATABASE_PAGE_SIZE)，超过时才会向分级堆申请	*/
+#define DATABASE_PAGECACHE_PAGES	256
+
+/*	前三列为tUs、monoUs、run，数据列从第4列开始	*/
+#define DATABASE_FIRST_DATA_COLUMN	4
+
+/*	检查点线程自己的连接只读写WAL，页缓存用得很少	*/
+#define DATABASE_CHECKPOINT_CACHE_PAGES	16
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*	表	*/
+typedef enum
+{
+	DATABASE_TABLE_GPS = 0,
+	DATABASE_TABLE_MAINCABIN,
+	DATABASE_TABLE_CTD,
+	DATABASE_TABLE_DVL,
+	DATABASE_TABLE_USBL,
+	DATABASE_TABLE_DTU,
+	DATABASE_TABLE_SONAR,
+	DATABASE_TABLE_THRUSTER,
+	DATABASE_TABLE_TCP,
+	DATABASE_TABLE_NUM
+}databaseTable_t;
+
+/*	一张表:名称(兼容视图名，数据表为"<名称>Data")、数据列定义、数据列名、数据列数	*/
+typedef struct
+{
+	const char *name;
+	const char *columns;
+	const char *columnNames;
+	int columnNum;
+}databaseTableDef_t;
+
+/*	队列中的一条记录:采样时间和原始数据，写入线程再格式化、绑定参数	*/
+typedef struct
+{
+	databaseTable_t table;
+	int64_t stampNs;
+	union
+	{
+		gpsDataPack_t gps;
+		maincabinDataPack_t maincabin;
+		ctdDataPack_t ctd;
+		dvlDataPack_t dvl;
+		usblDataPack_t usbl;
+		sonarDataPack_t sonar;
+		thrusterDataPack_t thruster;
+		char text[DATABASE_TEXT_LEN];			//DTU、上位机收到的指令
+	}data;
+}databaseRecord_t;
+
+
 /************************************************************************************
  									全局变量
 *************************************************************************************/
 sqlite3 *g_database = NULL;
 
+static int64_t g_database_run = 0;					//运行编号(启动时的墙上时间，微秒)
+
+/*	预编译的语句和批量事务:各线程的插入共用一个事务，由g_database_mutex保护	*/
+static sqlite3_stmt *g_database_insert_stmt[DATABASE_TABLE_NUM];
+static sqlite3_stmt *g_database_begin_stmt = NULL;
+static sqlite3_stmt *g_database_commit_stmt = NULL;
+static pthread_mutex_t g_database_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int g_database_batch_rows = 0;				//当前事务中的行数
+static int64_t g_database_batch_startNs = 0;		//当前事务开始的时间，0为没有打开的事务
+static databaseStats_t g_database_stats;
+
+/*	异步写入:各线程入队，写入线程独占数据库写入	*/
+static ringQueue_t g_database_queue;
+static pthread_t g_database_writer_tid;
+static sqlite3 *g_database_writer_db = NULL;
+static int g_database_writer_running = 0;
+static int g_database_writer_efd = -1;					//入队时唤醒写入线程(eventfd)
+static int g_database_writer_sleeping = 0;				//写入线程准备等待时为1，生产者只在为1时写eventfd
+static databaseOverflow_t g_database_overflow = DATABASE_OVERFLOW_DROP_OLDEST;
+static unsigned long g_database_dropped = 0;			//队列满时丢弃的记录
+
+/*	默认配置	*/
+static const databaseConfig_t g_database_default_config = {
+	.wal = 1,
+	.synchronous = DATABASE_SYNC_NORMAL,
+	.pageSize = DATABASE_PAGE_SIZE,
+	.checkpointMs = DATABASE_CHECKPOINT_MS,
+	.checkpointPages = DATABASE_CHECKPOINT_PAGES
+};
+
+/*	WAL检查点线程:写入连接提交时记录WAL页数，检查点线程用另一个连接按时间或页数做检查点，
+	提交不再承担检查点的耗时	*/
+static databaseConfig_t g_database_config;
+static char g_database_filename[256];
+static pthread_t g_database_checkpoint_tid;
+static int g_database_checkpoint_running = 0;
+static int g_database_wal_pages = 0;					//WAL中还没有写回数据库的页数
+static unsigned long g_database_checkpoints = 0;
+static unsigned long g_database_checkpoint_failed = 0;
+
+/*	SQLite内部分配(语句编译、错误信息等)使用的分级堆:块大小、块数	*/
+static const poolClassConfig_t g_database_mem_classes[] = {
+	{64, 1024}, {128, 1024}, {256, 512}, {512, 256}, {1024, 128},
+	{2048, 64}, {4096, 32}, {8192, 32}, {16384, 8}, {65536, 4}
+};
+
 
 /************************************************************************************
  									指令
 *************************************************************************************/
-/*	GPS	*/
-const char Sql_createGPSTable[180] = {"create table GPS(time char, systemFlag char, isValid int, satelliteNum int, longitudeDirection char, longitude float, latitudeDirection char, latitude float);"}; 
+/*	各表的数据列，与databaseTable_t顺序一致。每张表保存在"<表名>Data"中，前三列为:
+	tUs(墙上时间，1970年起的微秒)、monoUs(单调时钟微秒，同一次运行内严格可比)、run(运行编号)；
+	"<表名>"为兼容视图，time列换算为"HH:MM:SS.mmm"，旧的查询语句和工具不用修改	*/
+static const databaseTableDef_t g_database_tables[DATABASE_TABLE_NUM] = {
+	[DATABASE_TABLE_GPS] = {"GPS",
+		"systemFlag text, isValid integer, satelliteNum integer, longitudeDirection text, longitude real, latitudeDirection text, latitude real",
+		"systemFlag, isValid, satelliteNum, longitudeDirection, longitude, latitudeDirection, latitude", 7},
+	[DATABASE_TABLE_MAINCABIN] = {"MainCabin",
+		"temperature real, humidity real, pressure real, isLeak01 text, isLeak02 text, deviceState text, releaser1State text, releaser2State text",
+		"temperature, humidity, pressure, isLeak01, isLeak02, deviceState, releaser1State, releaser2State", 8},
+	[DATABASE_TABLE_CTD] = {"CTD",
+		"temperature real, conductivity real, pressure real, depth real, salinity real, soundVelocity real, density real",
+		"temperature, conductivity, pressure, depth, salinity, soundVelocity, density", 7},
+	[DATABASE_TABLE_DVL] = {"DVL",
+		"pitch real, roll real, heading real, transducerEntryDepth real, speedX real, speedY real, speedZ real, buttomDistance real",
+		"pitch, roll, heading, transducerEntryDepth, speedX, speedY, speedZ, buttomDistance", 8},
+	[DATABASE_TABLE_USBL] = {"USBL", "recvdata text", "recvdata", 1},
+	[DATABASE_TABLE_DTU] = {"DTU", "recv text", "recv", 1},
+	[DATABASE_TABLE_SONAR] = {"Sonar", "bearing real, distance real", "bearing, distance", 2},
+	[DATABASE_TABLE_THRUSTER] = {"Thruster",		/*	每个电机一行	*/
+		"motor integer, speedSet integer, speed integer, current real, fault integer, stalled integer, responseMs integer",
+		"motor, speedSet, speed, current, fault, stalled, responseMs", 7},
+	[DATABASE_TABLE_TCP] = {"TCP", "recv text", "recv", 1},
+};
+
+/*	运行信息:每个数据库文件一行(合并多个文件分析时用run区分)	*/
+static const char Sql_createRunTable[] = {"create table if not exists Run(run integer primary key, startUs integer, startMonoUs integer, file text);"};
+
+/*	兼容视图中的time列:本地时间"HH:MM:SS.mmm"	*/
+#define DATABASE_SQL_LEGACY_TIME	"strftime('%%H:%%M:%%f', tUs / 1000000.0, 'unixepoch', 'localtime')"
+
+/*	迁移旧文件时把time列("HH:MM:SS"或"HH:MM:SS.mmm"，本地时间)换算为tUs:
+	?1为文件名中的日期，?2为文件名中的开始时间，早于开始时间的行属于第二天。
+	全程整数运算(unixepoch需要SQLite 3.38以上)，秒的小数部分按字符补齐到6位直接取微秒，
+	不经过julianday的浮点换算，不会有微秒级的误差	*/
+#define DATABASE_SQL_MIGRATE_TUS	"(unixepoch(?1 || ' ' || time, case when time < ?2 then '+1 day' else '+0 day' end, 'utc') * 1000000 " \
+									"+ case when length(time) > 9 then cast(substr(time || '00000', 10, 6) as integer) else 0 end)"
+
+/*******************************************************************
+ * 函数原型:static int Database_commit(sqlite3 *db)
+ * 函数简介:提交当前事务(调用者持有g_database_mutex)，失败时回滚，这一批插入丢弃
+ * 函数参数:db:数据库指针
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_commit(sqlite3 *db)
+{
+	int ret = 0;
+
+	Trace_begin("db", "commit");
+	if(sqlite3_step(g_database_commit_stmt) != SQLITE_DONE)
+	{
+		fprintf(stderr, "database commit error:%s\n", sqlite3_errmsg(db));
+		if(!sqlite3_get_autocommit(db))
+		{
+			sqlite3_exec(db, "rollback;", NULL, NULL, NULL);
+		}
+		g_database_stats.failedCommits++;
+		ret = -1;
+	}
+	else
+	{
+		g_database_stats.commits++;
+	}
+	sqlite3_reset(g_database_commit_stmt);
+	Trace_end("db", "commit");
+
+	g_database_batch_rows = 0;
+	g_database_batch_startNs = 0;
+
+	return ret;
+}
+
+/*******************************************************************
+ * 函数原型:static sqlite3_stmt *Database_beginRow(sqlite3 *db, databaseTable_t table)
+ * 函数简介:开始插入一行:加锁，没有打开的事务时开始一个事务，返回该表的插入语句供绑定参数
+ * 函数参数:db:数据库指针，table:表
+ * 函数返回值: 插入语句(之后必须调用Database_stepRow、Database_endRow)
+ *****************************************************************/
+static sqlite3_stmt *Database_beginRow(sqlite3 *db, databaseTable_t table)
+{
+	pthread_mutex_lock(&g_database_mutex);
+	if(g_database_batch_startNs == 0)
+	{
+		/*	开始失败时g_database_batch_startNs保持0，这一行按自动提交写入，下一行再重试开始事务	*/
+		if(sqlite3_step(g_database_begin_stmt) != SQLITE_DONE)
+		{
+			fprintf(stderr, "database begin error:%s\n", sqlite3_errmsg(db));
+		}
+		else
+		{
+			g_database_batch_startNs = Clock_nowNs();
+		}
+		sqlite3_reset(g_database_begin_stmt);
+	}
+
+	return g_database_insert_stmt[table];
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_stepRow(sqlite3 *db, databaseTable_t table)
+ * 函数简介:执行已绑定参数的插入语句，之后语句复位供下一行使用
+ * 函数参数:db:数据库指针，table:表
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_stepRow(sqlite3 *db, databaseTable_t table)
+{
+	sqlite3_stmt *stmt = g_database_insert_stmt[table];
+	int ret = 0;
+
+	Trace_begin("db", g_database_tables[table].name);
+	if(sqlite3_step(stmt) != SQLITE_DONE)
+	{
+		fprintf(stderr, "database insert %s data error:%s\n", g_database_tables[table].name, sqlite3_errmsg(db));
+		g_database_stats.failedRows++;
+		ret = -1;
+	}
+	else
+	{
+		g_database_stats.rows++;
+		g_database_batch_rows++;
+	}
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	Trace_end("db", g_database_tables[table].name);
+
+	return ret;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_endRow(sqlite3 *db, int ret)
+ * 函数简介:结束插入一行:事务中的行数或时间到了阈值时提交，然后解锁
+ * 函数参数:db:数据库指针，ret:Database_stepRow的返回值
+ * 函数返回值: ret
+ *****************************************************************/
+static int Database_endRow(sqlite3 *db, int ret)
+{
+	if(g_database_batch_startNs == 0)
+	{
+		g_database_batch_rows = 0;			//没有打开的事务，这一行已自动提交
+	}
+	else if(g_database_batch_rows >= DATABASE_BATCH_ROWS || Clock_sinceMs(g_database_batch_startNs) >= DATABASE_BATCH_MS)
+	{
+		Database_commit(db);
+	}
+	pthread_mutex_unlock(&g_database_mutex);
+
+	return ret;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_bindStamp(sqlite3_stmt *stmt, int64_t stampNs)
+ * 函数简介:绑定每行的前三列(tUs、monoUs、run)
+ * 函数参数:stmt:插入语句，stampNs:采样时间戳(单调时钟纳秒)
+ * 函数返回值: 第一个数据列的序号
+ *****************************************************************/
+static int Database_bindStamp(sqlite3_stmt *stmt, int64_t stampNs)
+{
+	sqlite3_bind_int64(stmt, 1, Clock_toEpochNs(stampNs) / CLOCK_NS_PER_US);
+	sqlite3_bind_int64(stmt, 2, stampNs / CLOCK_NS_PER_US);
+	sqlite3_bind_int64(stmt, 3, g_database_run);
+
+	return DATABASE_FIRST_DATA_COLUMN;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_writeRecord(sqlite3 *db, const databaseRecord_t *rec)
+ * 函数简介:把一条记录写入对应的表(在当前批量事务中)
+ * 函数参数:db:数据库指针，rec:记录
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_writeRecord(sqlite3 *db, const databaseRecord_t *rec)
+{
+	sqlite3_stmt *stmt = Database_beginRow(db, rec->table);
+	int col = Database_bindStamp(stmt, rec->stampNs);
+	int ret = 0;
+
+	switch(rec->table)
+	{
+		case DATABASE_TABLE_GPS:
+		{
+			const gpsDataPack_t *p = &rec->data.gps;
+			sqlite3_bind_text(stmt, col++, p->systemFlag, strnlen(p->systemFlag, sizeof(p->systemFlag)), SQLITE_STATIC);
+			sqlite3_bind_int(stmt, col++, p->isValid);
+			sqlite3_bind_int(stmt, col++, p->satelliteNum);
+			sqlite3_bind_text(stmt, col++, &p->longitudeDirection, 1, SQLITE_STATIC);
+			sqlite3_bind_double(stmt, col++, p->longitude);
+			sqlite3_bind_text(stmt, col++, &p->latitudeDirection, 1, SQLITE_STATIC);
+			sqlite3_bind_double(stmt, col++, p->latitude);
+			ret = Database_stepRow(db, rec->table);
+			break;
+		}
+		case DATABASE_TABLE_MAINCABIN:
+		{
+			const maincabinDataPack_t *p = &rec->data.maincabin;
+			sqlite3_bind_double(stmt, col++, p->temperature);
+			sqlite3_bind_double(stmt, col++, p->humidity);
+			sqlite3_bind_double(stmt, col++, p->pressure);
+			sqlite3_bind_text(stmt, col++, p->isLeak01, strnlen(p->isLeak01, sizeof(p->isLeak01)), SQLITE_STATIC);
+			sqlite3_bind_text(stmt, col++, p->isLeak02, strnlen(p->isLeak02, sizeof(p->isLeak02)), SQLITE_STATIC);
+			sqlite3_bind_text(stmt, col++, p->deviceState, strnlen(p->deviceState, sizeof(p->deviceState)), SQLITE_STATIC);
+			sqlite3_bind_text(stmt, col++, p->releaser1State, strnlen(p->releaser1State, sizeof(p->releaser1State)), SQLITE_STATIC);
+			sqlite3_bind_text(stmt, col++, p->releaser2State, strnlen(p->releaser2State, sizeof(p->releaser2State)), SQLITE_STATIC);
+			ret = Database_stepRow(db, rec->table);
+			break;
+		}
+		case DATABASE_TABLE_CTD:
+		{
+			const ctdDataPack_t *p = &rec->data.ctd;
+			sqlite3_bind_double(stmt, col++, p->temperature);
+			sqlite3_bind_double(stmt, col++, p->conductivity);
+			sqlite3_bind_double(stmt, col++, p->pressure);
+			sqlite3_bind_double(stmt, col++, p->depth);
+			sqlite3_bind_double(stmt, col++, p->salinity);
+			sqlite3_bind_double(stmt, col++, p->soundVelocity);
+			sqlite3_bind_double(stmt, col++, p->density);
+			ret = Database_stepRow(db, rec->table);
+			break;
+		}
+		case DATABASE_TABLE_DVL:
+		{
+			const dvlDataPack_t *p = &rec->data.dvl;
+			sqlite3_bind_double(stmt, col++, p->pitch);
+			sqlite3_bind_double(stmt, col++, p->roll);
+			sqlite3_bind_double(stmt, col++, p->heading);
+			sqlite3_bind_double(stmt, col++, p->transducerEntryDepth);
+			sqlite3_bind_double(stmt, col++, p->speedX);
+			sqlite3_bind_double(stmt, col++, p->speedY);
+			sqlite3_bind_double(stmt, col++, p->speedZ);
+			sqlite3_bind_double(stmt, col++, p->buttomDistance);
+			ret = Database_stepRow(db, rec->table);
+			break;
+		}
+		case DATABASE_TABLE_USBL:
+			sqlite3_bind_text(stmt, col, rec->data.usbl.recvdata, strnlen(rec->data.usbl.recvdata, sizeof(rec->data.usbl.recvdata)), SQLITE_STATIC);
+			ret = Database_stepRow(db, rec->table);
+			break;
+		case DATABASE_TABLE_DTU:
+		case DATABASE_TABLE_TCP:
+			sqlite3_bind_text(stmt, col, rec->data.text, -1, SQLITE_STATIC);
+			ret = Database_stepRow(db, rec->table);
+			break;
+		case DATABASE_TABLE_SONAR:
+			sqlite3_bind_double(stmt, col++, rec->data.sonar.obstaclesBearing);
+			sqlite3_bind_double(stmt, col++, rec->data.sonar.obstaclesDistance);
+			ret = Database_stepRow(db, rec->table);
+			break;
+		case DATABASE_TABLE_THRUSTER:
+			for(int i = 0; i < THRUSTER_MOTOR_NUM && ret == 0; i++)
+			{
+				const thrusterMotorData_t *m = &rec->data.thruster.motor[i];
+				col = Database_bindStamp(stmt, rec->stampNs);
+				sqlite3_bind_int(stmt, col++, i + 1);
+				sqlite3_bind_int(stmt, col++, m->speedSet);
+				sqlite3_bind_int(stmt, col++, m->speed);
+				sqlite3_bind_double(stmt, col++, m->current);
+				sqlite3_bind_int(stmt, col++, m->fault);
+				sqlite3_bind_int(stmt, col++, m->stalled);
+				sqlite3_bind_int64(stmt, col++, m->responseMs);
+				ret = Database_stepRow(db, rec->table);
+			}
+			break;
+		default:
+			ret = -1;
+			break;
+	}
+
+	return Database_endRow(db, ret);
+}
+
+/*******************************************************************
+ * 函数原型:static void Database_wakeWriter(void)
+ * 函数简介:入队后唤醒写入线程。写入线程正忙时只读一个标志，不做系统调用
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Database_wakeWriter(void)
+{
+	/*	与写入线程"置等待标志后再看队列"配对:入队在前、看标志在后，两边至少有一方看到对方	*/
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&g_database_writer_sleeping, __ATOMIC_RELAXED) &&
+	   __atomic_exchange_n(&g_database_writer_sleeping, 0, __ATOMIC_RELAXED))
+	{
+		uint64_t one = 1;
+		if(write(g_database_writer_efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		{
+			perror("Database_wakeWriter:eventfd write");
+		}
+	}
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_submit(sqlite3 *db, databaseRecord_t *rec)
+ * 函数简介:提交一条记录:写入线程在运行时入队(不阻塞)，否则在调用线程中直接写入。
+ *          队列满时按g_database_overflow丢弃最旧或最新的一条并计数，入库不会反过来卡住控制
+ * 函数参数:db:数据库指针，rec:记录(stampNs为0时取当前时间)
+ * 函数返回值: 成功返回0，丢弃了这条记录或写入失败返回-1
+ *****************************************************************/
+static int Database_submit(sqlite3 *db, databaseRecord_t *rec)
+{
+	if(rec->stampNs == 0)
+	{
+		rec->stampNs = Clock_nowNs();
+	}
+
+	if(!__atomic_load_n(&g_database_writer_running, __ATOMIC_ACQUIRE))
+	{
+		return Database_writeRecord(db, rec);
+	}
+
+	while(Ring_push(&g_database_queue, rec) < 0)
+	{
+		if(g_database_overflow == DATABASE_OVERFLOW_DROP_NEWEST)
+		{
+			__atomic_fetch_add(&g_database_dropped, 1, __ATOMIC_RELAXED);
+			return -1;
+		}
+
+		databaseRecord_t oldest;
+		if(Ring_pop(&g_database_queue, &oldest) == 0)
+		{
+			__atomic_fetch_add(&g_database_dropped, 1, __ATOMIC_RELAXED);
+		}
+	}
+	Database_wakeWriter();
+
+	return 0;
+}
+
+/*******************************************************************
+ * 函数原型:static void Database_waitRecord(void)
+ * 函数简介:队列空时等待入队唤醒。有未提交的事务时最多等到提交时间，否则最多等DATABASE_IDLE_WAIT_MS
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Database_waitRecord(void)
+{
+	struct pollfd pfd = {g_database_writer_efd, POLLIN, 0};
+	int timeoutMs = DATABASE_IDLE_WAIT_MS;
+	uint64_t count;
+
+	/*	事务只在写入线程中打开和提交，不需要加锁	*/
+	if(g_database_batch_startNs != 0)
+	{
+		int64_t leftMs = DATABASE_BATCH_MS - Clock_sinceMs(g_database_batch_startNs);
+		timeoutMs = leftMs <= 0 ? 0 : (leftMs < timeoutMs ? (int)leftMs : timeoutMs);
+	}
+
+	/*	1.先置等待标志再看队列，置标志之前入队的记录在这里能看到	*/
+	__atomic_store_n(&g_database_writer_sleeping, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(Ring_count(&g_database_queue) == 0 && __atomic_load_n(&g_database_writer_running, __ATOMIC_ACQUIRE))
+	{
+		poll(&pfd, 1, timeoutMs);
+	}
+	__atomic_store_n(&g_database_writer_sleeping, 0, __ATOMIC_RELAXED);
+
+	/*	2.清零计数(非阻塞，超时醒来时没有计数)	*/
+	if(read(g_database_writer_efd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+	{
+		perror("Database_waitRecord:eventfd read");
+	}
+}
+
+/*******************************************************************
+ * 函数原型:static void *Database_WriterThread(void *arg)
+ * 函数简介:写入线程，独占数据库写入:取出队列中的记录写入批量事务，队列空时等待入队唤醒，按时间提交
+ * 函数参数:arg:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void *Database_WriterThread(void *arg)
+{
+	(void)arg;
+	databaseRecord_t rec;
+
+	Rt_enterThread(RT_ROLE_BACKGROUND);
+	Trace_instant("db", "writer");
+
+	for(;;)
+	{
+		if(Ring_pop(&g_database_queue, &rec) == 0)
+		{
+			Database_writeRecord(g_database_writer_db, &rec);
+			continue;
+		}
+
+		Database_flush(g_database_writer_db, 0);
+		if(!__atomic_load_n(&g_database_writer_running, __ATOMIC_ACQUIRE))
+		{
+			break;
+		}
+		Database_waitRecord();
+	}
+
+	return NULL;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_walHook(void *arg, sqlite3 *db, const char *name, int pages)
+ * 函数简介:写入连接每次提交后由SQLite调用，记录WAL中的页数供检查点线程判断(代替自动检查点)
+ * 函数参数:arg:无，db:数据库指针，name:数据库名，pages:WAL中的页数
+ * 函数返回值: SQLITE_OK
+ *****************************************************************/
+static int Database_walHook(void *arg, sqlite3 *db, const char *name, int pages)
+{
+	(void)arg;
+	(void)db;
+	(void)name;
+	__atomic_store_n(&g_database_wal_pages, pages, __ATOMIC_RELAXED);
+
+	return SQLITE_OK;
+}
+
+/*******************************************************************
+ * 函数原型:static void *Database_CheckpointThread(void *arg)
+ * 函数简介:检查点线程，WAL页数超过阈值或距上次检查点超过时间阈值时做一次PASSIVE检查点
+ *          (不等待读者和写入，写不完的页留到下一次)
+ * 函数参数:arg:检查点使用的连接
+ * 函数返回值: 无
+ *****************************************************************/
+static void *Database_CheckpointThread(void *arg)
+{
+	sqlite3 *db = (sqlite3 *)arg;
+	struct timespec poll = {0, DATABASE_CHECKPOINT_POLL_MS * 1000000L};
+	int64_t lastNs = Clock_nowNs();
+
+	Rt_enterThread(RT_ROLE_BACKGROUND);
+	Trace_instant("db", "checkpointer");			//启动时分配本线程的追踪缓冲区，不留到封存内存池之后
+
+	while(__atomic_load_n(&g_database_checkpoint_running, __ATOMIC_ACQUIRE))
+	{
+		nanosleep(&poll, NULL);
+
+		int pages = __atomic_load_n(&g_database_wal_pages, __ATOMIC_RELAXED);
+		if(pages <= 0 || (pages < g_database_config.checkpointPages &&
+						  Clock_sinceMs(lastNs) < g_database_config.checkpointMs))
+		{
+			continue;
+		}
+
+		int logPages = 0, donePages = 0;
+		Trace_begin("db", "checkpoint");
+		int rc = sqlite3_wal_checkpoint_v2(db, NULL, SQLITE_CHECKPOINT_PASSIVE, &logPages, &donePages);
+		Trace_end("db", "checkpoint");
+		if(rc == SQLITE_OK)
+		{
+			__atomic_store_n(&g_database_wal_pages, logPages - donePages, __ATOMIC_RELAXED);
+			__atomic_fetch_add(&g_database_checkpoints, 1, __ATOMIC_RELAXED);
+		}
+		else
+		{
+			__atomic_fetch_add(&g_database_checkpoint_failed, 1, __ATOMIC_RELAXED);
+		}
+		lastNs = Clock_nowNs();
+	}
+
+	sqlite3_close(db);
+	return NULL;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_startCheckpointer(sqlite3 *db)
+ * 函数简介:接管写入连接的WAL通知(同时关闭自动检查点)，打开检查点连接并启动检查点线程
+ * 函数参数:db:写入连接
+ * 函数返回值: 成功返回0，失败返回-1(改回提交时自动检查点)
+ *****************************************************************/
+static int Database_startCheckpointer(sqlite3 *db)
+{
+	sqlite3 *ckptDb = NULL;
+
+	if(sqlite3_open_v2(g_database_filename, &ckptDb, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK)
+	{
+		fprintf(stderr, "database start checkpointer error:%s\n", sqlite3_errmsg(ckptDb));
+		sqlite3_close(ckptDb);
+		return -1;
+	}
+
+	char sql[64];
+	snprintf(sql, sizeof(sql), "pragma cache_size=%d;", DATABASE_CHECKPOINT_CACHE_PAGES);
+	sqlite3_exec(ckptDb, sql, NULL, NULL, NULL);
+
+	sqlite3_wal_hook(db, Database_walHook, NULL);
+	__atomic_store_n(&g_database_checkpoint_running, 1, __ATOMIC_RELEASE);
+	if(pthread_create(&g_database_checkpoint_tid, NULL, Database_CheckpointThread, ckptDb) != 0)
+	{
+		fprintf(stderr, "database start checkpointer error: pthread_create failed\n");
+		__atomic_store_n(&g_database_checkpoint_running, 0, __ATOMIC_RELEASE);
+		sqlite3_wal_autocheckpoint(db, g_database_config.checkpointPages);
+		sqlite3_close(ckptDb);
+		return -1;
+	}
+	ProcStat_setThreadName(g_database_checkpoint_tid, "db-ckpt");
+
+	return 0;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_configure(sqlite3 *db, const databaseConfig_t *config)
+ * 函数简介:建表之前设置页大小、日志模式和同步方式
+ * 函数参数:db:数据库指针，config:配置
+ * 函数返回值: 成功返回0，WAL模式打开失败返回-1(数据库仍可用，为回滚日志模式)
+ *****************************************************************/
+static int Database_configure(sqlite3 *db, const databaseConfig_t *config)
+{
+	char sql[64];
+	int ret = 0;
+
+	/*	1.页大小:只在数据库为空时生效，必须在建表和切换到WAL之前	*/
+	snprintf(sql, sizeof(sql), "pragma page_size=%d;", config->pageSize);
+	sqlite3_exec(db, sql, NULL, NULL, NULL);
+
+	/*	2.日志模式:WAL时写入只追加到-wal文件，运行中可以用sqlite3只读查看，
+		异常退出后下次打开时自动恢复已提交的数据	*/
+	if(config->wal)
+	{
+		sqlite3_stmt *stmt = NULL;
+		if(sqlite3_prepare_v2(db, "pragma journal_mode=wal;", -1, &stmt, NULL) != SQLITE_OK ||
+		   sqlite3_step(stmt) != SQLITE_ROW ||
+		   strcmp((const char *)sqlite3_column_text(stmt, 0), "wal") != 0)
+		{
+			fprintf(stderr, "database configure error: journal_mode=wal failed:%s\n", sqlite3_errmsg(db));
+			ret = -1;
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	/*	3.同步方式	*/
+	snprintf(sql, sizeof(sql), "pragma synchronous=%d;", config->synchronous);
+	sqlite3_exec(db, sql, NULL, NULL, NULL);
+
+	return ret;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_execSql(sqlite3 *db, const char *sql)
+ * 函数简介:执行一条不返回结果的语句，失败时打印语句和错误
+ * 函数参数:db:数据库指针，sql:语句
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_execSql(sqlite3 *db, const char *sql)
+{
+	char *errmsg = NULL;
+
+	if(sqlite3_exec(db, sql, NULL, NULL, &errmsg) != SQLITE_OK)
+	{
+		fprintf(stderr, "database exec error:%s (%s)\n", errmsg, sql);
+		sqlite3_free(errmsg);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_createSchema(sqlite3 *db)
+ * 函数简介:创建各表的数据表、时间索引和运行信息表(已存在的跳过)
+ * 函数参数:db:数据库指针
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_createSchema(sqlite3 *db)
+{
+	char sql[512];
+
+	for(int i = 0; i < DATABASE_TABLE_NUM; i++)
+	{
+		const databaseTableDef_t *def = &g_database_tables[i];
+
+		snprintf(sql, sizeof(sql), "create table if not exists %sData(tUs integer, monoUs integer, run integer, %s);",
+				 def->name, def->columns);
+		if(Database_execSql(db, sql) < 0)
+		{
+			return -1;
+		}
+
+		/*	按时间范围查询时走索引，不扫描整张表	*/
+		snprintf(sql, sizeof(sql), "create index if not exists %sData_tUs on %sData(tUs);", def->name, def->name);
+		if(Database_execSql(db, sql) < 0)
+		{
+			return -1;
+		}
+	}
+
+	return Database_execSql(db, Sql_createRunTable);
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_createViews(sqlite3 *db)
+ * 函数简介:创建兼容视图(与旧表同名，time列为本地时间字符串)，记录数据库格式版本
+ * 函数参数:db:数据库指针
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_createViews(sqlite3 *db)
+{
+	char sql[512];
+
+	for(int i = 0; i < DATABASE_TABLE_NUM; i++)
+	{
+		const databaseTableDef_t *def = &g_database_tables[i];
+
+		snprintf(sql, sizeof(sql), "create view if not exists %s as select " DATABASE_SQL_LEGACY_TIME " as time, %s from %sData;",
+				 def->name, def->columnNames, def->name);
+		if(Database_execSql(db, sql) < 0)
+		{
+			return -1;
+		}
+	}
+
+	snprintf(sql, sizeof(sql), "pragma user_version=%d;", DATABASE_SCHEMA_VERSION);
+	return Database_execSql(db, sql);
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_insertRun(sqlite3 *db, int64_t run, int64_t startMonoUs, const char *path)
+ * 函数简介:在运行信息表中记录一次运行
+ * 函数参数:db:数据库指针，run:运行编号(开始时的墙上时间，微秒)，startMonoUs:开始时的单调时钟(未知时为0)，
+ *          path:数据库文件
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_insertRun(sqlite3 *db, int64_t run, int64_t startMonoUs, const char *path)
+{
+	const char *file = strrchr(path, '/');
+	sqlite3_stmt *stmt = NULL;
+	int ret = 0;
+
+	if(sqlite3_prepare_v2(db, "insert or replace into Run values(?,?,?,?);", -1, &stmt, NULL) != SQLITE_OK)
+	{
+		fprintf(stderr, "database insert run error:%s\n", sqlite3_errmsg(db));
+		return -1;
+	}
+	sqlite3_bind_int64(stmt, 1, run);
+	sqlite3_bind_int64(stmt, 2, run);
+	if(startMonoUs != 0)
+	{
+		sqlite3_bind_int64(stmt, 3, startMonoUs);
+	}
+	sqlite3_bind_text(stmt, 4, file != NULL ? file + 1 : path, -1, SQLITE_STATIC);
+	if(sqlite3_step(stmt) != SQLITE_DONE)
+	{
+		fprintf(stderr, "database insert run error:%s\n", sqlite3_errmsg(db));
+		ret = -1;
+	}
+	sqlite3_finalize(stmt);
+
+	return ret;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_startRun(sqlite3 *db, const char *path)
+ * 函数简介:开始本次运行:以当前墙上时间(或配置中给定的编号)作为运行编号并记录
+ * 函数参数:db:数据库指针，path:数据库文件
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_startRun(sqlite3 *db, const char *path)
+{
+	int64_t nowNs = Clock_nowNs();
+
+	if(g_database_config.run != 0)
+	{
+		g_database_run = g_database_config.run;
+		return Database_insertRun(db, g_database_run, 0, path);
+	}
+	g_database_run = Clock_toEpochNs(nowNs) / CLOCK_NS_PER_US;
+
+	return Database_insertRun(db, g_database_run, nowNs / CLOCK_NS_PER_US, path);
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_migrateTable(sqlite3 *db, const databaseTableDef_t *def, const char *date,
+ *                                           const char *start, int64_t run)
+ * 函数简介:把旧格式的一张表(time为"HH:MM:SS"字符串)搬到新的数据表中并删除旧表，
+ *          只搬两边都有的列(早期文件的列可能不全)
+ * 函数参数:db:数据库指针，def:表，date:文件名中的日期，start:文件名中的开始时间，run:运行编号
+ * 函数返回值: 搬移的行数，旧表不存在返回0，失败返回-1
+ *****************************************************************/
+static int Database_migrateTable(sqlite3 *db, const databaseTableDef_t *def, const char *date, const char *start, int64_t run)
+{
+	char dataName[32];
+	char columns[256] = {0};
+	char sql[1024];
+	sqlite3_stmt *stmt = NULL;
+	int ret = -1;
+
+	snprintf(dataName, sizeof(dataName), "%sData", def->name);
+
+	/*	1.旧表不存在或已是视图时不处理	*/
+	if(sqlite3_prepare_v2(db, "select type from sqlite_master where name = ?1;", -1, &stmt, NULL) != SQLITE_OK)
+	{
+		fprintf(stderr, "database migrate %s error:%s\n", def->name, sqlite3_errmsg(db));
+		return -1;
+	}
+	sqlite3_bind_text(stmt, 1, def->name, -1, SQLITE_STATIC);
+	int exist = sqlite3_step(stmt) == SQLITE_ROW && strcmp((const char *)sqlite3_column_text(stmt, 0), "table") == 0;
+	sqlite3_finalize(stmt);
+	if(!exist)
+	{
+		return 0;
+	}
+
+	/*	2.两边都有的列	*/
+	if(sqlite3_prepare_v2(db, "select group_concat(o.name, ', ') from pragma_table_info(?1) o "
+							  "join pragma_table_info(?2) n on o.name = n.name;", -1, &stmt, NULL) != SQLITE_OK)
+	{
+		fprintf(stderr, "database migrate %s error:%s\n", def->name, sqlite3_errmsg(db));
+		return -1;
+	}
+	sqlite3_bind_text(stmt, 1, def->name, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, dataName, -1, SQLITE_STATIC);
+	if(sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0) != NULL)
+	{
+		snprintf(columns, sizeof(columns), ", %s", (const char *)sqlite3_column_text(stmt, 0));
+	}
+	sqlite3_finalize(stmt);
+
+	/*	3.搬移并删除旧表	*/
+	snprintf(sql, sizeof(sql), "insert into %s(tUs, monoUs, run%s) select " DATABASE_SQL_MIGRATE_TUS ", NULL, %lld%s from %s;",
+			 dataName, columns, (long long)run, columns, def->name);
+	if(sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+	{
+		fprintf(stderr, "database migrate %s error:%s\n", def->name, sqlite3_errmsg(db));
+		return -1;
+	}
+	sqlite3_bind_text(stmt, 1, date, -1, SQLITE_STATIC);
+	sqlite3_bind_text(stmt, 2, start, -1, SQLITE_STATIC);
+	if(sqlite3_step(stmt) == SQLITE_DONE)
+	{
+		ret = sqlite3_changes(db);
+	}
+	else
+	{
+		fprintf(stderr, "database migrate %s error:%s\n", def->name, sqlite3_errmsg(db));
+	}
+	sqlite3_finalize(stmt);
+
+	snprintf(sql, sizeof(sql), "drop table %s;", def->name);
+	if(ret >= 0 && Database_execSql(db, sql) < 0)
+	{
+		ret = -1;
+	}
+
+	return ret;
+}
+
+/*******************************************************************
+ * 函数原型:static int Database_prepare(sqlite3 *db)
+ * 函数简介:编译各表的插入语句和事务语句(建表之后调用一次)
+ * 函数参数:db:数据库指针
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Database_prepare(sqlite3 *db)
+{
+	char sql[256];
+
+	for(int i = 0; i < DATABASE_TABLE_NUM; i++)
+	{
+		/*	insert into <表名>Data values(?,?,?,?...);	*/
+		int len = snprintf(sql, sizeof(sql), "insert into %sData values(?,?,?", g_database_tables[i].name);
+		for(int j = 0; j < g_database_tables[i].columnNum; j++)
+		{
+			len += snprintf(sql + len, sizeof(sql) - len, ",?");
+		}
+		snprintf(sql + len, sizeof(sql) - len, ");");
+
+		if(sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &g_database_insert_stmt[i], NULL) != SQLITE_OK)
+		{
+			fprintf(stderr, "database prepare %s error:%s\n", g_database_tables[i].name, sqlite3_errmsg(db));
+			return -1;
+		}
+	}
+
+	if(sqlite3_prepare_v3(db, "begin;", -1, SQLITE_PREPARE_PERSISTENT, &g_database_begin_stmt, NULL) != SQLITE_OK ||
+	   sqlite3_prepare_v3(db, "commit;", -1, SQLITE_PREPARE_PERSISTENT, &g_database_commit_stmt, NULL) != SQLITE_OK)
+	{
+		fprintf(stderr, "database prepare transaction error:%s\n", sqlite3_errmsg(db));
+		return -1;
+	}
+	return 0;
+}
+
+/*	SQLite内存接口，转到分级堆	*/
+static void *Database_memMalloc(int size)
+{
+	return Pool_heapAlloc((size_t)size);
+}
+
+static void Database_memFree(void *ptr)
+{
+	Pool_heapFree(ptr);
+}
+
+static void *Database_memRealloc(void *ptr, int size)
+{
+	return Pool_heapRealloc(ptr, (size_t)size);
+}
+
+static int Database_memSize(void *ptr)
+{
+	return (int)Pool_heapSize(ptr);
+}
+
+static int Database_memRoundup(int size)
+{
+	return (size + 7) & ~7;
+}
 
-/*	MainCabin	*/
-const char Sql_createMainCabinTable[180] = {"create table MainCabin(time char, temperature float, humidity float, pressure float, isLeak01 char, isLeak02 char, deviceState char, releaser1State char, releaser2State char);"};
+static int Database_memInit(void *arg)
+{
+	(void)arg;
+	return SQLITE_OK;
+}
 
-/*	CTD	*/
-const char Sql_createCTDTable[180] = {"create table CTD(time char, temperature float, conductivity float, pressure float, depth float, salinity float, soundVelocity float, density float);"};
+static void Database_memShutdown(void *arg)
+{
+	(void)arg;
+}
 
-/*	DVL*/
-const char Sql_createDVLTable[180] = {"create table DVL(time char, pitch float, roll float, heading float, transducerEntryDepth float, speedX float, speedY float, speedZ float, buttomDistance float);"};
+/*******************************************************************
+ * 函数原型:static int Database_configMemory(void)
+ * 函数简介:在打开数据库之前配置SQLite的内存:内部分配改用分级堆，页缓存一次分配好，
+ *          关闭内存统计(省掉每次分配的全局锁)。稳定运行时SQLite不再调用malloc
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1(SQLite仍使用默认的malloc)
+ *****************************************************************/
+static int Database_configMemory(void)
+{
+	static sqlite3_mem_methods methods = {
+		Database_memMalloc, Database_memFree, Database_memRealloc, Database_memSize,
+		Database_memRoundup, Database_memInit, Database_memShutdown, NULL
+	};
 
-/*	USBL*/
-const char Sql_createUSBLTable[64] = {"create table USBL(time char, recvdata char);"};
+	if(Pool_heapInit(g_database_mem_classes, sizeof(g_database_mem_classes) / sizeof(g_database_mem_classes[0])) < 0)
+	{
+		fprintf(stderr, "database config memory error: pool init failed\n");
+		return -1;
+	}
 
-/*	DTU*/
-const char Sql_createDTUTable[64] = {"create table DTU(time char, recv char);"};
+	sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 0);
+	if(sqlite3_config(SQLITE_CONFIG_MALLOC, &methods) != SQLITE_OK)
+	{
+		fprintf(stderr, "database config memory error: SQLITE_CONFIG_MALLOC failed\n");
+		return -1;
+	}
 
-/*	Sonar*/
-const char Sql_createSonarTable[64] = {"create table Sonar(time char, bearing float, distance float);"};
+	/*	每页还带有页缓存的头部	*/
+	int hdrSize = 0;
+	sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &hdrSize);
+	int slotSize = (DATABASE_PAGE_SIZE + hdrSize + 7) & ~7;
+	void *pageCache = malloc((size_t)slotSize * DATABASE_PAGECACHE_PAGES);
+	if(pageCache == NULL || sqlite3_config(SQLITE_CONFIG_PAGECACHE, pageCache, slotSize, DATABASE_PAGECACHE_PAGES) != SQLITE_OK)
+	{
+		fprintf(stderr, "database config memory error: page cache\n");
+		free(pageCache);
+		return -1;
+	}
 
-/*	ConnectHost	*/
-const char Sql_createTCPRecvTable[64] = {"create table TCP(time char, recv char);"};
+	return 0;
+}
 
 /*******************************************************************
- * 函数原型:int Database_init(sqlite3 *db)
- * 函数简介:初始化sqlite3，主要进行创建数据库，并创建表。
- * 函数参数:db:数据库指针
+ * 函数原型:sqlite3 *Database_init(sqlite3 *db, const databaseConfig_t *config)
+ * 函数简介:初始化sqlite3，主要进行创建数据库，按配置设置日志模式，并创建表。
+ * 函数参数:db:数据库指针，config:配置，NULL为默认配置
  * 函数返回值: 成功返回数据库指针，失败返回 NULL
  *****************************************************************/
-sqlite3 *Database_init(sqlite3 *db)
+sqlite3 *Database_init(sqlite3 *db, const databaseConfig_t *config)
 {
     time_t now = time(NULL);	
 	struct tm *nowtime = localtime(&now);
 	char time[32] = {0};
     sprintf(time, "%d-%02d-%02d--%02d:%02d:%02d.db",nowtime->tm_year + 1900,nowtime->tm_mon + 1,nowtime->tm_mday,\
     											nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-	char filename[64] = {"../database/"};
-	strcat(filename,time);
+	g_database_config = config != NULL ? *config : g_database_default_config;
+
+	char *filename = g_database_filename;
+	if(g_database_config.path != NULL)
+	{
+		snprintf(filename, sizeof(g_database_filename), "%s", g_database_config.path);
+	}
+	else
+	{
+		snprintf(filename, sizeof(g_database_filename), "../database/%s", time);
+	}
+
+	Database_configMemory();
 
 	if(sqlite3_open(filename, &db) != 0)
 	{
@@ -61,64 +1008,54 @@ sqlite3 *Database_init(sqlite3 *db)
 		return NULL;
 	}
 
-    char *errmsg = NULL;
+	char Sql_cacheSize[64];
+	snprintf(Sql_cacheSize, sizeof(Sql_cacheSize), "pragma cache_size=%d;", DATABASE_PAGECACHE_PAGES);
+	sqlite3_exec(db, Sql_cacheSize, NULL, NULL, NULL);
+	if(Database_configure(db, &g_database_config) < 0)
+	{
+		g_database_config.wal = 0;
+	}
+
 	do
 	{
-		if(sqlite3_exec(db, Sql_createGPSTable, NULL, NULL, &errmsg) != SQLITE_OK)
-		{
-			fprintf(stderr, "database init error:create GPS table error: %s\n", errmsg);
-			break;
-		}
-		else if(sqlite3_exec(db, Sql_createMainCabinTable, NULL, NULL, &errmsg) != SQLITE_OK)
-		{
-			fprintf(stderr, "database init error:create MainCabin table error: %s\n", errmsg);
-			break;
-		}
-		else if(sqlite3_exec(db, Sql_createCTDTable, NULL, NULL, &errmsg) != SQLITE_OK)
-		{
-			fprintf(stderr, "database init error:create CTD table error: %s\n", errmsg);
-			break;
-		}
-		else if(sqlite3_exec(db, Sql_createDVLTable, NULL, NULL, &errmsg) != SQLITE_OK)
-		{
-			fprintf(stderr, "database init error:create DVL table error: %s\n", errmsg);
-			break;
-		}
-		else if(sqlite3_exec(db, Sql_createUSBLTable, NULL, NULL, &errmsg) != SQLITE_OK)
+		if(Database_createSchema(db) < 0 || Database_createViews(db) < 0)
 		{
-			fprintf(stderr, "database init error:create USBL table error: %s\n", errmsg);
 			break;
 		}
-		else if(sqlite3_exec(db, Sql_createDTUTable, NULL, NULL, &errmsg) != SQLITE_OK)
+		else if(Database_startRun(db, filename) < 0)
 		{
-			fprintf(stderr, "database init error:create DTU table error: %s\n", errmsg);
 			break;
 		}
-		else if(sqlite3_exec(db, Sql_createSonarTable, NULL, NULL, &errmsg) != SQLITE_OK)
+		else if(Database_prepare(db) < 0)
 		{
-			fprintf(stderr, "database init error:create Sonar table error: %s\n", errmsg);
 			break;
 		}
-		else if(sqlite3_exec(db, Sql_createTCPRecvTable, NULL, NULL, &errmsg) != SQLITE_OK)
+
+		/*	WAL检查点:有时间阈值时由检查点线程做，否则在提交时按页数自动做	*/
+		if(g_database_config.wal)
 		{
-			fprintf(stderr, "database init error:create TCP table error: %s\n", errmsg);
-			break;
+			if(g_database_config.checkpointMs <= 0 || Database_startCheckpointer(db) < 0)
+			{
+				sqlite3_wal_autocheckpoint(db, g_database_config.checkpointPages);
+			}
 		}
+		printf("数据库:%s，%s，synchronous=%d，页大小%d，检查点:%s\n", filename,
+			   g_database_config.wal ? "WAL" : "回滚日志", g_database_config.synchronous, g_database_config.pageSize,
+			   g_database_checkpoint_running ? "检查点线程" : "提交时自动");
 
 		return db;
 	}while(0);
-	
-	sqlite3_free(errmsg);
+
 	return NULL;
 }
 
 /*******************************************************************
- * 函数原型:int Database_insertGPSData(sqlite3 *db, gpsDataPack_t *psensor)
+ * 函数原型:int Database_insertGPSData(sqlite3 *db, gpsDataPack_t *psensor, int64_t stampNs)
  * 函数简介:保存GPS采集的数据到数据库
- * 函数参数:db:数据库指针，psensor:GPS数据结构体指针
+ * 函数参数:db:数据库指针，psensor:GPS数据结构体指针，stampNs:采样时间戳(单调时钟纳秒，0表示当前时间)
  * 函数返回值: 成功返回0，失败返回-1
  *****************************************************************/
-int Database_insertGPSData(sqlite3 *db, gpsDataPack_t *psensor)
+int Database_insertGPSData(sqlite3 *db, gpsDataPack_t *psensor, int64_t stampNs)
 {
 	if(db == NULL)
 	{
@@ -136,42 +1073,17 @@ int Database_insertGPSData(sqlite3 *db, gpsDataPack_t *psensor)
 		return -1;
 	}
 
-	char *Sql_insert = NULL;
-	if((Sql_insert = (char*)malloc(sizeof(char) * 256)) == NULL)
-	{
-		fprintf(stderr, "database insert gps data error: malloc failed\n");
-		return -1;
-	}
-
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-	char time[32] = {0};
-    sprintf(time, "%02d:%02d:%02d",nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-
-	sprintf(Sql_insert,"insert into GPS values('%s','%s',%d,%d,'%c',%f,'%c',%f);", time, psensor->systemFlag, psensor->isValid, psensor->satelliteNum, \
-			psensor->longitudeDirection, psensor->longitude, psensor->latitudeDirection, psensor->latitude);
-
-	char *errmsg = NULL;
-	if(sqlite3_exec(db, Sql_insert, NULL, NULL, &errmsg) != SQLITE_OK)
-	{
-		fprintf(stderr, "database insert gps data error:%s", errmsg);
-		free(Sql_insert);
-		sqlite3_free(errmsg);
-		return -1;
-	}
-
-	free(Sql_insert);
-	sqlite3_free(errmsg);
-	return 0;
+	databaseRecord_t rec = {.table = DATABASE_TABLE_GPS, .stampNs = stampNs, .data.gps = *psensor};
+	return Database_submit(db, &rec);
 }
 
 /*******************************************************************
- * 函数原型:int Database_insertMainCabinData(sqlite3 *db, maincabinDataPack_t *psensor)
+ * 函数原型:int Database_insertMainCabinData(sqlite3 *db, maincabinDataPack_t *psensor, int64_t stampNs)
  * 函数简介:保存主控舱采集的数据到数据库
- * 函数参数:db:数据库指针，psensor:主控舱数据结构体指针
+ * 函数参数:db:数据库指针，psensor:主控舱数据结构体指针，stampNs:采样时间戳(单调时钟纳秒，0表示当前时间)
  * 函数返回值: 成功返回0，失败返回-1
  *****************************************************************/
-int Database_insertMainCabinData(sqlite3 *db, maincabinDataPack_t *psensor)
+int Database_insertMainCabinData(sqlite3 *db, maincabinDataPack_t *psensor, int64_t stampNs)
 {
 	if(db == NULL)
 	{
@@ -184,42 +1096,17 @@ int Database_insertMainCabinData(sqlite3 *db, maincabinDataPack_t *psensor)
 		return -1;
 	}
 
-	char *Sql_insert = NULL;
-	if((Sql_insert = (char*)malloc(sizeof(char) * 256)) == NULL)
-	{
-		fprintf(stderr, "database insert maincabin data error: malloc failed\n");
-		return -1;
-	}
-
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-	char time[32] = {0};
-    sprintf(time, "%02d:%02d:%02d",nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-
-	sprintf(Sql_insert,"insert into MainCabin values('%s',%f,%f,%f,'%s','%s','%s','%s','%s');", time, psensor->temperature, psensor->humidity, psensor->pressure, \
-			psensor->isLeak01, psensor->isLeak02, psensor->deviceState, psensor->releaser1State, psensor->releaser1State);
-
-	char *errmsg = NULL;
-	if(sqlite3_exec(db, Sql_insert, NULL, NULL, &errmsg) != SQLITE_OK)
-	{
-		fprintf(stderr, "database insert maincabin data error:%s", errmsg);
-		free(Sql_insert);
-		sqlite3_free(errmsg);
-		return -1;
-	}
-
-	free(Sql_insert);
-	sqlite3_free(errmsg);
-	return 0;
+	databaseRecord_t rec = {.table = DATABASE_TABLE_MAINCABIN, .stampNs = stampNs, .data.maincabin = *psensor};
+	return Database_submit(db, &rec);
 }
 
 /*******************************************************************
- * 函数原型:int Database_insertCTDData(sqlite3 *db, ctdDataPack_t *psensor)
+ * 函数原型:int Database_insertCTDData(sqlite3 *db, ctdDataPack_t *psensor, int64_t stampNs)
  * 函数简介:保存CTD采集的数据到数据库
- * 函数参数:db:数据库指针，psensor:CTD数据结构体指针
+ * 函数参数:db:数据库指针，psensor:CTD数据结构体指针，stampNs:采样时间戳(单调时钟纳秒，0表示当前时间)
  * 函数返回值: 成功返回0，失败返回-1
  *****************************************************************/
-int Database_insertCTDData(sqlite3 *db, ctdDataPack_t *psensor)
+int Database_insertCTDData(sqlite3 *db, ctdDataPack_t *psensor, int64_t stampNs)
 {
 	if(db == NULL)
 	{
@@ -232,42 +1119,17 @@ int Database_insertCTDData(sqlite3 *db, ctdDataPack_t *psensor)
 		return -1;
 	}
 
-	char *Sql_insert = NULL;
-	if((Sql_insert = (char*)malloc(sizeof(char) * 256)) == NULL)
-	{
-		fprintf(stderr, "database insert ctd data error: malloc failed\n");
-		return -1;
-	}
-
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-	char time[32] = {0};
-    sprintf(time, "%02d:%02d:%02d",nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-
-	sprintf(Sql_insert,"insert into CTD values('%s',%6.2f,%6.2f,%6.2f,%6.2f,%6.2f,%6.2f,%6.2f);", time, psensor->temperature, psensor->conductivity, psensor->pressure, \
-			psensor->depth, psensor->salinity, psensor->soundVelocity, psensor->density);
-
-	char *errmsg = NULL;
-	if(sqlite3_exec(db, Sql_insert, NULL, NULL, &errmsg) != SQLITE_OK)
-	{
-		fprintf(stderr, "database insert ctd data error:%s", errmsg);
-		free(Sql_insert);
-		sqlite3_free(errmsg);
-		return -1;
-	}
-
-	free(Sql_insert);
-	sqlite3_free(errmsg);
-	return 0;
+	databaseRecord_t rec = {.table = DATABASE_TABLE_CTD, .stampNs = stampNs, .data.ctd = *psensor};
+	return Database_submit(db, &rec);
 }
 
 /*******************************************************************
- * 函数原型:int Database_insertDVLData(sqlite3 *db, dvlDataPack_t *psensor)
+ * 函数原型:int Database_insertDVLData(sqlite3 *db, dvlDataPack_t *psensor, int64_t stampNs)
  * 函数简介:保存DVL采集的数据到数据库
- * 函数参数:db:数据库指针，psensor:DVL数据结构体指针
+ * 函数参数:db:数据库指针，psensor:DVL数据结构体指针，stampNs:采样时间戳(单调时钟纳秒，0表示当前时间)
  * 函数返回值: 成功返回0，失败返回-1
  *****************************************************************/
-int Database_insertDVLData(sqlite3 *db, dvlDataPack_t *psensor)
+int Database_insertDVLData(sqlite3 *db, dvlDataPack_t *psensor, int64_t stampNs)
 {
 	if(db == NULL)
 	{
@@ -280,42 +1142,17 @@ int Database_insertDVLData(sqlite3 *db, dvlDataPack_t *psensor)
 		return -1;
 	}
 
-	char *Sql_insert = NULL;
-	if((Sql_insert = (char*)malloc(sizeof(char) * 256)) == NULL)
-	{
-		fprintf(stderr, "database insert dvl data error: malloc failed\n");
-		return -1;
-	}
-
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-	char time[32] = {0};
-    sprintf(time, "%02d:%02d:%02d",nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-
-	sprintf(Sql_insert,"insert into DVL values('%s',%6.2f,%6.2f,%6.2f,%6.2f,%6.2f,%6.2f,%6.2f,%6.2f);", time, psensor->pitch, psensor->roll, psensor->heading, \
-			psensor->transducerEntryDepth, psensor->speedX, psensor->speedY, psensor->speedZ, psensor->buttomDistance);
-
-	char *errmsg = NULL;
-	if(sqlite3_exec(db, Sql_insert, NULL, NULL, &errmsg) != SQLITE_OK)
-	{
-		fprintf(stderr, "database insert dvl data error:%s", errmsg);
-		free(Sql_insert);
-		sqlite3_free(errmsg);
-		return -1;
-	}
-
-	free(Sql_insert);
-	sqlite3_free(errmsg);
-	return 0;
+	databaseRecord_t rec = {.table = DATABASE_TABLE_DVL, .stampNs = stampNs, .data.dvl = *psensor};
+	return Database_submit(db, &rec);
 }
 
 /*******************************************************************
- * 函数原型:int Database_insertUSBLData(sqlite3 *db, usblDataPack_t *psensor)
+ * 函数原型:int Database_insertUSBLData(sqlite3 *db, usblDataPack_t *psensor, int64_t stampNs)
  * 函数简介:保存USBL接收的的数据到数据库
- * 函数参数:db:数据库指针，psensor:USBL数据结构体指针
+ * 函数参数:db:数据库指针，psensor:USBL数据结构体指针，stampNs:采样时间戳(单调时钟纳秒，0表示当前时间)
  * 函数返回值: 成功返回0，失败返回-1
  *****************************************************************/
-int Database_insertUSBLData(sqlite3 *db, usblDataPack_t *psensor)
+int Database_insertUSBLData(sqlite3 *db, usblDataPack_t *psensor, int64_t stampNs)
 {
 	if(db == NULL)
 	{
@@ -328,32 +1165,8 @@ int Database_insertUSBLData(sqlite3 *db, usblDataPack_t *psensor)
 		return -1;
 	}
 
-	char *Sql_insert = NULL;
-	if((Sql_insert = (char*)malloc(sizeof(char) * 256)) == NULL)
-	{
-		fprintf(stderr, "database insert usbl data error: malloc failed\n");
-		return -1;
-	}
-
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-	char time[32] = {0};
-    sprintf(time, "%02d:%02d:%02d",nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-
-	sprintf(Sql_insert,"insert into USBL values('%s','%s');", time, psensor->recvdata);
-
-	char *errmsg = NULL;
-	if(sqlite3_exec(db, Sql_insert, NULL, NULL, &errmsg) != SQLITE_OK)
-	{
-		fprintf(stderr, "database insert usbl data error:%s", errmsg);
-		free(Sql_insert);
-		sqlite3_free(errmsg);
-		return -1;
-	}
-
-	free(Sql_insert);
-	sqlite3_free(errmsg);
-	return 0;
+	databaseRecord_t rec = {.table = DATABASE_TABLE_USBL, .stampNs = stampNs, .data.usbl = *psensor};
+	return Database_submit(db, &rec);
 }
 
 /*******************************************************************
@@ -375,40 +1188,18 @@ int Database_insertDTURecvData(sqlite3 *db, unsigned char *dtuRecvData)
 		return -1;
 	}
 
-	char *Sql_insert = NULL;
-	if((Sql_insert = (char*)malloc(sizeof(char) * 256)) == NULL)
-	{
-		fprintf(stderr, "database insert dtu data error: malloc failed\n");
-		return -1;
-	}
-
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-	char time[32] = {0};
-    sprintf(time, "%02d:%02d:%02d",nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-	sprintf(Sql_insert,"insert into DTU values('%s','%s');", time, dtuRecvData);
-
-	char *errmsg = NULL;
-	if(sqlite3_exec(db, Sql_insert, NULL, NULL, &errmsg) != SQLITE_OK)
-	{
-		fprintf(stderr, "database insert dtu data error:%s", errmsg);
-		free(Sql_insert);
-		sqlite3_free(errmsg);
-		return -1;
-	}
-
-	free(Sql_insert);
-	sqlite3_free(errmsg);
-	return 0;
+	databaseRecord_t rec = {.table = DATABASE_TABLE_DTU, .stampNs = 0};
+	snprintf(rec.data.text, sizeof(rec.data.text), "%s", (const char *)dtuRecvData);
+	return Database_submit(db, &rec);
 }
 
 /*******************************************************************
- * 函数原型:int Database_insertSonarData(sqlite3 *db, sonarDataPack_p psensor)
+ * 函数原型:int Database_insertSonarData(sqlite3 *db, sonarDataPack_t *psensor, int64_t stampNs)
  * 函数简介:保存Sonar接收的的数据到数据库
- * 函数参数:db:数据库指针，psensor:Sonar数据结构体指针
+ * 函数参数:db:数据库指针，psensor:Sonar数据结构体指针，stampNs:采样时间戳(单调时钟纳秒，0表示当前时间)
  * 函数返回值: 成功返回0，失败返回-1
  *****************************************************************/
-int Database_insertSonarData(sqlite3 *db, sonarDataPack_t *psensor)
+int Database_insertSonarData(sqlite3 *db, sonarDataPack_t *psensor, int64_t stampNs)
 {
 	if(db == NULL)
 	{
@@ -421,32 +1212,33 @@ int Database_insertSonarData(sqlite3 *db, sonarDataPack_t *psensor)
 		return -1;
 	}
 
-	char *Sql_insert = NULL;
-	if((Sql_insert = (char*)malloc(sizeof(char) * 256)) == NULL)
+	databaseRecord_t rec = {.table = DATABASE_TABLE_SONAR, .stampNs = stampNs, .data.sonar = *psensor};
+	return Database_submit(db, &rec);
+}
+
+/*******************************************************************
+ * 函数原型:int Database_insertThrusterData(sqlite3 *db, thrusterDataPack_t *psensor, int64_t stampNs)
+ * 函数简介:保存推进器的反馈数据到数据库，每个电机一行
+ * 函数参数:db:数据库指针，psensor:推进器数据结构体指针，stampNs:采样时间戳(单调时钟纳秒，0表示当前时间)
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int Database_insertThrusterData(sqlite3 *db, thrusterDataPack_t *psensor, int64_t stampNs)
+{
+	if(db == NULL)
 	{
-		fprintf(stderr, "database insert sonar data error: malloc failed\n");
+		fprintf(stderr, "database insert thruster data error: db NULL\n");
 		return -1;
 	}
-
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-	char time[32] = {0};
-    sprintf(time, "%02d:%02d:%02d",nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-	sprintf(Sql_insert,"insert into Sonar values('%s',%05.1f,%04.1f);", time, psensor->obstaclesBearing, psensor->obstaclesDistance);
-
-	char *errmsg = NULL;
-	if(sqlite3_exec(db, Sql_insert, NULL, NULL, &errmsg) != SQLITE_OK)
+	else if(psensor == NULL)
 	{
-		fprintf(stderr, "database insert sonar data error:%s", errmsg);
-		free(Sql_insert);
-		sqlite3_free(errmsg);
+		fprintf(stderr, "database insert thruster data error: psensor NULL\n");
 		return -1;
 	}
 
-	free(Sql_insert);
-	sqlite3_free(errmsg);
-	return 0;
+	databaseRecord_t rec = {.table = DATABASE_TABLE_THRUSTER, .stampNs = stampNs, .data.thruster = *psensor};
+	return Database_submit(db, &rec);
 }
+
 /*******************************************************************
  * 函数原型:int Database_insertTCPRecvData(sqlite3 *db, char *tcpRecvData)
  * 函数简介:保存TCP接收的的数据到数据库
@@ -466,30 +1258,269 @@ int Database_insertTCPRecvData(sqlite3 *db, char *tcpRecvData)
 		return -1;
 	}
 
-	char *Sql_insert = NULL;
-	if((Sql_insert = (char*)malloc(sizeof(char) * 256)) == NULL)
+	databaseRecord_t rec = {.table = DATABASE_TABLE_TCP, .stampNs = 0};
+	snprintf(rec.data.text, sizeof(rec.data.text), "%s", tcpRecvData);
+	return Database_submit(db, &rec);
+}
+
+/*******************************************************************
+ * 函数原型:int Database_StartWriter(sqlite3 *db, size_t capacity, databaseOverflow_t overflow)
+ * 函数简介:创建队列并启动写入线程，之后各线程的插入只入队，由写入线程独占数据库写入
+ * 函数参数:db:数据库指针，capacity:队列容量(2的幂)，overflow:队列满时的处理方式
+ * 函数返回值: 成功返回0，失败返回-1(之后的插入仍在调用线程中直接写入)
+ *****************************************************************/
+int Database_StartWriter(sqlite3 *db, size_t capacity, databaseOverflow_t overflow)
+{
+	if(db == NULL || g_database_writer_running)
 	{
-		fprintf(stderr, "database insert tcp data error: malloc failed\n");
 		return -1;
 	}
 
-	time_t now = time(NULL);	
-	struct tm *nowtime = localtime(&now);
-	char time[32] = {0};
-    sprintf(time, "%02d:%02d:%02d",nowtime->tm_hour,nowtime->tm_min,nowtime->tm_sec);
-	sprintf(Sql_insert,"insert into TCP values('%s','%s');", time, tcpRecvData);
+	if(Ring_init(&g_database_queue, capacity, sizeof(databaseRecord_t)) < 0)
+	{
+		return -1;
+	}
 
-	char *errmsg = NULL;
-	if(sqlite3_exec(db, Sql_insert, NULL, NULL, &errmsg) != SQLITE_OK)
+	g_database_writer_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(g_database_writer_efd < 0)
 	{
-		fprintf(stderr, "database insert tcp data error:%s", errmsg);
-		free(Sql_insert);
-		sqlite3_free(errmsg);
+		perror("database start writer error: eventfd");
+		Ring_destroy(&g_database_queue);
 		return -1;
 	}
 
-	free(Sql_insert);
-	sqlite3_free(errmsg);
+	g_database_overflow = overflow;
+	g_database_writer_db = db;
+	__atomic_store_n(&g_database_writer_running, 1, __ATOMIC_RELEASE);
+	if(pthread_create(&g_database_writer_tid, NULL, Database_WriterThread, NULL) != 0)
+	{
+		fprintf(stderr, "database start writer error: pthread_create failed\n");
+		__atomic_store_n(&g_database_writer_running, 0, __ATOMIC_RELEASE);
+		close(g_database_writer_efd);
+		g_database_writer_efd = -1;
+		Ring_destroy(&g_database_queue);
+		return -1;
+	}
+	ProcStat_setThreadName(g_database_writer_tid, "db");
+
 	return 0;
 }
 
+/*******************************************************************
+ * 函数原型:void Database_StopWriter(void)
+ * 函数简介:停止写入线程，队列中剩下的记录写完并提交后返回
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+void Database_StopWriter(void)
+{
+	if(!g_database_writer_running)
+	{
+		return;
+	}
+
+	uint64_t one = 1;
+	__atomic_store_n(&g_database_writer_running, 0, __ATOMIC_RELEASE);
+	if(write(g_database_writer_efd, &one, sizeof(one)) < 0)		//写入线程可能正在等待
+	{
+		perror("database stop writer error: eventfd");
+	}
+	pthread_join(g_database_writer_tid, NULL);
+	close(g_database_writer_efd);
+	g_database_writer_efd = -1;
+
+	/*	停止前最后一刻入队的记录	*/
+	databaseRecord_t rec;
+	while(Ring_pop(&g_database_queue, &rec) == 0)
+	{
+		Database_writeRecord(g_database_writer_db, &rec);
+	}
+	Database_flush(g_database_writer_db, 1);
+}
+
+/*******************************************************************
+ * 函数原型:int64_t Database_getRun(void)
+ * 函数简介:本次运行的编号(Database_init之后有效)
+ * 函数参数:无
+ * 函数返回值: 运行编号(启动时的墙上时间，微秒)
+ *****************************************************************/
+int64_t Database_getRun(void)
+{
+	return g_database_run;
+}
+
+/*******************************************************************
+ * 函数原型:int Database_migrate(const char *path)
+ * 函数简介:把旧格式的数据库文件(time为"HH:MM:SS"字符串，没有日期)原地转换为新格式:
+ *          日期和开始时间取自文件名"YYYY-MM-DD--HH:MM:SS.db"(或HH_MM_SS)，旧表换成同名的兼容视图。
+ *          不认识的旧表(如RangeSonar)保持不变。整个转换在一个事务中，失败时文件不变
+ * 函数参数:path:数据库文件
+ * 函数返回值: 成功(或已是新格式)返回0，失败返回-1
+ *****************************************************************/
+int Database_migrate(const char *path)
+{
+	const char *file = strrchr(path, '/');
+	struct tm start = {0};
+	char date[16], startTime[16];
+	sqlite3 *db = NULL;
+	sqlite3_stmt *stmt = NULL;
+
+	/*	1.文件名中的日期和开始时间(本地时间)	*/
+	file = file != NULL ? file + 1 : path;
+	if(sscanf(file, "%4d-%2d-%2d--%2d%*1[:_]%2d%*1[:_]%2d", &start.tm_year, &start.tm_mon, &start.tm_mday,
+			  &start.tm_hour, &start.tm_min, &start.tm_sec) != 6)
+	{
+		fprintf(stderr, "database migrate error:%s 文件名不是YYYY-MM-DD--HH:MM:SS.db格式\n", path);
+		return -1;
+	}
+	snprintf(date, sizeof(date), "%04d-%02d-%02d", start.tm_year, start.tm_mon, start.tm_mday);
+	snprintf(startTime, sizeof(startTime), "%02d:%02d:%02d", start.tm_hour, start.tm_min, start.tm_sec);
+	start.tm_year -= 1900;
+	start.tm_mon -= 1;
+	start.tm_isdst = -1;
+	int64_t run = (int64_t)mktime(&start) * 1000000LL;
+
+	if(sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK)
+	{
+		fprintf(stderr, "database migrate error:open %s failed: %s\n", path, sqlite3_errmsg(db));
+		sqlite3_close(db);
+		return -1;
+	}
+
+	/*	2.已是新格式时不处理	*/
+	int version = 0;
+	if(sqlite3_prepare_v2(db, "pragma user_version;", -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		version = sqlite3_column_int(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+	if(version >= DATABASE_SCHEMA_VERSION)
+	{
+		printf("%s:已是新格式(版本%d)\n", path, version);
+		sqlite3_close(db);
+		return 0;
+	}
+
+	/*	3.建新表，逐表搬移，建兼容视图	*/
+	int rows = 0, ret = Database_execSql(db, "begin;");
+	if(ret == 0)
+	{
+		ret = Database_createSchema(db);
+	}
+	for(int i = 0; i < DATABASE_TABLE_NUM && ret == 0; i++)
+	{
+		int n = Database_migrateTable(db, &g_database_tables[i], date, startTime, run);
+		if(n < 0)
+		{
+			ret = -1;
+			break;
+		}
+		rows += n;
+	}
+	if(ret == 0)
+	{
+		ret = Database_insertRun(db, run, 0, path);
+	}
+	if(ret == 0)
+	{
+		ret = Database_createViews(db);
+	}
+	if(ret == 0)
+	{
+		ret = Database_execSql(db, "commit;");
+	}
+	if(ret < 0)
+	{
+		sqlite3_exec(db, "rollback;", NULL, NULL, NULL);
+		fprintf(stderr, "database migrate error:%s 未转换\n", path);
+	}
+	else
+	{
+		printf("%s:已转换为新格式，共%d行\n", path, rows);
+	}
+
+	sqlite3_close(db);
+	return ret;
+}
+
+/*******************************************************************
+ * 函数原型:void Database_close(sqlite3 *db)
+ * 函数简介:提交未提交的插入，停止检查点线程，关闭数据库(最后一个连接关闭时SQLite把WAL写回
+ *          数据库并删除-wal、-shm文件)。写入线程已启动时先调用Database_StopWriter
+ * 函数参数:db:数据库指针
+ * 函数返回值: 无
+ *****************************************************************/
+void Database_close(sqlite3 *db)
+{
+	if(db == NULL)
+	{
+		return;
+	}
+
+	Database_flush(db, 1);
+
+	if(g_database_checkpoint_running)
+	{
+		__atomic_store_n(&g_database_checkpoint_running, 0, __ATOMIC_RELEASE);
+		pthread_join(g_database_checkpoint_tid, NULL);
+	}
+
+	pthread_mutex_lock(&g_database_mutex);
+	for(int i = 0; i < DATABASE_TABLE_NUM; i++)
+	{
+		sqlite3_finalize(g_database_insert_stmt[i]);
+		g_database_insert_stmt[i] = NULL;
+	}
+	sqlite3_finalize(g_database_begin_stmt);
+	sqlite3_finalize(g_database_commit_stmt);
+	g_database_begin_stmt = g_database_commit_stmt = NULL;
+	if(sqlite3_close(db) != SQLITE_OK)
+	{
+		fprintf(stderr, "database close error:%s\n", sqlite3_errmsg(db));
+	}
+	pthread_mutex_unlock(&g_database_mutex);
+}
+
+/*******************************************************************
+ * 函数原型:int Database_flush(sqlite3 *db, int force)
+ * 函数简介:提交未提交的插入。写入线程空闲时调用，保证最多DATABASE_BATCH_MS内落盘
+ * 函数参数:db:数据库指针，force:1为立即提交，0为只在事务超过DATABASE_BATCH_MS时提交
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int Database_flush(sqlite3 *db, int force)
+{
+	if(db == NULL)
+	{
+		return -1;
+	}
+
+	int ret = 0;
+	pthread_mutex_lock(&g_database_mutex);
+	if(g_database_batch_startNs != 0 && (force || Clock_sinceMs(g_database_batch_startNs) >= DATABASE_BATCH_MS))
+	{
+		ret = Database_commit(db);
+	}
+	pthread_mutex_unlock(&g_database_mutex);
+
+	return ret;
+}
+
+/*******************************************************************
+ * 函数原型:void Database_getStats(databaseStats_t *stats)
+ * 函数简介:取插入、提交、队列统计
+ * 函数参数:stats:输出
+ * 函数返回值: 无
+ *****************************************************************/
+void Database_getStats(databaseStats_t *stats)
+{
+	pthread_mutex_lock(&g_database_mutex);
+	*stats = g_database_stats;
+	stats->pendingRows = g_database_batch_rows;
+	pthread_mutex_unlock(&g_database_mutex);
+
+	stats->dropped = __atomic_load_n(&g_database_dropped, __ATOMIC_RELAXED);
+	stats->queued = g_database_writer_running ? Ring_count(&g_database_queue) : 0;
+	stats->checkpoints = __atomic_load_n(&g_database_checkpoints, __ATOMIC_RELAXED);
+	stats->checkpointFailed = __atomic_load_n(&g_database_checkpoint_failed, __ATOMIC_RELAXED);
+	stats->walPages = __atomic_load_n(&g_database_wal_pages, __ATOMIC_RELAXED);
+}
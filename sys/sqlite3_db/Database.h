@@ -18,6 +18,9 @@
 #include <unistd.h>
 #include <time.h>
 #include <sqlite3.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 
 #include "../../drivers/gps/GPS.h"
@@ -27,43 +30,138 @@
 #include "../../drivers/dtu/DTU.h"
 #include "../../drivers/usbl/USBL.h"
 #include "../../drivers/sonar/Sonar.h"
+#include "../../drivers/thruster/Thruster.h"
+#include "../clock/clock.h"
+#include "../trace/trace.h"
+#include "../pool/pool.h"
+#include "../ring/ring.h"
+#include "../rt/rt.h"
+#include "../procstat/procstat.h"
+
+
+/************************************************************************************
+								宏定义
+*************************************************************************************/
+/*	批量提交:事务中的行数达到DATABASE_BATCH_ROWS，或事务开始超过DATABASE_BATCH_MS时提交	*/
+#define DATABASE_BATCH_ROWS				200
+#define DATABASE_BATCH_MS				1000
+
+/*	异步写入:默认队列容量(2的幂)、队列空时写入线程等待入队唤醒的最长时间(毫秒，兜底，
+	有未提交的事务时等到提交时间为止)、DTU/上位机指令的最大长度	*/
+#define DATABASE_QUEUE_SIZE				1024
+#define DATABASE_IDLE_WAIT_MS			1000
+#define DATABASE_TEXT_LEN				256
+
+/*	数据库格式版本(PRAGMA user_version):2为微秒时间戳、运行编号、时间索引，旧表名为兼容视图	*/
+#define DATABASE_SCHEMA_VERSION			2
+
+/*	默认页大小(页缓存按这个大小预分配)	*/
+#define DATABASE_PAGE_SIZE				4096
+
+/*	WAL检查点:默认每DATABASE_CHECKPOINT_MS或WAL超过DATABASE_CHECKPOINT_PAGES页时做一次，
+	检查点线程每DATABASE_CHECKPOINT_POLL_MS检查一次	*/
+#define DATABASE_CHECKPOINT_MS			5000
+#define DATABASE_CHECKPOINT_PAGES		1000
+#define DATABASE_CHECKPOINT_POLL_MS		100
 
 
 /************************************************************************************
 								数据类型
 *************************************************************************************/
-sqlite3 *g_database;                        	//数据库指针
+extern sqlite3 *g_database;                 	//数据库指针(定义在Database.c)
+
+/*	队列满时的处理方式	*/
+typedef enum
+{
+	DATABASE_OVERFLOW_DROP_OLDEST = 0,			//丢弃队列中最旧的一条，保留最新数据
+	DATABASE_OVERFLOW_DROP_NEWEST				//丢弃正要入队的一条
+}databaseOverflow_t;
+
+/*	同步方式(PRAGMA synchronous)	*/
+typedef enum
+{
+	DATABASE_SYNC_OFF = 0,						//不等待落盘，断电可能损坏数据库
+	DATABASE_SYNC_NORMAL = 1,					//WAL下只在检查点时落盘，断电只丢最后几次提交
+	DATABASE_SYNC_FULL = 2						//每次提交都落盘
+}databaseSync_t;
+
+/*	数据库配置(传给Database_init，NULL为默认配置)	*/
+typedef struct
+{
+	int wal;									//1为WAL模式，0为回滚日志(-journal)模式
+	databaseSync_t synchronous;
+	int pageSize;								//页大小(512~65536的2的幂)，大于DATABASE_PAGE_SIZE时页缓存改用分级堆
+	int checkpointMs;							//检查点线程的时间阈值，0为不启动检查点线程(由提交时自动检查点)
+	int checkpointPages;						//WAL页数阈值(自动检查点时同样使用)
+	const char *path;							//数据库文件，NULL为../database/<启动时间>.db
+	int64_t run;								//运行编号，0为启动时的墙上时间(转换记录的数据时用记录时的编号)
+}databaseConfig_t;
+
+/*	插入、提交统计	*/
+typedef struct
+{
+	unsigned long rows;							//插入成功的行数
+	unsigned long failedRows;					//插入失败的行数
+	unsigned long commits;						//提交次数
+	unsigned long failedCommits;				//提交失败次数(该批插入被回滚)
+	int pendingRows;							//当前事务中还没有提交的行数
+	unsigned long dropped;						//队列满时丢弃的记录
+	size_t queued;								//队列中等待写入的记录
+	unsigned long checkpoints;					//检查点线程完成的检查点次数
+	unsigned long checkpointFailed;				//检查点失败(被读者占用等)的次数
+	int walPages;								//WAL中还没有写回数据库的页数
+}databaseStats_t;
 
 
 /************************************************************************************
  								函数原型
 *************************************************************************************/
-/*	数据库初始化	*/
-sqlite3 *Database_init(sqlite3 *db);
+/*	数据库初始化(config为NULL时使用默认配置:WAL、synchronous=NORMAL、检查点线程)、关闭	*/
+sqlite3 *Database_init(sqlite3 *db, const databaseConfig_t *config);
+void Database_close(sqlite3 *db);
+
+/*	本次运行的编号(二进制日志等其他记录使用同一个编号)	*/
+int64_t Database_getRun(void);
+
+/*	旧格式文件(time为"HH:MM:SS"字符串)原地转换为新格式	*/
+int Database_migrate(const char *path);
+
+/*	传感器数据:stampNs为采样时间戳(Clock_nowNs时基)，0表示当前时间	*/
 
 /*	GPS*/
-int Database_insertGPSData(sqlite3 *db, gpsDataPack_t *psensor);
+int Database_insertGPSData(sqlite3 *db, gpsDataPack_t *psensor, int64_t stampNs);
 
 /*	MainCabin*/
-int Database_insertMainCabinData(sqlite3 *db, maincabinDataPack_t *psensor);
+int Database_insertMainCabinData(sqlite3 *db, maincabinDataPack_t *psensor, int64_t stampNs);
 
 /*	CTD	*/
-int Database_insertCTDData(sqlite3 *db, ctdDataPack_t *psensor);
+int Database_insertCTDData(sqlite3 *db, ctdDataPack_t *psensor, int64_t stampNs);
 
 /*	DVL	*/
-int Database_insertDVLData(sqlite3 *db, dvlDataPack_t *psensor);
+int Database_insertDVLData(sqlite3 *db, dvlDataPack_t *psensor, int64_t stampNs);
 
 /*	USBL	*/
-int Database_insertUSBLData(sqlite3 *db, usblDataPack_t *psensor);
+int Database_insertUSBLData(sqlite3 *db, usblDataPack_t *psensor, int64_t stampNs);
 
 /*	DTU	*/
 int Database_insertDTURecvData(sqlite3 *db, unsigned char *dtuRecvData);
 
 /*	Sonar	*/
-int Database_insertSonarData(sqlite3 *db, sonarDataPack_t *psensor);
+int Database_insertSonarData(sqlite3 *db, sonarDataPack_t *psensor, int64_t stampNs);
+
+/*	Thruster	*/
+int Database_insertThrusterData(sqlite3 *db, thrusterDataPack_t *psensor, int64_t stampNs);
 
 /*	ConnectHost*/
 int Database_insertTCPRecvData(sqlite3 *db, char *tcpRecvData);
 
+/*	异步写入:启动后插入函数只入队，由写入线程写入；停止时写完队列并提交	*/
+int Database_StartWriter(sqlite3 *db, size_t capacity, databaseOverflow_t overflow);
+void Database_StopWriter(void);
+
+/*	提交未提交的插入(force为1时立即提交)、取统计	*/
+int Database_flush(sqlite3 *db, int force);
+void Database_getStats(databaseStats_t *stats);
+
 #endif
 
@@ -0,0 +1,269 @@
+/************************************************************************************
+					文件名：trace.c
+					描述：进程内事件追踪实现
+ ************************************************************************************/
+
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+#define TRACE_RING_MASK         (TRACE_RING_SIZE - 1)
+#define TRACE_THREAD_NAME_LEN   16
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  一个事件:seq为写入序号加1，写入期间为0，导出时据此丢弃正在被覆盖的事件  */
+typedef struct
+{
+    uint64_t seq;
+    int64_t stampNs;
+    const char *cat;
+    const char *name;
+    char phase;                         //'B'开始，'E'结束，'i'瞬时
+}traceEvent_t;
+
+/*  一个线程的环形缓冲区:只有所属线程写，导出线程读  */
+typedef struct
+{
+    pid_t tid;
+    char threadName[TRACE_THREAD_NAME_LEN];
+    uint64_t head;                      //已写入的事件数
+    traceEvent_t events[TRACE_RING_SIZE];
+}traceRing_t;
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+static volatile int g_trace_enabled = 1;
+
+/*  已注册的缓冲区，g_trace_ring_num只增不减    */
+static traceRing_t *g_trace_rings[TRACE_MAX_THREADS];
+static int g_trace_ring_num = 0;
+
+/*  本线程的缓冲区，注册失败后不再重试  */
+static __thread traceRing_t *t_trace_ring = NULL;
+static __thread int t_trace_failed = 0;
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:static traceRing_t *Trace_threadRing(void)
+* 函数简介:取本线程的缓冲区，第一次调用时分配并注册
+* 函数参数:无
+* 函数返回值:缓冲区，线程数超过TRACE_MAX_THREADS或内存不足时返回NULL
+*****************************************************************/
+static traceRing_t *Trace_threadRing(void)
+{
+    if(t_trace_ring != NULL || t_trace_failed)
+    {
+        return t_trace_ring;
+    }
+
+    int idx = __atomic_fetch_add(&g_trace_ring_num, 1, __ATOMIC_RELAXED);
+    traceRing_t *ring = idx < TRACE_MAX_THREADS ? calloc(1, sizeof(traceRing_t)) : NULL;
+    if(ring == NULL)
+    {
+        t_trace_failed = 1;
+        return NULL;
+    }
+
+    ring->tid = (pid_t)syscall(SYS_gettid);
+    prctl(PR_GET_NAME, ring->threadName, 0, 0, 0);
+    __atomic_store_n(&g_trace_rings[idx], ring, __ATOMIC_RELEASE);
+    t_trace_ring = ring;
+
+    return ring;
+}
+
+/*******************************************************************
+* 函数原型:static void Trace_record(char phase, const char *cat, const char *name)
+* 函数简介:写入一个事件
+* 函数参数:phase:事件类型
+* 函数参数:cat:类别
+* 函数参数:name:名称
+* 函数返回值:无
+*****************************************************************/
+static void Trace_record(char phase, const char *cat, const char *name)
+{
+    if(!g_trace_enabled)
+    {
+        return;
+    }
+
+    traceRing_t *ring = Trace_threadRing();
+    if(ring == NULL)
+    {
+        return;
+    }
+
+    uint64_t head = ring->head;
+    traceEvent_t *ev = &ring->events[head & TRACE_RING_MASK];
+
+    __atomic_store_n(&ev->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ev->stampNs = Clock_nowNs();
+    ev->cat = cat;
+    ev->name = name;
+    ev->phase = phase;
+    __atomic_store_n(&ev->seq, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************
+* 函数原型:static void Trace_threadNameOf(const traceRing_t *ring, char *name, size_t size)
+* 函数简介:线程名，线程还在时取当前的名称(注册后可能被改过)，否则用注册时的名称
+* 函数参数:ring:缓冲区
+* 函数参数:name:输出名称
+* 函数参数:size:name大小
+* 函数返回值:无
+*****************************************************************/
+static void Trace_threadNameOf(const traceRing_t *ring, char *name, size_t size)
+{
+    char path[64];
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/proc/self/task/%d/comm", (int)ring->tid);
+    if((fp = fopen(path, "r")) != NULL)
+    {
+        if(fgets(name, size, fp) != NULL)
+        {
+            name[strcspn(name, "\n")] = '\0';
+            fclose(fp);
+            return;
+        }
+        fclose(fp);
+    }
+
+    snprintf(name, size, "%s", ring->threadName);
+}
+
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+* 函数原型:void Trace_setEnabled(int enable)
+* 函数简介:开启或关闭记录
+* 函数参数:enable:1为开启，0为关闭
+* 函数返回值:无
+*****************************************************************/
+void Trace_setEnabled(int enable)
+{
+    g_trace_enabled = enable;
+}
+
+/*******************************************************************
+* 函数原型:void Trace_begin(const char *cat, const char *name)
+* 函数简介:记录开始事件
+* 函数参数:cat:类别(常量字符串)
+* 函数参数:name:名称(常量字符串)
+* 函数返回值:无
+*****************************************************************/
+void Trace_begin(const char *cat, const char *name)
+{
+    Trace_record('B', cat, name);
+}
+
+/*******************************************************************
+* 函数原型:void Trace_end(const char *cat, const char *name)
+* 函数简介:记录结束事件
+* 函数参数:cat:类别(常量字符串)
+* 函数参数:name:名称(常量字符串)
+* 函数返回值:无
+*****************************************************************/
+void Trace_end(const char *cat, const char *name)
+{
+    Trace_record('E', cat, name);
+}
+
+/*******************************************************************
+* 函数原型:void Trace_instant(const char *cat, const char *name)
+* 函数简介:记录瞬时事件(超时、丢帧等)
+* 函数参数:cat:类别(常量字符串)
+* 函数参数:name:名称(常量字符串)
+* 函数返回值:无
+*****************************************************************/
+void Trace_instant(const char *cat, const char *name)
+{
+    Trace_record('i', cat, name);
+}
+
+/*******************************************************************
+* 函数原型:int Trace_Dump(const char *path)
+* 函数简介:把所有线程缓冲区中的事件导出为Chrome trace-event格式(JSON)。
+*          导出时各线程照常记录，正在被覆盖的事件跳过
+* 函数参数:path:文件路径
+* 函数返回值:成功返回导出的事件数，失败返回-1
+*****************************************************************/
+int Trace_Dump(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL)
+    {
+        perror("Trace_Dump:fopen");
+        return -1;
+    }
+
+    int pid = (int)getpid();
+    int ringNum = __atomic_load_n(&g_trace_ring_num, __ATOMIC_RELAXED);
+    int total = 0;
+    const char *sep = "";
+
+    if(ringNum > TRACE_MAX_THREADS)
+    {
+        ringNum = TRACE_MAX_THREADS;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for(int r = 0; r < ringNum; r++)
+    {
+        traceRing_t *ring = __atomic_load_n(&g_trace_rings[r], __ATOMIC_ACQUIRE);
+        if(ring == NULL)
+        {
+            continue;
+        }
+
+        char threadName[TRACE_THREAD_NAME_LEN];
+        Trace_threadNameOf(ring, threadName, sizeof(threadName));
+        fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                sep, pid, (int)ring->tid, threadName);
+        sep = ",";
+
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        for(uint64_t i = first; i < head; i++)
+        {
+            traceEvent_t *slot = &ring->events[i & TRACE_RING_MASK];
+            traceEvent_t ev;
+
+            uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            ev = *slot;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if(seq != i + 1 || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+            {
+                continue;
+            }
+
+            fprintf(fp, ",\n{\"name\":\"%s.%s\",\"cat\":\"%s\",\"ph\":\"%c\",%s\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d}",
+                    ev.name, ev.cat, ev.cat, ev.phase, ev.phase == 'i' ? "\"s\":\"t\"," : "",
+                    (long long)(ev.stampNs / CLOCK_NS_PER_US), (long long)(ev.stampNs % CLOCK_NS_PER_US), pid, (int)ring->tid);
+            total++;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    return total;
+}
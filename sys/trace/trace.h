@@ -0,0 +1,44 @@
+/************************************************************************************
+					文件名：trace.h
+					描述：进程内事件追踪。每个线程一个环形缓冲区，记录读取、解析、入库、上传、
+						  控制周期等的开始/结束事件(纳秒时间戳)，写入不加锁；
+						  可导出为Chrome trace-event格式(JSON)，用chrome://tracing或Perfetto打开
+ ************************************************************************************/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/************************************************************************************
+ 									包含头文件
+*************************************************************************************/
+#include <stdio.h>
+#include <stdint.h>
+#include "../clock/clock.h"
+
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  最多追踪的线程数，超过后新线程的事件不记录  */
+#define TRACE_MAX_THREADS       32
+
+/*  每个线程保留的事件数(2的幂)，写满后覆盖最旧的事件   */
+#define TRACE_RING_SIZE         4096
+
+
+/************************************************************************************
+ 									函数原型
+*************************************************************************************/
+/*  开关(默认开启)  */
+void Trace_setEnabled(int enable);
+
+/*  记录事件:cat为类别(read、parse、db、send、control...)，name为设备或模块名，
+    都必须是常量字符串(只保存指针)，begin和end成对调用 */
+void Trace_begin(const char *cat, const char *name);
+void Trace_end(const char *cat, const char *name);
+void Trace_instant(const char *cat, const char *name);
+
+/*  导出为Chrome trace-event格式   */
+int Trace_Dump(const char *path);
+
+#endif
@@ -1,6 +1,10 @@
 #include "task_mission.h"
 #include "../drivers/thruster/Thruster.h"
 #include "../drivers/dvl/DVL.h"
+#include "../sys/clock/clock.h"
+#include "../sys/log/log.h"
+#include "../sys/procstat/procstat.h"
+#include "../sys/rt/rt.h"
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
@@ -11,6 +15,9 @@ static volatile int g_mission_running = 0;
 static MissionStep_t g_current_mission[MISSION_STEP_COUNT]; 
 static pthread_mutex_t g_mission_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* 航向样本最大年龄 (毫秒)，超过视为DVL失效 */
+#define MISSION_HEADING_MAX_AGE_MS  2000
+
 /* 辅助宏：角度归一化到 [0, 360) */
 #define NORMALIZE_ANGLE(a)  (fmod((a) + 360.0f, 360.0f))
 
@@ -43,9 +50,27 @@ static void Run_Action(uint8_t action) {
     }
 }
 
+/* 辅助函数：读取航向快照，样本过旧或没有数据时返回 -1 */
+static int Get_Heading(float *heading) {
+    dvlDataPack_t dvl;
+    int64_t stamp;
+
+    DVL_getDataPack(&dvl, &stamp);
+    if (Bus_ageMs(stamp) > MISSION_HEADING_MAX_AGE_MS) {
+        return -1;
+    }
+    *heading = dvl.heading;
+    return 0;
+}
+
 /* 闭环转向等待函数 */
 static void Wait_For_Turn(float target_delta, int is_left) {
-    float start_heading = DVL_getHeadingValue();
+    float start_heading = 0.0f;
+    if (Get_Heading(&start_heading) < 0) {
+        LOG_E(LOG_MOD_MISSION, "[Mission Turn] 错误：航向数据过旧或没有数据，取消转向！\n");
+        Thruster_StopHorizontal();
+        return;
+    }
     float target_heading = start_heading;
 
     if (is_left) {
@@ -54,31 +79,34 @@ static void Wait_For_Turn(float target_delta, int is_left) {
         target_heading = NORMALIZE_ANGLE(start_heading + target_delta);
     }
 
-    printf("[Mission Turn] 开始转向: Start=%.1f, Target=%.1f (Delta=%.1f)\n", 
+    LOG_I(LOG_MOD_MISSION, "[Mission Turn] 开始转向: Start=%.1f, Target=%.1f (Delta=%.1f)\n", 
            start_heading, target_heading, target_delta);
 
     int has_started_turning = (target_delta >= 350.0f) ? 0 : 1;
     int max_wait_sec = (int)(target_delta / 90.0f) * 15 + 10; 
-    int elapsed = 0;
+    int64_t deadline_ms = Clock_nowMs() + (int64_t)max_wait_sec * 1000;
 
-    while (g_mission_running && elapsed < max_wait_sec * 10) { 
-        float current_heading = DVL_getHeadingValue();
+    while (g_mission_running && Clock_nowMs() < deadline_ms) { 
+        float current_heading = 0.0f;
+        if (Get_Heading(&current_heading) < 0) {
+            LOG_E(LOG_MOD_MISSION, "[Mission Turn] 错误：航向数据中断，停止转向！\n");
+            break;
+        }
         float err = fabs(AngleDiff(target_heading, current_heading));
 
         if (!has_started_turning) {
             if (err > 30.0f) {
                 has_started_turning = 1;
-                printf("[Mission Turn] 已偏离原点，开始检测回归...\n");
+                LOG_I(LOG_MOD_MISSION, "[Mission Turn] 已偏离原点，开始检测回归...\n");
             }
         } else {
             if (err < 8.0f) { 
-                printf("[Mission Turn] 转向完成! Err=%.1f\n", err);
+                LOG_I(LOG_MOD_MISSION, "[Mission Turn] 转向完成! Err=%.1f\n", err);
                 break;
             }
         }
 
         usleep(100000); 
-        elapsed++;
     }
 
     Thruster_StopHorizontal();
@@ -86,7 +114,8 @@ static void Wait_For_Turn(float target_delta, int is_left) {
 
 /* 任务调度线程 */
 void *Task_Mission_WorkThread(void *arg) {
-    printf("[Mission] 预编程任务线程就绪...\n");
+    Rt_enterThread(RT_ROLE_CONTROL);
+    LOG_I(LOG_MOD_MISSION, "[Mission] 预编程任务线程就绪...\n");
     
     while (1) {
         if (!g_mission_running) {
@@ -94,7 +123,7 @@ void *Task_Mission_WorkThread(void *arg) {
             continue;
         }
 
-        printf("[Mission] --- 开始执行预编程序列 ---\n");
+        LOG_I(LOG_MOD_MISSION, "[Mission] --- 开始执行预编程序列 ---\n");
 
         for (int i = 0; i < MISSION_STEP_COUNT; i++) {
             if (!g_mission_running) break; 
@@ -119,19 +148,20 @@ void *Task_Mission_WorkThread(void *arg) {
                 else if (cmd_val == 3) turn_angle = 270.0f;
                 else turn_angle = 360.0f; 
 
-                printf("[Mission] 步骤[%d]: 转向控制 -> 指令%d, 目标%.0f度\n", 
+                LOG_I(LOG_MOD_MISSION, "[Mission] 步骤[%d]: 转向控制 -> 指令%d, 目标%.0f度\n", 
                        i+1, cmd_val, turn_angle);
                 
                 Wait_For_Turn(turn_angle, (step.action == M_ACT_LEFT));
             } 
             else {
                 // 时间控制逻辑 (仅剩前进/后退/停止)
-                printf("[Mission] 步骤[%d]: 时间控制 -> 动作%d, 持续%d秒\n", 
+                LOG_I(LOG_MOD_MISSION, "[Mission] 步骤[%d]: 时间控制 -> 动作%d, 持续%d秒\n", 
                        i+1, step.action, step.duration);
                 
-                for (int t = 0; t < step.duration; t++) {
-                    if (!g_mission_running) break; 
-                    sleep(1);
+                // 按单调时钟计时，循环里的打印、调度延迟不会累积成误差
+                int64_t deadline_ms = Clock_nowMs() + (int64_t)step.duration * 1000;
+                while (g_mission_running && Clock_nowMs() < deadline_ms) {
+                    usleep(100000);
                 }
                 Thruster_StopHorizontal();
             }
@@ -140,9 +170,9 @@ void *Task_Mission_WorkThread(void *arg) {
         }
 
         if (g_mission_running) {
-            printf("[Mission] 序列完成，自动悬停。\n");
+            LOG_I(LOG_MOD_MISSION, "[Mission] 序列完成，自动悬停。\n");
         } else {
-            printf("[Mission] ⚠ 任务被强制中断停止！\n");
+            LOG_W(LOG_MOD_MISSION, "[Mission] ⚠ 任务被强制中断停止！\n");
         }
         
         Thruster_StopHorizontal();
@@ -155,6 +185,7 @@ void *Task_Mission_WorkThread(void *arg) {
 int Task_Mission_Init(void) {
     pthread_t tid;
     if (pthread_create(&tid, NULL, Task_Mission_WorkThread, NULL) < 0) return -1;
+    ProcStat_setThreadName(tid, "mission");
     return 0;
 }
 
@@ -164,13 +195,13 @@ void Task_Mission_UpdateAndStart(MissionStep_t steps[MISSION_STEP_COUNT]) {
     memcpy(g_current_mission, steps, sizeof(MissionStep_t) * MISSION_STEP_COUNT);
     g_mission_running = 1;
     pthread_mutex_unlock(&g_mission_mutex);
-    printf("[Mission] 收到新指令，任务启动！\n");
+    LOG_I(LOG_MOD_MISSION, "[Mission] 收到新指令，任务启动！\n");
 }
 
 /* 强制停止 */
 void Task_Mission_Stop(void) {
     if (g_mission_running) {
-        printf("[Mission] 收到停止信号，正在终止...\n");
+        LOG_I(LOG_MOD_MISSION, "[Mission] 收到停止信号，正在终止...\n");
         g_mission_running = 0;
         Thruster_StopHorizontal();
     }
@@ -2,6 +2,7 @@
 
 /*  1.Epoll管理器   */
 #include "../sys/epoll/epoll_manager.h"
+#include "../sys/SerialPort/SerialPort.h"
 
 /*  2.主控舱    */
 #include "../drivers/maincabin/MainCabin.h"
@@ -36,11 +37,95 @@
 /*  13.sqlite3  */
 #include "../sys/sqlite3_db/Database.h"
 
+/*  14.链路延时统计 */
+#include "../sys/latency/latency.h"
+
+/*  15.事件追踪 */
+#include "../sys/trace/trace.h"
+
+/*  16.日志 */
+#include "../sys/log/log.h"
+
+/*  17.运行指标 */
+#include "../sys/metrics/metrics.h"
+
+/*  18.线程命名与资源采样   */
+#include "../sys/procstat/procstat.h"
+
+/*  19.实时调度配置 */
+#include "../sys/rt/rt.h"
+
+/*  20.内存池与堆分配计数   */
+#include "../sys/pool/pool.h"
+
+/*  21.二进制日志   */
+#include "../sys/binlog/binlog.h"
+
 // [新增] 必须包含这个头文件，否则会出现 implicit declaration 警告
 #include "../control/depth_control.h"
 #include "../control/altitude_control.h"
 #include "../control/navigation_control.h"
+#include "../control/control_executor.h"
 #include "../task/task_mission.h"
+
+/************************************************************************************
+ 									宏定义
+*************************************************************************************/
+/*  线程模式下设备fd的监听事件:单次触发，工作线程读完数据后再重新使能，避免电平触发时反复唤醒  */
+#define TASK_EPOLL_EVENTS       (EPOLLIN | EPOLLONESHOT)
+
+/*  事件循环模式下设备fd的监听事件:在Epoll线程中直接读取，使用电平触发即可    */
+#define TASK_EVENTLOOP_EVENTS   (EPOLLIN)
+
+/*  挂断设备的重连间隔(毫秒)，设备初始化和上电配置会睡眠数秒，因此在单独的重连线程中进行  */
+#define TASK_RECONNECT_INTERVAL_MS      1000
+
+/*  每次唤醒最多处理的帧数，避免一个设备长时间占用Epoll线程(剩下的帧下次唤醒再处理)   */
+#define TASK_MAX_FRAMES_PER_WAKEUP      32
+
+/*  各串口设备的取帧策略:SERIALPORT_FRAME_ALL处理每一帧，SERIALPORT_FRAME_LATEST只处理最新的一帧   */
+#define TASK_GPS_FRAME_POLICY           SERIALPORT_FRAME_LATEST
+#define TASK_CTD_FRAME_POLICY           SERIALPORT_FRAME_ALL
+#define TASK_DVL_FRAME_POLICY           SERIALPORT_FRAME_ALL
+#define TASK_DTU_FRAME_POLICY           SERIALPORT_FRAME_ALL         //指令不能丢
+#define TASK_USBL_FRAME_POLICY          SERIALPORT_FRAME_ALL         //指令不能丢
+#define TASK_SONAR_FRAME_POLICY         SERIALPORT_FRAME_ALL         //一问一答，缓冲区中最多一帧
+
+/*  入库并记录入库耗时(写入线程运行时只是入队的耗时)  */
+#define TASK_STORE(dev, insert)                                                 \
+    do {                                                                        \
+        int64_t _storeStartNs = Clock_nowNs();                                  \
+        insert;                                                                 \
+        Metrics_observeSince(dev, METRICS_TIME_DB, _storeStartNs);              \
+    } while(0)
+
+/*  高频数据:启用二进制日志时写入二进制日志(一次拷贝)，否则入库    */
+#define TASK_STORE_HIGHRATE(dev, type, pack, stamp, insert)                     \
+    TASK_STORE(dev, Binlog_isEnabled() ? Binlog_write(type, stamp, pack) : (insert))
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  二进制日志的记录类型(tool/binlog2db按登记的名称转换到数据库) */
+typedef enum
+{
+    TASK_BINLOG_DVL = 0,
+    TASK_BINLOG_SONAR,
+    TASK_BINLOG_THRUSTER
+}taskBinlogType_t;
+
+/*  设备工作上下文(挂在epoll处理器的context上)  */
+typedef struct
+{
+    pthread_mutex_t *mutex;             //工作线程互斥锁
+    pthread_cond_t *cond;               //工作线程条件变量
+    volatile int *work_flag;            //工作标志 -1为不工作，1为开始工作
+    void (*process)(void);              //读取、解析、发布一次数据(两种运行模式共用)
+    int64_t wakeNs;                     //最近一次Epoll唤醒的时间(Clock_nowNs，延时统计用)
+    int (*reopen)(void);                //挂断后重新打开设备并加入监听，NULL表示由处理函数自行处理挂断
+    volatile int lost;                  //1为已挂断、已移出监听，等待重连线程重新打开
+}taskWorker_t;
+
 /************************************************************************************
  									外部变量
 *************************************************************************************/
@@ -49,6 +134,8 @@ extern int g_connecthost_tcpser_accept_sock_fd;         //上位机的传输套
 extern volatile int g_connecthost_tcpserConnectFlag;		//-1为未连接，1为已连接
 extern char g_tcpserRecvBuf[256];
 
+extern volatile int g_maincabin_tcpcliConnectFlag;		//-1为未连接，1为已连接
+
 extern volatile int g_ctd_status;           //CTD是否可工作的状态
 extern volatile int g_dvl_status;           //DVL是否可工作的状态
 extern volatile int g_dtu_status;          //数传电台是否可工作的状态
@@ -56,13 +143,7 @@ extern volatile int g_usbl_status;         //USBL是否可工作的状态
 extern volatile int g_sonar_status;         //Sonar是否可工作的状态
 
 
-extern maincabinDataPack_t g_maincabin_data_pack;       //主控舱数据结构体
-extern gpsDataPack_t g_gps_DataPack;                                        //GPS数据结构体
-extern ctdDataPack_t g_ctdDataPack;                                             //CTD数据结构体
-extern dvlDataPack_t g_dvlDataPack;                                             //DVL数据结构体
-extern usblDataPack_t g_usbl_dataPack;                                      //USBL数据结构体
 extern unsigned char g_dtu_recvbuf[MAX_DTU_RECV_DATA_SIZE] ;       //数传电台数据数组
-extern sonarDataPack_t g_sonar_dataPack;                                //Sonar数据结构体
 
 /************************************************************************************
  									全局变量(外界可以使用)
@@ -73,6 +154,12 @@ int g_epoll_manager_fd = -1;
 /************************************************************************************
  									全局变量(仅可本文件使用)
 *************************************************************************************/
+/*  运行模式(Task_Epoll_Init之前设置)   */
+static volatile TaskRunMode g_task_run_mode = TASK_RUN_MODE_THREAD;
+
+/*  推进器反馈轮询(Task_Thruster_Init之前设置)，反馈寄存器地址未确认前默认关闭   */
+static int g_task_thruster_telemetry = 0;
+
 /*  条件变量  && 互斥锁*/
 static pthread_cond_t g_maincabin_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t g_maincabin_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -95,6 +182,9 @@ pthread_mutex_t g_usbl_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t g_sonar_cond = PTHREAD_COND_INITIALIZER;
 pthread_mutex_t g_sonar_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+static pthread_cond_t g_thruster_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t g_thruster_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 pthread_cond_t g_connecthost_cond = PTHREAD_COND_INITIALIZER;
 pthread_mutex_t g_connecthost_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -107,6 +197,823 @@ static volatile int g_dtu_work_flag = -1;      //-1为不工作，1为开始工
 static volatile int g_usbl_work_flag = -1;      //-1为不工作，1为开始工作
 static volatile int g_sonar_work_flag = -1;      //-1为不工作，1为开始工作
 static volatile int g_connecthost_work_flag = -1;      //-1为不工作，1为开始工作
+static volatile int g_thruster_work_flag = -1;      //-1为不工作，1为开始工作
+
+/*  上位机IP(打印用)    */
+static char g_connecthost_ipstr[INET_ADDRSTRLEN] = {0};
+
+/*  Epoll处理器回调 */
+static void Task_Epoll_WakeWorker(epollHandler_t *handler, uint32_t events);
+static void Task_Epoll_ProcessInline(epollHandler_t *handler, uint32_t events);
+static void Task_ConnectHost_AcceptInline(epollHandler_t *handler, uint32_t events);
+static void Task_Control_TickInline(epollHandler_t *handler, uint32_t events);
+
+/*  各设备的读取、解析、发布    */
+static void Task_MainCabin_Process(void);
+static void Task_GPS_Process(void);
+static void Task_CTD_Process(void);
+static void Task_DVL_Process(void);
+static void Task_DTU_Process(void);
+static void Task_USBL_Process(void);
+static void Task_Sonar_Process(void);
+static void Task_ConnectHost_Process(void);
+static void Task_Thruster_Process(void);
+
+/*  各设备挂断后的重新打开(在重连线程中调用) */
+static int Task_MainCabin_Reopen(void);
+static int Task_GPS_Reopen(void);
+static int Task_CTD_Reopen(void);
+static int Task_DVL_Reopen(void);
+static int Task_DTU_Reopen(void);
+static int Task_USBL_Reopen(void);
+static int Task_Sonar_Reopen(void);
+static void *Task_Reconnect_WorkThread(void *arg);
+
+static taskWorker_t g_maincabin_worker = {&g_maincabin_mutex, &g_maincabin_cond, &g_maincabin_work_flag, Task_MainCabin_Process, 0, Task_MainCabin_Reopen};
+static taskWorker_t g_gps_worker = {&g_gps_mutex, &g_gps_cond, &g_gps_work_flag, Task_GPS_Process, 0, Task_GPS_Reopen};
+static taskWorker_t g_ctd_worker = {&g_ctd_mutex, &g_ctd_cond, &g_ctd_work_flag, Task_CTD_Process, 0, Task_CTD_Reopen};
+static taskWorker_t g_dvl_worker = {&g_dvl_mutex, &g_dvl_cond, &g_dvl_work_flag, Task_DVL_Process, 0, Task_DVL_Reopen};
+static taskWorker_t g_dtu_worker = {&g_dtu_mutex, &g_dtu_cond, &g_dtu_work_flag, Task_DTU_Process, 0, Task_DTU_Reopen};
+static taskWorker_t g_usbl_worker = {&g_usbl_mutex, &g_usbl_cond, &g_usbl_work_flag, Task_USBL_Process, 0, Task_USBL_Reopen};
+static taskWorker_t g_sonar_worker = {&g_sonar_mutex, &g_sonar_cond, &g_sonar_work_flag, Task_Sonar_Process, 0, Task_Sonar_Reopen};
+static taskWorker_t g_connecthost_worker = {&g_connecthost_mutex, &g_connecthost_cond, &g_connecthost_work_flag, Task_ConnectHost_Process};
+static taskWorker_t g_thruster_worker = {&g_thruster_mutex, &g_thruster_cond, &g_thruster_work_flag, Task_Thruster_Process};
+
+/*  Epoll处理器，回调函数在加入监听时按运行模式选择    */
+static epollHandler_t g_maincabin_epoll_handler = {-1, "MainCabin", Task_Epoll_WakeWorker, &g_maincabin_worker, {0}};
+static epollHandler_t g_gps_epoll_handler = {-1, "GPS", Task_Epoll_WakeWorker, &g_gps_worker, {0}};
+static epollHandler_t g_ctd_epoll_handler = {-1, "CTD", Task_Epoll_WakeWorker, &g_ctd_worker, {0}};
+static epollHandler_t g_dvl_epoll_handler = {-1, "DVL", Task_Epoll_WakeWorker, &g_dvl_worker, {0}};
+static epollHandler_t g_dtu_epoll_handler = {-1, "DTU", Task_Epoll_WakeWorker, &g_dtu_worker, {0}};
+static epollHandler_t g_usbl_epoll_handler = {-1, "USBL", Task_Epoll_WakeWorker, &g_usbl_worker, {0}};
+static epollHandler_t g_sonar_epoll_handler = {-1, "Sonar", Task_Epoll_WakeWorker, &g_sonar_worker, {0}};
+static epollHandler_t g_connecthost_epoll_handler = {-1, "ConnectHost", Task_Epoll_WakeWorker, &g_connecthost_worker, {0}};
+static epollHandler_t g_thruster_epoll_handler = {-1, "Thruster", Task_Epoll_WakeWorker, &g_thruster_worker, {0}};
+static epollHandler_t g_connecthost_listen_epoll_handler = {-1, "ConnectHostListen", Task_ConnectHost_AcceptInline, NULL, {0}};
+static epollHandler_t g_control_epoll_handler = {-1, "Control", Task_Control_TickInline, NULL, {0}};
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*******************************************************************
+ * 函数原型:static int Task_Epoll_Hangup(epollHandler_t *handler, uint32_t events)
+ * 函数简介:处理设备fd的挂断(EPOLLHUP)和错误(EPOLLERR)。这两个事件无法屏蔽，不处理的话每次
+ *          epoll_wait都会立即返回，Epoll线程空转。设备有重新打开函数时移出监听，交给重连线程
+ * 函数参数:handler:就绪的处理器
+ * 函数参数:events:就绪事件
+ * 函数返回值: 已移出监听返回1，否则返回0(继续按可读处理)
+ *****************************************************************/
+static int Task_Epoll_Hangup(epollHandler_t *handler, uint32_t events)
+{
+    taskWorker_t *worker = (taskWorker_t *)handler->context;
+
+    if(!(events & (EPOLLERR | EPOLLHUP)) || worker->reopen == NULL)
+    {
+        return 0;
+    }
+
+    /*  1.移出监听，工作线程处理完当前数据后也不会再重新使能(见Task_Epoll_Rearm)  */
+    epoll_manager_del_handler(g_epoll_manager_fd, handler);
+    handler->fd = -1;
+
+    /*  2.交给重连线程  */
+    worker->lost = 1;
+    LOG_W(LOG_MOD_MAIN, "%s:设备挂断(events 0x%x)，已移出监听，等待重连\n", handler->name, events);
+
+    return 1;
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_Epoll_WakeWorker(epollHandler_t *handler, uint32_t events)
+ * 函数简介:线程模式的Epoll处理器回调，持锁置位工作标志并唤醒工作线程。
+ *          工作线程以工作标志为条件等待，即使它正忙于上一帧也不会丢失唤醒
+ * 函数参数:handler:就绪的处理器
+ * 函数参数:events:就绪事件
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_Epoll_WakeWorker(epollHandler_t *handler, uint32_t events)
+{
+    taskWorker_t *worker = (taskWorker_t *)handler->context;
+
+    if(Task_Epoll_Hangup(handler, events))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(worker->mutex);
+    worker->wakeNs = Clock_nowNs();
+    *worker->work_flag = 1;
+    pthread_cond_signal(worker->cond);
+    pthread_mutex_unlock(worker->mutex);
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_Epoll_ProcessInline(epollHandler_t *handler, uint32_t events)
+ * 函数简介:事件循环模式的Epoll处理器回调，直接在Epoll线程中读取、解析、发布
+ * 函数参数:handler:就绪的处理器
+ * 函数参数:events:就绪事件
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_Epoll_ProcessInline(epollHandler_t *handler, uint32_t events)
+{
+    taskWorker_t *worker = (taskWorker_t *)handler->context;
+
+    if(Task_Epoll_Hangup(handler, events))
+    {
+        return;
+    }
+
+    worker->wakeNs = Clock_nowNs();
+    worker->process();
+}
+
+/*******************************************************************
+ * 函数原型:static int Task_Epoll_Attach(epollHandler_t *handler, int fd)
+ * 函数简介:把设备fd挂到处理器上并加入Epoll监听，按运行模式选择回调和监听事件
+ * 函数参数:handler:处理器
+ * 函数参数:fd:设备文件描述符
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_Epoll_Attach(epollHandler_t *handler, int fd)
+{
+    handler->fd = fd;
+
+    if(g_task_run_mode == TASK_RUN_MODE_EVENTLOOP)
+    {
+        handler->handler = Task_Epoll_ProcessInline;
+        return epoll_manager_add_handler(g_epoll_manager_fd, handler, TASK_EVENTLOOP_EVENTS);
+    }
+
+    handler->handler = Task_Epoll_WakeWorker;
+    return epoll_manager_add_handler(g_epoll_manager_fd, handler, TASK_EPOLL_EVENTS);
+}
+
+/*******************************************************************
+ * 函数原型:static int Task_Epoll_AttachSerial(epollHandler_t *handler, int fd, serialPortStream_t *stream, serialPortFramePolicy_t policy)
+ * 函数简介:串口设备加入Epoll监听并设置取帧策略。事件循环模式下串口设为非阻塞，读取不会卡住Epoll线程
+ * 函数参数:handler:处理器
+ * 函数参数:fd:串口文件描述符
+ * 函数参数:stream:设备的串口接收缓冲区
+ * 函数参数:policy:取帧策略
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_Epoll_AttachSerial(epollHandler_t *handler, int fd, serialPortStream_t *stream, serialPortFramePolicy_t policy)
+{
+    if(g_task_run_mode == TASK_RUN_MODE_EVENTLOOP && SerialPort_setNonBlock(fd, 1) < 0)
+    {
+        return -1;
+    }
+
+    SerialPort_streamSetPolicy(stream, policy);
+
+    return Task_Epoll_Attach(handler, fd);
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_Epoll_Rearm(epollHandler_t *handler, int fd)
+ * 函数简介:工作线程处理完后重新使能单次触发的监听
+ * 函数参数:handler:处理器
+ * 函数参数:fd:设备当前的文件描述符，设备已关闭(-1)或已换新fd时不处理
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_Epoll_Rearm(epollHandler_t *handler, int fd)
+{
+    if(fd < 0 || handler->fd != fd)
+    {
+        return;
+    }
+
+    epoll_manager_mod_handler(g_epoll_manager_fd, handler, TASK_EPOLL_EVENTS);
+}
+
+/*******************************************************************
+ * 函数原型:static int Task_CreateWorkThread(void *(*routine)(void *), const char *name, const char *threadName)
+ * 函数简介:创建设备工作线程并命名，事件循环模式下不创建
+ * 函数参数:routine:线程函数
+ * 函数参数:name:设备名称(打印用)
+ * 函数参数:threadName:线程名(最多15个字符，top -H中显示)
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_CreateWorkThread(void *(*routine)(void *), const char *name, const char *threadName)
+{
+    if(g_task_run_mode == TASK_RUN_MODE_EVENTLOOP)
+    {
+        return 0;
+    }
+
+    pthread_t tid;
+    if(pthread_create(&tid, NULL, routine, NULL) != 0)
+    {
+        printf("Task_CreateWorkThread:%s工作线程创建错误\n", name);
+        return -1;
+    }
+    ProcStat_setThreadName(tid, threadName);
+    usleep(100000);//等待线程创建
+
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:static int Task_Parse(metricsDevice_t dev, int (*parse)(void))
+ * 函数简介:调用设备的解析函数，记录追踪事件、解析耗时，返回-1时计入无效帧
+ * 函数参数:dev:设备
+ * 函数参数:parse:解析函数
+ * 函数返回值: 解析函数的返回值
+ *****************************************************************/
+static int Task_Parse(metricsDevice_t dev, int (*parse)(void))
+{
+    const char *name = Metrics_deviceName(dev);
+    int64_t startNs = Clock_nowNs();
+
+    Trace_begin("parse", name);
+    int ret = parse();
+    Trace_end("parse", name);
+
+    Metrics_observeSince(dev, METRICS_TIME_PARSE, startNs);
+    if(ret == -1)
+    {
+        Metrics_add(dev, METRICS_FRAMES_INVALID, 1);
+    }
+
+    return ret;
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_SendToHost(metricsDevice_t dev, char *msg)
+ * 函数简介:把打包好的数据发给上位机(已连接时)，记录上传耗时，并清空打包缓冲区
+ * 函数参数:dev:数据所属设备
+ * 函数参数:msg:DataPackageProcessing返回的打包缓冲区
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_SendToHost(metricsDevice_t dev, char *msg)
+{
+    int len = strlen(msg);
+
+    // [新增] 只有当标志位显示“已连接”时，才尝试发送
+    if(g_connecthost_tcpserConnectFlag == 1) {
+        int64_t startNs = Clock_nowNs();
+        Trace_begin("send", "TCP");
+        TCP_SendData(g_connecthost_tcpser_accept_sock_fd, (unsigned char *)msg, len);
+        Trace_end("send", "TCP");
+        Metrics_observeSince(dev, METRICS_TIME_SEND, startNs);
+    }
+
+    memset(msg, 0, len);
+}
+
+/*******************************************************************
+ * 函数原型:static int Task_ReadError(ssize_t ret)
+ * 函数简介:读取函数的返回值是否为读取错误(如USB串口拔出后的EIO)。帧无效(errno为EBADMSG)时
+ *          缓冲区中可能还有帧，继续读；读取错误时结束本次唤醒，不在同一次唤醒中重复读
+ * 函数参数:ret:ReadRawData/RecvData的返回值
+ * 函数返回值: 读取错误返回1，否则返回0
+ *****************************************************************/
+static int Task_ReadError(ssize_t ret)
+{
+    return ret < 0 && errno != EBADMSG;
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_MainCabin_Process(void)
+ * 函数简介:主控舱 读取->解析->上传->入库
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_MainCabin_Process(void)
+{
+    Trace_begin("read", "MainCabin");
+    int ret = MainCabin_ReadRawData();
+    Trace_end("read", "MainCabin");
+
+    if(ret == 0)
+    {
+        if(Task_Parse(METRICS_DEV_MAINCABIN, MainCabin_ParseData) == 0)
+        {
+            maincabinDataPack_t pack;
+            int64_t stamp = 0;
+
+            Task_SendToHost(METRICS_DEV_MAINCABIN, MainCabin_DataPackageProcessing());
+
+            MainCabin_getDataPack(&pack, &stamp);
+            TASK_STORE(METRICS_DEV_MAINCABIN, Database_insertMainCabinData(g_database, &pack, stamp));
+        }
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_GPS_Process(void)
+ * 函数简介:GPS 读取->解析->上传->入库
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_GPS_Process(void)
+{
+    ssize_t ret = 0;
+
+    for(int i = 0; i < TASK_MAX_FRAMES_PER_WAKEUP && (ret = GPS_ReadRawData()) != 0 && !Task_ReadError(ret); i++)
+    {
+        if(ret > 0 && Task_Parse(METRICS_DEV_GPS, GPS_ParseData) != -1)
+        {
+            gpsDataPack_t pack;
+            int64_t stamp = 0;
+
+            Task_SendToHost(METRICS_DEV_GPS, GPS_DataPackageProcessing());
+
+            GPS_getDataPack(&pack, &stamp);
+            TASK_STORE(METRICS_DEV_GPS, Database_insertGPSData(g_database, &pack, stamp));
+        }
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_CTD_Process(void)
+ * 函数简介:CTD 读取->解析->上传->入库(定深控制由控制执行器按固定频率运行)
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_CTD_Process(void)
+{
+    ssize_t ret = 0;
+    latencyTrace_t trace = {{0}};
+
+    /*  唤醒、开始处理的时间点只属于这次唤醒读到的第一帧    */
+    Latency_traceMark(&trace, LATENCY_POINT_WAKE, g_ctd_worker.wakeNs);
+    Latency_traceMark(&trace, LATENCY_POINT_START, 0);
+
+    for(int i = 0; i < TASK_MAX_FRAMES_PER_WAKEUP && (ret = CTD_ReadRawData()) != 0 && !Task_ReadError(ret); i++)
+    {
+        if(ret > 0 && Task_Parse(METRICS_DEV_CTD, CTD_ParseData) == 0)
+        {
+            ctdDataPack_t pack;
+            int64_t stamp = 0;
+
+            Latency_traceMark(&trace, LATENCY_POINT_PARSED, 0);
+            Latency_traceMark(&trace, LATENCY_POINT_FRAME, CTD_getStream()->frameStampNs);
+
+            Task_SendToHost(METRICS_DEV_CTD, CTD_DataPackageProcessing());
+            Latency_traceMark(&trace, LATENCY_POINT_SENT, 0);
+
+            CTD_getDataPack(&pack, &stamp);
+            TASK_STORE(METRICS_DEV_CTD, Database_insertCTDData(g_database, &pack, stamp));
+            Latency_traceMark(&trace, LATENCY_POINT_STORED, 0);
+
+            Latency_traceCommit(&trace);
+            memset(&trace, 0, sizeof(trace));
+        }
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_DVL_Process(void)
+ * 函数简介:DVL 读取->解析->上传->入库(定高/导航控制由控制执行器按固定频率运行)
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_DVL_Process(void)
+{
+    ssize_t ret = 0;
+
+    for(int i = 0; i < TASK_MAX_FRAMES_PER_WAKEUP && (ret = DVL_ReadRawData()) != 0 && !Task_ReadError(ret); i++)
+    {
+        if(ret > 0 && Task_Parse(METRICS_DEV_DVL, DVL_ParseData) == 0)
+        {
+            dvlDataPack_t pack;
+            int64_t stamp = 0;
+
+            Task_SendToHost(METRICS_DEV_DVL, DVL_DataPackageProcessing());
+
+            DVL_getDataPack(&pack, &stamp);
+            TASK_STORE_HIGHRATE(METRICS_DEV_DVL, TASK_BINLOG_DVL, &pack, stamp, Database_insertDVLData(g_database, &pack, stamp));
+        }
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_DTU_Process(void)
+ * 函数简介:数传电台 读取->解析->入库
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_DTU_Process(void)
+{
+    ssize_t ret = 0;
+
+    for(int i = 0; i < TASK_MAX_FRAMES_PER_WAKEUP && (ret = DTU_RecvData()) != 0 && !Task_ReadError(ret); i++)
+    {
+        if(ret > 0)
+        {
+            int64_t startNs = Clock_nowNs();
+            Trace_begin("parse", "DTU");
+            DTU_ParseData();
+            Trace_end("parse", "DTU");
+            Metrics_observeSince(METRICS_DEV_DTU, METRICS_TIME_PARSE, startNs);
+
+            TASK_STORE(METRICS_DEV_DTU, Database_insertDTURecvData(g_database, g_dtu_recvbuf));
+        }
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_USBL_Process(void)
+ * 函数简介:USBL 读取->解析->入库
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_USBL_Process(void)
+{
+    ssize_t ret = 0;
+
+    for(int i = 0; i < TASK_MAX_FRAMES_PER_WAKEUP && (ret = USBL_ReadRawData()) != 0 && !Task_ReadError(ret); i++)
+    {
+        usblDataPack_t pack;
+        int64_t stamp = 0;
+
+        if(ret > 0 && Task_Parse(METRICS_DEV_USBL, USBL_ParseData) == 0 && USBL_getDataPack(&pack, &stamp) == 0)
+        {
+            TASK_STORE(METRICS_DEV_USBL, Database_insertUSBLData(g_database, &pack, stamp));
+        }
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_Sonar_Process(void)
+ * 函数简介:Sonar 读取->解析->入库，然后请求下一帧(一问一答)
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_Sonar_Process(void)
+{
+    ssize_t ret = Sonar_ReadRawData();
+    if(ret > 0)
+    {
+        sonarDataPack_t pack;
+        int64_t stamp = 0;
+
+        if(Task_Parse(METRICS_DEV_SONAR, Sonar_ParseData) == 0 && Sonar_getDataPack(&pack, &stamp) == 0)
+        {
+            TASK_STORE_HIGHRATE(METRICS_DEV_SONAR, TASK_BINLOG_SONAR, &pack, stamp, Database_insertSonarData(g_database, &pack, stamp));
+        }
+    }
+
+    /*  应答还不完整时不重复请求    */
+    if(ret != 0 && g_sonar_status == 1)
+    {
+        Sonar_SendDataRequest();
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_Thruster_Process(void)
+ * 函数简介:推进器反馈 取数据->上传->入库(总线调度线程每轮询完一轮通知一次)
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_Thruster_Process(void)
+{
+    thrusterDataPack_t pack;
+    int64_t stamp = 0;
+
+    if(Thruster_ReadTelemetry() == 0 && Thruster_getDataPack(&pack, &stamp) == 0)
+    {
+        Task_SendToHost(METRICS_DEV_THRUSTER, Thruster_DataPackageProcessing());
+
+        TASK_STORE_HIGHRATE(METRICS_DEV_THRUSTER, TASK_BINLOG_THRUSTER, &pack, stamp,
+                            Database_insertThrusterData(g_database, &pack, stamp));
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_ConnectHost_Disconnect(void)
+ * 函数简介:断开上位机连接并移除监听
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_ConnectHost_Disconnect(void)
+{
+    g_connecthost_tcpserConnectFlag = -1;			//-1为未连接，1为已连接
+
+    epoll_manager_del_handler(g_epoll_manager_fd, &g_connecthost_epoll_handler);
+
+    close(g_connecthost_tcpser_accept_sock_fd);
+    g_connecthost_tcpser_accept_sock_fd = -1;
+    g_connecthost_epoll_handler.fd = -1;
+    memset(g_tcpserRecvBuf, 0, sizeof(g_tcpserRecvBuf));
+}
+
+/*******************************************************************
+ * 函数原型:static int Task_ConnectHost_Accept(void)
+ * 函数简介:接受上位机连接并加入Epoll监听
+ * 函数参数:无
+ * 函数返回值: 成功返回0，accept失败返回-1(errno有效)，客户端地址无效返回1
+ *****************************************************************/
+static int Task_ConnectHost_Accept(void)
+{
+    /*  客户端信息  */
+	struct sockaddr_in client_addr = {0};
+    socklen_t  client_len = sizeof(client_addr);
+
+    int fd = accept(g_connecthost_tcpser_listen_sock_fd, (struct sockaddr *)&client_addr, &client_len);
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    if (inet_ntop(AF_INET, &client_addr.sin_addr.s_addr, g_connecthost_ipstr, INET_ADDRSTRLEN) == NULL)
+    {
+        perror("tcp server error:inet_ntop");
+        close(fd);
+        return 1;
+    }
+
+    printf("tcp 与客户端连接成功,目标IP,%s\n", g_connecthost_ipstr);
+
+    if(g_task_run_mode == TASK_RUN_MODE_EVENTLOOP)
+    {
+        TCP_SetNonBlock(fd);
+    }
+
+    g_connecthost_tcpser_accept_sock_fd = fd;
+    Task_Epoll_Attach(&g_connecthost_epoll_handler, fd);
+
+    g_connecthost_tcpserConnectFlag = 1;
+
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_ConnectHost_AcceptInline(epollHandler_t *handler, uint32_t events)
+ * 函数简介:事件循环模式下监听套接字就绪的回调。只服务一个上位机，已连接时拒绝新的连接
+ * 函数参数:handler:就绪的处理器
+ * 函数参数:events:就绪事件
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_ConnectHost_AcceptInline(epollHandler_t *handler, uint32_t events)
+{
+    if(g_connecthost_tcpserConnectFlag == 1)
+    {
+        int fd = accept(handler->fd, NULL, NULL);
+        if(fd >= 0)
+        {
+            printf("Task_ConnectHost_AcceptInline:已有上位机连接，拒绝新的连接\n");
+            close(fd);
+        }
+        return;
+    }
+
+    if(Task_ConnectHost_Accept() < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        perror("Task_ConnectHost_AcceptInline: accept");
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_Control_TickInline(epollHandler_t *handler, uint32_t events)
+ * 函数简介:控制定时器到期，两种运行模式下都直接在Epoll线程中运行控制器
+ * 函数参数:handler:就绪的处理器
+ * 函数参数:events:就绪事件
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_Control_TickInline(epollHandler_t *handler, uint32_t events)
+{
+    ControlExec_Tick();
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_ConnectHost_HandleCommand(int recvDataSize)
+ * 函数简介:解析上位机指令
+ * 函数参数:recvDataSize:g_tcpserRecvBuf中的数据长度
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_ConnectHost_HandleCommand(int recvDataSize)
+{
+  /* 1. 解析电机推进器指令 (手动控制) */
+    if(g_tcpserRecvBuf[0] == '#' && g_tcpserRecvBuf[7] == '#' && g_tcpserRecvBuf[3] == '$' && g_tcpserRecvBuf[4] == '$')
+    {
+        // [关键修改] 手动模式优先级最高，强制关闭所有自动任务
+        DepthControl_Stop();      // 关定深
+        AltitudeControl_Stop();   // 关定高
+        Nav_Stop();               // 关导航
+        Task_Mission_Stop();      // 关预编程任务 (防止死循环)
+
+        char ctl_cmd[3] = {0};
+        int ctl_arg = 0;
+        sscanf(&g_tcpserRecvBuf[1], "%2s", ctl_cmd);
+        sscanf(&g_tcpserRecvBuf[5], "%2d", &ctl_arg);
+        Thruster_ControlHandle(ctl_cmd, ctl_arg);
+    }
+
+    /*		2.解析主控舱传感器供电指令		*/
+    else if(g_tcpserRecvBuf[0] == '=' && g_tcpserRecvBuf[recvDataSize-1] == '=')
+    {
+        if(strstr(g_tcpserRecvBuf, "open") != NULL)
+        {
+            MainCabin_PowerOnAllDeviceExceptReleaser();
+            printf("传感器已经全部供电\n");
+        }
+        else if(strstr(g_tcpserRecvBuf, "close") != NULL)
+        {
+            MainCabin_PowerOffAllDeviceExceptReleaser();
+            printf("传感器已经全部断电\n");
+        }
+    }
+
+    /*		3.解析释放器打开和关闭			*/
+    else if(g_tcpserRecvBuf[0] == '@' && g_tcpserRecvBuf[recvDataSize-1] == '@')
+    {
+        if(strstr(g_tcpserRecvBuf, "open1") != NULL)
+        {
+            if(MainCabin_SwitchPowerDevice(Releaser1, 1) == 0)
+            {
+                printf("释放器_1:已打开\n");
+            }
+        }
+        else if(strstr(g_tcpserRecvBuf, "open2") != NULL)
+        {
+            if(MainCabin_SwitchPowerDevice(Releaser2, 1) == 0)
+            {
+                printf("释放器_2:已打开\n");
+            }
+        }
+        else if(strstr(g_tcpserRecvBuf, "close1") != NULL)
+        {
+            if(MainCabin_SwitchPowerDevice(Releaser1, -1) == 0)
+            {
+                printf("释放器_1:已关闭\n");
+            }
+        }
+        else if(strstr(g_tcpserRecvBuf, "close2") != NULL)
+        {
+            if(MainCabin_SwitchPowerDevice(Releaser2, -1) == 0)
+            {
+                printf("释放器_2:已关闭\n");
+            }
+        }
+    }
+
+    /* 4. 解析定深控制指令 */
+    else if(g_tcpserRecvBuf[0] == '!' && g_tcpserRecvBuf[recvDataSize-1] == '!')
+    {
+        if(strncmp(g_tcpserRecvBuf, "!AD:OFF!", 8) == 0)
+        {
+             DepthControl_Stop();
+             printf("定深模式已关闭\n");
+        }
+        else if(strncmp(g_tcpserRecvBuf, "!AD:", 4) == 0)
+        {
+             // [关键修改] 开启定深前，必须强制关闭定高！
+             AltitudeControl_Stop();
+
+             double target = 0.0;
+             if(sscanf(g_tcpserRecvBuf, "!AD:%lf!", &target) == 1)
+             {
+                 DepthControl_Start(target);
+                 printf("收到定深指令，目标深度: %.2f 米\n", target);
+             }
+        }
+    }
+    /* 5. 解析定高控制指令 */
+    else if(strncmp(g_tcpserRecvBuf, "!AH:", 4) == 0)
+    {
+        // [关键修改] 开启定高前，必须强制关闭定深！
+        DepthControl_Stop();
+
+        if(strncmp(g_tcpserRecvBuf, "!AH:OFF!", 8) == 0) {
+            AltitudeControl_Stop();
+        } else {
+            double target = 0.0;
+            if(sscanf(g_tcpserRecvBuf, "!AH:%lf!", &target) == 1) {
+                AltitudeControl_Start(target);
+            }
+        }
+    }
+}
+
+/*******************************************************************
+ * 函数原型:static void Task_ConnectHost_Process(void)
+ * 函数简介:上位机 接收->解析指令->入库，连接断开时清理连接
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+static void Task_ConnectHost_Process(void)
+{
+    int recvDataSize = recv(g_connecthost_tcpser_accept_sock_fd, g_tcpserRecvBuf, sizeof(g_tcpserRecvBuf) - 1, 0);
+    if(recvDataSize == 0)
+    {
+        printf("客户端：%s已断开连接\n", g_connecthost_ipstr);
+        Task_ConnectHost_Disconnect();
+        return;
+    }
+    else if(recvDataSize < 0)
+    {
+        /*  非阻塞套接字暂无数据    */
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        {
+            return;
+        }
+
+        perror("Task_ConnectHost_Process:tcp server thread occured error, closing tcp \n");
+        Task_ConnectHost_Disconnect();
+        return;
+    }
+
+    g_tcpserRecvBuf[recvDataSize] = '\0';
+    printf("tcp server recv size:%d recv data:%s\n", recvDataSize, g_tcpserRecvBuf);
+
+    Task_ConnectHost_HandleCommand(recvDataSize);
+
+    Database_insertTCPRecvData(g_database, g_tcpserRecvBuf);
+
+    /*  之后的字节本来就是0，只清掉这次收到的部分    */
+    memset(g_tcpserRecvBuf, 0, recvDataSize + 1);
+}
+
+/************************************************************************************
+ 									公共接口实现(外部可调用)
+*************************************************************************************/
+/*******************************************************************
+ * 函数原型:int Task_SetRunMode(TaskRunMode mode)
+ * 函数简介:设置运行模式，必须在Task_Epoll_Init之前调用
+ * 函数参数:mode:TASK_RUN_MODE_THREAD 或 TASK_RUN_MODE_EVENTLOOP
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int Task_SetRunMode(TaskRunMode mode)
+{
+    if(g_epoll_manager_fd >= 0)
+    {
+        printf("Task_SetRunMode:Epoll管理器已创建，不能再切换运行模式\n");
+        return -1;
+    }
+
+    if(mode != TASK_RUN_MODE_THREAD && mode != TASK_RUN_MODE_EVENTLOOP)
+    {
+        return -1;
+    }
+
+    g_task_run_mode = mode;
+
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:void Task_SetThrusterTelemetry(int enable)
+ * 函数简介:设置是否轮询推进器反馈(转速、电流、故障码)，必须在Task_Thruster_Init之前调用
+ * 函数参数:enable:1为轮询，0为不轮询(默认)
+ * 函数返回值: 无
+ *****************************************************************/
+void Task_SetThrusterTelemetry(int enable)
+{
+    g_task_thruster_telemetry = enable;
+}
+
+/*******************************************************************
+ * 函数原型:TaskRunMode Task_GetRunMode(void)
+ * 函数简介:获取运行模式
+ * 函数参数:无
+ * 函数返回值: 当前运行模式
+ *****************************************************************/
+TaskRunMode Task_GetRunMode(void)
+{
+    return g_task_run_mode;
+}
+
+/*******************************************************************
+ * 函数原型:void Task_PrintSerialStats(void)
+ * 函数简介:打印各串口设备的接收统计(帧数、跳过的旧帧、丢帧、丢弃字节、溢出)
+ *           推进器总线的发送统计(发送、抑制的重复指令)、控制执行器的耗时统计、链路延时、日志丢弃以及入库情况
+ * 函数参数:无
+ * 函数返回值: 无
+ *****************************************************************/
+void Task_PrintSerialStats(void)
+{
+    serialPortStream_t *streams[] = {GPS_getStream(), CTD_getStream(), DVL_getStream(),
+                                     DTU_getStream(), USBL_getStream(), Sonar_getStream()};
+
+    for(size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); i++)
+    {
+        /*  没有初始化的设备不打印  */
+        if(streams[i]->name != NULL)
+        {
+            SerialPort_streamPrintStats(streams[i]);
+        }
+    }
+
+    Thruster_PrintBusStats();
+    ControlExec_PrintStats();
+    Latency_Print();
+    ProcStat_Print();
+    Pool_Print();
+    Binlog_Print();
+
+    logStats_t logStats;
+    Log_getStats(&logStats);
+    printf("[Log] 已输出:%lu 队列满丢弃:%lu 限速丢弃:%lu\n", logStats.written, logStats.dropped, logStats.limited);
+
+    databaseStats_t dbStats;
+    Database_getStats(&dbStats);
+    printf("[DB] 插入:%lu 失败:%lu 提交:%lu 提交失败:%lu 未提交:%d 队列:%zu 队列满丢弃:%lu 检查点:%lu/失败%lu WAL页:%d\n",
+           dbStats.rows, dbStats.failedRows, dbStats.commits, dbStats.failedCommits, dbStats.pendingRows,
+           dbStats.queued, dbStats.dropped, dbStats.checkpoints, dbStats.checkpointFailed, dbStats.walPages);
+}
 
 /*******************************************************************
  * 函数原型:int Task_Database_Init(void)
@@ -117,16 +1024,42 @@ static volatile int g_connecthost_work_flag = -1;      //-1为不工作，1为
 int Task_Database_Init(void)
 {
     /*  1.初始化数据库 */
-    g_database = Database_init(g_database);
+    g_database = Database_init(g_database, NULL);
     if(g_database == NULL)
     {
         return -1;
     }
 
+    /*  2.启动写入线程，各设备线程只入队，SQLite卡顿时不会阻塞读取、控制  */
+    if(Database_StartWriter(g_database, DATABASE_QUEUE_SIZE, DATABASE_OVERFLOW_DROP_OLDEST) < 0)
+    {
+        printf("数据库写入线程启动失败，在各设备线程中直接写入\n");
+    }
+
     return 0;
 }
 
 
+/*******************************************************************
+ * 函数原型:int Task_Binlog_Init(void)
+ * 函数简介:登记高频数据的记录类型并启动二进制日志，之后DVL、声纳、推进器反馈不再逐行入库
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1(仍入库)
+ *****************************************************************/
+int Task_Binlog_Init(void)
+{
+    /*  1.记录类型:名称与数据库表名一致  */
+    if(Binlog_registerType(TASK_BINLOG_DVL, "DVL", sizeof(dvlDataPack_t)) < 0 ||
+       Binlog_registerType(TASK_BINLOG_SONAR, "Sonar", sizeof(sonarDataPack_t)) < 0 ||
+       Binlog_registerType(TASK_BINLOG_THRUSTER, "Thruster", sizeof(thrusterDataPack_t)) < 0)
+    {
+        return -1;
+    }
+
+    /*  2.段文件以数据库的运行编号命名 */
+    return Binlog_Init(BINLOG_DIR, Database_getRun());
+}
+
 /*******************************************************************
  * 函数原型:int Task_Epoll_Init(void)
  * 函数简介:Epoll任务初始化 创建Epoll工作线程
@@ -150,186 +1083,356 @@ int Task_Epoll_Init(void)
         printf("Task_Epoll_Init:Epoll 管理器创建工作线程错误\n");
         return -1;
     }
+    ProcStat_setThreadName(tid, "epoll");
     usleep(100000);//等待线程创建
 
+    /*  3.创建挂断设备的重连线程    */
+    if(pthread_create(&tid, NULL, Task_Reconnect_WorkThread, NULL) != 0)
+    {
+        printf("Task_Epoll_Init:重连线程创建错误\n");
+        return -1;
+    }
+    ProcStat_setThreadName(tid, "reconnect");
+
     return 0;
 }
 
 /*******************************************************************
  * 函数原型:void *Task_Epoll_WorkThread(void *arg)
- * 函数简介:Epoll工作线程
+ * 函数简介:Epoll工作线程。线程模式下负责唤醒各设备工作线程，
+ *          事件循环模式下直接完成所有设备的读取、解析、发布
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
  *****************************************************************/
 void *Task_Epoll_WorkThread(void *arg)
 {
-    pthread_detach(pthread_self());
-
-    printf("Epoll工作线程创建成功......\n");
-
-    int epoll_fd = *(int *)arg;
-    struct epoll_event events[30] = {0};
+    pthread_detach(pthread_self());
+    Rt_enterThread(RT_ROLE_CONTROL);
+
+    printf("Epoll工作线程创建成功(%s模式)......\n", g_task_run_mode == TASK_RUN_MODE_EVENTLOOP ? "事件循环" : "多线程");
+
+    int epoll_fd = *(int *)arg;
+    struct epoll_event events[30] = {0};
+
+    while(1)
+    {
+        /*  等待有事件发生，直接回调data.ptr中的处理器  */
+        epoll_manager_dispatch(epoll_fd, events, 30, 200);
+    }
+
+    return NULL;
+}
+
+/*******************************************************************
+ * 函数原型:static void *Task_Reconnect_WorkThread(void *arg)
+ * 函数简介:重连线程。每隔TASK_RECONNECT_INTERVAL_MS检查被Task_Epoll_Hangup移出监听的设备，
+ *          持工作线程的锁(等它处理完当前数据)重新打开，成功后设备重新加入监听
+ * 函数参数:无
+ * 函数返回值: NULL
+ *****************************************************************/
+static void *Task_Reconnect_WorkThread(void *arg)
+{
+    pthread_detach(pthread_self());
+    Rt_enterThread(RT_ROLE_BACKGROUND);
+
+    taskWorker_t *workers[] = {&g_maincabin_worker, &g_gps_worker, &g_ctd_worker, &g_dvl_worker, &g_dtu_worker, &g_usbl_worker, &g_sonar_worker};
+    epollHandler_t *handlers[] = {&g_maincabin_epoll_handler, &g_gps_epoll_handler, &g_ctd_epoll_handler, &g_dvl_epoll_handler, &g_dtu_epoll_handler, &g_usbl_epoll_handler, &g_sonar_epoll_handler};
+
+    while(1)
+    {
+        usleep(TASK_RECONNECT_INTERVAL_MS * 1000);
+
+        for(size_t i = 0; i < sizeof(workers) / sizeof(workers[0]); i++)
+        {
+            if(workers[i]->lost != 1)
+            {
+                continue;
+            }
+
+            pthread_mutex_lock(workers[i]->mutex);
+            int ret = workers[i]->reopen();
+            pthread_mutex_unlock(workers[i]->mutex);
+
+            if(ret == 0)
+            {
+                workers[i]->lost = 0;
+                LOG_I(LOG_MOD_MAIN, "%s:挂断处理完成，已重新加入监听或交给原有的重连流程\n", handlers[i]->name);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+ /*******************************************************************
+ * 函数原型:int Task_MainCabin_Init(void)
+ * 函数简介:主控舱相关任务初始化
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int Task_MainCabin_Init(void)
+{
+    /*  1.主控舱初始化  */
+    if(MainCabin_Init() < 0)
+    {
+        return -1;
+    }
+
+    /*  打开释放器*/
+    if(MainCabin_SwitchPowerDevice(Releaser1, 1) < 0 || MainCabin_SwitchPowerDevice(Releaser2, 1) < 0)
+    {
+        return -1;
+    }
+
+    /*  2.加入Epoll监听文件描述符   */
+    if(Task_MainCabin_Attach() < 0)
+    {
+        return -1;
+    }
+        printf("释放器已打开......\n");
+
+    /*  3.创建工作线程  */
+    if(Task_CreateWorkThread(Task_MainCabin_WorkThread, "主控舱", "maincabin") < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:static int Task_MainCabin_Reopen(void)
+ * 函数简介:主控舱连接挂断后交给主循环中已有的断线重连(MainCabin_ReConnect)
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_MainCabin_Reopen(void)
+{
+    g_maincabin_tcpcliConnectFlag = -1;
+
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:int Task_MainCabin_Attach(void)
+ * 函数简介:把主控舱当前的套接字加入Epoll监听(初始化和断线重连时调用)
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int Task_MainCabin_Attach(void)
+{
+    return Task_Epoll_Attach(&g_maincabin_epoll_handler, MainCabin_getFD());
+}
+
+/*******************************************************************
+ * 函数原型:void *Task_MainCabin_WorkThread(void *arg)
+ * 函数简介:主控舱工作线程
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+void *Task_MainCabin_WorkThread(void *arg)
+{
+    Rt_enterThread(RT_ROLE_IO);
 
     while(1)
     {
-        /*  等待有事件发生  */
-        int nfds = epoll_manager_wait(epoll_fd, events, 30, 200);
-        if(nfds < 0 || nfds == 0) continue;
-
-        if(nfds > 0)
+        pthread_mutex_lock(&g_maincabin_mutex);
+        while(g_maincabin_work_flag != 1)
         {
-            for(int i = 0; i < nfds; i++)
-            {
-                int fd = events[i].data.fd;
-
-                /*  主控舱*/
-                if(fd == MainCabin_getFD()){
-
-                    g_maincabin_work_flag = 1;
-                    pthread_cond_signal(&g_maincabin_cond);
-                }
-
-                /*  GPS */
-                if(fd == GPS_getFD()){
-                    g_gps_work_flag = 1;
-                    pthread_cond_signal(&g_gps_cond);
-                }
-
-                /*  CTD  */
-                if(fd == CTD_getFD()){
-                    g_ctd_work_flag = 1;
-                    pthread_cond_signal(&g_ctd_cond);
-                }
-
-                /*  DVL  */
-                if(fd == DVL_getFD()){
-                    g_dvl_work_flag = 1;
-                    pthread_cond_signal(&g_dvl_cond);
-                }
-
-                /*  数传电台    */
-                if(fd == DTU_getFD()){
-                    g_dtu_work_flag = 1;
-                    pthread_cond_signal(&g_dtu_cond);
-                }
-
-                /*  USBL    */
-                if(fd == USBL_getFD()){
-                    g_usbl_work_flag = 1;
-                    pthread_cond_signal(&g_usbl_cond);
-                }
-
-                /*  上位机连接  */
-                if(fd == g_connecthost_tcpser_accept_sock_fd){
-                    g_connecthost_work_flag = 1;
-                    pthread_cond_signal(&g_connecthost_cond);
-                }
-            }
+            pthread_cond_wait(&g_maincabin_cond, &g_maincabin_mutex);
+        }
+        if(g_maincabin_work_flag == 1)        //开始工作
+        {
+            g_maincabin_work_flag = -1;
+            Task_MainCabin_Process();
         }
+        pthread_mutex_unlock(&g_maincabin_mutex);
+        Task_Epoll_Rearm(&g_maincabin_epoll_handler, MainCabin_getFD());
     }
 }
 
  /*******************************************************************
- * 函数原型:int Task_MainCabin_Init(void)
- * 函数简介:主控舱相关任务初始化
+ * 函数原型:int Task_Thruster_Init(void)
+ * 函数简介:推进器相关任务初始化
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
-int Task_MainCabin_Init(void)
+ *****************************************************************/
+int Task_Thruster_Init(void)
 {
-    /*  1.主控舱初始化  */
-    if(MainCabin_Init() < 0)
+    /*  1.推进器初始化    */
+    if(Thruster_Init() < 0)
     {
         return -1;
     }
+    usleep(500000);
 
-    /*  打开释放器*/
-    if(MainCabin_SwitchPowerDevice(Releaser1, 1) < 0 || MainCabin_SwitchPowerDevice(Releaser2, 1) < 0)
+    /*  2.发送上电配置  */
+    if(Thruster_SendInitConfig() < 0)
     {
         return -1;
     }
 
-    /*  2.加入Epoll监听文件描述符   */
-    if(epoll_manager_add_fd(g_epoll_manager_fd ,MainCabin_getFD(), EPOLLIN) < 0)
+    /*  3.打开总线发送线程，之后控制接口不再等待串口  */
+    if(Thruster_StartBusWriterThread() == 0)
     {
         return -1;
     }
-        printf("释放器已打开......\n");
 
-    /*  3.创建工作线程  */
-    pthread_t tid;
-    if(pthread_create(&tid, NULL, (void *)Task_MainCabin_WorkThread, NULL) < 0)
+    /*  4.打开心跳(由总线调度线程按时间表发送)  */
+    if(Thruster_StartHeartbeatThread() == 0)
+    {
+        return -1;
+    }
+
+    /*  5.打开反馈轮询，每轮询完一轮通过eventfd通知(未启用时只发控制和心跳)   */
+    if(!g_task_thruster_telemetry)
+    {
+        printf("推进器反馈轮询:未启用\n");
+        return 0;
+    }
+    if(Thruster_StartTelemetry() < 0)
+    {
+        return -1;
+    }
+
+    if(Task_Epoll_Attach(&g_thruster_epoll_handler, Thruster_getEventFD()) < 0)
+    {
+        return -1;
+    }
+
+    /*  6.创建工作线程  */
+    if(Task_CreateWorkThread(Task_Thruster_WorkThread, "推进器", "thr-telemetry") < 0)
     {
-        printf("Task_MainCabin_Init:主控舱工作线程创建错误\n");
         return -1;
     }
-    usleep(100000);//等待线程创建
 
     return 0;
 }
 
 /*******************************************************************
- * 函数原型:void *Task_MainCabin_WorkThread(void *arg)
- * 函数简介:主控舱工作线程
+ * 函数原型:void *Task_Thruster_WorkThread(void *arg)
+ * 函数简介:推进器反馈数据工作线程
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
  *****************************************************************/
-void *Task_MainCabin_WorkThread(void *arg)
+void *Task_Thruster_WorkThread(void *arg)
 {
+    Rt_enterThread(RT_ROLE_IO);
+
     while(1)
     {
-        pthread_mutex_lock(&g_maincabin_mutex);
-        pthread_cond_wait(&g_maincabin_cond, &g_maincabin_mutex);
-        if(g_maincabin_work_flag == 1)        //开始工作
+        pthread_mutex_lock(&g_thruster_mutex);
+        while(g_thruster_work_flag != 1)
         {
-            if(MainCabin_ReadRawData() == 0)
-            {
-                if(MainCabin_ParseData() == 0)
-                {
-                    char *msg = MainCabin_DataPackageProcessing();
-                    int len = strlen(msg);
-                    if(g_connecthost_tcpserConnectFlag == 1) {
-                        TCP_SendData(g_connecthost_tcpser_accept_sock_fd, (unsigned char *)msg, len);
-                    }
-                    memset(msg, 0, len);
-
-                    Database_insertMainCabinData(g_database, &g_maincabin_data_pack);
-                }
-            }
-            g_maincabin_work_flag = -1;
-            pthread_mutex_unlock(&g_maincabin_mutex);
+            pthread_cond_wait(&g_thruster_cond, &g_thruster_mutex);
+        }
+        if(g_thruster_work_flag == 1)        //开始工作
+        {
+            g_thruster_work_flag = -1;
+            Task_Thruster_Process();
         }
+        pthread_mutex_unlock(&g_thruster_mutex);
+        Task_Epoll_Rearm(&g_thruster_epoll_handler, Thruster_getEventFD());
     }
 }
 
  /*******************************************************************
- * 函数原型:int Task_Thruster_Init(void)
- * 函数简介:推进器相关任务初始化
+ * 函数原型:int Task_Control_Init(void)
+ * 函数简介:控制执行器初始化，定时器加入Epoll监听(频率由ControlExec_SetRate设置)
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
-int Task_Thruster_Init(void)
+ *****************************************************************/
+int Task_Control_Init(void)
 {
-    /*  1.推进器初始化    */
-    if(Thruster_Init() < 0)                  
+    int fd = ControlExec_Init();
+    if(fd < 0)
     {
         return -1;
-    }            
-    usleep(500000);
+    }
 
-    /*  2.发送上电配置  */
-    if(Thruster_SendInitConfig() < 0)  
+    g_control_epoll_handler.fd = fd;
+    if(epoll_manager_add_handler(g_epoll_manager_fd, &g_control_epoll_handler, EPOLLIN) < 0)
     {
         return -1;
     }
 
-    /*  3.打开心跳  */
-    if(Thruster_StartHeartbeatThread() == 0)
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:static long Task_LogQueueDepth(void)
+ * 函数简介:日志队列中等待输出的条数(运行指标用)
+ * 函数参数:无
+ * 函数返回值: 条数
+ *****************************************************************/
+static long Task_LogQueueDepth(void)
+{
+    logStats_t stats;
+    Log_getStats(&stats);
+
+    return (long)stats.queued;
+}
+
+/*******************************************************************
+ * 函数原型:static long Task_DbQueueDepth(void)
+ * 函数简介:数据库队列中等待写入的记录数(运行指标用)
+ * 函数参数:无
+ * 函数返回值: 记录数
+ *****************************************************************/
+static long Task_DbQueueDepth(void)
+{
+    databaseStats_t stats;
+    Database_getStats(&stats);
+
+    return (long)stats.queued;
+}
+
+/*******************************************************************
+ * 函数原型:static long Task_DbDropped(void)
+ * 函数简介:数据库队列满时丢弃的记录数(运行指标用)
+ * 函数参数:无
+ * 函数返回值: 记录数
+ *****************************************************************/
+static long Task_DbDropped(void)
+{
+    databaseStats_t stats;
+    Database_getStats(&stats);
+
+    return (long)stats.dropped;
+}
+
+/*******************************************************************
+ * 函数原型:int Task_Metrics_Init(const char *addr)
+ * 函数简介:登记各设备的接收缓冲区、Epoll处理器和队列深度，在Epoll管理器中提供运行指标
+ * 函数参数:addr:监听地址，见Metrics_Init
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+int Task_Metrics_Init(const char *addr)
+{
+    epollHandler_t *handlers[] = {&g_maincabin_epoll_handler, &g_gps_epoll_handler, &g_ctd_epoll_handler,
+                                  &g_dvl_epoll_handler, &g_dtu_epoll_handler, &g_usbl_epoll_handler,
+                                  &g_sonar_epoll_handler, &g_connecthost_epoll_handler, &g_thruster_epoll_handler,
+                                  &g_connecthost_listen_epoll_handler, &g_control_epoll_handler};
+
+    Metrics_registerStream(METRICS_DEV_GPS, GPS_getStream());
+    Metrics_registerStream(METRICS_DEV_CTD, CTD_getStream());
+    Metrics_registerStream(METRICS_DEV_DVL, DVL_getStream());
+    Metrics_registerStream(METRICS_DEV_DTU, DTU_getStream());
+    Metrics_registerStream(METRICS_DEV_USBL, USBL_getStream());
+    Metrics_registerStream(METRICS_DEV_SONAR, Sonar_getStream());
+
+    for(size_t i = 0; i < sizeof(handlers) / sizeof(handlers[0]); i++)
     {
-        return -1;
+        Metrics_registerHandler(handlers[i]);
     }
 
-    return 0;
+    Metrics_registerGauge("auv_log_queue_depth", "日志队列中等待输出的条数", Task_LogQueueDepth);
+    Metrics_registerGauge("auv_db_queue_depth", "数据库队列中等待写入的记录数", Task_DbQueueDepth);
+    Metrics_registerGauge("auv_db_records_dropped", "数据库队列满时丢弃的记录数", Task_DbDropped);
+    Metrics_registerCollector(ProcStat_renderMetrics);
+    Metrics_registerCollector(Pool_renderMetrics);
+
+    return Metrics_Init(g_epoll_manager_fd, addr);
 }
 
  /*******************************************************************
@@ -337,7 +1440,7 @@ int Task_Thruster_Init(void)
  * 函数简介:上位机连接相关任务初始化
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
+ *****************************************************************/
 int Task_ConnectHost_Init(void)
 {
     /*  1.初始化连接 -- 监听 */
@@ -346,6 +1449,19 @@ int Task_ConnectHost_Init(void)
         return -1;
     }
 
+    /*  2.事件循环模式:监听套接字直接加入Epoll，在Epoll线程中accept    */
+    if(g_task_run_mode == TASK_RUN_MODE_EVENTLOOP)
+    {
+        g_connecthost_listen_epoll_handler.fd = g_connecthost_tcpser_listen_sock_fd;
+        if(TCP_SetNonBlock(g_connecthost_tcpser_listen_sock_fd) < 0 ||
+           epoll_manager_add_handler(g_epoll_manager_fd, &g_connecthost_listen_epoll_handler, TASK_EVENTLOOP_EVENTS) < 0)
+        {
+            return -1;
+        }
+
+        return 0;
+    }
+
      /*  2.创建工作线程  */
     pthread_t tcpServertid;
 	if(pthread_create(&tcpServertid, NULL, (void*)Task_ConnectHost_WorkThread, NULL) < 0)
@@ -353,6 +1469,7 @@ int Task_ConnectHost_Init(void)
 		perror("Task_ConnectHost_Init:create tcp server thread error");
 		return -1;
 	}
+    ProcStat_setThreadName(tcpServertid, "host");
 
     usleep(100000);
 
@@ -361,194 +1478,44 @@ int Task_ConnectHost_Init(void)
 
  /*******************************************************************
  * 函数原型:void *Task_ConnectHost_WorkThread(void *arg)
- * 函数简介:上位机连接线程函数
+ * 函数简介:上位机连接线程函数(线程模式)
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
+ *****************************************************************/
 void *Task_ConnectHost_WorkThread(void *arg)
 {
     /* 设置线程分离 */
     pthread_detach(pthread_self());
-
-    /*  客户端信息  */
-	struct sockaddr_in client_addr = {0};
-    socklen_t  client_len = 0;
-    client_len = sizeof(client_addr);
-    char ipstr[INET_ADDRSTRLEN] = {0};
-
-    int recvDataSize = 0;
+    Rt_enterThread(RT_ROLE_COMMAND);
 
     while(1)
     {
         while(g_connecthost_tcpserConnectFlag == -1)
         {
-            g_connecthost_tcpser_accept_sock_fd = accept(g_connecthost_tcpser_listen_sock_fd, (struct sockaddr *)&client_addr, &client_len);
-            if (g_connecthost_tcpser_accept_sock_fd < 0)
+            if(Task_ConnectHost_Accept() < 0)
             {
                 perror("Task_ConnectHost_WorkThread: accept");
                 close(g_connecthost_tcpser_listen_sock_fd);
                 pthread_exit((void *)-1);
             }
-
-            if (inet_ntop(AF_INET, &client_addr.sin_addr.s_addr, ipstr, INET_ADDRSTRLEN) == NULL)
-            {
-                perror("tcp server error:inet_ntop");
-                close(g_connecthost_tcpser_accept_sock_fd);
-                continue;
-            }
-
-            printf("tcp 与客户端连接成功,目标IP,%s\n", ipstr);
-
-            epoll_manager_add_fd(g_epoll_manager_fd, g_connecthost_tcpser_accept_sock_fd, EPOLLIN);
-
-            g_connecthost_tcpserConnectFlag = 1;
         }
 
         while(g_connecthost_tcpserConnectFlag == 1)
         {
-            if(g_connecthost_work_flag == 1)
+            pthread_mutex_lock(&g_connecthost_mutex);
+            while(g_connecthost_work_flag != 1)
             {
                 pthread_cond_wait(&g_connecthost_cond, &g_connecthost_mutex);
-                recvDataSize = recv(g_connecthost_tcpser_accept_sock_fd, g_tcpserRecvBuf, sizeof(g_tcpserRecvBuf), 0);
-                if(recvDataSize == 0)
-                {
-                    printf("客户端：%s已断开连接\n", ipstr);
-                    g_connecthost_tcpserConnectFlag = -1;			//-1为未连接，1为已连接
-
-                    epoll_manager_del_fd(g_epoll_manager_fd, g_connecthost_tcpser_accept_sock_fd);
-
-                    close(g_connecthost_tcpser_accept_sock_fd);
-                    g_connecthost_tcpser_accept_sock_fd = -1;
-                    memset(g_tcpserRecvBuf, 0, sizeof(g_tcpserRecvBuf));
-                    break;
-                }
-                else if(recvDataSize < 0)
-                {
-                    perror("Task_ConnectHost_WorkThread:tcp server thread occured error, closing tcp \n");
-                    epoll_manager_del_fd(g_epoll_manager_fd, g_connecthost_tcpser_accept_sock_fd);
-                    close(g_connecthost_tcpser_accept_sock_fd);
-                    g_connecthost_tcpser_accept_sock_fd = -1;
-                    g_connecthost_tcpserConnectFlag = -1;			//-1为未连接，1为已连接
-                    break;
-                }
-                else
-                {
-                    g_tcpserRecvBuf[recvDataSize] = '\0';
-                    printf("tcp server recv size:%d recv data:%s\n", recvDataSize, g_tcpserRecvBuf);
-
-                  /* 1. 解析电机推进器指令 (手动控制) */
-                    if(g_tcpserRecvBuf[0] == '#' && g_tcpserRecvBuf[7] == '#' && g_tcpserRecvBuf[3] == '$' && g_tcpserRecvBuf[4] == '$')
-                    {
-                        // [关键修改] 手动模式优先级最高，强制关闭所有自动任务
-                        DepthControl_Stop();      // 关定深
-                        AltitudeControl_Stop();   // 关定高
-                        Nav_Stop();               // 关导航
-                        Task_Mission_Stop();      // 关预编程任务 (防止死循环)
-                        
-                        char ctl_cmd[3] = {0}; 
-                        int ctl_arg = 0;
-                        sscanf(&g_tcpserRecvBuf[1], "%2s", ctl_cmd);
-                        sscanf(&g_tcpserRecvBuf[5], "%2d", &ctl_arg);
-                        Thruster_ControlHandle(ctl_cmd, ctl_arg);
-                    }
-
-                    /*		2.解析主控舱传感器供电指令		*/
-                    else if(g_tcpserRecvBuf[0] == '=' && g_tcpserRecvBuf[recvDataSize-1] == '=')
-                    {
-                        if(strstr(g_tcpserRecvBuf, "open") != NULL)
-                        {
-                            MainCabin_PowerOnAllDeviceExceptReleaser();
-                            printf("传感器已经全部供电\n");
-                        }
-                        else if(strstr(g_tcpserRecvBuf, "close") != NULL)
-                        {
-                            MainCabin_PowerOffAllDeviceExceptReleaser();
-                            printf("传感器已经全部断电\n");
-                        }
-                    }
-
-                    /*		3.解析释放器打开和关闭			*/
-                    else if(g_tcpserRecvBuf[0] == '@' && g_tcpserRecvBuf[recvDataSize-1] == '@')
-                    {
-                        if(strstr(g_tcpserRecvBuf, "open1") != NULL)
-                        {
-                            if(MainCabin_SwitchPowerDevice(Releaser1, 1) == 0)
-                            {
-                                printf("释放器_1:已打开\n");
-                            }
-                        }
-                        else if(strstr(g_tcpserRecvBuf, "open2") != NULL)
-                        {
-                            if(MainCabin_SwitchPowerDevice(Releaser2, 1) == 0)
-                            {
-                                printf("释放器_2:已打开\n");
-                            }
-                        }
-                        else if(strstr(g_tcpserRecvBuf, "close1") != NULL)
-                        {
-                            if(MainCabin_SwitchPowerDevice(Releaser1, -1) == 0)
-                            {
-                                printf("释放器_1:已关闭\n");
-                            }
-                        }
-                        else if(strstr(g_tcpserRecvBuf, "close2") != NULL)
-                        {
-                            if(MainCabin_SwitchPowerDevice(Releaser2, -1) == 0)
-                            {
-                                printf("释放器_2:已关闭\n");
-                            }
-                        }
-                    }
-
-                    /* 4. 解析定深控制指令 */
-                    else if(g_tcpserRecvBuf[0] == '!' && g_tcpserRecvBuf[recvDataSize-1] == '!')
-                    {
-                        if(strncmp(g_tcpserRecvBuf, "!AD:OFF!", 8) == 0)
-                        {
-                             DepthControl_Stop(); 
-                             printf("定深模式已关闭\n");
-                        }
-                        else if(strncmp(g_tcpserRecvBuf, "!AD:", 4) == 0)
-                        {
-                             // [关键修改] 开启定深前，必须强制关闭定高！
-                             AltitudeControl_Stop(); 
-                             
-                             double target = 0.0;
-                             if(sscanf(g_tcpserRecvBuf, "!AD:%lf!", &target) == 1)
-                             {
-                                 DepthControl_Start(target);
-                                 printf("收到定深指令，目标深度: %.2f 米\n", target);
-                             }
-                        }
-                    }
-                    /* 5. 解析定高控制指令 */
-                    else if(strncmp(g_tcpserRecvBuf, "!AH:", 4) == 0) 
-                    {
-                        // [关键修改] 开启定高前，必须强制关闭定深！
-                        DepthControl_Stop(); 
-        
-                        if(strncmp(g_tcpserRecvBuf, "!AH:OFF!", 8) == 0) {
-                            AltitudeControl_Stop();
-                        } else {
-                            double target = 0.0;
-                            if(sscanf(g_tcpserRecvBuf, "!AH:%lf!", &target) == 1) {
-                                AltitudeControl_Start(target);
-                            }
-                        }
-                    }
-
-
-                    g_connecthost_work_flag = -1;
-                }
-
-                Database_insertTCPRecvData(g_database, g_tcpserRecvBuf);
-            
-                memset(g_tcpserRecvBuf, 0, sizeof(g_tcpserRecvBuf));
-                recvDataSize = 0;	
             }
+            g_connecthost_work_flag = -1;
+            pthread_mutex_unlock(&g_connecthost_mutex);
+
+            Task_ConnectHost_Process();
+
+            Task_Epoll_Rearm(&g_connecthost_epoll_handler, g_connecthost_tcpser_accept_sock_fd);
         }
     }
-    
+
     return NULL;
 }
 
@@ -558,7 +1525,7 @@ void *Task_ConnectHost_WorkThread(void *arg)
  * 函数简介:GPS相关任务初始化
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
+ *****************************************************************/
 int Task_GPS_Init(void)
 {
     /*  GPS初始化   */
@@ -568,23 +1535,36 @@ int Task_GPS_Init(void)
     }
 
     /*  2.加入Epoll监听文件描述符   */
-    if(epoll_manager_add_fd(g_epoll_manager_fd ,GPS_getFD(), EPOLLIN) < 0)
+    if(Task_Epoll_AttachSerial(&g_gps_epoll_handler, GPS_getFD(), GPS_getStream(), TASK_GPS_FRAME_POLICY) < 0)
     {
         return -1;
     }
 
     /*  3.创建工作线程  */
-    pthread_t tid;
-    if(pthread_create(&tid, NULL, (void *)Task_GPS_WorkThread, NULL) < 0)
+    if(Task_CreateWorkThread(Task_GPS_WorkThread, "GPS", "gps") < 0)
     {
-        printf("Task_GPS_Init:GPS工作线程创建错误\n");
         return -1;
     }
-    usleep(100000);//等待线程创建
-    
+
     return 0;
 }
 
+/*******************************************************************
+ * 函数原型:static int Task_GPS_Reopen(void)
+ * 函数简介:GPS串口挂断后重新打开并加入Epoll监听(重连线程中调用)
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_GPS_Reopen(void)
+{
+    if(GPS_Reopen() < 0)
+    {
+        return -1;
+    }
+
+    return Task_Epoll_AttachSerial(&g_gps_epoll_handler, GPS_getFD(), GPS_getStream(), TASK_GPS_FRAME_POLICY);
+}
+
 /*******************************************************************
  * 函数原型:void *Task_GPS_WorkThread(void *arg)
  * 函数简介:GPS工作线程
@@ -593,32 +1573,22 @@ int Task_GPS_Init(void)
  *****************************************************************/
 void *Task_GPS_WorkThread(void *arg)
 {
+    Rt_enterThread(RT_ROLE_IO);
+
     while(1)
     {
         pthread_mutex_lock(&g_gps_mutex);
-        pthread_cond_wait(&g_gps_cond, &g_gps_mutex);
+        while(g_gps_work_flag != 1)
+        {
+            pthread_cond_wait(&g_gps_cond, &g_gps_mutex);
+        }
         if(g_gps_work_flag == 1)        //开始工作
         {
-            if(GPS_ReadRawData() > 0)
-            {
-                if(GPS_ParseData() != -1)
-                {
-                    char *msg = GPS_DataPackageProcessing();
-                    int len = strlen(msg);
-    
-                    // [新增] 只有当标志位显示“已连接”时，才尝试发送
-                    if(g_connecthost_tcpserConnectFlag == 1) {
-                       TCP_SendData(g_connecthost_tcpser_accept_sock_fd, (unsigned char *)msg, len);
-                        }
-    
-                    memset(msg, 0, len);
-
-                    Database_insertGPSData(g_database, &g_gps_DataPack);
-                }
-            }
             g_gps_work_flag = -1;
-            pthread_mutex_unlock(&g_gps_mutex);
+            Task_GPS_Process();
         }
+        pthread_mutex_unlock(&g_gps_mutex);
+        Task_Epoll_Rearm(&g_gps_epoll_handler, GPS_getFD());
     }
 
     return NULL;
@@ -629,7 +1599,7 @@ void *Task_GPS_WorkThread(void *arg)
  * 函数简介:CTD相关任务初始化
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
+ *****************************************************************/
 int Task_CTD_Init(void)
 {
     /*  CTD初始化   */
@@ -639,7 +1609,7 @@ int Task_CTD_Init(void)
     }
 
     /*  2.加入Epoll监听文件描述符   */
-    if(epoll_manager_add_fd(g_epoll_manager_fd ,CTD_getFD(), EPOLLIN) < 0)
+    if(Task_Epoll_AttachSerial(&g_ctd_epoll_handler, CTD_getFD(), CTD_getStream(), TASK_CTD_FRAME_POLICY) < 0)
     {
         return -1;
     }
@@ -647,17 +1617,30 @@ int Task_CTD_Init(void)
     g_ctd_status = 1;
 
     /*  3.创建工作线程  */
-    pthread_t tid;
-    if(pthread_create(&tid, NULL, (void *)Task_CTD_WorkThread, NULL) < 0)
+    if(Task_CreateWorkThread(Task_CTD_WorkThread, "CTD", "ctd") < 0)
     {
-        printf("Task_CTD_Init:CTD工作线程创建错误\n");
         return -1;
     }
-    usleep(100000);//等待线程创建
 
     return 0;
 }
 
+/*******************************************************************
+ * 函数原型:static int Task_CTD_Reopen(void)
+ * 函数简介:CTD串口挂断后重新打开并加入Epoll监听(重连线程中调用)
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_CTD_Reopen(void)
+{
+    if(CTD_Reopen() < 0)
+    {
+        return -1;
+    }
+
+    return Task_Epoll_AttachSerial(&g_ctd_epoll_handler, CTD_getFD(), CTD_getStream(), TASK_CTD_FRAME_POLICY);
+}
+
 /*******************************************************************
  * 函数原型:void *Task_CTD_WorkThread(void *arg)
  * 函数简介:CTD工作线程
@@ -666,33 +1649,24 @@ int Task_CTD_Init(void)
  *****************************************************************/
 void *Task_CTD_WorkThread(void *arg)
 {
+    Rt_enterThread(RT_ROLE_SENSOR);
+
     while(g_ctd_status == 1)
     {
         pthread_testcancel(); // 取消点
         pthread_mutex_lock(&g_ctd_mutex);
         pthread_testcancel(); // 取消点
-        pthread_cond_wait(&g_ctd_cond, &g_ctd_mutex);
+        while(g_ctd_work_flag != 1 && g_ctd_status == 1)
+        {
+            pthread_cond_wait(&g_ctd_cond, &g_ctd_mutex);
+        }
         if(g_ctd_work_flag == 1)        //开始工作
         {
-            if(CTD_ReadRawData() == 0)
-            {
-                if(CTD_ParseData() == 0)
-                {
-                    char *msg = CTD_DataPackageProcessing();
-                    int len = strlen(msg);
-                    if(g_connecthost_tcpserConnectFlag == 1) {
-                        TCP_SendData(g_connecthost_tcpser_accept_sock_fd, (unsigned char *)msg, len);
-                    }
-                    memset(msg, 0, len);
-                    Database_insertCTDData(g_database, &g_ctdDataPack);
-                    // 2. [新增] 触发定深控制逻辑
-                    // 只有当数据是最新的时候才计算一次控制，完美匹配 1Hz 频率
-                    DepthControl_Loop(g_ctdDataPack.depth);
-                }
-            }
             g_ctd_work_flag = -1;
-            pthread_mutex_unlock(&g_ctd_mutex);
+            Task_CTD_Process();
         }
+        pthread_mutex_unlock(&g_ctd_mutex);
+        Task_Epoll_Rearm(&g_ctd_epoll_handler, CTD_getFD());
     }
 
     return NULL;
@@ -703,7 +1677,7 @@ void *Task_CTD_WorkThread(void *arg)
  * 函数简介:DVL相关任务初始化
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
+ *****************************************************************/
 int Task_DVL_Init(void)
 {
     /*  DVL初始化   */
@@ -724,7 +1698,7 @@ int Task_DVL_Init(void)
     }
 
     /*  3.加入Epoll监听文件描述符   */
-    if(epoll_manager_add_fd(g_epoll_manager_fd ,DVL_getFD(), EPOLLIN) < 0)
+    if(Task_Epoll_AttachSerial(&g_dvl_epoll_handler, DVL_getFD(), DVL_getStream(), TASK_DVL_FRAME_POLICY) < 0)
     {
         return -1;
     }
@@ -732,17 +1706,36 @@ int Task_DVL_Init(void)
     g_dvl_status = 1;
 
     /*  3.创建工作线程  */
-    pthread_t tid;
-    if(pthread_create(&tid, NULL, (void *)Task_DVL_WorkThread, NULL) < 0)
+    if(Task_CreateWorkThread(Task_DVL_WorkThread, "DVL", "dvl") < 0)
     {
-        printf("Task_DVL_Init:DVL工作线程创建错误\n");
         return -1;
     }
-    usleep(100000);//等待线程创建
 
     return 0;
 }
 
+/*******************************************************************
+ * 函数原型:static int Task_DVL_Reopen(void)
+ * 函数简介:DVL串口挂断后重新打开、重发上电配置指令并加入Epoll监听(重连线程中调用)
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_DVL_Reopen(void)
+{
+    if(DVL_Reopen() < 0)
+    {
+        return -1;
+    }
+
+    /*  重新上电的DVL需要重新配置 */
+    if(DVL_SendCmd_OpenDVLDevice() < 0 || DVL_SendCmd_SetDVLSendFreq() < 0)
+    {
+        return -1;
+    }
+
+    return Task_Epoll_AttachSerial(&g_dvl_epoll_handler, DVL_getFD(), DVL_getStream(), TASK_DVL_FRAME_POLICY);
+}
+
 /*******************************************************************
  * 函数原型:void *Task_DVL_WorkThread(void *arg)
  * 函数简介:DVL工作线程
@@ -751,37 +1744,24 @@ int Task_DVL_Init(void)
  *****************************************************************/
 void *Task_DVL_WorkThread(void *arg)
 {
+    Rt_enterThread(RT_ROLE_SENSOR);
+
     while(g_dvl_status == 1)
     {
         pthread_testcancel(); // 取消点
         pthread_mutex_lock(&g_dvl_mutex);
         pthread_testcancel(); // 取消点
-        pthread_cond_wait(&g_dvl_cond, &g_dvl_mutex);
+        while(g_dvl_work_flag != 1 && g_dvl_status == 1)
+        {
+            pthread_cond_wait(&g_dvl_cond, &g_dvl_mutex);
+        }
         if(g_dvl_work_flag == 1)        //开始工作
         {
-            if(DVL_ReadRawData() == 0)
-            {
-                if(DVL_ParseData() == 0)
-                {
-                    char *msg = DVL_DataPackageProcessing();
-                    int len = strlen(msg);
-                    if(g_connecthost_tcpserConnectFlag == 1) {
-                        TCP_SendData(g_connecthost_tcpser_accept_sock_fd, (unsigned char *)msg, len);
-                    }
-                    memset(msg, 0, len);
-
-                    Database_insertDVLData(g_database, &g_dvlDataPack);
-                    // 2. [新增] 触发定高控制逻辑
-                    // 1Hz 更新率，使用 buttomDistance (注意原文件拼写是 u)
-                    AltitudeControl_Loop(g_dvlDataPack.buttomDistance);
-                    // [新增] 导航控制 (挂载在这里！)
-                    // 利用 DVL 提供的航向角 (heading) 进行控制
-                    Nav_Loop(g_dvlDataPack.heading);
-                }
-            }
             g_dvl_work_flag = -1;
-            pthread_mutex_unlock(&g_dvl_mutex);
+            Task_DVL_Process();
         }
+        pthread_mutex_unlock(&g_dvl_mutex);
+        Task_Epoll_Rearm(&g_dvl_epoll_handler, DVL_getFD());
     }
 
     return NULL;
@@ -792,7 +1772,7 @@ void *Task_DVL_WorkThread(void *arg)
  * 函数简介:数传电台相关任务初始化
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
+ *****************************************************************/
 int Task_DTU_Init(void)
 {
     /*  1.DTU初始化   */
@@ -802,7 +1782,7 @@ int Task_DTU_Init(void)
     }
 
     /*  2.加入Epoll监听文件描述符   */
-    if(epoll_manager_add_fd(g_epoll_manager_fd ,DTU_getFD(), EPOLLIN) < 0)
+    if(Task_Epoll_AttachSerial(&g_dtu_epoll_handler, DTU_getFD(), DTU_getStream(), TASK_DTU_FRAME_POLICY) < 0)
     {
         return -1;
     }
@@ -810,17 +1790,30 @@ int Task_DTU_Init(void)
     g_dtu_status = 1;
 
     /*  3.创建工作线程  */
-    pthread_t tid;
-    if(pthread_create(&tid, NULL, (void *)Task_DTU_WorkThread, NULL) < 0)
+    if(Task_CreateWorkThread(Task_DTU_WorkThread, "数传电台", "dtu") < 0)
     {
-        printf("Task_DTU_Init:数传电台工作线程创建错误\n");
         return -1;
     }
-    usleep(100000);//等待线程创建
 
     return 0;
 }
 
+/*******************************************************************
+ * 函数原型:static int Task_DTU_Reopen(void)
+ * 函数简介:DTU串口挂断后重新打开并加入Epoll监听(重连线程中调用)
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_DTU_Reopen(void)
+{
+    if(DTU_Reopen() < 0)
+    {
+        return -1;
+    }
+
+    return Task_Epoll_AttachSerial(&g_dtu_epoll_handler, DTU_getFD(), DTU_getStream(), TASK_DTU_FRAME_POLICY);
+}
+
 /*******************************************************************
  * 函数原型:void *Task_DTU_WorkThread(void *arg)
  * 函数简介:数传电台工作线程
@@ -829,23 +1822,24 @@ int Task_DTU_Init(void)
  *****************************************************************/
 void *Task_DTU_WorkThread(void *arg)
 {
+    Rt_enterThread(RT_ROLE_COMMAND);
+
     while(g_dtu_status == 1)
     {
         pthread_testcancel(); // 取消点
         pthread_mutex_lock(&g_dtu_mutex);
         pthread_testcancel(); // 取消点
-        pthread_cond_wait(&g_dtu_cond, &g_dtu_mutex);
+        while(g_dtu_work_flag != 1 && g_dtu_status == 1)
+        {
+            pthread_cond_wait(&g_dtu_cond, &g_dtu_mutex);
+        }
         if(g_dtu_work_flag == 1)        //开始工作
         {
-            if(DTU_RecvData() > 0)
-            {
-                DTU_ParseData();
-
-                Database_insertDTURecvData(g_database, g_dtu_recvbuf);
-            }
             g_dtu_work_flag = -1;
-            pthread_mutex_unlock(&g_dtu_mutex);
+            Task_DTU_Process();
         }
+        pthread_mutex_unlock(&g_dtu_mutex);
+        Task_Epoll_Rearm(&g_dtu_epoll_handler, DTU_getFD());
     }
 
     printf("DTU工作线程已退出\n");
@@ -857,7 +1851,7 @@ void *Task_DTU_WorkThread(void *arg)
  * 函数简介:USBL相关任务初始化
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
+ *****************************************************************/
 int Task_USBL_Init(void)
 {
     /*  1.USBL初始化   */
@@ -867,7 +1861,7 @@ int Task_USBL_Init(void)
     }
 
     /*  2.加入Epoll监听文件描述符   */
-    if(epoll_manager_add_fd(g_epoll_manager_fd ,USBL_getFD(), EPOLLIN) < 0)
+    if(Task_Epoll_AttachSerial(&g_usbl_epoll_handler, USBL_getFD(), USBL_getStream(), TASK_USBL_FRAME_POLICY) < 0)
     {
         return -1;
     }
@@ -875,17 +1869,30 @@ int Task_USBL_Init(void)
     g_usbl_status = 1;
 
     /*  3.创建工作线程  */
-    pthread_t tid;
-    if(pthread_create(&tid, NULL, (void *)Task_USBL_WorkThread, NULL) < 0)
+    if(Task_CreateWorkThread(Task_USBL_WorkThread, "USBL", "usbl") < 0)
     {
-        printf("Task_USBL_Init:USBL工作线程创建错误\n");
         return -1;
     }
-    usleep(100000);//等待线程创建
 
     return 0;
 }
 
+/*******************************************************************
+ * 函数原型:static int Task_USBL_Reopen(void)
+ * 函数简介:USBL串口挂断后重新打开并加入Epoll监听(重连线程中调用)
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_USBL_Reopen(void)
+{
+    if(USBL_Reopen() < 0)
+    {
+        return -1;
+    }
+
+    return Task_Epoll_AttachSerial(&g_usbl_epoll_handler, USBL_getFD(), USBL_getStream(), TASK_USBL_FRAME_POLICY);
+}
+
 /*******************************************************************
  * 函数原型:void *Task_USBL_WorkThread(void *arg)
  * 函数简介:USBL工作线程
@@ -894,24 +1901,24 @@ int Task_USBL_Init(void)
  *****************************************************************/
 void *Task_USBL_WorkThread(void *arg)
 {
+    Rt_enterThread(RT_ROLE_COMMAND);
+
     while(g_usbl_status == 1)
     {
         pthread_testcancel(); // 取消点
         pthread_mutex_lock(&g_usbl_mutex);
         pthread_testcancel(); // 取消点
-        pthread_cond_wait(&g_usbl_cond, &g_usbl_mutex);
+        while(g_usbl_work_flag != 1 && g_usbl_status == 1)
+        {
+            pthread_cond_wait(&g_usbl_cond, &g_usbl_mutex);
+        }
         if(g_usbl_work_flag == 1)        //开始工作
         {
-            if(USBL_ReadRawData() > 0)
-            {
-                if(USBL_ParseData() == 0)
-                {
-                    Database_insertUSBLData(g_database, &g_usbl_dataPack);
-                }
-            }
             g_usbl_work_flag = -1;
-            pthread_mutex_unlock(&g_usbl_mutex);
+            Task_USBL_Process();
         }
+        pthread_mutex_unlock(&g_usbl_mutex);
+        Task_Epoll_Rearm(&g_usbl_epoll_handler, USBL_getFD());
     }
 
     printf("USBL工作线程已退出\n");
@@ -923,7 +1930,7 @@ void *Task_USBL_WorkThread(void *arg)
  * 函数简介:Sonar相关任务初始化
  * 函数参数:无
  * 函数返回值: 成功返回0，失败返回-1
- *****************************************************************/ 
+ *****************************************************************/
 int Task_Sonar_Init(void)
 {
     /*  1.Sonar初始化   */
@@ -939,7 +1946,7 @@ int Task_Sonar_Init(void)
     }
 
     /*  3.加入Epoll监听文件描述符   */
-    if(epoll_manager_add_fd(g_epoll_manager_fd ,Sonar_getFD(), EPOLLIN) < 0)
+    if(Task_Epoll_AttachSerial(&g_sonar_epoll_handler, Sonar_getFD(), Sonar_getStream(), TASK_SONAR_FRAME_POLICY) < 0)
     {
         return -1;
     }
@@ -947,13 +1954,42 @@ int Task_Sonar_Init(void)
     g_sonar_status = 1;
 
     /*  3.创建工作线程  */
-    pthread_t tid;
-    if(pthread_create(&tid, NULL, (void *)Task_Sonar_WorkThread, NULL) < 0)
+    if(Task_CreateWorkThread(Task_Sonar_WorkThread, "Sonar", "sonar") < 0)
     {
-        printf("Task_Sonar_Init:Sonar工作线程创建错误\n");
         return -1;
     }
-    usleep(100000);//等待线程创建
+
+    /*  4.请求第一帧数据，之后每处理完一帧再请求下一帧   */
+    Sonar_SendDataRequest();
+
+    return 0;
+}
+
+/*******************************************************************
+ * 函数原型:static int Task_Sonar_Reopen(void)
+ * 函数简介:Sonar串口挂断后重新打开、重发上电配置并加入Epoll监听，再请求一帧数据(重连线程中调用)
+ * 函数参数:无
+ * 函数返回值: 成功返回0，失败返回-1
+ *****************************************************************/
+static int Task_Sonar_Reopen(void)
+{
+    if(Sonar_Reopen() < 0)
+    {
+        return -1;
+    }
+
+    if(Sonar_writeCmd_mtStopAlive() < 0 || Sonar_writeCmd_mtSendVersion() < 0 || Sonar_writeCmd_mtHeadCommand() < 0)
+    {
+        return -1;
+    }
+
+    if(Task_Epoll_AttachSerial(&g_sonar_epoll_handler, Sonar_getFD(), Sonar_getStream(), TASK_SONAR_FRAME_POLICY) < 0)
+    {
+        return -1;
+    }
+
+    /*  一问一答，挂断时未答复的请求已丢失   */
+    Sonar_SendDataRequest();
 
     return 0;
 }
@@ -966,27 +2002,24 @@ int Task_Sonar_Init(void)
  *****************************************************************/
 void *Task_Sonar_WorkThread(void *arg)
 {
+    Rt_enterThread(RT_ROLE_IO);
+
     while(g_sonar_status == 1)
     {
-        Sonar_SendDataRequest();
-
         pthread_testcancel(); // 取消点
         pthread_mutex_lock(&g_sonar_mutex);
         pthread_testcancel(); // 取消点
-        pthread_cond_wait(&g_sonar_cond, &g_sonar_mutex);
+        while(g_sonar_work_flag != 1 && g_sonar_status == 1)
+        {
+            pthread_cond_wait(&g_sonar_cond, &g_sonar_mutex);
+        }
         if(g_sonar_work_flag == 1)        //开始工作
         {
-            if(Sonar_ReadRawData() == 0)
-            {
-                if(Sonar_ParseData() == 0)
-                {
-                    Database_insertSonarData(g_database, &g_sonar_dataPack);
-                }
-            }
+            g_sonar_work_flag = -1;
+            Task_Sonar_Process();
         }
-
-        g_sonar_work_flag = -1;
         pthread_mutex_unlock(&g_sonar_mutex);
+        Task_Epoll_Rearm(&g_sonar_epoll_handler, Sonar_getFD());
     }
 
     printf("Sonar工作线程已退出\n");
@@ -3,22 +3,50 @@
 
 #include <pthread.h>
 
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  运行模式    */
+typedef enum
+{
+    TASK_RUN_MODE_THREAD = 0,           //多线程:每个设备一个工作线程，由Epoll线程唤醒(默认)
+    TASK_RUN_MODE_EVENTLOOP,            //事件循环:所有设备在Epoll线程中直接读取、解析、发布
+}TaskRunMode;
+
 /************************************************************************************
  									函数原型
 *************************************************************************************/
+/*  运行模式(在Task_Epoll_Init之前设置)  */
+int Task_SetRunMode(TaskRunMode mode);
+TaskRunMode Task_GetRunMode(void);
+
+/*  推进器反馈轮询(在Task_Thruster_Init之前设置，默认关闭)  */
+void Task_SetThrusterTelemetry(int enable);
+
 /*	数据库相关任务初始化	*/
 int Task_Database_Init(void);
 
+/*	二进制日志:DVL、声纳、推进器反馈改为写入二进制日志(在Task_Database_Init之后)	*/
+int Task_Binlog_Init(void);
+
 /*	Epoll相关任务初始化	*/
 int Task_Epoll_Init(void);
 void *Task_Epoll_WorkThread(void *arg);
 
 /*  主控舱相关任务初始化    */
 int Task_MainCabin_Init(void);
+int Task_MainCabin_Attach(void);
 void *Task_MainCabin_WorkThread(void *arg);
 
 /*  推进器相关任务初始化    */
 int Task_Thruster_Init(void);
+void *Task_Thruster_WorkThread(void *arg);
+
+/*  控制执行器初始化    */
+int Task_Control_Init(void);
+
+/*  运行指标(Prometheus文本格式)    */
+int Task_Metrics_Init(const char *addr);
 
 /*  上位机连接相关任务初始化    */
 int Task_ConnectHost_Init(void);
@@ -48,6 +76,9 @@ void *Task_USBL_WorkThread(void *arg);
 int Task_Sonar_Init(void);
 void *Task_Sonar_WorkThread(void *arg);
 
+/*  串口接收统计    */
+void Task_PrintSerialStats(void);
+
 
 #endif
 
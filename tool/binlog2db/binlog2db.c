@@ -0,0 +1,236 @@
+/************************************************************************************
+					文件名：binlog2db.c
+					描述：二进制日志转换工具。读取sys/binlog写下的段文件，按段头中登记的
+						  记录名称找到对应的表，经Database的插入函数写入与运行时相同格式的
+						  数据库(运行编号、时间戳与记录时一致)。
+					用法：./binlog2db [-a] [-o 输出.db] ../../binlog/<运行编号>-*.blog
+ ************************************************************************************/
+
+#include "../../sys/binlog/binlog.h"
+#include "../../sys/sqlite3_db/Database.h"
+#include "../../sys/clock/clock.h"
+
+
+/************************************************************************************
+ 									数据类型
+*************************************************************************************/
+/*  一种记录:登记的名称、数据大小、写入数据库的函数  */
+typedef struct
+{
+    const char *name;
+    size_t size;
+    int (*insert)(sqlite3 *db, const void *data, int64_t stampNs);
+    unsigned long count;
+}binlog2dbType_t;
+
+
+/************************************************************************************
+ 									辅助函数(仅本文件可使用)
+*************************************************************************************/
+/*  记录中的数据按8字节对齐存放，拷贝出来再交给插入函数    */
+static int Binlog2db_insertDVL(sqlite3 *db, const void *data, int64_t stampNs)
+{
+    dvlDataPack_t pack;
+    memcpy(&pack, data, sizeof(pack));
+    return Database_insertDVLData(db, &pack, stampNs);
+}
+
+static int Binlog2db_insertSonar(sqlite3 *db, const void *data, int64_t stampNs)
+{
+    sonarDataPack_t pack;
+    memcpy(&pack, data, sizeof(pack));
+    return Database_insertSonarData(db, &pack, stampNs);
+}
+
+static int Binlog2db_insertThruster(sqlite3 *db, const void *data, int64_t stampNs)
+{
+    thrusterDataPack_t pack;
+    memcpy(&pack, data, sizeof(pack));
+    return Database_insertThrusterData(db, &pack, stampNs);
+}
+
+
+/************************************************************************************
+ 									全局变量(仅可本文件使用)
+*************************************************************************************/
+/*  能转换的记录(名称与数据库表名一致)    */
+static binlog2dbType_t g_binlog2db_types[] = {
+    {"DVL",      sizeof(dvlDataPack_t),      Binlog2db_insertDVL,      0},
+    {"Sonar",    sizeof(sonarDataPack_t),    Binlog2db_insertSonar,    0},
+    {"Thruster", sizeof(thrusterDataPack_t), Binlog2db_insertThruster, 0},
+};
+
+#define BINLOG2DB_TYPE_NUM      (int)(sizeof(g_binlog2db_types) / sizeof(g_binlog2db_types[0]))
+
+
+/*******************************************************************
+* 函数原型:static void Binlog2db_mapTypes(const binlogSegmentHeader_t *header, int map[BINLOG_MAX_TYPES])
+* 函数简介:按段头中登记的名称和大小找到每种记录的转换方式
+* 函数参数:header:段头
+* 函数参数:map:输出，记录类型对应g_binlog2db_types的下标，不能转换为-1
+* 函数返回值:无
+*****************************************************************/
+static void Binlog2db_mapTypes(const binlogSegmentHeader_t *header, int map[BINLOG_MAX_TYPES])
+{
+    for(int id = 0; id < BINLOG_MAX_TYPES; id++)
+    {
+        const binlogTypeDesc_t *desc = &header->types[id];
+
+        map[id] = -1;
+        if(desc->size == 0)
+        {
+            continue;
+        }
+        for(int i = 0; i < BINLOG2DB_TYPE_NUM; i++)
+        {
+            if(strncmp(desc->name, g_binlog2db_types[i].name, sizeof(desc->name)) != 0)
+            {
+                continue;
+            }
+            if(desc->size != g_binlog2db_types[i].size)
+            {
+                printf("记录%.*s:大小%u与当前程序的%zu不一致(数据结构已修改)，跳过\n", (int)sizeof(desc->name), desc->name,
+                       desc->size, g_binlog2db_types[i].size);
+                break;
+            }
+            map[id] = i;
+            break;
+        }
+        if(map[id] < 0)
+        {
+            printf("记录%.*s:不能转换，跳过\n", (int)sizeof(desc->name), desc->name);
+        }
+    }
+}
+
+/*******************************************************************
+* 函数原型:static void Binlog2db_PrintUsage(const char *prog)
+* 函数简介:打印命令行参数说明
+* 函数参数:prog:程序名
+* 函数返回值:无
+*****************************************************************/
+static void Binlog2db_PrintUsage(const char *prog)
+{
+    printf("用法: %s [-a] [-o 输出.db] 段文件...\n", prog);
+    printf("  -a  也转换未封存的块(异常退出时最后不到%d毫秒的数据，没有CRC保护)\n", BINLOG_FLUSH_MS);
+    printf("  -o  输出的数据库文件(默认<运行编号>.db，已存在时追加)\n");
+}
+
+
+int main(int argc, const char *argv[])
+{
+    const char *outPath = NULL;
+    int acceptOpen = 0;
+    int first = argc;
+
+    /*  0.命令行参数    */
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-a") == 0)
+        {
+            acceptOpen = 1;
+        }
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else if(argv[i][0] == '-')
+        {
+            Binlog2db_PrintUsage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            first = i;
+            break;
+        }
+    }
+    if(first >= argc)
+    {
+        Binlog2db_PrintUsage(argv[0]);
+        return 1;
+    }
+
+    /*  1.第一个段决定运行编号和时间换算，输出与运行时相同格式的数据库    */
+    binlogReader_t reader;
+    if(Binlog_openReader(&reader, argv[first], acceptOpen) < 0)
+    {
+        return 1;
+    }
+    int64_t run = reader.header->run;
+    char defaultPath[64];
+    snprintf(defaultPath, sizeof(defaultPath), "%lld.db", (long long)run);
+    Clock_setEpochOffsetNs(reader.header->epochOffsetNs);
+    Binlog_closeReader(&reader);
+
+    databaseConfig_t config = {
+        .wal = 0,
+        .synchronous = DATABASE_SYNC_OFF,
+        .pageSize = DATABASE_PAGE_SIZE,
+        .checkpointMs = 0,
+        .checkpointPages = DATABASE_CHECKPOINT_PAGES,
+        .path = outPath != NULL ? outPath : defaultPath,
+        .run = run
+    };
+    sqlite3 *db = Database_init(NULL, &config);
+    if(db == NULL)
+    {
+        return 1;
+    }
+
+    /*  2.逐个段、逐条记录写入    */
+    unsigned long records = 0, skipped = 0, failed = 0, badBlocks = 0, openBlocks = 0;
+    for(int i = first; i < argc; i++)
+    {
+        if(Binlog_openReader(&reader, argv[i], acceptOpen) < 0)
+        {
+            continue;
+        }
+        if(reader.header->run != run)
+        {
+            printf("%s:运行编号%lld与第一个段不同，跳过\n", argv[i], (long long)reader.header->run);
+            Binlog_closeReader(&reader);
+            continue;
+        }
+
+        int map[BINLOG_MAX_TYPES];
+        Binlog2db_mapTypes(reader.header, map);
+
+        const binlogRecordHeader_t *rec;
+        const void *data;
+        while(Binlog_nextRecord(&reader, &rec, &data) == 1)
+        {
+            int t = rec->type < BINLOG_MAX_TYPES ? map[rec->type] : -1;
+            if(t < 0 || rec->size != g_binlog2db_types[t].size)
+            {
+                skipped++;
+                continue;
+            }
+            if(g_binlog2db_types[t].insert(db, data, rec->stampNs) < 0)
+            {
+                failed++;
+                continue;
+            }
+            g_binlog2db_types[t].count++;
+            records++;
+        }
+
+        printf("%s:段%u，CRC错误块%lu，未封存块%lu%s\n", argv[i], reader.header->segmentSeq, reader.badBlocks,
+               reader.openBlocks, (reader.openBlocks > 0 && !acceptOpen) ? "(未转换，加-a转换)" : "");
+        badBlocks += reader.badBlocks;
+        openBlocks += reader.openBlocks;
+        Binlog_closeReader(&reader);
+    }
+
+    Database_close(db);
+
+    /*  3.汇总  */
+    printf("已写入%s:%lu条(", config.path, records);
+    for(int i = 0; i < BINLOG2DB_TYPE_NUM; i++)
+    {
+        printf("%s%s:%lu", i ? " " : "", g_binlog2db_types[i].name, g_binlog2db_types[i].count);
+    }
+    printf(")，跳过%lu条，写入失败%lu条，CRC错误块%lu，未封存块%lu\n", skipped, failed, badBlocks, openBlocks);
+
+    return badBlocks > 0 || failed > 0;
+}
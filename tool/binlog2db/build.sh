@@ -0,0 +1,4 @@
+#! /bin/bash
+
+# 二进制日志转换工具，与主程序共用Database的建表和插入
+gcc binlog2db.c ../../sys/binlog/binlog.c ../../sys/sqlite3_db/Database.c ../../sys/clock/clock.c ../../sys/trace/trace.c ../../sys/pool/pool.c ../../sys/ring/ring.c ../../sys/log/log.c ../../sys/rt/rt.c ../../sys/procstat/procstat.c -o binlog2db -lpthread -lm -lsqlite3 -Wall
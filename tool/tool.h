@@ -22,6 +22,7 @@
 float Tool_parseIEEE754(const unsigned int data);
 int Tool_floatCompare(float a, float b);
 int Tool_getSerialportReadBufferCount(int fd);
+unsigned short Tool_modbusCRC16(const unsigned char *data, size_t len);
  
  
 #endif 